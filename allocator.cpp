@@ -0,0 +1,378 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "allocator.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+
+/// Granularity of the size classes of the arena allocator, in bytes.
+///
+/// This is also the alignment of the blocks returned by the arena, and thus
+/// must be suitable for any Lua object.
+static const std::size_t class_granularity = 16;
+
+
+/// Number of size classes of the arena allocator.
+static const std::size_t num_classes = 32;
+
+
+/// Largest block served from the chunks of the arena allocator, in bytes.
+static const std::size_t max_small_size = class_granularity * num_classes;
+
+
+/// Default size of the chunks of the arena allocator, in bytes.
+static const std::size_t default_chunk_size = 64 * 1024;
+
+
+/// Computes the size class of a small block.
+///
+/// \param size The size of the block.  Must be between 1 and max_small_size.
+///
+/// \return The index of the size class.
+static std::size_t
+class_of(const std::size_t size)
+{
+    assert(size > 0 && size <= max_small_size);
+    return (size - 1) / class_granularity;
+}
+
+
+}  // anonymous namespace
+
+
+/// Constructs a new allocator without a limit.
+lutok::allocator::allocator(void) :
+    _bytes_in_use(0),
+    _peak_bytes(0),
+    _limit(0)
+{
+}
+
+
+/// Destructor.
+lutok::allocator::~allocator(void)
+{
+}
+
+
+/// Resizes, allocates or releases a block of memory.
+///
+/// This has the semantics of the lua_Alloc function type, except that old_size
+/// must be 0 when ptr is NULL.
+///
+/// \param ptr The block to resize or release, or NULL to allocate a new block.
+/// \param old_size The size of the block pointed to by ptr, or 0 if ptr is
+///     NULL.
+/// \param new_size The new size of the block, or 0 to release it.
+///
+/// \return The new block, or NULL if new_size is 0.  If the block cannot be
+/// allocated, either because memory is exhausted or because the request would
+/// exceed the limit, returns NULL and leaves ptr untouched.
+void*
+lutok::allocator::reallocate(void* ptr, const std::size_t old_size,
+                             const std::size_t new_size) throw()
+{
+    assert(ptr != NULL || old_size == 0);
+    assert(old_size <= _bytes_in_use);
+
+    if (new_size > old_size && _limit != 0 &&
+        _bytes_in_use - old_size + new_size > _limit)
+        return NULL;
+
+    void* new_ptr = do_reallocate(ptr, old_size, new_size);
+    if (new_ptr != NULL || new_size == 0) {
+        _bytes_in_use = _bytes_in_use - old_size + new_size;
+        if (_bytes_in_use > _peak_bytes)
+            _peak_bytes = _bytes_in_use;
+    }
+    return new_ptr;
+}
+
+
+/// Gets the number of bytes currently handed out.
+///
+/// \return The sum of the sizes of all live blocks, as requested by Lua.
+std::size_t
+lutok::allocator::bytes_in_use(void) const
+{
+    return _bytes_in_use;
+}
+
+
+/// Gets the maximum number of bytes that have ever been handed out at once.
+///
+/// \return The peak value of bytes_in_use().
+std::size_t
+lutok::allocator::peak_bytes(void) const
+{
+    return _peak_bytes;
+}
+
+
+/// Gets the current limit.
+///
+/// \return The maximum number of bytes that can be handed out, or 0 if there is
+/// no limit.
+std::size_t
+lutok::allocator::limit(void) const
+{
+    return _limit;
+}
+
+
+/// Sets a limit on the memory that can be handed out.
+///
+/// Lowering the limit below bytes_in_use() does not release any memory but
+/// causes any further request to grow memory to fail.
+///
+/// \param limit_ The maximum number of bytes that can be handed out, or 0 to
+///     remove the limit.
+void
+lutok::allocator::set_limit(const std::size_t limit_)
+{
+    _limit = limit_;
+}
+
+
+/// Constructs a new allocator backed by malloc.
+lutok::malloc_allocator::malloc_allocator(void)
+{
+}
+
+
+/// Destructor.
+lutok::malloc_allocator::~malloc_allocator(void)
+{
+}
+
+
+/// Resizes, allocates or releases a block of memory with realloc and free.
+///
+/// \param ptr The block to resize or release, or NULL to allocate a new block.
+/// \param unused_old_size The size of the block pointed to by ptr.
+/// \param new_size The new size of the block, or 0 to release it.
+///
+/// \return The new block, or NULL if new_size is 0 or on failure.
+void*
+lutok::malloc_allocator::do_reallocate(
+    void* ptr, const std::size_t /* unused_old_size */,
+    const std::size_t new_size) throw()
+{
+    if (new_size == 0) {
+        std::free(ptr);
+        return NULL;
+    } else
+        return std::realloc(ptr, new_size);
+}
+
+
+/// Internal implementation for lutok::arena_allocator.
+struct lutok::arena_allocator::impl {
+    /// Size of the chunks to allocate, in bytes.
+    std::size_t chunk_size;
+
+    /// All the chunks allocated so far.
+    std::vector< char* > chunks;
+
+    /// Next free byte in the current chunk.
+    char* next;
+
+    /// End of the current chunk.
+    char* end;
+
+    /// Heads of the lists of released blocks, one per size class.
+    ///
+    /// Released blocks are chained through their first word.
+    void* free_lists[num_classes];
+
+    /// Constructor.
+    ///
+    /// \param chunk_size_ Size of the chunks to allocate.
+    impl(const std::size_t chunk_size_) :
+        chunk_size(chunk_size_),
+        next(NULL),
+        end(NULL)
+    {
+        std::memset(free_lists, 0, sizeof(free_lists));
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        for (std::vector< char* >::const_iterator iter = chunks.begin();
+             iter != chunks.end(); ++iter)
+            std::free(*iter);
+    }
+
+    /// Obtains a block of a given size class.
+    ///
+    /// \param size_class The size class of the block.
+    ///
+    /// \return The new block, or NULL if memory is exhausted.
+    void*
+    allocate_small(const std::size_t size_class) throw()
+    {
+        void* block = free_lists[size_class];
+        if (block != NULL) {
+            free_lists[size_class] = *static_cast< void** >(block);
+            return block;
+        }
+
+        const std::size_t block_size = (size_class + 1) * class_granularity;
+        if (static_cast< std::size_t >(end - next) < block_size) {
+            char* chunk = static_cast< char* >(std::malloc(chunk_size));
+            if (chunk == NULL)
+                return NULL;
+            try {
+                chunks.push_back(chunk);
+            } catch (...) {
+                std::free(chunk);
+                return NULL;
+            }
+            next = chunk;
+            end = chunk + chunk_size;
+        }
+        block = next;
+        next += block_size;
+        return block;
+    }
+
+    /// Returns a block to the list of its size class.
+    ///
+    /// \param block The block to release.
+    /// \param size_class The size class of the block.
+    void
+    release_small(void* block, const std::size_t size_class) throw()
+    {
+        *static_cast< void** >(block) = free_lists[size_class];
+        free_lists[size_class] = block;
+    }
+};
+
+
+/// Constructs a new arena allocator with the default chunk size.
+lutok::arena_allocator::arena_allocator(void) :
+    _pimpl(new impl(default_chunk_size))
+{
+}
+
+
+/// Constructs a new arena allocator.
+///
+/// \param chunk_size The size of the chunks to request from the system, in
+///     bytes.  Values smaller than the largest small block are rounded up.
+lutok::arena_allocator::arena_allocator(const std::size_t chunk_size) :
+    _pimpl(new impl(chunk_size < max_small_size ? max_small_size : chunk_size))
+{
+}
+
+
+/// Destructor.
+///
+/// Returns all chunks to the system at once.
+lutok::arena_allocator::~arena_allocator(void)
+{
+}
+
+
+/// Resizes, allocates or releases a block of memory from the arena.
+///
+/// \param ptr The block to resize or release, or NULL to allocate a new block.
+/// \param old_size The size of the block pointed to by ptr, or 0 if ptr is
+///     NULL.
+/// \param new_size The new size of the block, or 0 to release it.
+///
+/// \return The new block, or NULL if new_size is 0 or on failure.
+void*
+lutok::arena_allocator::do_reallocate(void* ptr, const std::size_t old_size,
+                                      const std::size_t new_size) throw()
+{
+    const bool old_small = old_size <= max_small_size;
+    const bool new_small = new_size <= max_small_size;
+
+    if (new_size == 0) {
+        if (ptr != NULL) {
+            if (old_small)
+                _pimpl->release_small(ptr, class_of(old_size));
+            else
+                std::free(ptr);
+        }
+        return NULL;
+    }
+
+    if (ptr == NULL) {
+        if (new_small)
+            return _pimpl->allocate_small(class_of(new_size));
+        else
+            return std::malloc(new_size);
+    }
+
+    if (old_small && new_small) {
+        // A block can serve any request of its own size class or smaller
+        // ones.  Blocks released with a smaller size than they were obtained
+        // with end up in the list of the smaller class, which is safe.
+        if (class_of(new_size) <= class_of(old_size))
+            return ptr;
+    } else if (!old_small && !new_small)
+        return std::realloc(ptr, new_size);
+
+    void* new_ptr;
+    if (new_small)
+        new_ptr = _pimpl->allocate_small(class_of(new_size));
+    else
+        new_ptr = std::malloc(new_size);
+    if (new_ptr == NULL) {
+        // Shrinking requests must not fail.  If we cannot move a large block
+        // into the arena, keep it; it will never be returned to the system
+        // but this can only happen when we are already out of memory.
+        return new_size < old_size ? ptr : NULL;
+    }
+    std::memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    if (old_small)
+        _pimpl->release_small(ptr, class_of(old_size));
+    else
+        std::free(ptr);
+    return new_ptr;
+}
+
+
+/// Gets the number of chunks allocated so far.
+///
+/// \return The number of chunks held by the arena.
+std::size_t
+lutok::arena_allocator::chunks(void) const
+{
+    return _pimpl->chunks.size();
+}
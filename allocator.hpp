@@ -0,0 +1,154 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file allocator.hpp
+/// Provides memory allocators for Lua states.
+
+#if !defined(LUTOK_ALLOCATOR_HPP)
+#define LUTOK_ALLOCATOR_HPP
+
+#include <cstddef>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+/// Base class for the memory allocators of Lua states.
+///
+/// An allocator is handed to a state on construction and serves all the memory
+/// requests of that state from then on.  The allocator must remain alive until
+/// the state is closed.
+///
+/// This class keeps track of the number of bytes handed out to Lua and can
+/// enforce an upper limit on them, which is a cheap way of bounding the memory
+/// that a state can consume.  When the limit is reached, allocation requests
+/// fail and Lua reports them as memory errors.
+///
+/// Subclasses only need to implement do_reallocate().
+class allocator {
+    /// Number of bytes currently handed out to Lua.
+    std::size_t _bytes_in_use;
+
+    /// Maximum value ever reached by _bytes_in_use.
+    std::size_t _peak_bytes;
+
+    /// Maximum number of bytes that can be handed out; 0 for no limit.
+    std::size_t _limit;
+
+    /// Disallow copies.
+    allocator(const allocator&);
+
+    /// Disallow assignment.
+    allocator& operator=(const allocator&);
+
+protected:
+    /// Resizes, allocates or releases a block of memory.
+    ///
+    /// \param ptr The block to resize or release, or NULL to allocate a new
+    ///     block.
+    /// \param old_size The size of the block pointed to by ptr, or 0 if ptr is
+    ///     NULL.
+    /// \param new_size The new size of the block, or 0 to release it.
+    ///
+    /// \return The new block, or NULL if new_size is 0.  If the request cannot
+    /// be satisfied, returns NULL and leaves ptr untouched.  Implementations
+    /// must not fail when new_size is not larger than old_size.
+    virtual void* do_reallocate(void* ptr, const std::size_t old_size,
+                                const std::size_t new_size) throw() = 0;
+
+public:
+    allocator(void);
+    virtual ~allocator(void);
+
+    void* reallocate(void*, const std::size_t, const std::size_t) throw();
+
+    std::size_t bytes_in_use(void) const;
+    std::size_t peak_bytes(void) const;
+    std::size_t limit(void) const;
+    void set_limit(const std::size_t);
+};
+
+
+/// Allocator that delegates to the system's malloc.
+///
+/// This behaves like the default allocator of Lua but, being an allocator,
+/// accounts for the memory used by the state and can limit it.
+class malloc_allocator : public allocator {
+protected:
+    void* do_reallocate(void*, const std::size_t, const std::size_t) throw();
+
+public:
+    malloc_allocator(void);
+    ~malloc_allocator(void);
+};
+
+
+/// Allocator that carves small blocks out of large chunks of memory.
+///
+/// Small blocks are grouped in size classes and served from a bump pointer
+/// within the current chunk or, if available, from a per-class list of blocks
+/// previously released by Lua.  Large blocks are delegated to malloc.  The
+/// chunks are only returned to the system when the allocator is destroyed, so
+/// tearing down a state costs as much as pushing its blocks onto the free
+/// lists plus a handful of calls to free.
+///
+/// Because blocks are recycled, an arena can be used for several states in
+/// sequence, but not for several states at once.
+///
+/// \warning The allocator must not be destroyed while any state using it is
+/// still open.
+class arena_allocator : public allocator {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+protected:
+    void* do_reallocate(void*, const std::size_t, const std::size_t) throw();
+
+public:
+    arena_allocator(void);
+    explicit arena_allocator(const std::size_t);
+    ~arena_allocator(void);
+
+    std::size_t chunks(void) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_ALLOCATOR_HPP)
@@ -0,0 +1,236 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "allocator.hpp"
+
+#include <cstring>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Allocator that counts the calls it receives, for testing purposes.
+class counting_allocator : public lutok::malloc_allocator {
+public:
+    /// Number of calls to do_reallocate.
+    int calls;
+
+    /// Constructor.
+    counting_allocator(void) : calls(0) {}
+
+protected:
+    /// Counts the call and delegates to the parent allocator.
+    ///
+    /// \param ptr The block to resize or release.
+    /// \param old_size The size of the block.
+    /// \param new_size The new size of the block.
+    ///
+    /// \return The new block.
+    void*
+    do_reallocate(void* ptr, const std::size_t old_size,
+                  const std::size_t new_size) throw()
+    {
+        calls++;
+        return lutok::malloc_allocator::do_reallocate(ptr, old_size, new_size);
+    }
+};
+
+
+/// Runs a basic allocation cycle on an allocator.
+///
+/// \param allocator The allocator to test.
+static void
+check_cycle(lutok::allocator& allocator)
+{
+    ATF_REQUIRE_EQ(0, allocator.bytes_in_use());
+
+    char* block1 = static_cast< char* >(allocator.reallocate(NULL, 0, 10));
+    ATF_REQUIRE(block1 != NULL);
+    std::memset(block1, 'a', 10);
+    ATF_REQUIRE_EQ(10, allocator.bytes_in_use());
+
+    char* block2 = static_cast< char* >(allocator.reallocate(NULL, 0, 5000));
+    ATF_REQUIRE(block2 != NULL);
+    std::memset(block2, 'b', 5000);
+    ATF_REQUIRE_EQ(5010, allocator.bytes_in_use());
+
+    block1 = static_cast< char* >(allocator.reallocate(block1, 10, 100));
+    ATF_REQUIRE(block1 != NULL);
+    for (int i = 0; i < 10; i++)
+        ATF_REQUIRE_EQ('a', block1[i]);
+    std::memset(block1, 'c', 100);
+    ATF_REQUIRE_EQ(5100, allocator.bytes_in_use());
+
+    block2 = static_cast< char* >(allocator.reallocate(block2, 5000, 20));
+    ATF_REQUIRE(block2 != NULL);
+    for (int i = 0; i < 20; i++)
+        ATF_REQUIRE_EQ('b', block2[i]);
+    ATF_REQUIRE_EQ(120, allocator.bytes_in_use());
+
+    ATF_REQUIRE(allocator.reallocate(block1, 100, 0) == NULL);
+    ATF_REQUIRE(allocator.reallocate(block2, 20, 0) == NULL);
+    ATF_REQUIRE_EQ(0, allocator.bytes_in_use());
+    ATF_REQUIRE_EQ(5100, allocator.peak_bytes());
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(malloc_allocator__cycle);
+ATF_TEST_CASE_BODY(malloc_allocator__cycle)
+{
+    lutok::malloc_allocator allocator;
+    check_cycle(allocator);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(arena_allocator__cycle);
+ATF_TEST_CASE_BODY(arena_allocator__cycle)
+{
+    lutok::arena_allocator allocator;
+    check_cycle(allocator);
+    ATF_REQUIRE_EQ(1, allocator.chunks());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(arena_allocator__reuse);
+ATF_TEST_CASE_BODY(arena_allocator__reuse)
+{
+    lutok::arena_allocator allocator(1024);
+    void* blocks[100];
+    for (int i = 0; i < 100; i++)
+        blocks[i] = allocator.reallocate(NULL, 0, 64);
+    const std::size_t chunks = allocator.chunks();
+    ATF_REQUIRE(chunks > 1);
+
+    for (int i = 0; i < 100; i++)
+        allocator.reallocate(blocks[i], 64, 0);
+    for (int i = 0; i < 100; i++)
+        blocks[i] = allocator.reallocate(NULL, 0, 64);
+    ATF_REQUIRE_EQ(chunks, allocator.chunks());
+    for (int i = 0; i < 100; i++)
+        allocator.reallocate(blocks[i], 64, 0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(limit);
+ATF_TEST_CASE_BODY(limit)
+{
+    lutok::malloc_allocator allocator;
+    allocator.set_limit(100);
+    ATF_REQUIRE_EQ(100, allocator.limit());
+
+    void* block = allocator.reallocate(NULL, 0, 60);
+    ATF_REQUIRE(block != NULL);
+    ATF_REQUIRE(allocator.reallocate(NULL, 0, 60) == NULL);
+    ATF_REQUIRE(allocator.reallocate(block, 60, 200) == NULL);
+    ATF_REQUIRE_EQ(60, allocator.bytes_in_use());
+    block = allocator.reallocate(block, 60, 100);
+    ATF_REQUIRE(block != NULL);
+    ATF_REQUIRE_EQ(100, allocator.bytes_in_use());
+    allocator.reallocate(block, 100, 0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(state__custom);
+ATF_TEST_CASE_BODY(state__custom)
+{
+    counting_allocator allocator;
+    {
+        lutok::state state(allocator);
+        ATF_REQUIRE(allocator.calls > 0);
+        ATF_REQUIRE(allocator.bytes_in_use() > 0);
+        state.open_all();
+        lutok::do_string(state, "t = {}; for i = 1, 100 do t[i] = i end",
+                         0, 0, 0);
+        state.close();
+    }
+    ATF_REQUIRE_EQ(0, allocator.bytes_in_use());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(state__arena);
+ATF_TEST_CASE_BODY(state__arena)
+{
+    lutok::arena_allocator allocator;
+    for (int i = 0; i < 3; i++) {
+        lutok::state state(allocator);
+        state.open_all();
+        lutok::do_string(state, "return string.rep('x', 10000)", 0, 1, 0);
+        ATF_REQUIRE_EQ(10000, state.to_string(-1).length());
+        state.pop(1);
+        state.close();
+        ATF_REQUIRE_EQ(0, allocator.bytes_in_use());
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(state__limit);
+ATF_TEST_CASE_BODY(state__limit)
+{
+    lutok::malloc_allocator allocator;
+    lutok::state state(allocator);
+    state.open_all();
+    allocator.set_limit(allocator.bytes_in_use() + 64 * 1024);
+    ATF_REQUIRE_THROW(lutok::error, lutok::do_string(
+        state, "return string.rep('x', 1024 * 1024)", 0, 1, 0));
+    ATF_REQUIRE_EQ(0, state.get_top());
+    allocator.set_limit(0);
+    state.close();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(state__no_memory);
+ATF_TEST_CASE_BODY(state__no_memory)
+{
+    lutok::malloc_allocator allocator;
+    allocator.set_limit(16);
+    ATF_REQUIRE_THROW(lutok::error, lutok::state state(allocator));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, malloc_allocator__cycle);
+    ATF_ADD_TEST_CASE(tcs, arena_allocator__cycle);
+    ATF_ADD_TEST_CASE(tcs, arena_allocator__reuse);
+    ATF_ADD_TEST_CASE(tcs, limit);
+    ATF_ADD_TEST_CASE(tcs, state__custom);
+    ATF_ADD_TEST_CASE(tcs, state__arena);
+    ATF_ADD_TEST_CASE(tcs, state__limit);
+    ATF_ADD_TEST_CASE(tcs, state__no_memory);
+}
@@ -0,0 +1,139 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file benchmarks/benchmark.hpp
+/// Utilities for the benchmark programs of lutok.
+///
+/// This file is intended to be included once, and only once, for every
+/// benchmark program.  All the code is herein contained to simplify the
+/// dependency chain in the build rules.
+///
+/// Every benchmark prints its results to stdout as one line per measurement
+/// with the following tab-separated fields: the name of the measurement, the
+/// number of iterations, the total elapsed time in seconds, the average time
+/// per iteration in nanoseconds and the release of Lua that lutok was built
+/// against.  The last field allows comparing the results of different Lua
+/// versions, which take different code paths in lutok.
+
+#if !defined(LUTOK_BENCHMARK_HPP)
+#   define LUTOK_BENCHMARK_HPP
+#else
+#   error "benchmark.hpp can only be included once"
+#endif
+
+extern "C" {
+#include <time.h>
+}
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <lua.hpp>
+
+#include <lutok/state.hpp>
+
+
+namespace {
+
+
+/// Gets the current value of a monotonic clock.
+///
+/// \return The current time in seconds since an arbitrary epoch.
+static double
+now_seconds(void)
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+
+/// Gets the number of iterations to run from the command line.
+///
+/// \param argc Length of argv.
+/// \param argv Command-line arguments to the program.  If present, the first
+///     argument is the number of iterations.
+/// \param default_iterations The value to return if argv does not specify it.
+///
+/// \return The number of iterations.
+static unsigned long
+parse_iterations(const int argc, char* const* argv,
+                 const unsigned long default_iterations)
+{
+    if (argc < 2)
+        return default_iterations;
+    const unsigned long iterations = std::strtoul(argv[1], NULL, 10);
+    if (iterations == 0) {
+        std::cerr << "Invalid number of iterations " << argv[1] << '\n';
+        std::exit(EXIT_FAILURE);
+    }
+    return iterations;
+}
+
+
+/// Prints the result of a measurement.
+///
+/// \param name The name of the measurement.
+/// \param iterations The number of iterations that were run.
+/// \param seconds The total elapsed time, in seconds.
+static void
+report(const std::string& name, const unsigned long iterations,
+       const double seconds)
+{
+    std::cout << name << '\t' << iterations << '\t' << seconds << '\t'
+              << (seconds * 1000000000.0 / iterations) << '\t'
+              << LUA_RELEASE << '\n';
+}
+
+
+/// Measures a Lua statement executed in a tight Lua loop.
+///
+/// The loop is compiled before the timer starts so that only its execution is
+/// accounted for.
+///
+/// \param state The Lua state in which to run the loop.
+/// \param name The name of the measurement.
+/// \param statement The Lua statement to execute on every iteration.
+/// \param iterations The number of iterations to run.
+static void
+run_lua_loop(lutok::state& state, const std::string& name,
+             const std::string& statement, const unsigned long iterations)
+{
+    std::ostringstream script;
+    script << "for i = 1, " << iterations << " do " << statement << " end";
+    state.load_string(script.str());
+
+    const double start = now_seconds();
+    state.pcall(0, 0, 0);
+    report(name, iterations, now_seconds() - start);
+}
+
+
+}  // anonymous namespace
@@ -0,0 +1,125 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file benchmarks/calls_bench.cpp
+/// Measures the cost of calling C and C++ functions from Lua.
+
+#include <cstdlib>
+
+#include <lua.hpp>
+
+#include <lutok/c_gate.hpp>
+#include <lutok/state.ipp>
+
+#include "benchmark.hpp"
+
+
+namespace {
+
+
+/// A C++ function for Lua that does nothing.
+///
+/// \return The number of result values, i.e. 0.
+static int
+cxx_noop(lutok::state& /* state */)
+{
+    return 0;
+}
+
+
+/// A C function for Lua that does nothing.
+///
+/// This is the baseline for all other measurements.
+///
+/// \return The number of result values, i.e. 0.
+static int
+c_noop(lua_State* /* raw_state */)
+{
+    return 0;
+}
+
+
+/// A C function for Lua that calls cxx_noop through state_c_gate::connect.
+///
+/// This mimics how the C++ trampolines wrapped the raw state before state_ref
+/// existed, so that both approaches can be compared side by side.
+///
+/// \param raw_state The raw Lua state.
+///
+/// \return The number of result values, i.e. 0.
+static int
+c_connect_noop(lua_State* raw_state)
+{
+    lutok::state state = lutok::state_c_gate::connect(raw_state);
+    return cxx_noop(state);
+}
+
+
+}  // anonymous namespace
+
+
+/// Program's entry point.
+///
+/// \param argc Length of argv.
+/// \param argv Command-line arguments to the program.  The first argument, if
+///     any, is the number of iterations to run.
+///
+/// \return A system exit code.
+int
+main(int argc, char** argv)
+{
+    const unsigned long iterations = parse_iterations(argc, argv, 10000000);
+
+    lutok::state state;
+    lua_State* raw_state = lutok::state_c_gate(state).c_state();
+
+    lua_pushcfunction(raw_state, c_noop);
+    lua_setglobal(raw_state, "c_noop");
+    lua_pushcfunction(raw_state, c_connect_noop);
+    lua_setglobal(raw_state, "c_connect_noop");
+    state.push_cxx_function(cxx_noop);
+    state.set_global("cxx_noop");
+    state.push_integer(1);
+    state.push_cxx_closure(cxx_noop, 1);
+    state.set_global("cxx_closure1_noop");
+    for (int i = 0; i < 16; i++)
+        state.push_integer(i);
+    state.push_cxx_closure(cxx_noop, 16);
+    state.set_global("cxx_closure16_noop");
+
+    run_lua_loop(state, "calls.c_function", "c_noop()", iterations);
+    run_lua_loop(state, "calls.connect", "c_connect_noop()", iterations);
+    run_lua_loop(state, "calls.cxx_function", "cxx_noop()", iterations);
+    run_lua_loop(state, "calls.cxx_closure1", "cxx_closure1_noop()",
+                 iterations);
+    run_lua_loop(state, "calls.cxx_closure16", "cxx_closure16_noop()",
+                 iterations);
+
+    state.close();
+    return EXIT_SUCCESS;
+}
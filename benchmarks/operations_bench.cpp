@@ -0,0 +1,199 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file benchmarks/operations_bench.cpp
+/// Measures the cost of the high-level operations on states.
+
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <lutok/chunk_cache.hpp>
+#include <lutok/operations.hpp>
+#include <lutok/state.ipp>
+
+#include "benchmark.hpp"
+
+
+namespace {
+
+
+/// Lua statement run by the chunk benchmarks.
+static const char* const chunk = "local x = 0; for i = 1, 10 do x = x + i end";
+
+
+/// A C++ function for Lua that does nothing.
+///
+/// \return The number of result values, i.e. 0.
+static int
+cxx_noop(lutok::state& /* state */)
+{
+    return 0;
+}
+
+
+/// Measures running a chunk through do_string, compiling it every time.
+///
+/// \param state The Lua state.
+/// \param iterations The number of times to run the chunk.
+static void
+measure_do_string(lutok::state& state, const unsigned long iterations)
+{
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++)
+        lutok::do_string(state, chunk, 0, 0, 0);
+    report("operations.do_string", iterations, now_seconds() - start);
+}
+
+
+/// Measures running a chunk through do_string with a chunk cache.
+///
+/// \param state The Lua state.
+/// \param iterations The number of times to run the chunk.
+static void
+measure_do_string_cached(lutok::state& state, const unsigned long iterations)
+{
+    lutok::chunk_cache cache;
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++)
+        lutok::do_string(state, cache, chunk, 0, 0, 0);
+    report("operations.do_string_cached", iterations, now_seconds() - start);
+}
+
+
+/// Measures calling a chunk that was compiled once upfront.
+///
+/// \param state The Lua state.
+/// \param iterations The number of times to run the chunk.
+static void
+measure_precompiled(lutok::state& state, const unsigned long iterations)
+{
+    state.load_string(chunk);
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++) {
+        state.push_value(-1);
+        state.pcall(0, 0, 0);
+    }
+    report("operations.precompiled", iterations, now_seconds() - start);
+    state.pop(1);
+}
+
+
+/// Measures registering modules with create_module.
+///
+/// \param state The Lua state.
+/// \param iterations The number of modules to register.
+/// \param nmembers The number of functions in every module.
+static void
+measure_create_module(lutok::state& state, const unsigned long iterations,
+                      const std::size_t nmembers)
+{
+    std::map< std::string, lutok::cxx_function > members;
+    for (std::size_t i = 0; i < nmembers; i++) {
+        std::ostringstream name;
+        name << "function" << i;
+        members[name.str()] = cxx_noop;
+    }
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++)
+        lutok::create_module(state, "module", members);
+
+    std::ostringstream name;
+    name << "operations.create_module." << nmembers;
+    report(name.str(), iterations, now_seconds() - start);
+}
+
+
+/// Measures registering modules with create_module from a table of functions.
+///
+/// \param state The Lua state.
+/// \param iterations The number of modules to register.
+/// \param nmembers The number of functions in every module.
+static void
+measure_create_module_static(lutok::state& state,
+                             const unsigned long iterations,
+                             const std::size_t nmembers)
+{
+    std::vector< std::string > names;
+    for (std::size_t i = 0; i < nmembers; i++) {
+        std::ostringstream name;
+        name << "function" << i;
+        names.push_back(name.str());
+    }
+    std::vector< lutok::module_function > members;
+    for (std::size_t i = 0; i < nmembers; i++) {
+        const lutok::module_function member = { names[i].c_str(), cxx_noop };
+        members.push_back(member);
+    }
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++)
+        lutok::create_module(state, "module", &members[0], members.size());
+
+    std::ostringstream name;
+    name << "operations.create_module_static." << nmembers;
+    report(name.str(), iterations, now_seconds() - start);
+
+    // The module refers to the members array, which is about to go away.
+    state.push_nil();
+    state.set_global("module");
+}
+
+
+}  // anonymous namespace
+
+
+/// Program's entry point.
+///
+/// \param argc Length of argv.
+/// \param argv Command-line arguments to the program.  The first argument, if
+///     any, is the number of iterations to run.
+///
+/// \return A system exit code.
+int
+main(int argc, char** argv)
+{
+    const unsigned long iterations = parse_iterations(argc, argv, 100000);
+
+    lutok::state state;
+    measure_do_string(state, iterations);
+    measure_do_string_cached(state, iterations);
+    measure_precompiled(state, iterations);
+    measure_create_module(state, iterations, 1);
+    measure_create_module(state, iterations / 10 > 0 ? iterations / 10 : 1,
+                          50);
+    measure_create_module_static(state, iterations, 1);
+    measure_create_module_static(
+        state, iterations / 10 > 0 ? iterations / 10 : 1, 50);
+    state.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file benchmarks/state_bench.cpp
+/// Measures the cost of creating states and moving strings across them.
+
+#include <cstdlib>
+#include <string>
+
+#include <lutok/lazy.hpp>
+#include <lutok/state.ipp>
+
+#include "benchmark.hpp"
+
+
+namespace {
+
+
+/// How to open the standard libraries in the states created by measure_create.
+enum open_mode {
+    /// Do not open any library.
+    open_none,
+
+    /// Open all the libraries with state::open_all.
+    open_eager,
+
+    /// Open all the libraries with open_all_lazy.
+    open_lazy
+};
+
+
+/// Measures creating and closing states.
+///
+/// \param iterations The number of states to create.
+/// \param mode How to open the standard libraries.
+static void
+measure_create(const unsigned long iterations, const open_mode mode)
+{
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++) {
+        lutok::state state;
+        if (mode == open_eager)
+            state.open_all();
+        else if (mode == open_lazy)
+            lutok::open_all_lazy(state);
+        state.close();
+    }
+
+    const char* name = "state.create";
+    if (mode == open_eager)
+        name = "state.create_open_all";
+    else if (mode == open_lazy)
+        name = "state.create_open_all_lazy";
+    report(name, iterations, now_seconds() - start);
+}
+
+
+/// Measures pushing strings of a given size onto the stack.
+///
+/// \param state The Lua state.
+/// \param iterations The number of strings to push.
+/// \param size The length of the strings, in bytes.
+static void
+measure_push_string(lutok::state& state, const unsigned long iterations,
+                    const std::size_t size)
+{
+    // Vary the contents of the string so that Lua cannot reuse an interned
+    // copy of it on every iteration.
+    std::string str(size, 'x');
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++) {
+        str[0] = static_cast< char >('a' + i % 26);
+        state.push_string(str);
+        state.pop(1);
+    }
+
+    std::ostringstream name;
+    name << "state.push_string." << size;
+    report(name.str(), iterations, now_seconds() - start);
+}
+
+
+/// Measures reading a string of a given size from the stack.
+///
+/// \param state The Lua state.
+/// \param iterations The number of times to read the string.
+/// \param size The length of the string, in bytes.
+/// \param by_reference Whether to use to_string_ref instead of to_string.
+static void
+measure_to_string(lutok::state& state, const unsigned long iterations,
+                  const std::size_t size, const bool by_reference)
+{
+    state.push_string(std::string(size, 'x'));
+
+    std::size_t total = 0;
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++) {
+        if (by_reference)
+            total += state.to_string_ref(-1).length();
+        else
+            total += state.to_string(-1).length();
+    }
+    const double elapsed = now_seconds() - start;
+    state.pop(1);
+
+    if (total != size * iterations)
+        std::abort();
+
+    std::ostringstream name;
+    name << (by_reference ? "state.to_string_ref." : "state.to_string.")
+         << size;
+    report(name.str(), iterations, elapsed);
+}
+
+
+}  // anonymous namespace
+
+
+/// Program's entry point.
+///
+/// \param argc Length of argv.
+/// \param argv Command-line arguments to the program.  The first argument, if
+///     any, is the number of operations on the smallest strings; larger
+///     strings and the creation of states run proportionally fewer times.
+///
+/// \return A system exit code.
+int
+main(int argc, char** argv)
+{
+    const unsigned long iterations = parse_iterations(argc, argv, 1000000);
+    const unsigned long states = iterations / 100 > 0 ? iterations / 100 : 1;
+
+    measure_create(states, open_none);
+    measure_create(states, open_eager);
+    measure_create(states, open_lazy);
+
+    static const std::size_t sizes[] = { 16, 256, 4096, 65536 };
+    lutok::state state;
+    for (std::size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        // Keep the number of copied bytes constant across sizes.
+        const unsigned long scaled = iterations * sizes[0] / sizes[i] > 0 ?
+            iterations * sizes[0] / sizes[i] : 1;
+        measure_push_string(state, scaled, sizes[i]);
+        measure_to_string(state, scaled, sizes[i], false);
+        measure_to_string(state, scaled, sizes[i], true);
+    }
+    state.close();
+    return EXIT_SUCCESS;
+}
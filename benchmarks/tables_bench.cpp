@@ -0,0 +1,214 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file benchmarks/tables_bench.cpp
+/// Measures the cost of accessing tables and globals from C++.
+
+#include <cstdlib>
+#include <vector>
+
+#include <lutok/pairs.hpp>
+#include <lutok/stack_cleaner.hpp>
+#include <lutok/state.ipp>
+#include <lutok/table.hpp>
+
+#include "benchmark.hpp"
+
+
+namespace {
+
+
+/// Measures filling an array-like table through set_table.
+///
+/// \pre stack(-1) contains the table to fill.
+///
+/// \param state The Lua state.
+/// \param size The number of entries to set.
+/// \param unchecked Whether to use the unprotected variant of set_table.
+static void
+measure_set_table(lutok::state& state, const unsigned long size,
+                  const bool unchecked)
+{
+    const double start = now_seconds();
+    for (unsigned long i = 1; i <= size; i++) {
+        state.push_integer(i);
+        state.push_integer(i * 2);
+        if (unchecked)
+            state.set_table_unchecked(-3);
+        else
+            state.set_table(-3);
+    }
+    report(unchecked ? "tables.set_table_unchecked" : "tables.set_table",
+           size, now_seconds() - start);
+}
+
+
+/// Measures reading all entries of an array-like table through get_table.
+///
+/// \pre stack(-1) contains the table to read, filled by measure_set_table.
+///
+/// \param state The Lua state.
+/// \param size The number of entries to get.
+/// \param unchecked Whether to use the unprotected variant of get_table.
+static void
+measure_get_table(lutok::state& state, const unsigned long size,
+                  const bool unchecked)
+{
+    const double start = now_seconds();
+    for (unsigned long i = 1; i <= size; i++) {
+        state.push_integer(i);
+        if (unchecked)
+            state.get_table_unchecked(-2);
+        else
+            state.get_table(-2);
+        state.pop(1);
+    }
+    report(unchecked ? "tables.get_table_unchecked" : "tables.get_table",
+           size, now_seconds() - start);
+}
+
+
+/// Measures walking a table through next.
+///
+/// \pre stack(-1) contains the table to walk, filled by measure_set_table.
+///
+/// \param state The Lua state.
+/// \param size The number of entries in the table.
+/// \param unchecked Whether to use the unprotected variant of next.
+static void
+measure_next(lutok::state& state, const unsigned long size,
+             const bool unchecked)
+{
+    const double start = now_seconds();
+    state.push_nil();
+    while (unchecked ? state.next_unchecked(-2) : state.next(-2))
+        state.pop(1);
+    report(unchecked ? "tables.next_unchecked" : "tables.next",
+           size, now_seconds() - start);
+}
+
+
+/// Measures walking a table through a pairs range.
+///
+/// \pre stack(-1) contains the table to walk, filled by measure_set_table.
+///
+/// \param state The Lua state.
+static void
+measure_pairs(lutok::state& state)
+{
+    const double start = now_seconds();
+    unsigned long count = 0;
+    lutok::pairs_range range = state.pairs(-1);
+    for (lutok::pairs_iterator iter = range.begin(); iter != range.end();
+         ++iter)
+        count++;
+    report("tables.pairs", count, now_seconds() - start);
+}
+
+
+/// Measures moving an array-like table from and to a vector in bulk.
+///
+/// \param state The Lua state.
+/// \param size The number of entries to move.
+static void
+measure_bulk(lutok::state& state, const unsigned long size)
+{
+    std::vector< long > values;
+    values.reserve(size);
+    for (unsigned long i = 1; i <= size; i++)
+        values.push_back(static_cast< long >(i * 2));
+
+    double start = now_seconds();
+    lutok::push_vector(state, values);
+    report("tables.push_vector", size, now_seconds() - start);
+
+    start = now_seconds();
+    const std::vector< long > copy = lutok::to_vector< long >(state, -1);
+    report("tables.to_vector", copy.size(), now_seconds() - start);
+    state.pop(1);
+}
+
+
+/// Measures reading a global variable through get_global.
+///
+/// \param state The Lua state.
+/// \param iterations The number of times to read the variable.
+/// \param unchecked Whether to use the unprotected variant of get_global.
+static void
+measure_get_global(lutok::state& state, const unsigned long iterations,
+                   const bool unchecked)
+{
+    const std::string name = "the_global";
+    state.push_integer(1);
+    state.set_global(name);
+
+    const double start = now_seconds();
+    for (unsigned long i = 0; i < iterations; i++) {
+        if (unchecked)
+            state.get_global_unchecked(name);
+        else
+            state.get_global(name);
+        state.pop(1);
+    }
+    report(unchecked ? "tables.get_global_unchecked" : "tables.get_global",
+           iterations, now_seconds() - start);
+}
+
+
+}  // anonymous namespace
+
+
+/// Program's entry point.
+///
+/// \param argc Length of argv.
+/// \param argv Command-line arguments to the program.  The first argument, if
+///     any, is the number of table entries to process.
+///
+/// \return A system exit code.
+int
+main(int argc, char** argv)
+{
+    const unsigned long size = parse_iterations(argc, argv, 1000000);
+
+    lutok::state state;
+    for (int i = 0; i < 2; i++) {
+        const bool unchecked = i == 1;
+
+        lutok::stack_cleaner cleaner(state);
+        state.new_table();
+        measure_set_table(state, size, unchecked);
+        measure_get_table(state, size, unchecked);
+        measure_next(state, size, unchecked);
+        if (unchecked)
+            measure_pairs(state);
+        measure_get_global(state, size, unchecked);
+    }
+    measure_bulk(state, size);
+    state.close();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,507 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file bind.hpp
+/// Provides automatic bindings of C++ callables into Lua.
+///
+/// This module requires C++11.
+
+#if !defined(LUTOK_BIND_HPP)
+#define LUTOK_BIND_HPP
+
+#if !defined(_LIBCPP_VERSION) && __cplusplus < 201103L
+#   error "lutok/bind.hpp requires C++11"
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <lua.hpp>
+#include <lutok/c_gate.hpp>
+#include <lutok/state.ipp>
+
+namespace lutok {
+namespace detail {
+
+
+/// Compile-time list of indices.
+template< std::size_t... Indices >
+struct index_list {
+};
+
+
+/// Builds an index_list with the values 0 to Count - 1.
+template< std::size_t Count, std::size_t... Indices >
+struct make_index_list : make_index_list< Count - 1, Count - 1, Indices... > {
+};
+
+
+/// Builds an index_list with the values 0 to Count - 1.
+template< std::size_t... Indices >
+struct make_index_list< 0, Indices... > {
+    /// The resulting list.
+    typedef index_list< Indices... > type;
+};
+
+
+/// Strips references and qualifiers from a parameter type.
+///
+/// The result is the type whose stack_traits convert values of the parameter.
+template< typename Type >
+struct bare {
+    /// The stripped type.
+    typedef typename std::remove_cv<
+        typename std::remove_reference< Type >::type >::type type;
+};
+
+
+/// Gets the name of the Lua type expected for a parameter type.
+///
+/// Uses the name() method of the stack_traits of the type if they provide one.
+template< typename Type >
+struct expected_type {
+    /// Gets the name from the stack_traits of the type.
+    ///
+    /// \param raw_state The Lua C API state.
+    ///
+    /// \return The name of the type.
+    template< typename Traits >
+    static auto
+    lookup(lua_State* raw_state, int) -> decltype(Traits::name(raw_state))
+    {
+        return Traits::name(raw_state);
+    }
+
+    /// Fallback for stack_traits that do not name their type.
+    ///
+    /// \return A generic name.
+    template< typename Traits >
+    static const char*
+    lookup(lua_State* /* raw_state */, long)
+    {
+        return "value";
+    }
+
+    /// Gets the name of the Lua type expected for the parameter.
+    ///
+    /// \param raw_state The Lua C API state.
+    ///
+    /// \return The name of the type.
+    static const char*
+    name(lua_State* raw_state)
+    {
+        return lookup< stack_traits< Type > >(raw_state, 0);
+    }
+};
+
+
+/// Pushes the result of a callable onto the Lua stack.
+///
+/// The generic case pushes a single value through its stack_traits.
+template< typename Result >
+struct result_pusher {
+    /// Invokes a callable and pushes its result.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param callable The callable to invoke.
+    /// \param arguments The arguments to pass to the callable.
+    ///
+    /// \return The number of values pushed onto the stack.
+    template< typename Callable, typename... Arguments >
+    static int
+    call(lua_State* raw_state, Callable& callable, Arguments&&... arguments)
+    {
+        stack_traits< typename bare< Result >::type >::push(
+            raw_state, callable(std::forward< Arguments >(arguments)...));
+        return 1;
+    }
+};
+
+
+/// Pushes the result of a callable onto the Lua stack.
+///
+/// Callables returning void push nothing.
+template<>
+struct result_pusher< void > {
+    /// Invokes a callable.
+    ///
+    /// \param unused_state The Lua C API state.
+    /// \param callable The callable to invoke.
+    /// \param arguments The arguments to pass to the callable.
+    ///
+    /// \return The number of values pushed onto the stack, i.e. 0.
+    template< typename Callable, typename... Arguments >
+    static int
+    call(lua_State* /* unused_state */, Callable& callable,
+         Arguments&&... arguments)
+    {
+        callable(std::forward< Arguments >(arguments)...);
+        return 0;
+    }
+};
+
+
+/// Pushes the result of a callable onto the Lua stack.
+///
+/// Callables returning tuples push each of the elements as a separate value.
+template< typename... Types >
+struct result_pusher< std::tuple< Types... > > {
+    /// Pushes the elements of a tuple.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param values The tuple to push.
+    template< std::size_t... Indices >
+    static void
+    push_elements(lua_State* raw_state, const std::tuple< Types... >& values,
+                  index_list< Indices... >)
+    {
+        const int unused[] = { 0, (stack_traits< typename bare< Types >::type
+                                   >::push(raw_state,
+                                           std::get< Indices >(values)),
+                                   0)... };
+        (void)unused;
+    }
+
+    /// Invokes a callable and pushes the elements of its result.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param callable The callable to invoke.
+    /// \param arguments The arguments to pass to the callable.
+    ///
+    /// \return The number of values pushed onto the stack.
+    template< typename Callable, typename... Arguments >
+    static int
+    call(lua_State* raw_state, Callable& callable, Arguments&&... arguments)
+    {
+        push_elements(raw_state,
+                      callable(std::forward< Arguments >(arguments)...),
+                      typename make_index_list< sizeof...(Types) >::type());
+        return static_cast< int >(sizeof...(Types));
+    }
+};
+
+
+/// Calls a callable with arguments taken from the Lua stack.
+///
+/// \tparam Result The type returned by the callable.
+/// \tparam Parameters The types of the parameters of the callable.
+template< typename Result, typename... Parameters >
+struct invoker {
+    /// Validates the arguments, invokes the callable and pushes its results.
+    ///
+    /// Any errors, be them invalid arguments or exceptions raised by the
+    /// callable, are reported as Lua errors.  The errors are raised once all
+    /// C++ objects involved in the call have been destroyed, as Lua performs a
+    /// longjmp to unwind the stack.
+    ///
+    /// \param raw_state The Lua C API state.  The arguments to the callable
+    ///     are in this stack, starting at index 1.
+    /// \param callable The callable to invoke.
+    ///
+    /// \return The number of values pushed onto the stack.
+    template< typename Callable, std::size_t... Indices >
+    static int
+    call(lua_State* raw_state, Callable& callable, index_list< Indices... >)
+    {
+        const bool valid[] = { true, stack_traits< typename bare<
+            Parameters >::type >::is(raw_state, Indices + 1)... };
+        const char* (*const expected[])(lua_State*) = { NULL,
+            &expected_type< typename bare< Parameters >::type >::name... };
+        for (std::size_t i = 1; i < sizeof(valid) / sizeof(valid[0]); i++) {
+            if (!valid[i]) {
+                const int argument = static_cast< int >(i);
+                lua_pushfstring(raw_state, "%s expected, got %s",
+                                expected[i](raw_state),
+                                luaL_typename(raw_state, argument));
+                return luaL_argerror(raw_state, argument,
+                                     lua_tostring(raw_state, -1));
+            }
+        }
+
+        char error_buf[1024];
+        try {
+            return result_pusher< Result >::call(
+                raw_state, callable,
+                stack_traits< typename bare< Parameters >::type >::get(
+                    raw_state, Indices + 1)...);
+        } catch (const std::exception& e) {
+            std::strncpy(error_buf, e.what(), sizeof(error_buf));
+        } catch (...) {
+            std::strncpy(error_buf, "Unhandled exception in Lua C++ hook",
+                         sizeof(error_buf));
+        }
+        error_buf[sizeof(error_buf) - 1] = '\0';
+        return luaL_error(raw_state, "%s", error_buf);
+    }
+};
+
+
+/// Describes the signature of a callable type.
+///
+/// The generic case handles functors and lambdas by inspecting their call
+/// operator.
+template< typename Callable >
+struct signature : signature< decltype(&Callable::operator()) > {
+};
+
+
+/// Describes the signature of a function pointer.
+template< typename Result, typename... Parameters >
+struct signature< Result (*)(Parameters...) > {
+    /// The invoker for callables with this signature.
+    typedef invoker< Result, Parameters... > invoker_type;
+
+    /// The indices of the parameters.
+    typedef typename make_index_list< sizeof...(Parameters) >::type
+        indices_type;
+};
+
+
+/// Describes the signature of the call operator of a mutable functor.
+template< typename Result, typename Class, typename... Parameters >
+struct signature< Result (Class::*)(Parameters...) > :
+    signature< Result (*)(Parameters...) > {
+};
+
+
+/// Describes the signature of the call operator of a constant functor.
+template< typename Result, typename Class, typename... Parameters >
+struct signature< Result (Class::*)(Parameters...) const > :
+    signature< Result (*)(Parameters...) > {
+};
+
+
+/// Adapts a pointer to a member function to a regular callable.
+///
+/// The resulting callable takes a pointer to the object as its first argument,
+/// which means that binding a member function requires stack_traits for
+/// pointers to its class.
+template< typename Method >
+struct method_caller;
+
+
+/// Adapts a pointer to a non-constant member function.
+template< typename Result, typename Class, typename... Parameters >
+struct method_caller< Result (Class::*)(Parameters...) > {
+    /// The adapted member function.
+    Result (Class::*method)(Parameters...);
+
+    /// Calls the member function.
+    ///
+    /// \param self The object on which to call the member function.
+    /// \param arguments The arguments to the member function.
+    ///
+    /// \return The result of the member function.
+    Result
+    operator()(Class* self, Parameters... arguments) const
+    {
+        return (self->*method)(std::forward< Parameters >(arguments)...);
+    }
+};
+
+
+/// Adapts a pointer to a constant member function.
+template< typename Result, typename Class, typename... Parameters >
+struct method_caller< Result (Class::*)(Parameters...) const > {
+    /// The adapted member function.
+    Result (Class::*method)(Parameters...) const;
+
+    /// Calls the member function.
+    ///
+    /// \param self The object on which to call the member function.
+    /// \param arguments The arguments to the member function.
+    ///
+    /// \return The result of the member function.
+    Result
+    operator()(const Class* self, Parameters... arguments) const
+    {
+        return (self->*method)(std::forward< Parameters >(arguments)...);
+    }
+};
+
+
+/// Provides a unique address for every type, to be used as a registry key.
+template< typename Type >
+struct registry_key {
+    /// Object whose address is the key.
+    static const char key;
+};
+
+
+template< typename Type >
+const char registry_key< Type >::key = 0;
+
+
+/// Lua glue to destroy a callable stored in a userdata.
+///
+/// \param raw_state The Lua C API state.  stack(1) is the userdata.
+///
+/// \return The number of return values, i.e. 0.
+template< typename Callable >
+int
+destroy_callable(lua_State* raw_state)
+{
+    static_cast< Callable* >(lua_touserdata(raw_state, 1))->~Callable();
+    return 0;
+}
+
+
+/// Lua glue to call a callable stored in the first upvalue of the closure.
+///
+/// \param raw_state The Lua C API state.
+///
+/// \return The number of return values of the callable.
+template< typename Callable >
+int
+callable_trampoline(lua_State* raw_state)
+{
+    Callable* callable = static_cast< Callable* >(
+        lua_touserdata(raw_state, lua_upvalueindex(1)));
+    typedef signature< Callable > signature_type;
+    return signature_type::invoker_type::call(
+        raw_state, *callable, typename signature_type::indices_type());
+}
+
+
+/// Pushes the metatable that destroys callables of a given type.
+///
+/// The metatable is created on first use and cached in the registry.
+///
+/// \param raw_state The Lua C API state.
+template< typename Callable >
+void
+push_callable_metatable(lua_State* raw_state)
+{
+    void* key = const_cast< char* >(&registry_key< Callable >::key);
+    lua_pushlightuserdata(raw_state, key);
+    lua_rawget(raw_state, LUA_REGISTRYINDEX);
+    if (lua_isnil(raw_state, -1)) {
+        lua_pop(raw_state, 1);
+        lua_newtable(raw_state);
+        lua_pushcfunction(raw_state, destroy_callable< Callable >);
+        lua_setfield(raw_state, -2, "__gc");
+        lua_pushlightuserdata(raw_state, key);
+        lua_pushvalue(raw_state, -2);
+        lua_rawset(raw_state, LUA_REGISTRYINDEX);
+    }
+}
+
+
+}  // namespace detail
+
+
+/// Pushes a C++ callable onto the stack as a Lua function.
+///
+/// The callable can be a function pointer, a functor or a lambda, including
+/// those that capture state.  Its parameters and return value are converted
+/// from and to Lua values through stack_traits, so all of them must be of a
+/// supported type.  Callables returning std::tuple push each element of the
+/// tuple as a separate result.
+///
+/// Arguments are checked against the parameters of the callable on every
+/// call and mismatches are reported as Lua errors.  Exceptions thrown by the
+/// callable are also converted to Lua errors.
+///
+/// The callable is stored by value within the Lua function, which collects
+/// it when the function is garbage collected.
+///
+/// \param s The Lua state.
+/// \param callable The callable to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Callable >
+void
+push_callable(state& s, Callable callable)
+{
+    typedef typename detail::bare< Callable >::type stored_type;
+    static_assert(std::alignment_of< stored_type >::value <=
+                  std::alignment_of< detail::userdata_alignment >::value,
+                  "Callable requires more alignment than Lua guarantees");
+
+    lua_State* raw_state = state_c_gate(s).c_state();
+    void* memory = lua_newuserdata(raw_state, sizeof(stored_type));
+    try {
+        new (memory) stored_type(std::move(callable));
+    } catch (...) {
+        lua_pop(raw_state, 1);
+        throw;
+    }
+    if (!std::is_trivially_destructible< stored_type >::value) {
+        detail::push_callable_metatable< stored_type >(raw_state);
+        lua_setmetatable(raw_state, -2);
+    }
+    lua_pushcclosure(raw_state, detail::callable_trampoline< stored_type >, 1);
+}
+
+
+/// Pushes a member function onto the stack as a Lua function.
+///
+/// The resulting Lua function takes the object as its first argument, which is
+/// converted through the stack_traits of pointers to the class.
+///
+/// \param s The Lua state.
+/// \param method The member function to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Result, typename Class, typename... Parameters >
+void
+push_callable(state& s, Result (Class::*method)(Parameters...))
+{
+    detail::method_caller< Result (Class::*)(Parameters...) > caller;
+    caller.method = method;
+    push_callable(s, caller);
+}
+
+
+/// Pushes a constant member function onto the stack as a Lua function.
+///
+/// The resulting Lua function takes the object as its first argument, which is
+/// converted through the stack_traits of pointers to the constant class.
+///
+/// \param s The Lua state.
+/// \param method The member function to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Result, typename Class, typename... Parameters >
+void
+push_callable(state& s, Result (Class::*method)(Parameters...) const)
+{
+    detail::method_caller< Result (Class::*)(Parameters...) const > caller;
+    caller.method = method;
+    push_callable(s, caller);
+}
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_BIND_HPP)
@@ -0,0 +1,406 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#   include "bind.hpp"
+
+#   include <tuple>
+#endif
+
+#include <stdexcept>
+#include <string>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+
+
+namespace {
+
+
+/// Object with member functions to validate the binding of methods.
+class accumulator {
+    /// The accumulated value.
+    int _total;
+
+public:
+    /// Constructs a new accumulator.
+    accumulator(void) : _total(0)
+    {
+    }
+
+    /// Adds a value to the accumulator.
+    ///
+    /// \param value The value to add.
+    void
+    add(const int value)
+    {
+        _total += value;
+    }
+
+    /// Gets the accumulated value.
+    ///
+    /// \return The accumulated value.
+    int
+    total(void) const
+    {
+        return _total;
+    }
+};
+
+
+/// Functor that tracks the number of live copies of itself.
+class tracker {
+    /// Counter of live copies, owned by the caller.
+    int* _live;
+
+public:
+    /// Constructs a new tracker.
+    ///
+    /// \param live Counter of live copies.
+    explicit tracker(int* live) : _live(live)
+    {
+        ++*_live;
+    }
+
+    /// Copies a tracker.
+    ///
+    /// \param other The tracker to copy.
+    tracker(const tracker& other) : _live(other._live)
+    {
+        ++*_live;
+    }
+
+    /// Destroys a tracker.
+    ~tracker(void)
+    {
+        --*_live;
+    }
+
+    /// Gets the number of live copies.
+    ///
+    /// \return The number of live copies.
+    int
+    operator()(void) const
+    {
+        return *_live;
+    }
+};
+
+
+/// Adds two integers.
+///
+/// \param a The first integer.
+/// \param b The second integer.
+///
+/// \return The sum of the integers.
+static int
+add(const int a, const int b)
+{
+    return a + b;
+}
+
+
+}  // anonymous namespace
+
+
+namespace lutok {
+
+
+/// Conversions for accumulators, represented as light userdata.
+template<>
+struct stack_traits< accumulator* > {
+    /// Checks if a value is a light userdata.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a light userdata.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_islightuserdata(raw_state, index);
+    }
+
+    /// Gets an accumulator from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static accumulator*
+    get(lua_State* raw_state, const int index)
+    {
+        return static_cast< accumulator* >(lua_touserdata(raw_state, index));
+    }
+};
+
+
+/// Conversions for constant accumulators, represented as light userdata.
+template<>
+struct stack_traits< const accumulator* > {
+    /// Checks if a value is a light userdata.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a light userdata.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_islightuserdata(raw_state, index);
+    }
+
+    /// Gets an accumulator from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static const accumulator*
+    get(lua_State* raw_state, const int index)
+    {
+        return static_cast< const accumulator* >(
+            lua_touserdata(raw_state, index));
+    }
+};
+
+
+}  // namespace lutok
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__function_pointer);
+ATF_TEST_CASE_BODY(push_callable__function_pointer)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_callable(state, add);
+    state.set_global("add");
+    lutok::do_string(state, "return add(2, 3)", 0, 1, 0);
+    ATF_REQUIRE_EQ(5, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__lambda);
+ATF_TEST_CASE_BODY(push_callable__lambda)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const std::string prefix = "Hello, ";
+    lutok::push_callable(state, [prefix](const std::string& name) {
+        return prefix + name;
+    });
+    state.set_global("greet");
+    lutok::do_string(state, "return greet('world')", 0, 1, 0);
+    ATF_REQUIRE_EQ("Hello, world", state.to_string(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__mutable_lambda);
+ATF_TEST_CASE_BODY(push_callable__mutable_lambda)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    int calls = 0;
+    lutok::push_callable(state, [calls](void) mutable { return ++calls; });
+    state.set_global("next");
+    lutok::do_string(state, "next(); next(); return next()", 0, 1, 0);
+    ATF_REQUIRE_EQ(3, state.to_integer(-1));
+    state.pop(1);
+    ATF_REQUIRE_EQ(0, calls);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__void_result);
+ATF_TEST_CASE_BODY(push_callable__void_result)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    bool flag = false;
+    double received = 0.0;
+    lutok::push_callable(state, [&](const bool a, const double b) {
+        flag = a;
+        received = b;
+    });
+    state.set_global("store");
+    ATF_REQUIRE_EQ(0, lutok::do_string(state, "store(true, 2.5)", 0, 0, 0));
+    ATF_REQUIRE(flag);
+    ATF_REQUIRE_EQ(2.5, received);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__tuple_result);
+ATF_TEST_CASE_BODY(push_callable__tuple_result)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_callable(state, [](const int value) {
+        return std::make_tuple(value / 2, value % 2 == 0, std::string("ok"));
+    });
+    state.set_global("split");
+    ATF_REQUIRE_EQ(3, lutok::do_string(state, "return split(7)", 0,
+                                       LUA_MULTRET, 0));
+    ATF_REQUIRE_EQ(3, state.to_integer(-3));
+    ATF_REQUIRE(!state.to_boolean(-2));
+    ATF_REQUIRE_EQ("ok", state.to_string(-1));
+    state.pop(3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__member_functions);
+ATF_TEST_CASE_BODY(push_callable__member_functions)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    accumulator object;
+    lua_pushlightuserdata(raw(state), &object);
+    state.set_global("object");
+    lutok::push_callable(state, &accumulator::add);
+    state.set_global("add");
+    lutok::push_callable(state, &accumulator::total);
+    state.set_global("total");
+
+    lutok::do_string(state, "add(object, 4); add(object, 5); "
+                     "return total(object)", 0, 1, 0);
+    ATF_REQUIRE_EQ(9, state.to_integer(-1));
+    state.pop(1);
+    ATF_REQUIRE_EQ(9, object.total());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__bad_argument);
+ATF_TEST_CASE_BODY(push_callable__bad_argument)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_callable(state, add);
+    state.set_global("add");
+    ATF_REQUIRE_THROW_RE(lutok::error,
+                         "bad argument #2.*number expected, got table",
+                         lutok::do_string(state, "return add(1, {})",
+                                          0, 1, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__missing_argument);
+ATF_TEST_CASE_BODY(push_callable__missing_argument)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_callable(state, add);
+    state.set_global("add");
+    ATF_REQUIRE_THROW_RE(lutok::error,
+                         "bad argument #2.*number expected, got no value",
+                         lutok::do_string(state, "return add(1)", 0, 1, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__exception);
+ATF_TEST_CASE_BODY(push_callable__exception)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_callable(state, [](const std::string& message) {
+        throw std::runtime_error("Failed with " + message);
+    });
+    state.set_global("fail");
+    ATF_REQUIRE_THROW_RE(lutok::error, "Failed with foo",
+                         lutok::do_string(state, "fail('foo')", 0, 0, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_callable__collected);
+ATF_TEST_CASE_BODY(push_callable__collected)
+{
+    int live = 0;
+    {
+        lutok::state state;
+        lutok::push_callable(state, tracker(&live));
+        state.set_global("live");
+        lutok::do_string(state, "return live()", 0, 1, 0);
+        ATF_REQUIRE_EQ(1, state.to_integer(-1));
+        state.pop(1);
+        ATF_REQUIRE_EQ(1, live);
+
+        lutok::do_string(state, "live = nil; collectgarbage()", 0, 0, 0);
+        ATF_REQUIRE_EQ(0, live);
+    }
+    ATF_REQUIRE_EQ(0, live);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, push_callable__function_pointer);
+    ATF_ADD_TEST_CASE(tcs, push_callable__lambda);
+    ATF_ADD_TEST_CASE(tcs, push_callable__mutable_lambda);
+    ATF_ADD_TEST_CASE(tcs, push_callable__void_result);
+    ATF_ADD_TEST_CASE(tcs, push_callable__tuple_result);
+    ATF_ADD_TEST_CASE(tcs, push_callable__member_functions);
+    ATF_ADD_TEST_CASE(tcs, push_callable__bad_argument);
+    ATF_ADD_TEST_CASE(tcs, push_callable__missing_argument);
+    ATF_ADD_TEST_CASE(tcs, push_callable__exception);
+    ATF_ADD_TEST_CASE(tcs, push_callable__collected);
+}
+
+
+#else  // !C++11
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(unsupported);
+ATF_TEST_CASE_BODY(unsupported)
+{
+    ATF_SKIP("bind.hpp requires C++11");
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, unsupported);
+}
+
+
+#endif  // C++11
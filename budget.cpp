@@ -0,0 +1,328 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "budget.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include <lua.hpp>
+
+#include "allocator.hpp"
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "internal.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Object whose address identifies the budget of a state in its registry.
+static const char registry_key = 0;
+
+
+/// Default number of instructions between checks of the budget.
+static const unsigned int default_check_interval = 1000;
+
+
+/// Gets the registry key of the budgets as a light userdata.
+///
+/// \return The key.
+static void*
+budget_key(void)
+{
+    return const_cast< char* >(&registry_key);
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::budget.
+struct lutok::budget::impl {
+    /// The Lua state to which the budget is attached.
+    lua_State* lua_state;
+
+    /// Number of instructions between checks of the budget.
+    unsigned int check_interval;
+
+    /// Maximum number of instructions to execute; 0 for no limit.
+    unsigned long instruction_limit;
+
+    /// Maximum wall-clock time to run, in milliseconds; 0 for no limit.
+    unsigned long time_limit;
+
+    /// Allocator whose limit bounds the memory of the state, if any.
+    allocator* memory_allocator;
+
+    /// Limit of memory_allocator before the budget changed it.
+    std::size_t previous_memory_limit;
+
+    /// Number of instructions executed since the last reset, in multiples of
+    /// the count of the hook.
+    unsigned long instructions;
+
+    /// Number of instructions between runs of the hook.
+    int hook_count;
+
+    /// Time at which the time limit expires, in milliseconds.
+    double deadline;
+
+    /// Name of the exceeded resource, or NULL if the budget is not exceeded.
+    const char* exceeded;
+
+    /// Attaches a new budget to a state.
+    ///
+    /// \param lua_state_ The Lua state.
+    impl(lua_State* lua_state_) :
+        lua_state(lua_state_),
+        check_interval(default_check_interval),
+        instruction_limit(0),
+        time_limit(0),
+        memory_allocator(NULL),
+        previous_memory_limit(0),
+        instructions(0),
+        hook_count(0),
+        deadline(0.0),
+        exceeded(NULL)
+    {
+    }
+
+    /// Gets the budget attached to a state.
+    ///
+    /// \param raw_state The Lua state or any of its threads.
+    ///
+    /// \return The budget, or NULL if the state does not have any.
+    static impl*
+    find(lua_State* raw_state)
+    {
+        lua_pushlightuserdata(raw_state, budget_key());
+        lua_rawget(raw_state, LUA_REGISTRYINDEX);
+        impl* budget = static_cast< impl* >(lua_touserdata(raw_state, -1));
+        lua_pop(raw_state, 1);
+        return budget;
+    }
+
+    /// Count hook to check the instruction and time limits.
+    ///
+    /// \param raw_state The Lua state running the hook.
+    /// \param unused_debug Information about the running function.
+    static void
+    hook(lua_State* raw_state, lua_Debug* /* unused_debug */)
+    {
+        impl* budget = find(raw_state);
+        if (budget == NULL)
+            return;
+
+        if (budget->exceeded == NULL) {
+            budget->instructions += budget->hook_count;
+            if (budget->instruction_limit != 0 &&
+                budget->instructions >= budget->instruction_limit)
+                budget->exceeded = "instructions";
+            else if (budget->time_limit != 0 &&
+                     lutok::detail::now_nanoseconds() / 1000000.0 >=
+                     budget->deadline)
+                budget->exceeded = "time";
+        }
+
+        if (budget->exceeded != NULL) {
+            // Fire on every instruction from now on so that the script cannot
+            // make any progress after catching the error.
+            lua_sethook(raw_state, hook, LUA_MASKCOUNT, 1);
+            luaL_error(raw_state, "Execution budget exceeded: %s",
+                       budget->exceeded);
+        }
+    }
+
+    /// Installs or removes the hook to match the configured limits.
+    void
+    update_hook(void)
+    {
+        if (instruction_limit == 0 && time_limit == 0) {
+            hook_count = 0;
+            lua_sethook(lua_state, NULL, 0, 0);
+            return;
+        }
+
+        unsigned long count = check_interval;
+        if (instruction_limit != 0 && instruction_limit < count)
+            count = instruction_limit;
+        hook_count = static_cast< int >(count);
+        lua_sethook(lua_state, hook, LUA_MASKCOUNT, hook_count);
+    }
+};
+
+
+/// Attaches a budget without limits to a state.
+///
+/// \param s The Lua state.
+///
+/// \throw error If the state already has a budget.
+lutok::budget::budget(state& s) :
+    _pimpl(new impl(state_c_gate(s).c_state()))
+{
+    if (impl::find(_pimpl->lua_state) != NULL)
+        throw lutok::error("The state already has a budget");
+
+    lua_pushlightuserdata(_pimpl->lua_state, budget_key());
+    lua_pushlightuserdata(_pimpl->lua_state, _pimpl.get());
+    lua_rawset(_pimpl->lua_state, LUA_REGISTRYINDEX);
+}
+
+
+/// Detaches the budget from the state, lifting all of its limits.
+lutok::budget::~budget(void)
+{
+    lua_sethook(_pimpl->lua_state, NULL, 0, 0);
+    if (_pimpl->memory_allocator != NULL)
+        _pimpl->memory_allocator->set_limit(_pimpl->previous_memory_limit);
+
+    lua_pushlightuserdata(_pimpl->lua_state, budget_key());
+    lua_pushnil(_pimpl->lua_state);
+    lua_rawset(_pimpl->lua_state, LUA_REGISTRYINDEX);
+}
+
+
+/// Gets the resource exceeded by the budget attached to a state, if any.
+///
+/// This is used to convert the errors raised by an exhausted budget into
+/// budget_exceeded_error exceptions.  Memory errors are attributed to the
+/// budget when it bounds the memory of the state.
+///
+/// \param s The Lua state.
+/// \param message The error message reported by Lua.
+///
+/// \return The name of the exceeded resource, or NULL if the state has no
+/// budget or the budget is not exceeded.
+const char*
+lutok::budget::exceeded_resource(state& s, const char* message)
+{
+    impl* budget = impl::find(state_c_gate(s).c_state());
+    if (budget == NULL)
+        return NULL;
+    if (budget->exceeded == NULL && budget->memory_allocator != NULL &&
+        std::strcmp(message, "not enough memory") == 0)
+        budget->exceeded = "memory";
+    return budget->exceeded;
+}
+
+
+/// Checks if the budget has been exceeded.
+///
+/// \return True if any of the limits has been exceeded since the last reset.
+bool
+lutok::budget::exceeded(void) const
+{
+    return _pimpl->exceeded != NULL;
+}
+
+
+/// Gets the number of instructions executed since the last reset.
+///
+/// \return The number of instructions, which is only accurate to the check
+/// interval and only counted while an instruction or time limit is set.
+unsigned long
+lutok::budget::instructions(void) const
+{
+    return _pimpl->instructions;
+}
+
+
+/// Grants a new budget.
+///
+/// This clears the exceeded flag, restarts the instruction count and sets a
+/// new deadline for the time limit, if any.
+void
+lutok::budget::reset(void)
+{
+    _pimpl->exceeded = NULL;
+    _pimpl->instructions = 0;
+    _pimpl->deadline = detail::now_nanoseconds() / 1000000.0 +
+        _pimpl->time_limit;
+    _pimpl->update_hook();
+}
+
+
+/// Sets the number of instructions between checks of the budget.
+///
+/// Lower values make the limits more precise at the expense of running the
+/// hook more often.
+///
+/// \param interval The number of instructions.  Must be positive.
+void
+lutok::budget::set_check_interval(const unsigned int interval)
+{
+    assert(interval > 0);
+    _pimpl->check_interval = interval;
+    _pimpl->update_hook();
+}
+
+
+/// Sets the maximum number of instructions to execute.
+///
+/// \param limit The number of instructions, counted from now on, or 0 to
+///     remove the limit.
+void
+lutok::budget::set_instruction_limit(const unsigned long limit)
+{
+    _pimpl->instruction_limit = limit;
+    _pimpl->instructions = 0;
+    _pimpl->update_hook();
+}
+
+
+/// Sets the maximum memory that the state can hold.
+///
+/// \param memory_allocator The allocator of the state.  The budget changes its
+///     limit and restores the previous one when destroyed.
+/// \param limit The maximum number of bytes, or 0 to remove the limit.
+void
+lutok::budget::set_memory_limit(allocator& memory_allocator,
+                                const std::size_t limit)
+{
+    if (_pimpl->memory_allocator == NULL) {
+        _pimpl->memory_allocator = &memory_allocator;
+        _pimpl->previous_memory_limit = memory_allocator.limit();
+    }
+    assert(_pimpl->memory_allocator == &memory_allocator);
+    memory_allocator.set_limit(limit);
+}
+
+
+/// Sets the maximum wall-clock time that Lua code can run.
+///
+/// \param milliseconds The time limit, counted from now on, or 0 to remove the
+///     limit.
+void
+lutok::budget::set_time_limit(const unsigned long milliseconds)
+{
+    _pimpl->time_limit = milliseconds;
+    _pimpl->deadline = detail::now_nanoseconds() / 1000000.0 + milliseconds;
+    _pimpl->update_hook();
+}
@@ -0,0 +1,110 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file budget.hpp
+/// Provides execution budgets to stop runaway scripts.
+
+#if !defined(LUTOK_BUDGET_HPP)
+#define LUTOK_BUDGET_HPP
+
+#include <cstddef>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class allocator;
+class api_error;
+class state;
+
+
+/// Limits on the resources that the code run by a state can consume.
+///
+/// A budget bounds the number of Lua instructions executed, the wall-clock time
+/// elapsed while running Lua code and the memory held by the state.  The
+/// instruction and time limits are counted from the moment they are set or
+/// the budget is reset.  When any of these
+/// limits is exceeded, the running code is aborted with a Lua error and the
+/// lutok call that started it raises budget_exceeded_error.  Once exceeded, the
+/// budget raises errors as soon as Lua executes any further instruction, so
+/// scripts cannot avoid their termination by catching the error with pcall.
+/// Call reset() to grant a new budget.
+///
+/// Instructions and time are checked from a count hook installed with
+/// lua_sethook, which runs every check_interval instructions.  The hook is only
+/// installed while an instruction or time limit is set, so a budget without
+/// such limits has no cost.  Memory is bounded through the limit of the
+/// allocator of the state, which must thus be created with a lutok allocator.
+///
+/// Hooks are per-thread in Lua: coroutines inherit the hook of the thread that
+/// creates them, so the budget must be configured before creating any
+/// coroutines that it should cover.
+///
+/// At most one budget can be attached to a state at any given time, and it
+/// must be destroyed before the state is closed.
+class budget {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    friend class api_error;
+    static const char* exceeded_resource(state&, const char*);
+
+    /// Disallow copies.
+    budget(const budget&);
+
+    /// Disallow assignment.
+    budget& operator=(const budget&);
+
+public:
+    explicit budget(state&);
+    ~budget(void);
+
+    bool exceeded(void) const;
+    unsigned long instructions(void) const;
+    void reset(void);
+    void set_check_interval(const unsigned int);
+    void set_instruction_limit(const unsigned long);
+    void set_memory_limit(allocator&, const std::size_t);
+    void set_time_limit(const unsigned long);
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_BUDGET_HPP)
@@ -0,0 +1,187 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "budget.hpp"
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "allocator.hpp"
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(no_limits);
+ATF_TEST_CASE_BODY(no_limits)
+{
+    lutok::state state;
+    {
+        lutok::budget budget(state);
+        ATF_REQUIRE(lua_gethook(raw(state)) == NULL);
+        lutok::do_string(state, "for i = 1, 100000 do end", 0, 0, 0);
+        ATF_REQUIRE(!budget.exceeded());
+        ATF_REQUIRE_EQ(0, budget.instructions());
+
+        budget.set_instruction_limit(1000);
+        ATF_REQUIRE(lua_gethook(raw(state)) != NULL);
+        budget.set_instruction_limit(0);
+        ATF_REQUIRE(lua_gethook(raw(state)) == NULL);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instruction_limit);
+ATF_TEST_CASE_BODY(instruction_limit)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::budget budget(state);
+    budget.set_check_interval(100);
+    budget.set_instruction_limit(10000);
+    try {
+        lutok::do_string(state, "while true do end", 0, 0, 0);
+        ATF_FAIL("budget_exceeded_error not raised");
+    } catch (const lutok::budget_exceeded_error& e) {
+        ATF_REQUIRE_EQ("instructions", e.resource());
+        ATF_REQUIRE_MATCH("budget exceeded", e.what());
+    }
+    ATF_REQUIRE(budget.exceeded());
+    ATF_REQUIRE(budget.instructions() >= 10000);
+
+    budget.reset();
+    ATF_REQUIRE(!budget.exceeded());
+    lutok::do_string(state, "local a = 1 + 2", 0, 0, 0);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instruction_limit__pcall);
+ATF_TEST_CASE_BODY(instruction_limit__pcall)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    lutok::budget budget(state);
+    budget.set_instruction_limit(10000);
+    ATF_REQUIRE_THROW(lutok::budget_exceeded_error,
+                      lutok::do_string(state, "while true do "
+                                       "pcall(function() while true do end "
+                                       "end) end", 0, 0, 0));
+    ATF_REQUIRE(budget.exceeded());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(time_limit);
+ATF_TEST_CASE_BODY(time_limit)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::budget budget(state);
+    budget.set_time_limit(50);
+    try {
+        lutok::do_string(state, "while true do end", 0, 0, 0);
+        ATF_FAIL("budget_exceeded_error not raised");
+    } catch (const lutok::budget_exceeded_error& e) {
+        ATF_REQUIRE_EQ("time", e.resource());
+    }
+    ATF_REQUIRE(budget.exceeded());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(memory_limit);
+ATF_TEST_CASE_BODY(memory_limit)
+{
+    lutok::malloc_allocator allocator;
+    lutok::state state(allocator);
+    state.open_base();
+    {
+        lutok::budget budget(state);
+        budget.set_memory_limit(allocator,
+                                allocator.bytes_in_use() + 64 * 1024);
+        try {
+            lutok::do_string(state, "local t = {}; for i = 1, 1000000 do "
+                             "t[i] = tostring(i) end", 0, 0, 0);
+            ATF_FAIL("budget_exceeded_error not raised");
+        } catch (const lutok::budget_exceeded_error& e) {
+            ATF_REQUIRE_EQ("memory", e.resource());
+        }
+        ATF_REQUIRE(budget.exceeded());
+    }
+    ATF_REQUIRE_EQ(0, allocator.limit());
+    state.close();
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(other_errors);
+ATF_TEST_CASE_BODY(other_errors)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    lutok::budget budget(state);
+    budget.set_instruction_limit(1000000);
+    try {
+        lutok::do_string(state, "error('oops')", 0, 0, 0);
+        ATF_FAIL("error not raised");
+    } catch (const lutok::budget_exceeded_error&) {
+        ATF_FAIL("Unexpected budget_exceeded_error");
+    } catch (const lutok::error& e) {
+        ATF_REQUIRE_MATCH("oops", e.what());
+    }
+    ATF_REQUIRE(!budget.exceeded());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(one_per_state);
+ATF_TEST_CASE_BODY(one_per_state)
+{
+    lutok::state state;
+    {
+        lutok::budget budget(state);
+        ATF_REQUIRE_THROW_RE(lutok::error, "already has a budget",
+                             lutok::budget other(state));
+    }
+    lutok::budget budget(state);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, no_limits);
+    ATF_ADD_TEST_CASE(tcs, instruction_limit);
+    ATF_ADD_TEST_CASE(tcs, instruction_limit__pcall);
+    ATF_ADD_TEST_CASE(tcs, time_limit);
+    ATF_ADD_TEST_CASE(tcs, memory_limit);
+    ATF_ADD_TEST_CASE(tcs, other_errors);
+    ATF_ADD_TEST_CASE(tcs, one_per_state);
+}
@@ -59,6 +59,9 @@ lutok::state_c_gate::~state_c_gate(void)
 /// \param raw_state The raw state to wrap temporarily.
 ///
 /// \return The wrapped state without strong ownership on the input state.
+///
+/// \see state_ref, which provides the same functionality without allocating
+/// memory and is thus more suitable for code in the hot path.
 lutok::state
 lutok::state_c_gate::connect(lua_State* raw_state)
 {
@@ -34,10 +34,9 @@
 
 #include <lua.hpp>
 
-namespace lutok {
-
+#include <lutok/state.hpp>
 
-class state;
+namespace lutok {
 
 
 /// Gateway to the raw C state of Lua.
@@ -66,6 +65,59 @@ public:
 };
 
 
+/// Non-owning handle to a raw Lua state that does not allocate memory.
+///
+/// This is the cheap counterpart of state_c_gate::connect(): while connect()
+/// returns a state object whose internal implementation lives in the heap, a
+/// state_ref keeps the implementation inline so that it can be constructed on
+/// the stack at no cost.  This is what the C++ trampolines use to deliver
+/// calls from Lua to cxx_function objects.
+///
+/// Use this class as follows:
+///
+/// static int
+/// my_c_function(lua_State* raw_state)
+/// {
+///     lutok::state_ref ref(raw_state);
+///     lutok::state& state = ref;
+///     ... use state here ...
+/// }
+///
+/// \warning The wrapped state is only valid during the lifetime of the
+/// state_ref object, so references and pointers to it must not be kept past
+/// that.  Copies of the state obtained from it, however, remain valid: they
+/// allocate their own internal implementation, as those returned by
+/// state_c_gate::connect() do.
+class state_ref {
+    /// Inline storage for the internal implementation of the wrapped state.
+    ///
+    /// The implementation verifies that this is large enough to hold the
+    /// internal implementation of the state class.
+    union storage {
+        /// Unused; only present to force pointer alignment.
+        void* align;
+
+        /// Raw bytes of the storage.
+        char data[2 * sizeof(void*)];
+    } _storage;
+
+    /// The wrapped state, built on top of _storage.
+    state _state;
+
+    /// Disallow copies.
+    state_ref(const state_ref&);
+
+    /// Disallow assignment.
+    state_ref& operator=(const state_ref&);
+
+public:
+    explicit state_ref(lua_State*);
+    ~state_ref(void);
+
+    operator state&(void);
+};
+
+
 }  // namespace lutok
 
 #endif  // !defined(LUTOK_C_GATE_HPP)
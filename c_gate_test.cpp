@@ -67,8 +67,56 @@ ATF_TEST_CASE_BODY(c_state)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(state_ref);
+ATF_TEST_CASE_BODY(state_ref)
+{
+    lua_State* raw_state = luaL_newstate();
+    ATF_REQUIRE(raw_state != NULL);
+
+    {
+        lutok::state_ref ref(raw_state);
+        lutok::state& state = ref;
+        ATF_REQUIRE(raw(state) == raw_state);
+        state.push_integer(123);
+    }
+    // If the wrapper object had closed the Lua state, we could very well crash
+    // here.
+    ATF_REQUIRE_EQ(123, lua_tointeger(raw_state, -1));
+
+    lua_close(raw_state);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(state_ref__copy);
+ATF_TEST_CASE_BODY(state_ref__copy)
+{
+    lua_State* raw_state = luaL_newstate();
+    ATF_REQUIRE(raw_state != NULL);
+
+    lutok::state* copy;
+    {
+        lutok::state_ref ref(raw_state);
+        lutok::state& state = ref;
+        copy = new lutok::state(state);
+        lutok::state assigned;
+        assigned = state;
+        ATF_REQUIRE(raw(assigned) == raw_state);
+    }
+    // The copy must not refer to the storage of the gone state_ref.
+    ATF_REQUIRE(raw(*copy) == raw_state);
+    copy->push_integer(123);
+    ATF_REQUIRE_EQ(123, lua_tointeger(raw_state, -1));
+    delete copy;
+
+    ATF_REQUIRE_EQ(123, lua_tointeger(raw_state, -1));
+    lua_close(raw_state);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, c_state);
     ATF_ADD_TEST_CASE(tcs, connect);
+    ATF_ADD_TEST_CASE(tcs, state_ref);
+    ATF_ADD_TEST_CASE(tcs, state_ref__copy);
 }
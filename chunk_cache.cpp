@@ -0,0 +1,644 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+}
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "chunk_cache.hpp"
+#include "exceptions.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Chunk name given to Lua when undumping cached chunks.
+///
+/// Binary chunks carry their own source name, so this is only used by Lua to
+/// report problems with the binary data itself.
+static const char* const cached_chunk_name = "=chunk_cache";
+
+
+/// Default maximum number of chunks held in memory by a cache.
+static const std::size_t default_max_entries = 256;
+
+
+/// Initial value of the 64-bit FNV-1a hash.
+static const uint64_t fnv1a_basis =
+    (static_cast< uint64_t >(0xcbf29ce4U) << 32) | 0x84222325U;
+
+
+/// Computes the 64-bit FNV-1a hash of a buffer.
+///
+/// \param data The buffer to hash.
+/// \param length The length of the buffer.
+/// \param hash The hash of the data that precedes the buffer, or fnv1a_basis
+///     if there is none.
+///
+/// \return The hash of the buffer.
+static uint64_t
+fnv1a(const char* data, const std::size_t length,
+      uint64_t hash = fnv1a_basis)
+{
+    const uint64_t prime = (static_cast< uint64_t >(0x100U) << 32) | 0x1b3U;
+    for (std::size_t i = 0; i < length; i++) {
+        hash ^= static_cast< unsigned char >(data[i]);
+        hash *= prime;
+    }
+    return hash;
+}
+
+
+/// Formats a hash as a fixed-length hexadecimal string.
+///
+/// \param hash The hash to format.
+///
+/// \return The textual representation of the hash.
+static std::string
+format_hash(const uint64_t hash)
+{
+    std::ostringstream output;
+    output << std::hex << std::setfill('0') << std::setw(16) << hash;
+    return output.str();
+}
+
+
+/// Computes the key that identifies a file in the cache.
+///
+/// \param file The path to the file.
+///
+/// \return The key of the file.
+///
+/// \throw file_not_found_error If the file cannot be accessed.
+static std::string
+file_key(const std::string& file)
+{
+    struct ::stat sb;
+    if (::access(file.c_str(), R_OK) == -1 || ::stat(file.c_str(), &sb) == -1)
+        throw lutok::file_not_found_error(file);
+
+    std::ostringstream key;
+    key << "file:" << sb.st_dev << ':' << sb.st_ino << ':' << sb.st_mtime
+        << ':' << sb.st_size << ':' << file;
+    return key.str();
+}
+
+
+/// Prefix of the keys of the strings in the on-disk copies of the chunks.
+static const std::string string_prefix = "string:";
+
+
+/// Separates the key and the compiled chunk stored in a cache file.
+///
+/// Cache files start with the length of the key in decimal, a newline and the
+/// key itself, so that chunks whose keys hash to the same file name are not
+/// mistaken for one another.  The key is given in two parts so that callers
+/// need not concatenate them.
+///
+/// \param contents The contents of the file.
+/// \param prefix The first part of the key of the chunk being looked for.
+/// \param suffix The second part of the key of the chunk being looked for.
+/// \param [out] bytecode The compiled chunk, if the file holds it.
+///
+/// \return True if the file holds the chunk for key; false otherwise.
+static bool
+parse_cache_file(const std::string& contents, const std::string& prefix,
+                 const std::string& suffix, std::string& bytecode)
+{
+    const std::string::size_type newline = contents.find('\n');
+    if (newline == std::string::npos)
+        return false;
+    std::istringstream header(contents.substr(0, newline));
+    std::string::size_type length;
+    if (!(header >> length) || !header.eof() ||
+        length != prefix.length() + suffix.length())
+        return false;
+    if (contents.compare(newline + 1, prefix.length(), prefix) != 0 ||
+        contents.compare(newline + 1 + prefix.length(), suffix.length(),
+                         suffix) != 0)
+        return false;
+    bytecode = contents.substr(newline + 1 + length);
+    return !bytecode.empty();
+}
+
+
+/// Pushes a function onto the stack from its binary form.
+///
+/// \param s The Lua state.
+/// \param bytecode The output of a previous dump_function call.
+///
+/// \throw api_error If the binary chunk is not valid for this version of Lua.
+static void
+undump_function(lutok::state& s, const std::string& bytecode)
+{
+    lua_State* raw_state = lutok::state_c_gate(s).c_state();
+
+#if LUA_VERSION_NUM >= 502
+    if (luaL_loadbufferx(raw_state, bytecode.data(), bytecode.length(),
+                         cached_chunk_name, "b") != 0)
+        throw lutok::api_error::from_stack(s, "luaL_loadbufferx");
+#else
+    if (luaL_loadbuffer(raw_state, bytecode.data(), bytecode.length(),
+                        cached_chunk_name) != 0)
+        throw lutok::api_error::from_stack(s, "luaL_loadbuffer");
+#endif
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::chunk_cache.
+struct lutok::chunk_cache::impl {
+    /// A compiled chunk held in memory.
+    struct entry {
+        /// The source code of the chunk; only set for strings.
+        std::string source;
+
+        /// The output of state::dump for the chunk.
+        std::string bytecode;
+
+        /// Value of the use counter of the cache when last used.
+        unsigned long last_use;
+    };
+
+    /// Compiled files indexed by their key, as returned by file_key.
+    typedef std::map< std::string, entry > file_map;
+
+    /// Identifier of a string: its hash and its length.
+    typedef std::pair< uint64_t, std::size_t > string_id;
+
+    /// Compiled strings indexed by their identifier.
+    ///
+    /// Different strings can share the same identifier, so the source code
+    /// of the entries must be compared to find a match.
+    typedef std::multimap< string_id, entry > string_map;
+
+    /// Directory in which to persist the compiled chunks; empty for none.
+    std::string directory;
+
+    /// Compiled files held in memory.
+    file_map files;
+
+    /// Compiled strings held in memory.
+    string_map strings;
+
+    /// Maximum number of chunks to hold in memory; 0 for no limit.
+    std::size_t max_entries;
+
+    /// Counter of the uses of the chunks, to find the least recently used.
+    unsigned long uses;
+
+    /// Number of loads served from the cache.
+    std::size_t hits;
+
+    /// Number of loads that required compiling the source code.
+    std::size_t misses;
+
+    /// Constructor.
+    ///
+    /// \param directory_ Directory in which to persist the compiled chunks, or
+    ///     an empty string to keep them in memory only.
+    impl(const std::string& directory_) :
+        directory(directory_),
+        max_entries(default_max_entries),
+        uses(0),
+        hits(0),
+        misses(0)
+    {
+    }
+
+    /// Computes the path to the on-disk copy of a chunk.
+    ///
+    /// The name of the file accounts for the version of Lua and the size of
+    /// pointers, so that incompatible builds sharing a cache directory do not
+    /// overwrite each other's chunks.
+    ///
+    /// \param prefix The first part of the key of the chunk.
+    /// \param suffix The second part of the key of the chunk.
+    ///
+    /// \return The path to the file holding the chunk.
+    std::string
+    path_for(const std::string& prefix, const std::string& suffix) const
+    {
+        std::ostringstream tag;
+        tag << LUA_VERSION_NUM << ':' << sizeof(void*) << ':';
+        const std::string input = tag.str();
+        uint64_t hash = fnv1a(input.data(), input.length());
+        hash = fnv1a(prefix.data(), prefix.length(), hash);
+        hash = fnv1a(suffix.data(), suffix.length(), hash);
+        return directory + "/" + format_hash(hash) + ".luac";
+    }
+
+    /// Reads the on-disk copy of a chunk.
+    ///
+    /// \param prefix The first part of the key of the chunk.
+    /// \param suffix The second part of the key of the chunk.
+    /// \param [out] bytecode The compiled chunk, if found.
+    ///
+    /// \return True if the chunk was found on disk; false otherwise.
+    bool
+    read_file(const std::string& prefix, const std::string& suffix,
+         std::string& bytecode) const
+    {
+        if (directory.empty())
+            return false;
+
+        std::ifstream input(path_for(prefix, suffix).c_str(),
+                            std::ios::binary);
+        if (!input)
+            return false;
+        std::ostringstream contents;
+        contents << input.rdbuf();
+        return !input.bad() && parse_cache_file(contents.str(), prefix,
+                                                suffix, bytecode);
+    }
+
+    /// Writes the on-disk copy of a chunk.
+    ///
+    /// The chunk is written to a temporary file first so that concurrent
+    /// readers, in this process or others, never see a partially-written
+    /// chunk.
+    ///
+    /// \param prefix The first part of the key of the chunk.
+    /// \param suffix The second part of the key of the chunk.
+    /// \param bytecode The compiled chunk.
+    void
+    write_file(const std::string& prefix, const std::string& suffix,
+          const std::string& bytecode) const
+    {
+        if (directory.empty())
+            return;
+
+        const std::string path = path_for(prefix, suffix);
+        const std::string pattern = path + ".XXXXXX";
+        std::vector< char > temp(pattern.begin(), pattern.end());
+        temp.push_back('\0');
+        const int fd = ::mkstemp(&temp[0]);
+        if (fd == -1)
+            return;
+        std::FILE* output = ::fdopen(fd, "wb");
+        if (output == NULL) {
+            ::close(fd);
+            ::unlink(&temp[0]);
+            return;
+        }
+
+        std::ostringstream header;
+        header << prefix.length() + suffix.length() << '\n' << prefix;
+        const std::string header_str = header.str();
+        bool ok =
+            std::fwrite(header_str.data(), 1, header_str.length(), output) ==
+                header_str.length() &&
+            std::fwrite(suffix.data(), 1, suffix.length(), output) ==
+                suffix.length() &&
+            std::fwrite(bytecode.data(), 1, bytecode.length(), output) ==
+                bytecode.length();
+        ok = std::fclose(output) == 0 && ok;
+        if (!ok || std::rename(&temp[0], path.c_str()) == -1)
+            ::unlink(&temp[0]);
+    }
+
+    /// Pushes a chunk held in memory onto the stack.
+    ///
+    /// \param s The Lua state.
+    /// \param cached The chunk.
+    ///
+    /// \return True if the chunk has been pushed; false if it cannot be loaded
+    /// and must be dropped, such as an on-disk copy written by a different
+    /// version of Lua.
+    bool
+    undump(state& s, entry& cached)
+    {
+        try {
+            undump_function(s, cached.bytecode);
+        } catch (const lutok::api_error& /* error */) {
+            return false;
+        }
+        cached.last_use = ++uses;
+        ++hits;
+        return true;
+    }
+
+    /// Drops the least recently used chunks until the limit is honored.
+    void
+    trim(void)
+    {
+        while (max_entries != 0 &&
+               files.size() + strings.size() > max_entries) {
+            file_map::iterator oldest_file = files.end();
+            for (file_map::iterator iter = files.begin(); iter != files.end();
+                 ++iter) {
+                if (oldest_file == files.end() ||
+                    (*iter).second.last_use < (*oldest_file).second.last_use)
+                    oldest_file = iter;
+            }
+            string_map::iterator oldest_string = strings.end();
+            for (string_map::iterator iter = strings.begin();
+                 iter != strings.end(); ++iter) {
+                if (oldest_string == strings.end() ||
+                    (*iter).second.last_use < (*oldest_string).second.last_use)
+                    oldest_string = iter;
+            }
+
+            if (oldest_string == strings.end() ||
+                (oldest_file != files.end() &&
+                 (*oldest_file).second.last_use <
+                 (*oldest_string).second.last_use))
+                files.erase(oldest_file);
+            else
+                strings.erase(oldest_string);
+        }
+    }
+
+    /// Pushes a compiled file onto the stack if it is in the cache.
+    ///
+    /// \param s The Lua state.
+    /// \param key The key of the file.
+    ///
+    /// \return True if the chunk has been pushed; false otherwise.
+    bool
+    load_cached_file(state& s, const std::string& key)
+    {
+        file_map::iterator iter = files.find(key);
+        if (iter == files.end()) {
+            std::string bytecode;
+            if (!read_file(key, "", bytecode))
+                return false;
+            iter = files.insert(file_map::value_type(key, entry())).first;
+            (*iter).second.bytecode.swap(bytecode);
+        }
+
+        if (!undump(s, (*iter).second)) {
+            files.erase(iter);
+            return false;
+        }
+        trim();
+        return true;
+    }
+
+    /// Pushes a compiled string onto the stack if it is in the cache.
+    ///
+    /// \param s The Lua state.
+    /// \param str The source code of the chunk.
+    /// \param id The identifier of the string.
+    ///
+    /// \return True if the chunk has been pushed; false otherwise.
+    bool
+    load_cached_string(state& s, const std::string& str, const string_id& id)
+    {
+        std::pair< string_map::iterator, string_map::iterator > range =
+            strings.equal_range(id);
+        string_map::iterator iter = range.first;
+        while (iter != range.second && (*iter).second.source != str)
+            ++iter;
+        if (iter == range.second) {
+            std::string bytecode;
+            if (!read_file(string_prefix, str, bytecode))
+                return false;
+            iter = strings.insert(string_map::value_type(id, entry()));
+            (*iter).second.source = str;
+            (*iter).second.bytecode.swap(bytecode);
+        }
+
+        if (!undump(s, (*iter).second)) {
+            strings.erase(iter);
+            return false;
+        }
+        trim();
+        return true;
+    }
+
+    /// Compiles the function on the top of the stack.
+    ///
+    /// \param s The Lua state.
+    /// \param [out] cached The entry in which to store the compiled chunk.
+    ///
+    /// \return True if the function could be dumped; false otherwise.
+    bool
+    dump(state& s, entry& cached)
+    {
+        ++misses;
+        try {
+            cached.bytecode = s.dump();
+        } catch (const lutok::api_error& /* error */) {
+            return false;
+        }
+        cached.last_use = ++uses;
+        return true;
+    }
+
+    /// Stores the file on the top of the stack in the cache.
+    ///
+    /// The function is left on the stack.
+    ///
+    /// \param s The Lua state.
+    /// \param key The key of the file.
+    void
+    store_file(state& s, const std::string& key)
+    {
+        entry cached;
+        if (!dump(s, cached))
+            return;
+        entry& stored = files[key];
+        stored.bytecode.swap(cached.bytecode);
+        stored.last_use = cached.last_use;
+        write_file(key, "", stored.bytecode);
+        trim();
+    }
+
+    /// Stores the string on the top of the stack in the cache.
+    ///
+    /// The function is left on the stack.
+    ///
+    /// \param s The Lua state.
+    /// \param str The source code of the chunk.
+    /// \param id The identifier of the string.
+    void
+    store_string(state& s, const std::string& str, const string_id& id)
+    {
+        entry cached;
+        if (!dump(s, cached))
+            return;
+        entry& stored = (*strings.insert(
+            string_map::value_type(id, entry()))).second;
+        stored.source = str;
+        stored.bytecode.swap(cached.bytecode);
+        stored.last_use = cached.last_use;
+        write_file(string_prefix, str, stored.bytecode);
+        trim();
+    }
+};
+
+
+/// Constructs a new cache that keeps compiled chunks in memory only.
+lutok::chunk_cache::chunk_cache(void) :
+    _pimpl(new impl(""))
+{
+}
+
+
+/// Constructs a new cache backed by a directory.
+///
+/// \param directory The directory in which to persist the compiled chunks.
+///     The directory must exist; if it is not writable, the compiled chunks
+///     are kept in memory only.
+lutok::chunk_cache::chunk_cache(const std::string& directory) :
+    _pimpl(new impl(directory))
+{
+}
+
+
+/// Destructor.
+lutok::chunk_cache::~chunk_cache(void)
+{
+}
+
+
+/// Removes all the chunks from the in-memory cache.
+///
+/// The on-disk copies of the chunks, if any, are not deleted.
+void
+lutok::chunk_cache::clear(void)
+{
+    _pimpl->files.clear();
+    _pimpl->strings.clear();
+}
+
+
+/// Gets the number of loads that have been served from the cache.
+///
+/// \return A counter.
+std::size_t
+lutok::chunk_cache::hits(void) const
+{
+    return _pimpl->hits;
+}
+
+
+/// Loads a file, reusing its compiled form if possible.
+///
+/// This is a replacement for state::load_file.  The file is considered to be
+/// unmodified as long as its modification time and size do not change.
+///
+/// \param s The Lua state.
+/// \param file The file to load.
+///
+/// \throw file_not_found_error If the file cannot be accessed.
+/// \throw api_error If the file cannot be compiled.
+void
+lutok::chunk_cache::load_file(state& s, const std::string& file)
+{
+    const std::string key = file_key(file);
+    if (_pimpl->load_cached_file(s, key))
+        return;
+
+    s.load_file(file);
+    _pimpl->store_file(s, key);
+}
+
+
+/// Loads a string, reusing its compiled form if possible.
+///
+/// This is a replacement for state::load_string.
+///
+/// \param s The Lua state.
+/// \param str The chunk to load.
+///
+/// \throw api_error If the string cannot be compiled.
+void
+lutok::chunk_cache::load_string(state& s, const std::string& str)
+{
+    const impl::string_id id(fnv1a(str.data(), str.length()), str.length());
+    if (_pimpl->load_cached_string(s, str, id))
+        return;
+
+    s.load_string(str);
+    _pimpl->store_string(s, str, id);
+}
+
+
+/// Gets the maximum number of chunks held in memory.
+///
+/// \return The limit, or 0 if there is none.
+std::size_t
+lutok::chunk_cache::max_entries(void) const
+{
+    return _pimpl->max_entries;
+}
+
+
+/// Gets the number of loads that required compiling the source code.
+///
+/// \return A counter.
+std::size_t
+lutok::chunk_cache::misses(void) const
+{
+    return _pimpl->misses;
+}
+
+
+/// Sets the maximum number of chunks held in memory.
+///
+/// Once the limit is reached, storing a new chunk drops the one that has gone
+/// unused for the longest time.  The on-disk copies of the dropped chunks, if
+/// any, are not deleted.
+///
+/// \param max_entries_ The new limit, or 0 to hold any number of chunks.
+void
+lutok::chunk_cache::set_max_entries(const std::size_t max_entries_)
+{
+    _pimpl->max_entries = max_entries_;
+    _pimpl->trim();
+}
+
+
+/// Gets the number of chunks held in memory.
+///
+/// \return A counter.
+std::size_t
+lutok::chunk_cache::size(void) const
+{
+    return _pimpl->files.size() + _pimpl->strings.size();
+}
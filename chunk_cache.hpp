@@ -0,0 +1,106 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file chunk_cache.hpp
+/// Provides a cache of compiled Lua chunks.
+
+#if !defined(LUTOK_CHUNK_CACHE_HPP)
+#define LUTOK_CHUNK_CACHE_HPP
+
+#include <cstddef>
+#include <string>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class state;
+
+
+/// Cache of compiled Lua chunks.
+///
+/// Loading a chunk with state::load_file or state::load_string runs the Lua
+/// compiler every time.  This cache keeps the binary form of the chunks, as
+/// produced by lua_dump, so that loading the same code again only needs to
+/// undump it.
+///
+/// Files are identified by their path, modification time and size, so
+/// modifying a file invalidates its cached copy.  Strings are identified by
+/// their whole contents: the cache keeps a copy of the source code of every
+/// string it holds to tell apart those that hash to the same value.  The
+/// on-disk copies record the key of their chunk, which is checked on every
+/// load.
+///
+/// The number of chunks held in memory is bounded by max_entries(), which
+/// defaults to 256; the least recently used chunks are dropped first.
+///
+/// The cache can optionally be backed by a directory on disk, in which case
+/// the compiled chunks survive across processes.  Disk operations are best
+/// effort: failures to read or write the cache directory are ignored and the
+/// code is compiled from source instead.
+///
+/// The cache does not depend on any particular state, so a single cache can
+/// serve any number of states.  It is not thread-safe, though.
+///
+/// \warning Lua does not validate binary chunks, and loading a malicious one
+/// can crash the process.  The cache directory must only be writable by
+/// trusted users.
+class chunk_cache {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+public:
+    chunk_cache(void);
+    explicit chunk_cache(const std::string&);
+    ~chunk_cache(void);
+
+    void clear(void);
+    std::size_t hits(void) const;
+    void load_file(state&, const std::string&);
+    void load_string(state&, const std::string&);
+    std::size_t max_entries(void) const;
+    std::size_t misses(void) const;
+    void set_max_entries(const std::size_t);
+    std::size_t size(void) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_CHUNK_CACHE_HPP)
@@ -0,0 +1,440 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "chunk_cache.hpp"
+
+extern "C" {
+#include <sys/stat.h>
+
+#include <dirent.h>
+}
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Creates a file with the given contents.
+///
+/// \param file The path to the file to create.
+/// \param contents The contents of the file.
+static void
+create_file(const std::string& file, const std::string& contents)
+{
+    std::ofstream output(file.c_str());
+    ATF_REQUIRE(output);
+    output << contents;
+}
+
+
+/// Calls the chunk on the top of the stack and returns its integer result.
+///
+/// \param state The Lua state.
+///
+/// \return The integer returned by the chunk.
+static long
+call_chunk(lutok::state& state)
+{
+    state.pcall(0, 1, 0);
+    const long result = state.to_integer(-1);
+    state.pop(1);
+    return result;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_string__hit);
+ATF_TEST_CASE_BODY(load_string__hit)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_string(state, "return 2 + 3");
+    ATF_REQUIRE_EQ(5, call_chunk(state));
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+
+    cache.load_string(state, "return 2 + 3");
+    ATF_REQUIRE_EQ(5, call_chunk(state));
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+    ATF_REQUIRE_EQ(1, cache.size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_string__different);
+ATF_TEST_CASE_BODY(load_string__different)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_string(state, "return 1");
+    ATF_REQUIRE_EQ(1, call_chunk(state));
+    cache.load_string(state, "return 2");
+    ATF_REQUIRE_EQ(2, call_chunk(state));
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(2, cache.misses());
+    ATF_REQUIRE_EQ(2, cache.size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_string__many_states);
+ATF_TEST_CASE_BODY(load_string__many_states)
+{
+    lutok::chunk_cache cache;
+    lutok::state state1;
+    lutok::state state2;
+
+    cache.load_string(state1, "return 7");
+    ATF_REQUIRE_EQ(7, call_chunk(state1));
+    cache.load_string(state2, "return 7");
+    ATF_REQUIRE_EQ(7, call_chunk(state2));
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_string__error);
+ATF_TEST_CASE_BODY(load_string__error)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    REQUIRE_API_ERROR("luaL_loadstring", cache.load_string(state, "-"));
+    ATF_REQUIRE_EQ(0, cache.size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_file__hit);
+ATF_TEST_CASE_BODY(load_file__hit)
+{
+    create_file("test.lua", "return 10\n");
+
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(10, call_chunk(state));
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(10, call_chunk(state));
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_file__modified);
+ATF_TEST_CASE_BODY(load_file__modified)
+{
+    create_file("test.lua", "return 10\n");
+
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(10, call_chunk(state));
+
+    create_file("test.lua", "return 12345\n");
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(12345, call_chunk(state));
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(2, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_file__debug_info);
+ATF_TEST_CASE_BODY(load_file__debug_info)
+{
+    create_file("test.lua", "\nerror('oops')\n");
+
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_file(state, "test.lua");
+    state.pop(1);
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "test.lua:2: oops",
+                         state.pcall(0, 0, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_file__not_found);
+ATF_TEST_CASE_BODY(load_file__not_found)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE_THROW_RE(lutok::file_not_found_error, "missing.lua",
+                         cache.load_file(state, "missing.lua"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(clear);
+ATF_TEST_CASE_BODY(clear)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_string(state, "return 1");
+    state.pop(1);
+    cache.clear();
+    ATF_REQUIRE_EQ(0, cache.size());
+    cache.load_string(state, "return 1");
+    state.pop(1);
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(2, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(max_entries);
+ATF_TEST_CASE_BODY(max_entries)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_EQ(256, cache.max_entries());
+
+    cache.set_max_entries(2);
+    cache.load_string(state, "return 1");
+    ATF_REQUIRE_EQ(1, call_chunk(state));
+    cache.load_string(state, "return 2");
+    ATF_REQUIRE_EQ(2, call_chunk(state));
+    cache.load_string(state, "return 1");
+    ATF_REQUIRE_EQ(1, call_chunk(state));
+    cache.load_string(state, "return 3");
+    ATF_REQUIRE_EQ(3, call_chunk(state));
+    ATF_REQUIRE_EQ(2, cache.size());
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_EQ(3, cache.misses());
+
+    cache.load_string(state, "return 1");
+    ATF_REQUIRE_EQ(1, call_chunk(state));
+    cache.load_string(state, "return 2");
+    ATF_REQUIRE_EQ(2, call_chunk(state));
+    ATF_REQUIRE_EQ(2, cache.hits());
+    ATF_REQUIRE_EQ(4, cache.misses());
+
+    cache.set_max_entries(1);
+    ATF_REQUIRE_EQ(1, cache.size());
+    cache.set_max_entries(0);
+    cache.load_string(state, "return 4");
+    ATF_REQUIRE_EQ(4, call_chunk(state));
+    ATF_REQUIRE_EQ(2, cache.size());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(directory__persist);
+ATF_TEST_CASE_BODY(directory__persist)
+{
+    ATF_REQUIRE(::mkdir("cache", 0755) != -1);
+    create_file("test.lua", "return 3\n");
+
+    {
+        lutok::chunk_cache cache("cache");
+        lutok::state state;
+        cache.load_file(state, "test.lua");
+        ATF_REQUIRE_EQ(3, call_chunk(state));
+        cache.load_string(state, "return 4");
+        ATF_REQUIRE_EQ(4, call_chunk(state));
+        ATF_REQUIRE_EQ(2, cache.misses());
+    }
+
+    lutok::chunk_cache cache("cache");
+    lutok::state state;
+    stack_balance_checker checker(state);
+    cache.load_file(state, "test.lua");
+    ATF_REQUIRE_EQ(3, call_chunk(state));
+    cache.load_string(state, "return 4");
+    ATF_REQUIRE_EQ(4, call_chunk(state));
+    ATF_REQUIRE_EQ(2, cache.hits());
+    ATF_REQUIRE_EQ(0, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(directory__corrupt);
+ATF_TEST_CASE_BODY(directory__corrupt)
+{
+    ATF_REQUIRE(::mkdir("cache", 0755) != -1);
+
+    {
+        lutok::chunk_cache cache("cache");
+        lutok::state state;
+        cache.load_string(state, "return 4");
+        state.pop(1);
+    }
+
+    DIR* dir = ::opendir("cache");
+    ATF_REQUIRE(dir != NULL);
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = ::readdir(dir)) != NULL) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        create_file("cache/" + name, "this is not bytecode");
+        count++;
+    }
+    ::closedir(dir);
+    ATF_REQUIRE_EQ(1, count);
+
+    lutok::chunk_cache cache("cache");
+    lutok::state state;
+    stack_balance_checker checker(state);
+    cache.load_string(state, "return 4");
+    ATF_REQUIRE_EQ(4, call_chunk(state));
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(directory__other_key);
+ATF_TEST_CASE_BODY(directory__other_key)
+{
+    ATF_REQUIRE(::mkdir("cache", 0755) != -1);
+
+    {
+        lutok::chunk_cache cache("cache");
+        lutok::state state;
+        cache.load_string(state, "return 4");
+        cache.load_string(state, "return 5");
+        state.pop(2);
+    }
+
+    // Swap the contents of the two files to mimic chunks whose keys hash to
+    // the same file name.
+    DIR* dir = ::opendir("cache");
+    ATF_REQUIRE(dir != NULL);
+    std::vector< std::string > names;
+    struct dirent* entry;
+    while ((entry = ::readdir(dir)) != NULL) {
+        const std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            names.push_back("cache/" + name);
+    }
+    ::closedir(dir);
+    ATF_REQUIRE_EQ(2, names.size());
+    ATF_REQUIRE(std::rename(names[0].c_str(), "swap") != -1);
+    ATF_REQUIRE(std::rename(names[1].c_str(), names[0].c_str()) != -1);
+    ATF_REQUIRE(std::rename("swap", names[1].c_str()) != -1);
+
+    lutok::chunk_cache cache("cache");
+    lutok::state state;
+    stack_balance_checker checker(state);
+    cache.load_string(state, "return 4");
+    ATF_REQUIRE_EQ(4, call_chunk(state));
+    cache.load_string(state, "return 5");
+    ATF_REQUIRE_EQ(5, call_chunk(state));
+    ATF_REQUIRE_EQ(0, cache.hits());
+    ATF_REQUIRE_EQ(2, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(directory__shared);
+ATF_TEST_CASE_BODY(directory__shared)
+{
+    ATF_REQUIRE(::mkdir("cache", 0755) != -1);
+
+    lutok::chunk_cache cache1("cache");
+    lutok::chunk_cache cache2("cache");
+    lutok::state state;
+    stack_balance_checker checker(state);
+    cache1.load_string(state, "return 6");
+    ATF_REQUIRE_EQ(6, call_chunk(state));
+    cache2.load_string(state, "return 6");
+    ATF_REQUIRE_EQ(6, call_chunk(state));
+    ATF_REQUIRE_EQ(1, cache2.hits());
+
+    DIR* dir = ::opendir("cache");
+    ATF_REQUIRE(dir != NULL);
+    std::size_t count = 0;
+    struct dirent* entry;
+    while ((entry = ::readdir(dir)) != NULL) {
+        const std::string name = entry->d_name;
+        if (name != "." && name != "..")
+            count++;
+    }
+    ::closedir(dir);
+    ATF_REQUIRE_EQ(1, count);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(directory__missing);
+ATF_TEST_CASE_BODY(directory__missing)
+{
+    lutok::chunk_cache cache("missing");
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    cache.load_string(state, "return 5");
+    ATF_REQUIRE_EQ(5, call_chunk(state));
+    cache.load_string(state, "return 5");
+    ATF_REQUIRE_EQ(5, call_chunk(state));
+    ATF_REQUIRE_EQ(1, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, load_string__hit);
+    ATF_ADD_TEST_CASE(tcs, load_string__different);
+    ATF_ADD_TEST_CASE(tcs, load_string__many_states);
+    ATF_ADD_TEST_CASE(tcs, load_string__error);
+    ATF_ADD_TEST_CASE(tcs, load_file__hit);
+    ATF_ADD_TEST_CASE(tcs, load_file__modified);
+    ATF_ADD_TEST_CASE(tcs, load_file__debug_info);
+    ATF_ADD_TEST_CASE(tcs, load_file__not_found);
+    ATF_ADD_TEST_CASE(tcs, clear);
+    ATF_ADD_TEST_CASE(tcs, max_entries);
+    ATF_ADD_TEST_CASE(tcs, directory__persist);
+    ATF_ADD_TEST_CASE(tcs, directory__corrupt);
+    ATF_ADD_TEST_CASE(tcs, directory__other_key);
+    ATF_ADD_TEST_CASE(tcs, directory__shared);
+    ATF_ADD_TEST_CASE(tcs, directory__missing);
+}
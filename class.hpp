@@ -0,0 +1,535 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file class.hpp
+/// Provides the class_ template to expose C++ classes to Lua as userdata.
+
+#if !defined(LUTOK_CLASS_HPP)
+#define LUTOK_CLASS_HPP
+
+#include <new>
+#include <sstream>
+#include <string>
+
+#include <lua.hpp>
+#include <lutok/c_gate.hpp>
+#include <lutok/exceptions.hpp>
+#include <lutok/state.ipp>
+
+namespace lutok {
+
+
+/// Marks a C++ class as bound to Lua with class_.
+///
+/// Pointers to the classes for which this trait is true can be moved across
+/// the Lua stack with state::get() and state::is(), and can be used as
+/// arguments of callables bound through bind.hpp.  Pointers to any other type
+/// are rejected at compile time instead of being mistaken for bound objects.
+///
+/// To mark a class, specialize this template in the lutok namespace:
+///
+/// namespace lutok {
+/// template<>
+/// struct bound_class< my_class > {
+///     static const bool value = true;
+/// };
+/// }  // namespace lutok
+///
+/// \tparam Type The C++ class.
+template< typename Type >
+struct bound_class {
+    /// Whether the class is bound to Lua.
+    static const bool value = false;
+};
+
+
+namespace detail {
+
+
+template< typename Type, bool Bound >
+struct class_pointer_traits;
+
+
+}  // namespace detail
+
+
+/// Binding of a C++ class into Lua.
+///
+/// Objects of the bound class live within Lua userdata: they are constructed
+/// in place when pushed onto the stack and destroyed by the __gc metamethod
+/// when Lua collects them.  All objects of the class share a metatable that is
+/// created when the class is first registered in a state and that is cached in
+/// the registry under a light userdata key, so reaching it never involves
+/// string lookups.  The methods of the class are stored in the __index table
+/// of this metatable.
+///
+/// Type checks compare the metatable of a value against the cached metatable,
+/// which makes to() and is() constant-time operations that cannot be fooled by
+/// other userdata.
+///
+/// The class must be registered in a state, by constructing an object of this
+/// type, before any instance is pushed onto its stack.  Registering a class
+/// more than once in the same state reuses the existing metatable.
+///
+/// Lua only guarantees the alignment of double, long and void* for the memory
+/// of a userdata, so the class must not require a stricter alignment.
+///
+/// \tparam Type The C++ class to bind.
+template< typename Type >
+class class_ {
+    /// The Lua state in which the class is registered.
+    state& _state;
+
+    /// Object whose address identifies the metatable in the registry.
+    static const char _registry_key;
+
+    template< typename, bool > friend struct detail::class_pointer_traits;
+
+    static void* allocate(lua_State*);
+    static void* registry_key(void);
+    static int destroy(lua_State*);
+    static void push_metatable(lua_State*);
+    static Type* to_raw(lua_State*, const int);
+
+public:
+    class_(state&, const std::string&);
+
+    class_& metamethod(const std::string&, cxx_function);
+    class_& method(const std::string&, cxx_function);
+
+    static Type* check(state&, const int);
+    static bool is(state&, const int);
+    static Type* push(state&);
+    static Type* push(state&, const Type&);
+    static Type* to(state&, const int);
+};
+
+
+namespace detail {
+
+
+/// Conversions for pointers to objects of classes bound with class_.
+///
+/// There is no definition for classes not marked with bound_class, so that
+/// using them is a compile-time error.
+template< typename Type >
+struct class_pointer_traits< Type, true > {
+    /// Checks if a value is an object of the class.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is an object of the class.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return class_< Type >::to_raw(raw_state, index) != NULL;
+    }
+
+    /// Gets a pointer to an object of the class from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The pointer to the object held by Lua.
+    static Type*
+    get(lua_State* raw_state, const int index)
+    {
+        return class_< Type >::to_raw(raw_state, index);
+    }
+
+    /// Gets the name of the class, as given at registration time.
+    ///
+    /// \param raw_state The Lua C API state.
+    ///
+    /// \return The name of the class, which lives in its metatable, or a
+    /// generic name if the class is not registered.
+    static const char*
+    name(lua_State* raw_state)
+    {
+        const char* result = "userdata";
+        class_< Type >::push_metatable(raw_state);
+        if (lua_istable(raw_state, -1)) {
+            lua_getfield(raw_state, -1, "__name");
+            if (lua_type(raw_state, -1) == LUA_TSTRING)
+                result = lua_tostring(raw_state, -1);
+            lua_pop(raw_state, 1);
+        }
+        lua_pop(raw_state, 1);
+        return result;
+    }
+};
+
+
+}  // namespace detail
+
+
+/// Conversions for pointers to objects of classes bound with class_.
+///
+/// This allows the bound objects to be retrieved with state::get() and to be
+/// used as arguments of callables bound through bind.hpp.  Only applies to the
+/// classes marked with bound_class.
+template< typename Type >
+struct stack_traits< Type* > :
+    detail::class_pointer_traits< Type, bound_class< Type >::value > {
+};
+
+
+/// Conversions for constant pointers to objects of classes bound with class_.
+template< typename Type >
+struct stack_traits< const Type* > {
+    /// The conversions for the non-constant pointers.
+    typedef detail::class_pointer_traits< Type, bound_class< Type >::value >
+        pointer_traits;
+
+    /// Checks if a value is an object of the class.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is an object of the class.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return pointer_traits::is(raw_state, index);
+    }
+
+    /// Gets a pointer to an object of the class from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The pointer to the object held by Lua.
+    static const Type*
+    get(lua_State* raw_state, const int index)
+    {
+        return pointer_traits::get(raw_state, index);
+    }
+
+    /// Gets the name of the class, as given at registration time.
+    ///
+    /// \param raw_state The Lua C API state.
+    ///
+    /// \return The name of the class.
+    static const char*
+    name(lua_State* raw_state)
+    {
+        return pointer_traits::name(raw_state);
+    }
+};
+
+
+template< typename Type >
+const char class_< Type >::_registry_key = 0;
+
+
+/// Allocates the memory for a new object of the class.
+///
+/// \param raw_state The Lua C API state.
+///
+/// \return The memory for the object, which is yet to be constructed.
+///
+/// \post stack(-2) is the userdata that owns the memory and stack(-1) is the
+/// metatable of the class, which is yet to be set on the userdata.
+///
+/// \throw error If the class is not registered.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type >
+void*
+class_< Type >::allocate(lua_State* raw_state)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    static_assert(alignof(Type) <= alignof(detail::userdata_alignment),
+                  "Class requires more alignment than Lua guarantees");
+#endif
+    void* memory = lua_newuserdata(raw_state, sizeof(Type));
+    push_metatable(raw_state);
+    if (lua_isnil(raw_state, -1)) {
+        lua_pop(raw_state, 2);
+        throw error("Cannot push an object of an unregistered class");
+    }
+    return memory;
+}
+
+
+/// Gets the key of the metatable of the class in the registry.
+///
+/// \return A pointer to be used as a light userdata.
+template< typename Type >
+void*
+class_< Type >::registry_key(void)
+{
+    return const_cast< char* >(&_registry_key);
+}
+
+
+/// Lua glue to destroy an object of the class.
+///
+/// \param raw_state The Lua C API state.  stack(1) is the userdata.
+///
+/// \return The number of return values, i.e. 0.
+template< typename Type >
+int
+class_< Type >::destroy(lua_State* raw_state)
+{
+    static_cast< Type* >(lua_touserdata(raw_state, 1))->~Type();
+    return 0;
+}
+
+
+/// Pushes the metatable of the class onto the stack.
+///
+/// \param raw_state The Lua C API state.
+///
+/// \post stack(-1) is the metatable, or nil if the class is not registered.
+template< typename Type >
+void
+class_< Type >::push_metatable(lua_State* raw_state)
+{
+    lua_pushlightuserdata(raw_state, registry_key());
+    lua_rawget(raw_state, LUA_REGISTRYINDEX);
+}
+
+
+/// Gets an object of the class from the stack.
+///
+/// \param raw_state The Lua C API state.
+/// \param index The stack index of the value.
+///
+/// \return The pointer to the object held by Lua, or NULL if the value is not
+/// an object of the class.
+template< typename Type >
+Type*
+class_< Type >::to_raw(lua_State* raw_state, const int index)
+{
+    void* data = lua_touserdata(raw_state, index);
+    if (data == NULL || !lua_getmetatable(raw_state, index))
+        return NULL;
+    push_metatable(raw_state);
+    const bool matches = lua_rawequal(raw_state, -1, -2);
+    lua_pop(raw_state, 2);
+    return matches ? static_cast< Type* >(data) : NULL;
+}
+
+
+/// Registers the class in a state.
+///
+/// \param state_ The Lua state in which to register the class.
+/// \param name The name of the class, used in error messages and as the result
+///     of getmetatable() on its objects.
+template< typename Type >
+class_< Type >::class_(state& state_, const std::string& name) :
+    _state(state_)
+{
+    lua_State* raw_state = state_c_gate(_state).c_state();
+    push_metatable(raw_state);
+    if (lua_isnil(raw_state, -1)) {
+        lua_pop(raw_state, 1);
+        lua_newtable(raw_state);
+
+        lua_pushstring(raw_state, name.c_str());
+        lua_setfield(raw_state, -2, "__name");
+        lua_pushstring(raw_state, name.c_str());
+        lua_setfield(raw_state, -2, "__metatable");
+        lua_newtable(raw_state);
+        lua_setfield(raw_state, -2, "__index");
+        lua_pushcfunction(raw_state, destroy);
+        lua_setfield(raw_state, -2, "__gc");
+
+        lua_pushlightuserdata(raw_state, registry_key());
+        lua_pushvalue(raw_state, -2);
+        lua_rawset(raw_state, LUA_REGISTRYINDEX);
+    }
+    lua_pop(raw_state, 1);
+}
+
+
+/// Adds a metamethod to the class.
+///
+/// \param name The name of the metamethod, such as __tostring or __eq.
+/// \param function The C++ function that implements the metamethod.
+///
+/// \return A reference to this object, to chain calls.
+template< typename Type >
+class_< Type >&
+class_< Type >::metamethod(const std::string& name, cxx_function function)
+{
+    lua_State* raw_state = state_c_gate(_state).c_state();
+    push_metatable(raw_state);
+    _state.push_cxx_function(function);
+    lua_setfield(raw_state, -2, name.c_str());
+    lua_pop(raw_state, 1);
+    return *this;
+}
+
+
+/// Adds a method to the class.
+///
+/// Methods receive the object as their first argument when invoked with the
+/// colon syntax, and can retrieve it with check().
+///
+/// \param name The name of the method.
+/// \param function The C++ function that implements the method.
+///
+/// \return A reference to this object, to chain calls.
+template< typename Type >
+class_< Type >&
+class_< Type >::method(const std::string& name, cxx_function function)
+{
+    lua_State* raw_state = state_c_gate(_state).c_state();
+    push_metatable(raw_state);
+    lua_getfield(raw_state, -1, "__index");
+    _state.push_cxx_function(function);
+    lua_setfield(raw_state, -2, name.c_str());
+    lua_pop(raw_state, 2);
+    return *this;
+}
+
+
+/// Gets an object of the class from the stack, requiring it to be there.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the value.
+///
+/// \return The pointer to the object held by Lua.
+///
+/// \throw error If the value is not an object of the class.
+template< typename Type >
+Type*
+class_< Type >::check(state& s, const int index)
+{
+    Type* object = to(s, index);
+    if (object == NULL) {
+        lua_State* raw_state = state_c_gate(s).c_state();
+        std::string name = "object";
+        push_metatable(raw_state);
+        if (lua_istable(raw_state, -1)) {
+            lua_getfield(raw_state, -1, "__name");
+            if (lua_isstring(raw_state, -1))
+                name = lua_tostring(raw_state, -1);
+            lua_pop(raw_state, 1);
+        }
+        lua_pop(raw_state, 1);
+        std::ostringstream message;
+        message << "Value at index " << index << " is not a " << name;
+        throw error(message.str());
+    }
+    return object;
+}
+
+
+/// Checks if a value is an object of the class.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the value.
+///
+/// \return True if the value is an object of the class.
+template< typename Type >
+bool
+class_< Type >::is(state& s, const int index)
+{
+    return to_raw(state_c_gate(s).c_state(), index) != NULL;
+}
+
+
+/// Pushes a default-constructed object of the class onto the stack.
+///
+/// \param s The Lua state.  The class must be registered in it.
+///
+/// \return The pointer to the new object, which is owned by Lua.
+///
+/// \throw error If the class is not registered.
+/// \throw Any exception raised by the constructor of the class.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type >
+Type*
+class_< Type >::push(state& s)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    void* memory = allocate(raw_state);
+    Type* object;
+    try {
+        object = new (memory) Type();
+    } catch (...) {
+        lua_pop(raw_state, 2);
+        throw;
+    }
+    lua_setmetatable(raw_state, -2);
+    return object;
+}
+
+
+/// Pushes a copy of an object of the class onto the stack.
+///
+/// \param s The Lua state.  The class must be registered in it.
+/// \param value The object to copy.
+///
+/// \return The pointer to the new object, which is owned by Lua.
+///
+/// \throw error If the class is not registered.
+/// \throw Any exception raised by the copy constructor of the class.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type >
+Type*
+class_< Type >::push(state& s, const Type& value)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    void* memory = allocate(raw_state);
+    Type* object;
+    try {
+        object = new (memory) Type(value);
+    } catch (...) {
+        lua_pop(raw_state, 2);
+        throw;
+    }
+    lua_setmetatable(raw_state, -2);
+    return object;
+}
+
+
+/// Gets an object of the class from the stack.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the value.
+///
+/// \return The pointer to the object held by Lua, or NULL if the value is not
+/// an object of the class.
+template< typename Type >
+Type*
+class_< Type >::to(state& s, const int index)
+{
+    return to_raw(state_c_gate(s).c_state(), index);
+}
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_CLASS_HPP)
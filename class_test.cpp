@@ -0,0 +1,364 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "class.hpp"
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Number of live widgets, to validate construction and destruction.
+static int live_widgets = 0;
+
+
+/// Class to be bound into Lua.
+class widget {
+public:
+    /// The value held by the widget.
+    int value;
+
+    /// Constructs a default widget.
+    widget(void) : value(10)
+    {
+        ++live_widgets;
+    }
+
+    /// Constructs a widget with a given value.
+    ///
+    /// \param value_ The value of the widget.
+    explicit widget(const int value_) : value(value_)
+    {
+        ++live_widgets;
+    }
+
+    /// Copies a widget.
+    ///
+    /// \param other The widget to copy.
+    widget(const widget& other) : value(other.value)
+    {
+        ++live_widgets;
+    }
+
+    /// Destroys a widget.
+    ~widget(void)
+    {
+        --live_widgets;
+    }
+};
+
+
+/// Another class to be bound into Lua, to validate type checks.
+struct gadget {
+    /// Unused field.
+    int unused;
+};
+
+
+}  // anonymous namespace
+
+
+namespace lutok {
+
+
+/// Marks widgets as bound to Lua.
+template<>
+struct bound_class< widget > {
+    /// Whether the class is bound to Lua.
+    static const bool value = true;
+};
+
+
+/// Marks gadgets as bound to Lua.
+template<>
+struct bound_class< gadget > {
+    /// Whether the class is bound to Lua.
+    static const bool value = true;
+};
+
+
+}  // namespace lutok
+
+
+namespace {
+
+
+/// Lua method to get the value of a widget.
+///
+/// \param state The Lua state.
+///
+/// \return The number of results, i.e. 1.
+static int
+widget_get(lutok::state& state)
+{
+    const widget* object = lutok::class_< widget >::check(state, 1);
+    state.push_integer(object->value);
+    return 1;
+}
+
+
+/// Lua method to set the value of a widget.
+///
+/// \param state The Lua state.
+///
+/// \return The number of results, i.e. 0.
+static int
+widget_set(lutok::state& state)
+{
+    widget* object = lutok::class_< widget >::check(state, 1);
+    object->value = state.to_integer(2);
+    return 0;
+}
+
+
+/// Lua metamethod to convert a widget to a string.
+///
+/// \param state The Lua state.
+///
+/// \return The number of results, i.e. 1.
+static int
+widget_tostring(lutok::state& state)
+{
+    const widget* object = lutok::class_< widget >::check(state, 1);
+    state.push_string(object->value == 10 ? "widget 10" : "widget ?");
+    return 1;
+}
+
+
+/// Registers the widget class in a state.
+///
+/// \param state The Lua state.
+static void
+register_widget(lutok::state& state)
+{
+    lutok::class_< widget >(state, "widget")
+        .method("get", widget_get)
+        .method("set", widget_set)
+        .metamethod("__tostring", widget_tostring);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push__default);
+ATF_TEST_CASE_BODY(push__default)
+{
+    lutok::state state;
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    widget* object = lutok::class_< widget >::push(state);
+    ATF_REQUIRE_EQ(10, object->value);
+    ATF_REQUIRE(state.is_userdata(-1));
+    ATF_REQUIRE(object == lutok::class_< widget >::to(state, -1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push__copy);
+ATF_TEST_CASE_BODY(push__copy)
+{
+    lutok::state state;
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    const widget original(42);
+    widget* object = lutok::class_< widget >::push(state, original);
+    ATF_REQUIRE(object != &original);
+    ATF_REQUIRE_EQ(42, object->value);
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push__unregistered);
+ATF_TEST_CASE_BODY(push__unregistered)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const int before = live_widgets;
+    ATF_REQUIRE_THROW_RE(lutok::error, "unregistered class",
+                         lutok::class_< widget >::push(state));
+    ATF_REQUIRE_EQ(before, live_widgets);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(register__twice);
+ATF_TEST_CASE_BODY(register__twice)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    register_widget(state);
+    lutok::class_< widget > again(state, "other name");
+    lutok::class_< widget >::push(state, widget(5));
+    state.set_global("object");
+
+    lutok::do_string(state, "return getmetatable(object), object:get()",
+                     0, 2, 0);
+    ATF_REQUIRE_EQ("widget", state.to_string(-2));
+    ATF_REQUIRE_EQ(5, state.to_integer(-1));
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(methods);
+ATF_TEST_CASE_BODY(methods)
+{
+    lutok::state state;
+    state.open_base();
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    lutok::class_< widget >::push(state);
+    state.set_global("object");
+    lutok::do_string(state, "local before = tostring(object); object:set(3); "
+                     "return before, object:get(), tostring(object)", 0, 3, 0);
+    ATF_REQUIRE_EQ("widget 10", state.to_string(-3));
+    ATF_REQUIRE_EQ(3, state.to_integer(-2));
+    ATF_REQUIRE_EQ("widget ?", state.to_string(-1));
+    state.pop(3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(methods__wrong_self);
+ATF_TEST_CASE_BODY(methods__wrong_self)
+{
+    lutok::state state;
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    lutok::class_< widget >::push(state);
+    state.set_global("object");
+    ATF_REQUIRE_THROW_RE(lutok::error, "index 1 is not a widget",
+                         lutok::do_string(state, "object.get({})", 0, 0, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to__type_checks);
+ATF_TEST_CASE_BODY(to__type_checks)
+{
+    lutok::state state;
+    register_widget(state);
+    lutok::class_< gadget >(state, "gadget");
+    stack_balance_checker checker(state);
+
+    state.push_integer(5);
+    state.new_userdata< widget >();
+    lutok::class_< gadget >::push(state);
+    lutok::class_< widget >::push(state);
+
+    ATF_REQUIRE(lutok::class_< widget >::to(state, -1) != NULL);
+    ATF_REQUIRE(lutok::class_< widget >::to(state, -2) == NULL);
+    ATF_REQUIRE(lutok::class_< widget >::to(state, -3) == NULL);
+    ATF_REQUIRE(lutok::class_< widget >::to(state, -4) == NULL);
+
+    ATF_REQUIRE(lutok::class_< widget >::is(state, -1));
+    ATF_REQUIRE(!lutok::class_< widget >::is(state, -2));
+    ATF_REQUIRE(lutok::class_< gadget >::is(state, -2));
+    ATF_REQUIRE(!lutok::class_< gadget >::is(state, -1));
+    state.pop(4);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(check__fail);
+ATF_TEST_CASE_BODY(check__fail)
+{
+    lutok::state state;
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    state.push_integer(5);
+    ATF_REQUIRE_THROW_RE(lutok::error, "index -1 is not a widget",
+                         lutok::class_< widget >::check(state, -1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(stack_traits);
+ATF_TEST_CASE_BODY(stack_traits)
+{
+    lutok::state state;
+    register_widget(state);
+    stack_balance_checker checker(state);
+
+    widget* object = lutok::class_< widget >::push(state, widget(7));
+    ATF_REQUIRE(state.is< widget* >(-1));
+    ATF_REQUIRE(state.is< const widget* >(-1));
+    ATF_REQUIRE(!state.is< gadget* >(-1));
+    ATF_REQUIRE(object == state.get< widget* >(-1));
+    ATF_REQUIRE_EQ(7, state.get< const widget* >(-1)->value);
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc__destroys);
+ATF_TEST_CASE_BODY(gc__destroys)
+{
+    const int before = live_widgets;
+    {
+        lutok::state state;
+        state.open_base();
+        register_widget(state);
+
+        lutok::class_< widget >::push(state);
+        state.set_global("object");
+        ATF_REQUIRE_EQ(before + 1, live_widgets);
+
+        lutok::do_string(state, "object = nil; collectgarbage()", 0, 0, 0);
+        ATF_REQUIRE_EQ(before, live_widgets);
+
+        lutok::class_< widget >::push(state);
+        ATF_REQUIRE_EQ(before + 1, live_widgets);
+    }
+    ATF_REQUIRE_EQ(before, live_widgets);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, push__default);
+    ATF_ADD_TEST_CASE(tcs, push__copy);
+    ATF_ADD_TEST_CASE(tcs, push__unregistered);
+    ATF_ADD_TEST_CASE(tcs, register__twice);
+    ATF_ADD_TEST_CASE(tcs, methods);
+    ATF_ADD_TEST_CASE(tcs, methods__wrong_self);
+    ATF_ADD_TEST_CASE(tcs, to__type_checks);
+    ATF_ADD_TEST_CASE(tcs, check__fail);
+    ATF_ADD_TEST_CASE(tcs, stack_traits);
+    ATF_ADD_TEST_CASE(tcs, gc__destroys);
+}
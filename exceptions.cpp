@@ -30,6 +30,7 @@
 
 #include <lua.hpp>
 
+#include "budget.hpp"
 #include "c_gate.hpp"
 #include "exceptions.hpp"
 #include "state.ipp"
@@ -77,6 +78,9 @@ lutok::api_error::~api_error(void) throw()
 /// \param api_function_ The name of the Lua API function that caused the error.
 ///
 /// \return A new api_error with the popped message.
+///
+/// \throw budget_exceeded_error If the error was caused by the budget attached
+///     to the state.
 lutok::api_error
 lutok::api_error::from_stack(state& state_, const std::string& api_function_)
 {
@@ -85,6 +89,10 @@ lutok::api_error::from_stack(state& state_, const std::string& api_function_)
     assert(lua_isstring(raw_state, -1));
     const std::string message = lua_tostring(raw_state, -1);
     lua_pop(raw_state, 1);
+
+    const char* resource = budget::exceeded_resource(state_, message.c_str());
+    if (resource != NULL)
+        throw lutok::budget_exceeded_error(api_function_, message, resource);
     return lutok::api_error(api_function_, message);
 }
 
@@ -99,6 +107,36 @@ lutok::api_error::api_function(void) const
 }
  
 
+/// Constructs a new error.
+///
+/// \param api_function_ The name of the API function that caused the error.
+/// \param message The plain-text error message provided by Lua.
+/// \param resource_ The name of the exceeded resource.
+lutok::budget_exceeded_error::budget_exceeded_error(
+    const std::string& api_function_, const std::string& message,
+    const std::string& resource_) :
+    api_error(api_function_, message),
+    _resource(resource_)
+{
+}
+
+
+/// Destructor for the error.
+lutok::budget_exceeded_error::~budget_exceeded_error(void) throw()
+{
+}
+
+
+/// Gets the name of the exceeded resource.
+///
+/// \return One of instructions, memory or time.
+const std::string&
+lutok::budget_exceeded_error::resource(void) const
+{
+    return _resource;
+}
+
+
 /// Constructs a new error.
 ///
 /// \param filename_ The file that count not be found.
@@ -64,6 +64,23 @@ public:
 };
 
 
+/// Exception for the termination of code that exhausted its budget.
+///
+/// This is raised instead of a plain api_error when the error reported by Lua
+/// was caused by a limit of the budget attached to the state.
+class budget_exceeded_error : public api_error {
+    /// Name of the exceeded resource: instructions, memory or time.
+    std::string _resource;
+
+public:
+    explicit budget_exceeded_error(const std::string&, const std::string&,
+                                   const std::string&);
+    virtual ~budget_exceeded_error(void) throw();
+
+    const std::string& resource(void) const;
+};
+
+
 /// File not found error.
 class file_not_found_error : public error {
     /// Name of the not-found file.
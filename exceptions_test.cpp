@@ -68,6 +68,16 @@ ATF_TEST_CASE_BODY(api_error__from_stack)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(budget_exceeded_error);
+ATF_TEST_CASE_BODY(budget_exceeded_error)
+{
+    const lutok::budget_exceeded_error e("some_function", "Some text", "time");
+    ATF_REQUIRE(std::strcmp("Some text", e.what()) == 0);
+    ATF_REQUIRE_EQ("some_function", e.api_function());
+    ATF_REQUIRE_EQ("time", e.resource());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(file_not_found_error);
 ATF_TEST_CASE_BODY(file_not_found_error)
 {
@@ -83,6 +93,7 @@ ATF_INIT_TEST_CASES(tcs)
 
     ATF_ADD_TEST_CASE(tcs, api_error__explicit);
     ATF_ADD_TEST_CASE(tcs, api_error__from_stack);
+    ATF_ADD_TEST_CASE(tcs, budget_exceeded_error);
 
     ATF_ADD_TEST_CASE(tcs, file_not_found_error);
 }
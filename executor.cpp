@@ -0,0 +1,802 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "executor.hpp"
+
+extern "C" {
+#include <pthread.h>
+}
+
+#include <cassert>
+#include <deque>
+#include <map>
+#include <stdexcept>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+#include "exceptions.hpp"
+#include "internal.hpp"
+#include "ref.hpp"
+#include "serialize.hpp"
+#include "state.hpp"
+#include "state_template.hpp"
+
+
+namespace {
+
+
+/// Maximum number of compiled chunks that every worker keeps around.
+///
+/// Once this is reached, the cache of the worker is flushed to prevent jobs
+/// with ever-changing chunks from growing it forever.
+static const std::size_t max_cached_chunks = 64;
+
+
+/// Key of the thread-specific pointer to the worker running in a thread.
+static pthread_key_t current_worker_key;
+
+
+/// Guard to create current_worker_key only once.
+static pthread_once_t current_worker_once = PTHREAD_ONCE_INIT;
+
+
+/// Creates current_worker_key.
+static void
+create_current_worker_key(void)
+{
+    ::pthread_key_create(&current_worker_key, NULL);
+}
+
+
+using lutok::detail::mutex_locker;
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::job_future.
+struct lutok::job_future::impl {
+    /// Lock protecting all the fields of this structure.
+    pthread_mutex_t mutex;
+
+    /// Condition signaled when the job completes.
+    pthread_cond_t completed;
+
+    /// Whether the job has completed.
+    bool done;
+
+    /// Whether the job failed.
+    bool failed;
+
+    /// The serialized result of the job, or its error message if it failed.
+    std::string value;
+
+    /// Constructor.
+    impl(void) :
+        done(false),
+        failed(false)
+    {
+        ::pthread_mutex_init(&mutex, NULL);
+        ::pthread_cond_init(&completed, NULL);
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        ::pthread_cond_destroy(&completed);
+        ::pthread_mutex_destroy(&mutex);
+    }
+
+    /// Records the outcome of the job and wakes up the waiting threads.
+    ///
+    /// \param failed_ Whether the job failed.
+    /// \param value_ The serialized result or the error message.  Its
+    ///     contents are moved into the future.
+    void
+    complete(const bool failed_, std::string& value_)
+    {
+        mutex_locker locker(mutex);
+        failed = failed_;
+        value.swap(value_);
+        done = true;
+        ::pthread_cond_broadcast(&completed);
+    }
+
+    /// Waits for the job to complete.
+    ///
+    /// \post The mutex is not held.
+    void
+    wait(void)
+    {
+        mutex_locker locker(mutex);
+        while (!done)
+            ::pthread_cond_wait(&completed, &mutex);
+    }
+};
+
+
+/// Creates a future from its internal implementation.
+///
+/// \param pimpl The internal implementation, whose ownership is transferred.
+lutok::job_future::job_future(impl* pimpl) :
+    _pimpl(pimpl)
+{
+}
+
+
+/// Destructor.
+lutok::job_future::~job_future(void)
+{
+}
+
+
+/// Checks if the job failed, waiting for it to complete.
+///
+/// \return True if the job raised an error.
+bool
+lutok::job_future::failed(void) const
+{
+    _pimpl->wait();
+    return _pimpl->failed;
+}
+
+
+/// Gets the result of the job, waiting for it to complete.
+///
+/// \return The first value returned by the job in the binary form produced by
+/// serialize(); pass it to deserialize() to push it onto a stack.
+///
+/// \throw error If the job failed, with the error message of the job.
+std::string
+lutok::job_future::get(void) const
+{
+    _pimpl->wait();
+    if (_pimpl->failed)
+        throw lutok::error(_pimpl->value);
+    return _pimpl->value;
+}
+
+
+/// Checks if the job has completed without waiting for it.
+///
+/// \return True if the result of the job is available.
+bool
+lutok::job_future::ready(void) const
+{
+    mutex_locker locker(_pimpl->mutex);
+    return _pimpl->done;
+}
+
+
+/// Waits for the job to complete.
+void
+lutok::job_future::wait(void) const
+{
+    _pimpl->wait();
+}
+
+
+/// Internal implementation for lutok::executor.
+struct lutok::executor::impl {
+    /// A job waiting to be run.
+    struct job {
+        /// The chunk to run, shared by all the jobs of a map().
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        std::shared_ptr< const std::string > chunk;
+#else
+        std::tr1::shared_ptr< const std::string > chunk;
+#endif
+
+        /// The serialized arguments to pass to the chunk.
+        std::vector< std::string > arguments;
+
+        /// The future to deliver the outcome of the job to.
+        job_future future;
+
+        /// Function to call on completion, or NULL.
+        callback_function callback;
+
+        /// Opaque data to pass to the callback.
+        void* cookie;
+
+        /// Constructor.
+        ///
+        /// \param chunk_ The chunk to run.
+        /// \param arguments_ The serialized arguments to pass to the chunk.
+        /// \param callback_ Function to call on completion, or NULL.
+        /// \param cookie_ Opaque data to pass to the callback.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        job(const std::shared_ptr< const std::string >& chunk_,
+#else
+        job(const std::tr1::shared_ptr< const std::string >& chunk_,
+#endif
+            const std::vector< std::string >& arguments_,
+            callback_function callback_, void* cookie_) :
+            chunk(chunk_),
+            arguments(arguments_),
+            future(new job_future::impl()),
+            callback(callback_),
+            cookie(cookie_)
+        {
+        }
+    };
+
+    /// A worker thread and its state.
+    struct worker {
+        /// The executor that owns the worker.
+        impl* owner;
+
+        /// Position of the worker in the executor.
+        std::size_t index;
+
+        /// The Lua state in which the worker runs its jobs.
+        state* lua_state;
+
+        /// Compiled chunks, keyed by their code.
+        std::map< std::string, ref > chunks;
+
+        /// Lock protecting the queue of jobs.
+        pthread_mutex_t mutex;
+
+        /// Jobs waiting to be run.  Owned by the worker.
+        std::deque< job* > jobs;
+
+        /// The thread running the worker.
+        pthread_t thread;
+
+        /// Whether the thread has been started.
+        bool started;
+
+        /// Constructor.
+        ///
+        /// \param owner_ The executor that owns the worker.
+        /// \param index_ Position of the worker in the executor.
+        /// \param lua_state_ The state of the worker, whose ownership is
+        ///     transferred.
+        worker(impl* owner_, const std::size_t index_, state* lua_state_) :
+            owner(owner_),
+            index(index_),
+            lua_state(lua_state_),
+            started(false)
+        {
+            ::pthread_mutex_init(&mutex, NULL);
+        }
+
+        /// Destructor.
+        ///
+        /// The thread must have finished by now.
+        ~worker(void)
+        {
+            for (std::deque< job* >::iterator iter = jobs.begin();
+                 iter != jobs.end(); ++iter)
+                delete *iter;
+            chunks.clear();
+            delete lua_state;
+            ::pthread_mutex_destroy(&mutex);
+        }
+    };
+
+    /// The workers of the executor.
+    std::vector< worker* > workers;
+
+    /// Lock for the workers that have run out of jobs.
+    pthread_mutex_t sleep_mutex;
+
+    /// Condition signaled when a job is submitted while workers sleep.
+    pthread_cond_t wakeup;
+
+    /// Whether the executor is being destroyed.
+    ///
+    /// Protected by sleep_mutex.
+    bool stopping;
+
+    /// Number of workers waiting for jobs.
+    ///
+    /// Only modified while holding sleep_mutex.  Where atomic operations are
+    /// available, this is read without holding the lock so that submitting a
+    /// job does not need to take the global lock when all workers are busy.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::atomic< std::size_t > sleepers;
+#else
+    std::size_t sleepers;
+#endif
+
+    /// Counter to spread the jobs submitted from outside the executor.
+    ///
+    /// Protected by sleep_mutex where atomic operations are not available.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::atomic< std::size_t > next_worker;
+#else
+    std::size_t next_worker;
+#endif
+
+    /// Number of jobs taken from the queue of another worker.
+    ///
+    /// Protected by sleep_mutex where atomic operations are not available.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::atomic< std::size_t > steals;
+#else
+    std::size_t steals;
+#endif
+
+    /// Constructor.
+    impl(void) :
+        stopping(false),
+        sleepers(0),
+        next_worker(0),
+        steals(0)
+    {
+        ::pthread_mutex_init(&sleep_mutex, NULL);
+        ::pthread_cond_init(&wakeup, NULL);
+        ::pthread_once(&current_worker_once, create_current_worker_key);
+    }
+
+    /// Destructor.
+    ///
+    /// Waits for the workers to run all the pending jobs and to exit.
+    ~impl(void)
+    {
+        {
+            mutex_locker locker(sleep_mutex);
+            stopping = true;
+            ::pthread_cond_broadcast(&wakeup);
+        }
+        for (std::vector< worker* >::iterator iter = workers.begin();
+             iter != workers.end(); ++iter) {
+            if ((*iter)->started)
+                ::pthread_join((*iter)->thread, NULL);
+            delete *iter;
+        }
+        ::pthread_cond_destroy(&wakeup);
+        ::pthread_mutex_destroy(&sleep_mutex);
+    }
+
+    /// Creates the workers and starts their threads.
+    ///
+    /// \param size The number of workers.
+    /// \param recipe The template to instantiate in the state of every worker.
+    /// \param setup The function to initialize the states with after
+    ///     instantiating the template, or NULL.
+    ///
+    /// \throw Any exception thrown while initializing the states.
+    /// \throw std::runtime_error If a thread cannot be created.
+    void
+    populate(const std::size_t size, const state_template& recipe,
+             setup_function setup)
+    {
+        workers.reserve(size);
+        for (std::size_t i = 0; i < size; i++) {
+            state* lua_state = new state();
+            try {
+                recipe.instantiate(*lua_state);
+                if (setup != NULL)
+                    setup(*lua_state);
+            } catch (...) {
+                lua_state->pop(lua_state->get_top());
+                delete lua_state;
+                throw;
+            }
+            assert(lua_state->get_top() == 0);
+            workers.push_back(new worker(this, i, lua_state));
+        }
+
+        for (std::vector< worker* >::iterator iter = workers.begin();
+             iter != workers.end(); ++iter) {
+            if (::pthread_create(&(*iter)->thread, NULL, worker_main,
+                                 *iter) != 0)
+                throw std::runtime_error("Cannot create executor thread");
+            (*iter)->started = true;
+        }
+    }
+
+    /// Queues a job.
+    ///
+    /// \param chunk The chunk to run.
+    /// \param arguments The serialized arguments to pass to the chunk.
+    /// \param callback Function to call on completion, or NULL.
+    /// \param cookie Opaque data to pass to the callback.
+    ///
+    /// \return The future of the job.
+    job_future
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    enqueue(const std::shared_ptr< const std::string >& chunk,
+#else
+    enqueue(const std::tr1::shared_ptr< const std::string >& chunk,
+#endif
+            const std::vector< std::string >& arguments,
+            callback_function callback, void* cookie)
+    {
+        job* next = new job(chunk, arguments, callback, cookie);
+        const job_future future = next->future;
+
+        worker* target = static_cast< worker* >(
+            ::pthread_getspecific(current_worker_key));
+        if (target == NULL || target->owner != this)
+            target = workers[next_target() % workers.size()];
+        try {
+            mutex_locker locker(target->mutex);
+            target->jobs.push_back(next);
+        } catch (...) {
+            delete next;
+            throw;
+        }
+
+        if (has_sleepers()) {
+            mutex_locker locker(sleep_mutex);
+            ::pthread_cond_signal(&wakeup);
+        }
+        return future;
+    }
+
+    /// Checks if there are workers waiting for jobs.
+    ///
+    /// \return True if there are sleeping workers.
+    bool
+    has_sleepers(void)
+    {
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        return sleepers.load() > 0;
+#else
+        mutex_locker locker(sleep_mutex);
+        return sleepers > 0;
+#endif
+    }
+
+    /// Checks if all the queues are empty.
+    ///
+    /// \return True if there are no jobs waiting to be run.
+    bool
+    idle(void)
+    {
+        for (std::vector< worker* >::iterator iter = workers.begin();
+             iter != workers.end(); ++iter) {
+            mutex_locker locker((*iter)->mutex);
+            if (!(*iter)->jobs.empty())
+                return false;
+        }
+        return true;
+    }
+
+    /// Picks the worker to queue a job submitted from outside the executor.
+    ///
+    /// \return A number to be reduced modulo the number of workers.
+    std::size_t
+    next_target(void)
+    {
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        return next_worker++;
+#else
+        mutex_locker locker(sleep_mutex);
+        return next_worker++;
+#endif
+    }
+
+    /// Pushes a chunk onto the stack of a worker, compiling it if necessary.
+    ///
+    /// \param self The worker.
+    /// \param chunk The code of the chunk.
+    ///
+    /// \throw api_error If the chunk cannot be compiled.
+    static void
+    push_chunk(worker& self, const std::string& chunk)
+    {
+        state& s = *self.lua_state;
+        const std::map< std::string, ref >::const_iterator iter =
+            self.chunks.find(chunk);
+        if (iter != self.chunks.end()) {
+            (*iter).second.push(s);
+            return;
+        }
+
+        s.load_buffer(chunk.data(), chunk.length(), "=job");
+        if (self.chunks.size() >= max_cached_chunks)
+            self.chunks.clear();
+        self.chunks.insert(std::make_pair(chunk, ref(s, -1)));
+    }
+
+    /// Runs a job in a worker and delivers its outcome.
+    ///
+    /// \param self The worker.
+    /// \param next The job to run.
+    static void
+    run_job(worker& self, job& next)
+    {
+        state& s = *self.lua_state;
+        bool failed = false;
+        std::string value;
+        try {
+            push_chunk(self, *next.chunk);
+            for (std::vector< std::string >::const_iterator iter =
+                     next.arguments.begin(); iter != next.arguments.end();
+                 ++iter)
+                deserialize(s, *iter);
+            const status outcome = s.try_pcall(
+                static_cast< int >(next.arguments.size()), 1, 0);
+            if (outcome.ok()) {
+                value = serialize(s, -1);
+            } else {
+                failed = true;
+                value = outcome.message(s);
+            }
+        } catch (const std::exception& e) {
+            failed = true;
+            value = e.what();
+        }
+        s.pop(s.get_top());
+
+        next.future._pimpl->complete(failed, value);
+        if (next.callback != NULL)
+            next.callback(next.future, next.cookie);
+    }
+
+    /// Takes the next job for a worker.
+    ///
+    /// \param self The worker.
+    ///
+    /// \return The job from the back of the queue of the worker or, if it is
+    /// empty, from the front of the queue of another worker; NULL if there
+    /// are no jobs.
+    job*
+    take(worker& self)
+    {
+        {
+            mutex_locker locker(self.mutex);
+            if (!self.jobs.empty()) {
+                job* next = self.jobs.back();
+                self.jobs.pop_back();
+                return next;
+            }
+        }
+
+        for (std::size_t i = 1; i < workers.size(); i++) {
+            worker* victim = workers[(self.index + i) % workers.size()];
+            job* next = NULL;
+            {
+                mutex_locker locker(victim->mutex);
+                if (!victim->jobs.empty()) {
+                    next = victim->jobs.front();
+                    victim->jobs.pop_front();
+                }
+            }
+            if (next != NULL) {
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+                steals++;
+#else
+                mutex_locker locker(sleep_mutex);
+                steals++;
+#endif
+                return next;
+            }
+        }
+        return NULL;
+    }
+
+    /// Main loop of a worker.
+    ///
+    /// \param self The worker.
+    void
+    run(worker& self)
+    {
+        for (;;) {
+            job* next = take(self);
+            if (next != NULL) {
+                run_job(self, *next);
+                delete next;
+                continue;
+            }
+
+            mutex_locker locker(sleep_mutex);
+            sleepers++;
+            while (!stopping && idle())
+                ::pthread_cond_wait(&wakeup, &sleep_mutex);
+            sleepers--;
+            if (stopping && idle())
+                return;
+        }
+    }
+
+    /// Entry point of the worker threads.
+    ///
+    /// \param arg The worker to run.
+    ///
+    /// \return NULL.
+    static void*
+    worker_main(void* arg)
+    {
+        worker* self = static_cast< worker* >(arg);
+        ::pthread_setspecific(current_worker_key, self);
+        self->owner->run(*self);
+        return NULL;
+    }
+};
+
+
+/// Constructs a new executor and starts its workers.
+///
+/// \param size The number of workers.  Must be positive.
+/// \param setup The function used to initialize the state of every worker, or
+///     NULL to leave them as created by the state constructor.
+///
+/// \throw Any exception thrown by the setup function.
+lutok::executor::executor(const std::size_t size, setup_function setup) :
+    _pimpl(new impl())
+{
+    assert(size > 0);
+    _pimpl->populate(size, state_template(), setup);
+}
+
+
+/// Constructs a new executor and starts its workers.
+///
+/// \param size The number of workers.  Must be positive.
+/// \param recipe The template to instantiate in the state of every worker.
+///
+/// \throw error If the template cannot be instantiated.
+lutok::executor::executor(const std::size_t size,
+                          const state_template& recipe) :
+    _pimpl(new impl())
+{
+    assert(size > 0);
+    _pimpl->populate(size, recipe, NULL);
+}
+
+
+/// Destructor.
+///
+/// Waits for all the submitted jobs to complete.
+lutok::executor::~executor(void)
+{
+}
+
+
+/// Runs a chunk over every element of a data partition in parallel.
+///
+/// This must not be called from a job, as it blocks the worker until the jobs
+/// it submits complete.
+///
+/// \param chunk The chunk to run.
+/// \param partitions The serialized values to pass, one per job, to the chunk.
+///
+/// \return The serialized results of the jobs, in the order of the partitions.
+///
+/// \throw error If any of the jobs fails.  The other jobs run to completion.
+std::vector< std::string >
+lutok::executor::map(const std::string& chunk,
+                     const std::vector< std::string >& partitions)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    const std::shared_ptr< const std::string > shared_chunk(
+        new std::string(chunk));
+#else
+    const std::tr1::shared_ptr< const std::string > shared_chunk(
+        new std::string(chunk));
+#endif
+
+    std::vector< job_future > futures;
+    futures.reserve(partitions.size());
+    for (std::vector< std::string >::const_iterator iter = partitions.begin();
+         iter != partitions.end(); ++iter)
+        futures.push_back(_pimpl->enqueue(
+            shared_chunk, std::vector< std::string >(1, *iter), NULL, NULL));
+
+    std::vector< std::string > results;
+    results.reserve(futures.size());
+    for (std::vector< job_future >::const_iterator iter = futures.begin();
+         iter != futures.end(); ++iter)
+        results.push_back((*iter).get());
+    return results;
+}
+
+
+/// Runs a chunk over a data partition and combines the results with another.
+///
+/// The reduce chunk runs as a single job that receives the results of the map
+/// chunk, in the order of the partitions, as its arguments.  This must not be
+/// called from a job.
+///
+/// \param map_chunk The chunk to run over every element of the partition.
+/// \param reduce_chunk The chunk to combine the results with.
+/// \param partitions The serialized values to pass, one per job, to the map
+///     chunk.
+///
+/// \return The serialized result of the reduce chunk.
+///
+/// \throw error If any of the jobs fails.
+std::string
+lutok::executor::map_reduce(const std::string& map_chunk,
+                            const std::string& reduce_chunk,
+                            const std::vector< std::string >& partitions)
+{
+    return submit(reduce_chunk, map(map_chunk, partitions)).get();
+}
+
+
+/// Queues a job.
+///
+/// \param chunk The chunk to run, as source code or in binary form.
+/// \param arguments The serialized values to pass to the chunk.
+///
+/// \return The future to wait for the result of the job.
+lutok::job_future
+lutok::executor::submit(const std::string& chunk,
+                        const std::vector< std::string >& arguments)
+{
+    return submit(chunk, arguments, NULL, NULL);
+}
+
+
+/// Queues a job and arranges for a function to be called on completion.
+///
+/// \param chunk The chunk to run, as source code or in binary form.
+/// \param arguments The serialized values to pass to the chunk.
+/// \param callback Function to call from the worker once the job completes,
+///     or NULL.
+/// \param cookie Opaque data to pass to the callback.
+///
+/// \return The future to wait for the result of the job.
+lutok::job_future
+lutok::executor::submit(const std::string& chunk,
+                        const std::vector< std::string >& arguments,
+                        callback_function callback, void* cookie)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    const std::shared_ptr< const std::string > shared_chunk(
+        new std::string(chunk));
+#else
+    const std::tr1::shared_ptr< const std::string > shared_chunk(
+        new std::string(chunk));
+#endif
+    return _pimpl->enqueue(shared_chunk, arguments, callback, cookie);
+}
+
+
+/// Gets the number of jobs that workers took from the queues of others.
+///
+/// \return A counter.
+std::size_t
+lutok::executor::steals(void) const
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    return _pimpl->steals.load();
+#else
+    mutex_locker locker(_pimpl->sleep_mutex);
+    return _pimpl->steals;
+#endif
+}
+
+
+/// Gets the number of workers.
+///
+/// \return The number of threads, and states, of the executor.
+std::size_t
+lutok::executor::workers(void) const
+{
+    return _pimpl->workers.size();
+}
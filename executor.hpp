@@ -0,0 +1,143 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file executor.hpp
+/// Provides a pool of worker threads that run Lua jobs in parallel.
+
+#if !defined(LUTOK_EXECUTOR_HPP)
+#define LUTOK_EXECUTOR_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class executor;
+class state;
+class state_template;
+
+
+/// Handle to the result of a job submitted to an executor.
+///
+/// Results and arguments travel between threads in the binary form produced by
+/// serialize(), so they can be restored into any state with deserialize().
+/// Copies of a future refer to the same job.
+class job_future {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    friend class executor;
+    job_future(impl*);
+
+public:
+    ~job_future(void);
+
+    bool failed(void) const;
+    std::string get(void) const;
+    bool ready(void) const;
+    void wait(void) const;
+};
+
+
+/// Pool of threads, each owning a Lua state, that run jobs in parallel.
+///
+/// A job is a chunk, either as source code or in the binary form returned by
+/// state::dump(), and a list of serialized arguments.  A worker loads the
+/// chunk into its state, caching the compiled function for later jobs, calls
+/// it with the deserialized arguments and serializes its first result.
+///
+/// Every worker has a double-ended queue of jobs.  Jobs submitted from outside
+/// the executor are spread over the queues in turn, while jobs submitted by
+/// code running in a worker go into the queue of that worker.  Workers take
+/// jobs from the back of their own queue and, once it is empty, steal from the
+/// front of the queues of the others, which balances the load without a
+/// central queue.
+///
+/// Destroying the executor waits for all the submitted jobs to complete.
+class executor {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    /// Disallow copies.
+    executor(const executor&);
+
+    /// Disallow assignment.
+    executor& operator=(const executor&);
+
+public:
+    /// Function to initialize the state of every worker.
+    ///
+    /// The function runs while the executor is constructed and must leave the
+    /// stack empty.  The function may throw exceptions to indicate an error.
+    typedef void (*setup_function)(state&);
+
+    /// Function to call when a job completes.
+    ///
+    /// The function runs in the worker thread that completed the job and must
+    /// not throw exceptions.  The future is ready at this point.
+    typedef void (*callback_function)(const job_future&, void*);
+
+    executor(const std::size_t, setup_function);
+    executor(const std::size_t, const state_template&);
+    ~executor(void);
+
+    std::vector< std::string > map(const std::string&,
+                                   const std::vector< std::string >&);
+    std::string map_reduce(const std::string&, const std::string&,
+                           const std::vector< std::string >&);
+    job_future submit(const std::string&, const std::vector< std::string >&);
+    job_future submit(const std::string&, const std::vector< std::string >&,
+                      callback_function, void*);
+    std::size_t steals(void) const;
+    std::size_t workers(void) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_EXECUTOR_HPP)
@@ -0,0 +1,305 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "executor.hpp"
+
+extern "C" {
+#include <pthread.h>
+}
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "serialize.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Computes the binary form of an integer.
+///
+/// \param value The integer to serialize.
+///
+/// \return The serialized integer.
+static std::string
+serialize_integer(const long value)
+{
+    lutok::state state;
+    state.push_integer64(value);
+    const std::string data = lutok::serialize(state, -1);
+    state.pop(1);
+    return data;
+}
+
+
+/// Restores an integer from its binary form.
+///
+/// \param data The serialized integer.
+///
+/// \return The integer.
+static long
+deserialize_integer(const std::string& data)
+{
+    lutok::state state;
+    lutok::deserialize(state, data);
+    const long value = state.to_integer(-1);
+    state.pop(1);
+    return value;
+}
+
+
+/// Initializes a state by defining a global function in it.
+///
+/// \param state The state to initialize.
+static void
+setup_double(lutok::state& state)
+{
+    lutok::do_string(state, "function double(x) return x * 2 end", 0, 0, 0);
+}
+
+
+/// Initializes a state by loading the base library into it.
+///
+/// \param state The state to initialize.
+static void
+setup_base(lutok::state& state)
+{
+    state.open_base();
+}
+
+
+/// Initialization function that always fails.
+static void
+setup_fail(lutok::state& /* state */)
+{
+    throw std::runtime_error("Cannot set up");
+}
+
+
+/// Lock protecting callback_sum.
+static pthread_mutex_t callback_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/// Sum of the results delivered to add_result.
+static long callback_sum = 0;
+
+
+/// Callback that accumulates the results of the jobs into callback_sum.
+///
+/// \param future The completed job.
+/// \param cookie Pointer to an integer to add to every result.
+static void
+add_result(const lutok::job_future& future, void* cookie)
+{
+    const long result = deserialize_integer(future.get()) +
+        *static_cast< const long* >(cookie);
+    ::pthread_mutex_lock(&callback_mutex);
+    callback_sum += result;
+    ::pthread_mutex_unlock(&callback_mutex);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(submit__source);
+ATF_TEST_CASE_BODY(submit__source)
+{
+    lutok::executor executor(2, NULL);
+    ATF_REQUIRE_EQ(2, executor.workers());
+
+    std::vector< std::string > arguments;
+    arguments.push_back(serialize_integer(2));
+    arguments.push_back(serialize_integer(3));
+    const lutok::job_future future = executor.submit(
+        "local a, b = ... return a + b", arguments);
+    ATF_REQUIRE_EQ(5, deserialize_integer(future.get()));
+    ATF_REQUIRE(future.ready());
+    ATF_REQUIRE(!future.failed());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(submit__bytecode);
+ATF_TEST_CASE_BODY(submit__bytecode)
+{
+    lutok::state state;
+    state.load_string("return select('#', ...) * 10");
+    const std::string bytecode = state.dump();
+    state.pop(1);
+
+    lutok::executor executor(1, setup_base);
+    std::vector< std::string > arguments(4, serialize_integer(0));
+    for (int i = 0; i < 10; i++)
+        ATF_REQUIRE_EQ(40, deserialize_integer(
+            executor.submit(bytecode, arguments).get()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(submit__error);
+ATF_TEST_CASE_BODY(submit__error)
+{
+    lutok::executor executor(1, setup_base);
+    const lutok::job_future future = executor.submit(
+        "error('oops', 0)", std::vector< std::string >());
+    ATF_REQUIRE(future.failed());
+    ATF_REQUIRE_THROW_RE(lutok::error, "^oops$", future.get());
+
+    const lutok::job_future syntax = executor.submit(
+        "this is not Lua", std::vector< std::string >());
+    ATF_REQUIRE_THROW_RE(lutok::error, "job", syntax.get());
+
+    ATF_REQUIRE_EQ(7, deserialize_integer(executor.submit(
+        "return 7", std::vector< std::string >()).get()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(submit__callback);
+ATF_TEST_CASE_BODY(submit__callback)
+{
+    callback_sum = 0;
+    long offset = 1000;
+    {
+        lutok::executor executor(4, NULL);
+        for (long i = 1; i <= 100; i++) {
+            executor.submit("return ...",
+                            std::vector< std::string >(
+                                1, serialize_integer(i)),
+                            add_result, &offset);
+        }
+    }
+    ATF_REQUIRE_EQ(5050 + 100 * 1000, callback_sum);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup);
+ATF_TEST_CASE_BODY(setup)
+{
+    lutok::executor executor(3, setup_double);
+    ATF_REQUIRE_EQ(42, deserialize_integer(executor.submit(
+        "return double(...)",
+        std::vector< std::string >(1, serialize_integer(21))).get()));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup__fail);
+ATF_TEST_CASE_BODY(setup__fail)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Cannot set up",
+                         lutok::executor(2, setup_fail));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(map);
+ATF_TEST_CASE_BODY(map)
+{
+    lutok::executor executor(4, NULL);
+    std::vector< std::string > partitions;
+    for (long i = 0; i < 500; i++)
+        partitions.push_back(serialize_integer(i));
+
+    const std::vector< std::string > results = executor.map(
+        "local x = ... return x * x", partitions);
+    ATF_REQUIRE_EQ(500, results.size());
+    for (long i = 0; i < 500; i++)
+        ATF_REQUIRE_EQ(i * i, deserialize_integer(results[i]));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(map__error);
+ATF_TEST_CASE_BODY(map__error)
+{
+    lutok::executor executor(2, setup_base);
+    std::vector< std::string > partitions;
+    for (long i = 0; i < 10; i++)
+        partitions.push_back(serialize_integer(i));
+
+    ATF_REQUIRE_THROW_RE(lutok::error, "five",
+                         executor.map("if ... == 5 then error('five') end",
+                                      partitions));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(map_reduce);
+ATF_TEST_CASE_BODY(map_reduce)
+{
+    lutok::executor executor(4, setup_base);
+    std::vector< std::string > partitions;
+    for (long i = 1; i <= 100; i++)
+        partitions.push_back(serialize_integer(i));
+
+    const std::string result = executor.map_reduce(
+        "return ... * 2",
+        "local sum = 0 for _, x in ipairs({...}) do sum = sum + x end "
+        "return sum",
+        partitions);
+    ATF_REQUIRE_EQ(10100, deserialize_integer(result));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(tables);
+ATF_TEST_CASE_BODY(tables)
+{
+    lutok::state state;
+    lutok::do_string(state, "return {1, 2, 3, name = 'abc'}", 0, 1, 0);
+    const std::string table = lutok::serialize(state, -1);
+    state.pop(1);
+
+    lutok::executor executor(2, NULL);
+    const std::string result = executor.submit(
+        "local t = ... t[#t + 1] = t.name return t",
+        std::vector< std::string >(1, table)).get();
+
+    lutok::deserialize(state, result);
+    state.set_global("copy");
+    lutok::do_string(state, "return #copy == 4 and copy[4] == 'abc'",
+                     0, 1, 0);
+    ATF_REQUIRE(state.to_boolean(-1));
+    state.pop(1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, submit__source);
+    ATF_ADD_TEST_CASE(tcs, submit__bytecode);
+    ATF_ADD_TEST_CASE(tcs, submit__error);
+    ATF_ADD_TEST_CASE(tcs, submit__callback);
+    ATF_ADD_TEST_CASE(tcs, setup);
+    ATF_ADD_TEST_CASE(tcs, setup__fail);
+    ATF_ADD_TEST_CASE(tcs, map);
+    ATF_ADD_TEST_CASE(tcs, map__error);
+    ATF_ADD_TEST_CASE(tcs, map_reduce);
+    ATF_ADD_TEST_CASE(tcs, tables);
+}
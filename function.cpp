@@ -0,0 +1,174 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "function.hpp"
+
+#include <cassert>
+
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "ref.hpp"
+#include "state.ipp"
+
+
+/// Internal implementation for lutok::function.
+struct lutok::function::impl {
+    /// The reference to the function in the registry.
+    ref reference;
+
+    /// Pins a function in the registry.
+    ///
+    /// \param s The Lua state.
+    /// \param index The stack index of the function.
+    impl(state& s, const int index) :
+        reference(s, index)
+    {
+    }
+};
+
+
+/// Creates a handle to a function on the stack.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the function.  The function is not
+///     removed from the stack.
+///
+/// \warning Terminates execution if there is not enough memory.
+lutok::function::function(state& s, const int index)
+{
+    assert(s.is_function(index));
+    _pimpl.reset(new impl(s, index));
+}
+
+
+/// Destructor.
+lutok::function::~function(void)
+{
+}
+
+
+/// Compiles an expression into a function that returns its value.
+///
+/// This is the precompiled counterpart of eval.
+///
+/// \param s The Lua state.
+/// \param expression The textual expression to compile.
+///
+/// \return The handle to the compiled expression.
+///
+/// \throw api_error If the expression cannot be compiled.
+lutok::function
+lutok::function::from_expression(state& s, const std::string& expression)
+{
+    return from_string(s, "return " + expression);
+}
+
+
+/// Compiles a file into a function.
+///
+/// This is the precompiled counterpart of do_file.
+///
+/// \param s The Lua state.
+/// \param file The file to compile.
+///
+/// \return The handle to the compiled file.
+///
+/// \throw file_not_found_error If the file cannot be accessed.
+/// \throw api_error If the file cannot be compiled.
+lutok::function
+lutok::function::from_file(state& s, const std::string& file)
+{
+    s.load_file(file);
+    const function handle(s, -1);
+    s.pop(1);
+    return handle;
+}
+
+
+/// Compiles a string into a function.
+///
+/// This is the precompiled counterpart of do_string.
+///
+/// \param s The Lua state.
+/// \param str The code to compile.
+///
+/// \return The handle to the compiled string.
+///
+/// \throw api_error If the string cannot be compiled.
+lutok::function
+lutok::function::from_string(state& s, const std::string& str)
+{
+    s.load_string(str);
+    const function handle(s, -1);
+    s.pop(1);
+    return handle;
+}
+
+
+/// Calls the function.
+///
+/// \param s The Lua state in which to run the function.  This must be the
+///     state in which the function was created or one of its threads.
+/// \param nargs The number of arguments on the stack to pass to the function.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler.
+///
+/// \return The number of results left on the stack.
+///
+/// \throw api_error If the function raises an error.
+unsigned int
+lutok::function::call(state& s, const int nargs, const int nresults,
+                      const int errfunc) const
+{
+    assert(nresults >= -1);
+    const int height = s.get_top() - nargs;
+
+    push(s);
+    if (nargs > 0)
+        s.insert(-nargs - 1);
+    s.pcall(nargs, nresults == -1 ? LUA_MULTRET : nresults,
+            errfunc == 0 ? 0 : errfunc - 1);
+
+    const int actual_results = s.get_top() - height;
+    assert(nresults == -1 || actual_results == nresults);
+    assert(actual_results >= 0);
+    return static_cast< unsigned int >(actual_results);
+}
+
+
+/// Pushes the function onto the stack.
+///
+/// \param s The Lua state.  This must be the state in which the function was
+///     created or one of its threads.
+void
+lutok::function::push(state& s) const
+{
+    _pimpl->reference.push(s);
+}
@@ -0,0 +1,85 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file function.hpp
+/// Provides handles to Lua functions that can be called many times.
+
+#if !defined(LUTOK_FUNCTION_HPP)
+#define LUTOK_FUNCTION_HPP
+
+#include <string>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class state;
+
+
+/// Handle to a Lua function pinned in the registry.
+///
+/// A function object compiles a piece of code once and keeps the resulting
+/// function alive in the Lua registry, so that it can later be invoked any
+/// number of times at the cost of a single protected call.  This is much
+/// cheaper than calling do_string or eval repeatedly, as these recompile
+/// their input every time.
+///
+/// Copies of a function object share the same registry reference, which is
+/// released when the last copy is destroyed.  All copies must be destroyed
+/// before the Lua state they belong to is closed.
+class function {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+public:
+    function(state&, const int);
+    ~function(void);
+
+    static function from_expression(state&, const std::string&);
+    static function from_file(state&, const std::string&);
+    static function from_string(state&, const std::string&);
+
+    unsigned int call(state&, const int, const int, const int) const;
+    void push(state&) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_FUNCTION_HPP)
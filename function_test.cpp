@@ -0,0 +1,256 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "function.hpp"
+
+#include <fstream>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ctor__from_stack);
+ATF_TEST_CASE_BODY(ctor__from_stack)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "return function() return 42 end") == 0);
+    const lutok::function function(state, -1);
+    state.pop(1);
+
+    ATF_REQUIRE_EQ(1, function.call(state, 0, 1, 0));
+    ATF_REQUIRE_EQ(42, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_expression);
+ATF_TEST_CASE_BODY(from_expression)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const lutok::function function = lutok::function::from_expression(
+        state, "3 + 10");
+    ATF_REQUIRE_EQ(1, function.call(state, 0, 1, 0));
+    ATF_REQUIRE_EQ(13, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_file);
+ATF_TEST_CASE_BODY(from_file)
+{
+    std::ofstream output("test.lua");
+    output << "local a1, a2 = ...\nreturn a1 * a2\n";
+    output.close();
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const lutok::function function = lutok::function::from_file(
+        state, "test.lua");
+    state.push_integer(6);
+    state.push_integer(7);
+    ATF_REQUIRE_EQ(1, function.call(state, 2, 1, 0));
+    ATF_REQUIRE_EQ(42, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_file__not_found);
+ATF_TEST_CASE_BODY(from_file__not_found)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_THROW_RE(lutok::file_not_found_error, "missing.lua",
+                         lutok::function::from_file(state, "missing.lua"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_string__error);
+ATF_TEST_CASE_BODY(from_string__error)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    REQUIRE_API_ERROR("luaL_loadstring",
+                      lutok::function::from_string(state, "a b c"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(call__many_times);
+ATF_TEST_CASE_BODY(call__many_times)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const lutok::function function = lutok::function::from_string(
+        state, "counter = (counter or 0) + 1; return counter, ...");
+    for (int i = 1; i <= 10; i++) {
+        state.push_integer(i * 100);
+        ATF_REQUIRE_EQ(2, function.call(state, 1, -1, 0));
+        ATF_REQUIRE_EQ(i, state.to_integer(-2));
+        ATF_REQUIRE_EQ(i * 100, state.to_integer(-1));
+        state.pop(2);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(call__args_below);
+ATF_TEST_CASE_BODY(call__args_below)
+{
+    lutok::state state;
+
+    const lutok::function function = lutok::function::from_string(
+        state, "return ...");
+    state.push_integer(1);
+    state.push_integer(2);
+    state.push_integer(3);
+    ATF_REQUIRE_EQ(1, function.call(state, 1, 1, 0));
+    ATF_REQUIRE_EQ(3, state.get_top());
+    ATF_REQUIRE_EQ(1, state.to_integer(-3));
+    ATF_REQUIRE_EQ(2, state.to_integer(-2));
+    ATF_REQUIRE_EQ(3, state.to_integer(-1));
+    state.pop(3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(call__error);
+ATF_TEST_CASE_BODY(call__error)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const lutok::function function = lutok::function::from_string(
+        state, "error('oops')");
+    REQUIRE_API_ERROR("lua_pcall", function.call(state, 0, 0, 0));
+    REQUIRE_API_ERROR("lua_pcall", function.call(state, 0, 0, 0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(call__error_with_errfunc);
+ATF_TEST_CASE_BODY(call__error_with_errfunc)
+{
+    lutok::state state;
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "return function() return 'Handled!' end") == 0);
+    {
+        stack_balance_checker checker(state);
+        const lutok::function function = lutok::function::from_string(
+            state, "unknown_function()");
+        ATF_REQUIRE_THROW_RE(lutok::api_error, "Handled!",
+                             function.call(state, 0, 0, -1));
+    }
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy);
+ATF_TEST_CASE_BODY(copy)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::function* original = new lutok::function(
+        lutok::function::from_expression(state, "'hello'"));
+    const lutok::function copy = *original;
+    delete original;
+
+    ATF_REQUIRE_EQ(1, copy.call(state, 0, 1, 0));
+    ATF_REQUIRE_EQ("hello", state.to_string(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push);
+ATF_TEST_CASE_BODY(push)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const lutok::function function = lutok::function::from_string(
+        state, "return 5");
+    function.push(state);
+    ATF_REQUIRE(state.is_function(-1));
+    state.set_global("five");
+    ATF_REQUIRE(luaL_dostring(raw(state), "return five() + 1") == 0);
+    ATF_REQUIRE_EQ(6, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(release);
+ATF_TEST_CASE_BODY(release)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lua_newtable(raw(state));
+    lua_pushvalue(raw(state), -1);
+    lua_setglobal(raw(state), "weak");
+    state.open_base();
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "setmetatable(weak, {__mode='v'})") == 0);
+    {
+        const lutok::function function = lutok::function::from_string(
+            state, "return 1");
+        function.push(state);
+        lua_setfield(raw(state), -2, "entry");
+        lua_gc(raw(state), LUA_GCCOLLECT, 0);
+        lua_getfield(raw(state), -1, "entry");
+        ATF_REQUIRE(lua_isfunction(raw(state), -1));
+        lua_pop(raw(state), 1);
+    }
+    lua_gc(raw(state), LUA_GCCOLLECT, 0);
+    lua_getfield(raw(state), -1, "entry");
+    ATF_REQUIRE(lua_isnil(raw(state), -1));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, ctor__from_stack);
+    ATF_ADD_TEST_CASE(tcs, from_expression);
+    ATF_ADD_TEST_CASE(tcs, from_file);
+    ATF_ADD_TEST_CASE(tcs, from_file__not_found);
+    ATF_ADD_TEST_CASE(tcs, from_string__error);
+    ATF_ADD_TEST_CASE(tcs, call__many_times);
+    ATF_ADD_TEST_CASE(tcs, call__args_below);
+    ATF_ADD_TEST_CASE(tcs, call__error);
+    ATF_ADD_TEST_CASE(tcs, call__error_with_errfunc);
+    ATF_ADD_TEST_CASE(tcs, copy);
+    ATF_ADD_TEST_CASE(tcs, push);
+    ATF_ADD_TEST_CASE(tcs, release);
+}
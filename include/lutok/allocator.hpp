@@ -0,0 +1 @@
+#include "../../allocator.hpp"
@@ -0,0 +1 @@
+#include "../../bind.hpp"
@@ -0,0 +1 @@
+#include "../../budget.hpp"
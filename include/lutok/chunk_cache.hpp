@@ -0,0 +1 @@
+#include "../../chunk_cache.hpp"
@@ -0,0 +1 @@
+#include "../../class.hpp"
@@ -0,0 +1 @@
+#include "../../executor.hpp"
@@ -0,0 +1 @@
+#include "../../function.hpp"
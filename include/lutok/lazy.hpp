@@ -0,0 +1 @@
+#include "../../lazy.hpp"
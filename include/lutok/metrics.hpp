@@ -0,0 +1 @@
+#include "../../metrics.hpp"
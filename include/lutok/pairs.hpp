@@ -0,0 +1 @@
+#include "../../pairs.hpp"
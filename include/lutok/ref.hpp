@@ -0,0 +1 @@
+#include "../../ref.hpp"
@@ -0,0 +1 @@
+#include "../../serialize.hpp"
@@ -0,0 +1 @@
+#include "../../state_pool.hpp"
@@ -0,0 +1 @@
+#include "../../state_template.hpp"
@@ -0,0 +1 @@
+#include "../../table.hpp"
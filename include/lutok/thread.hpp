@@ -0,0 +1 @@
+#include "../../thread.hpp"
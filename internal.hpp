@@ -0,0 +1,92 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file internal.hpp
+/// Utilities shared by the implementation of the library.
+///
+/// This header is not installed: its contents are not part of the public
+/// interface of the library and can change at any time.
+
+#if !defined(LUTOK_INTERNAL_HPP)
+#define LUTOK_INTERNAL_HPP
+
+extern "C" {
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+}
+
+namespace lutok {
+namespace detail {
+
+
+/// Scoped holder of a mutex.
+class mutex_locker {
+    /// The held mutex.
+    pthread_mutex_t& _mutex;
+
+    /// Disallow copies.
+    mutex_locker(const mutex_locker&);
+
+    /// Disallow assignment.
+    mutex_locker& operator=(const mutex_locker&);
+
+public:
+    /// Locks a mutex.
+    ///
+    /// \param mutex_ The mutex to lock.
+    explicit mutex_locker(pthread_mutex_t& mutex_) :
+        _mutex(mutex_)
+    {
+        ::pthread_mutex_lock(&_mutex);
+    }
+
+    /// Unlocks the mutex.
+    ~mutex_locker(void)
+    {
+        ::pthread_mutex_unlock(&_mutex);
+    }
+};
+
+
+/// Gets the current value of a monotonic clock.
+///
+/// \return The current time in nanoseconds since an arbitrary epoch.
+inline uint64_t
+now_nanoseconds(void)
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast< uint64_t >(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+
+}  // namespace detail
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_INTERNAL_HPP)
@@ -0,0 +1,338 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lazy.hpp"
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Object whose address identifies the table of loaders in the registry.
+static const char registry_key = 0;
+
+
+/// Gets the registry key of the table of loaders as a light userdata.
+///
+/// \return The key.
+static void*
+loaders_key(void)
+{
+    return const_cast< char* >(&registry_key);
+}
+
+
+/// Runs the lazy loader of a global variable, if there is one.
+///
+/// If there is a loader for the key, the loader is run and its result is
+/// stored in the globals table, so that later accesses to the key do not need
+/// the loader.  The loader is only discarded once it succeeds.
+///
+/// \param raw_state The Lua state.
+/// \param globals The absolute stack index of the globals table.
+/// \param loaders The absolute stack index of the table of loaders.
+/// \param key The absolute stack index of the name of the global variable.
+///
+/// \post stack(-1) is the value of the global variable.
+static void
+run_loader(lua_State* raw_state, const int globals, const int loaders,
+           const int key)
+{
+    lua_pushvalue(raw_state, key);
+    lua_rawget(raw_state, loaders);
+    if (!lua_isfunction(raw_state, -1)) {
+        lua_pop(raw_state, 1);
+        lua_pushvalue(raw_state, key);
+        lua_rawget(raw_state, globals);
+        return;
+    }
+
+    lua_pushvalue(raw_state, key);
+    lua_call(raw_state, 1, 1);
+
+    lua_pushvalue(raw_state, key);
+    lua_pushvalue(raw_state, -2);
+    lua_rawset(raw_state, globals);
+
+    lua_pushvalue(raw_state, key);
+    lua_pushnil(raw_state);
+    lua_rawset(raw_state, loaders);
+}
+
+
+/// Index metamethod of the globals table to run the lazy loaders.
+///
+/// \pre stack(1) is the globals table.
+/// \pre stack(2) is the requested key.
+/// \pre upvalue(1) is the table of loaders.
+///
+/// \param raw_state The Lua state.
+///
+/// \return The number of results, i.e. 1: the value of the global variable.
+static int
+lazy_index(lua_State* raw_state)
+{
+    run_loader(raw_state, 1, lua_upvalueindex(1), 2);
+    return 1;
+}
+
+
+/// Searcher entry in package.preload for a lazily-opened standard library.
+///
+/// This makes require() find the libraries that have not been accessed yet
+/// through their global variable, and returns the same table as that access.
+///
+/// \pre stack(1) is the name of the library, as passed by require().
+/// \pre upvalue(1) is the table of loaders.
+///
+/// \param raw_state The Lua state.
+///
+/// \return The number of results, i.e. 1: the library.
+static int
+preload_library(lua_State* raw_state)
+{
+    lua_settop(raw_state, 1);
+#if LUA_VERSION_NUM >= 502
+    lua_rawgeti(raw_state, LUA_REGISTRYINDEX, LUA_RIDX_GLOBALS);
+#else
+    lua_pushvalue(raw_state, LUA_GLOBALSINDEX);
+#endif
+    run_loader(raw_state, 2, lua_upvalueindex(1), 1);
+    return 1;
+}
+
+
+/// Lazy loader of a standard library.
+///
+/// \pre stack(1) is the name of the library.
+/// \pre upvalue(1) is the function that opens the library.
+///
+/// \param raw_state The Lua state.
+///
+/// \return The number of results, i.e. 1: the library.
+static int
+load_library(lua_State* raw_state)
+{
+#if LUA_VERSION_NUM >= 502
+    luaL_requiref(raw_state, lua_tostring(raw_state, 1),
+                  lua_tocfunction(raw_state, lua_upvalueindex(1)), 0);
+#else
+    lua_pushvalue(raw_state, lua_upvalueindex(1));
+    lua_pushvalue(raw_state, 1);
+    lua_call(raw_state, 1, 1);
+#endif
+    return 1;
+}
+
+
+/// Lazy loader of a module of C++ functions.
+///
+/// \pre stack(1) is the name of the module.
+/// \pre upvalue(1) is a light userdata pointing to the members of the module.
+/// \pre upvalue(2) is the number of members of the module.
+///
+/// \param s The Lua state.
+///
+/// \return The number of results, i.e. 1: the module.
+static int
+load_module(lutok::state& s)
+{
+    lua_State* raw_state = lutok::state_c_gate(s).c_state();
+    const lutok::module_function* members =
+        static_cast< const lutok::module_function* >(
+            lua_touserdata(raw_state, lua_upvalueindex(1)));
+    const std::size_t nmembers = static_cast< std::size_t >(
+        lua_tointeger(raw_state, lua_upvalueindex(2)));
+    const std::string name = s.to_string(1);
+
+    lutok::create_module(s, name, members, nmembers);
+    s.get_global_table();
+    s.push_string(name);
+    s.raw_get(-2);
+    return 1;
+}
+
+
+/// Pushes the table of loaders, installing the index metamethod if needed.
+///
+/// \param s The Lua state.
+///
+/// \throw error If the globals table has a metatable not set by this module.
+///
+/// \warning Terminates execution if there is not enough memory.
+static void
+push_loaders(lutok::state& s)
+{
+    lua_State* raw_state = lutok::state_c_gate(s).c_state();
+
+    lua_pushlightuserdata(raw_state, loaders_key());
+    lua_rawget(raw_state, LUA_REGISTRYINDEX);
+    if (!lua_isnil(raw_state, -1))
+        return;
+    lua_pop(raw_state, 1);
+
+    s.get_global_table();
+    if (lua_getmetatable(raw_state, -1)) {
+        lua_pop(raw_state, 2);
+        throw lutok::error("The globals table already has a metatable");
+    }
+
+    lua_newtable(raw_state);
+    lua_pushlightuserdata(raw_state, loaders_key());
+    lua_pushvalue(raw_state, -2);
+    lua_rawset(raw_state, LUA_REGISTRYINDEX);
+
+    lua_createtable(raw_state, 0, 1);
+    lua_pushstring(raw_state, "__index");
+    lua_pushvalue(raw_state, -3);
+    lua_pushcclosure(raw_state, lazy_index, 1);
+    lua_rawset(raw_state, -3);
+    lua_setmetatable(raw_state, -3);
+
+    lua_remove(raw_state, -2);
+}
+
+
+/// Registers a standard library to be opened on first access.
+///
+/// \pre stack(-2) is the package.preload table.
+/// \pre stack(-1) is the table of loaders.
+///
+/// \param raw_state The Lua state.
+/// \param name The name of the library.
+/// \param open_function The function that opens the library.
+static void
+add_library(lua_State* raw_state, const char* name,
+            lua_CFunction open_function)
+{
+    lua_pushstring(raw_state, name);
+    lua_pushcfunction(raw_state, open_function);
+    lua_pushcclosure(raw_state, load_library, 1);
+    lua_rawset(raw_state, -3);
+
+    lua_pushstring(raw_state, name);
+    lua_pushvalue(raw_state, -2);
+    lua_pushcclosure(raw_state, preload_library, 1);
+    lua_rawset(raw_state, -4);
+}
+
+
+}  // anonymous namespace
+
+
+/// Registers a module to be created on first access.
+///
+/// The module is created with create_module() the first time that a script
+/// reads the global variable with its name.
+///
+/// \param s The Lua state.
+/// \param name The name of the module to create.
+/// \param members The member functions to add to the module.  The array must
+///     outlive the state, which usually means that it must have static storage
+///     duration.
+/// \param nmembers The number of entries in members.
+///
+/// \throw error If the globals table has a metatable not set by lutok.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::create_lazy_module(state& s, const std::string& name,
+                          const module_function* members,
+                          const std::size_t nmembers)
+{
+    push_loaders(s);
+    lua_State* raw_state = state_c_gate(s).c_state();
+    s.push_string(name);
+    lua_pushlightuserdata(raw_state, const_cast< module_function* >(members));
+    lua_pushinteger(raw_state, static_cast< lua_Integer >(nmembers));
+    s.push_cxx_closure(load_module, 2);
+    s.raw_set(-3);
+    s.pop(1);
+}
+
+
+/// Opens the standard libraries, deferring most of them until first access.
+///
+/// This is a replacement for state::open_all() for states whose scripts only
+/// use a few of the standard libraries.  The base, package and string
+/// libraries are opened right away: the first two define global functions and
+/// the last one sets the metatable of strings, neither of which can be
+/// deferred.  All other libraries are opened the first time that a script
+/// reads the global variable with their name or requires them by name, and
+/// both ways yield the same table.
+///
+/// \param s The Lua state.
+///
+/// \throw api_error If opening any of the libraries fails.
+/// \throw error If the globals table has a metatable not set by lutok.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::open_all_lazy(state& s)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+
+    s.open_base();
+#if LUA_VERSION_NUM >= 502
+    luaL_requiref(raw_state, LUA_LOADLIBNAME, luaopen_package, 1);
+#else
+    lua_pushcfunction(raw_state, luaopen_package);
+    if (lua_pcall(raw_state, 0, 1, 0) != 0)
+        throw api_error::from_stack(s, "luaopen_package");
+#endif
+    lua_getfield(raw_state, -1, "preload");
+    lua_remove(raw_state, -2);
+    try {
+        s.open_string();
+        push_loaders(s);
+    } catch (...) {
+        lua_pop(raw_state, 1);
+        throw;
+    }
+#if LUA_VERSION_NUM >= 502
+    add_library(raw_state, LUA_COLIBNAME, luaopen_coroutine);
+#endif
+    add_library(raw_state, LUA_TABLIBNAME, luaopen_table);
+    add_library(raw_state, LUA_IOLIBNAME, luaopen_io);
+    add_library(raw_state, LUA_OSLIBNAME, luaopen_os);
+    add_library(raw_state, LUA_MATHLIBNAME, luaopen_math);
+#if LUA_VERSION_NUM >= 503
+    add_library(raw_state, LUA_UTF8LIBNAME, luaopen_utf8);
+#endif
+#if LUA_VERSION_NUM == 502 || (LUA_VERSION_NUM == 503 && \
+                               defined(LUA_COMPAT_BITLIB))
+    add_library(raw_state, LUA_BITLIBNAME, luaopen_bit32);
+#endif
+    add_library(raw_state, LUA_DBLIBNAME, luaopen_debug);
+    lua_pop(raw_state, 2);
+}
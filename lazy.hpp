@@ -0,0 +1,78 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file lazy.hpp
+/// Provides lazy loading of libraries and modules into the globals table.
+///
+/// Lazy libraries and modules are registered as loaders that are only run the
+/// first time that a script accesses the global variable with their name, so
+/// that the cost of setting up a state scales with what its scripts use
+/// instead of with everything that could be used.
+///
+/// The loaders are run by an __index metamethod installed on the globals
+/// table.  Lazy loading therefore cannot be used on states whose globals table
+/// has a metatable set by other means.  Accessing the globals table with raw
+/// operations, e.g. through next(), does not trigger the loaders.
+
+#if !defined(LUTOK_LAZY_HPP)
+#define LUTOK_LAZY_HPP
+
+#include <cstddef>
+#include <string>
+
+#include <lutok/operations.hpp>
+
+namespace lutok {
+
+
+class state;
+
+
+void create_lazy_module(state&, const std::string&, const module_function*,
+                        const std::size_t);
+void open_all_lazy(state&);
+
+
+/// Registers a module to be created on first access.
+///
+/// \param s The Lua state.
+/// \param name The name of the module to create.
+/// \param members The member functions to add to the module.  The array must
+///     outlive the state.
+template< std::size_t Length >
+void
+create_lazy_module(state& s, const std::string& name,
+                   const module_function (&members)[Length])
+{
+    create_lazy_module(s, name, members, Length);
+}
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_LAZY_HPP)
@@ -0,0 +1,209 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lazy.hpp"
+
+#include <atf-c++.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Addition function for injection into Lua.
+///
+/// \pre stack(-2) The first summand.
+/// \pre stack(-1) The second summand.
+/// \post stack(-1) The result of the sum.
+///
+/// \param state The Lua state.
+///
+/// \return The number of results (1).
+static int
+hook_add(lutok::state& state)
+{
+    state.push_integer(state.to_integer(-1) + state.to_integer(-2));
+    return 1;
+}
+
+
+/// Members of the lazy module used by the tests.
+static const lutok::module_function math_members[] = {
+    { "add", hook_add },
+};
+
+
+/// Checks whether a Lua expression is true.
+///
+/// \param state The Lua state.
+/// \param expression The expression to evaluate.
+///
+/// \return The boolean value of the expression.
+static bool
+is_true(lutok::state& state, const std::string& expression)
+{
+    lutok::eval(state, expression, 1);
+    const bool value = state.to_boolean(-1);
+    state.pop(1);
+    return value;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open_all_lazy__eager);
+ATF_TEST_CASE_BODY(open_all_lazy__eager)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    lutok::open_all_lazy(state);
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'print') ~= nil"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'require') ~= nil"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'string') ~= nil"));
+    ATF_REQUIRE(is_true(state, "('abc'):upper() == 'ABC'"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open_all_lazy__deferred);
+ATF_TEST_CASE_BODY(open_all_lazy__deferred)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    lutok::open_all_lazy(state);
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'math') == nil"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'table') == nil"));
+
+    ATF_REQUIRE(is_true(state, "math.floor(2.5) == 2"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'math') ~= nil"));
+    ATF_REQUIRE(is_true(state, "package.loaded.math == math"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'table') == nil"));
+
+    ATF_REQUIRE(is_true(state, "table.concat({'a', 'b'}) == 'ab'"));
+    ATF_REQUIRE(is_true(state, "os ~= nil and io ~= nil and debug ~= nil"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open_all_lazy__unknown_globals);
+ATF_TEST_CASE_BODY(open_all_lazy__unknown_globals)
+{
+    lutok::state state;
+    lutok::open_all_lazy(state);
+    ATF_REQUIRE(is_true(state, "undefined_variable == nil"));
+    ATF_REQUIRE(is_true(state, "_G[1] == nil"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open_all_lazy__from_cxx);
+ATF_TEST_CASE_BODY(open_all_lazy__from_cxx)
+{
+    lutok::state state;
+    lutok::open_all_lazy(state);
+    state.get_global("math");
+    ATF_REQUIRE(state.is_table(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(open_all_lazy__require);
+ATF_TEST_CASE_BODY(open_all_lazy__require)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    lutok::open_all_lazy(state);
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'table') == nil"));
+
+    ATF_REQUIRE(is_true(state, "require('table') == table"));
+    ATF_REQUIRE(is_true(state, "package.loaded.table == table"));
+    ATF_REQUIRE(is_true(state, "require('table').concat({'a', 'b'}) == 'ab'"));
+
+    ATF_REQUIRE(is_true(state, "math.floor(2.5) == 2"));
+    ATF_REQUIRE(is_true(state, "require('math') == math"));
+
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'os') == nil"));
+    ATF_REQUIRE(is_true(state, "require('os') ~= nil"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'os') == require('os')"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(create_lazy_module__ok);
+ATF_TEST_CASE_BODY(create_lazy_module__ok)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    state.open_base();
+    lutok::create_lazy_module(state, "my_math", math_members);
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'my_math') == nil"));
+    ATF_REQUIRE(is_true(state, "my_math.add(10, 20) == 30"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'my_math') ~= nil"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(create_lazy_module__many);
+ATF_TEST_CASE_BODY(create_lazy_module__many)
+{
+    lutok::state state;
+    lutok::open_all_lazy(state);
+    lutok::create_lazy_module(state, "first", math_members);
+    lutok::create_lazy_module(state, "second", math_members, 1);
+    ATF_REQUIRE(is_true(state, "second.add(1, 2) == 3"));
+    ATF_REQUIRE(is_true(state, "rawget(_G, 'first') == nil"));
+    ATF_REQUIRE(is_true(state, "first.add(3, 4) == 7"));
+    ATF_REQUIRE(is_true(state, "math.floor(1.5) == 1"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(globals_metatable);
+ATF_TEST_CASE_BODY(globals_metatable)
+{
+    lutok::state state;
+    state.open_base();
+    lutok::do_string(state, "setmetatable(_G, {})", 0, 0, 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "already has a metatable",
+                         lutok::open_all_lazy(state));
+    ATF_REQUIRE_THROW_RE(lutok::error, "already has a metatable",
+                         lutok::create_lazy_module(state, "my_math",
+                                                   math_members));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, open_all_lazy__eager);
+    ATF_ADD_TEST_CASE(tcs, open_all_lazy__deferred);
+    ATF_ADD_TEST_CASE(tcs, open_all_lazy__unknown_globals);
+    ATF_ADD_TEST_CASE(tcs, open_all_lazy__from_cxx);
+    ATF_ADD_TEST_CASE(tcs, open_all_lazy__require);
+    ATF_ADD_TEST_CASE(tcs, create_lazy_module__ok);
+    ATF_ADD_TEST_CASE(tcs, create_lazy_module__many);
+    ATF_ADD_TEST_CASE(tcs, globals_metatable);
+}
@@ -0,0 +1,78 @@
+dnl Copyright 2026 Google Inc.
+dnl All rights reserved.
+dnl
+dnl Redistribution and use in source and binary forms, with or without
+dnl modification, are permitted provided that the following conditions are
+dnl met:
+dnl
+dnl * Redistributions of source code must retain the above copyright
+dnl   notice, this list of conditions and the following disclaimer.
+dnl * Redistributions in binary form must reproduce the above copyright
+dnl   notice, this list of conditions and the following disclaimer in the
+dnl   documentation and/or other materials provided with the distribution.
+dnl * Neither the name of Google Inc. nor the names of its contributors
+dnl   may be used to endorse or promote products derived from this software
+dnl   without specific prior written permission.
+dnl
+dnl THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+dnl "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+dnl LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+dnl A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+dnl OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+dnl SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+dnl LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+dnl DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+dnl THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+dnl (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+dnl OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+dnl
+dnl KYUA_PTHREAD
+dnl
+dnl Determines the flags required to build and link programs that use POSIX
+dnl threads and defines PTHREAD_CFLAGS and PTHREAD_LIBS accordingly.
+dnl
+AC_DEFUN([KYUA_PTHREAD], [
+    AC_CACHE_CHECK([for the flags required by POSIX threads],
+                   [kyua_cv_pthread_flags], [
+        kyua_cv_pthread_flags=unknown
+        for flags in -pthread -lpthread none; do
+            kyua_saved_cxxflags="${CXXFLAGS}"
+            kyua_saved_libs="${LIBS}"
+            case "${flags}" in
+                -pthread) CXXFLAGS="${CXXFLAGS} -pthread"
+                          LIBS="${LIBS} -pthread" ;;
+                -lpthread) LIBS="${LIBS} -lpthread" ;;
+            esac
+            AC_LINK_IFELSE([AC_LANG_PROGRAM([#include <pthread.h>], [
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, NULL);
+    return pthread_create(NULL, NULL, NULL, NULL);
+])],
+                [kyua_cv_pthread_flags="${flags}"])
+            CXXFLAGS="${kyua_saved_cxxflags}"
+            LIBS="${kyua_saved_libs}"
+            test "${kyua_cv_pthread_flags}" = unknown || break
+        done
+    ])
+
+    case "${kyua_cv_pthread_flags}" in
+        -pthread)
+            PTHREAD_CFLAGS=-pthread
+            PTHREAD_LIBS=-pthread
+            ;;
+        -lpthread)
+            PTHREAD_CFLAGS=
+            PTHREAD_LIBS=-lpthread
+            ;;
+        none)
+            PTHREAD_CFLAGS=
+            PTHREAD_LIBS=
+            ;;
+        *)
+            AC_MSG_ERROR([POSIX threads are required])
+            ;;
+    esac
+    AC_SUBST([PTHREAD_CFLAGS])
+    AC_SUBST([PTHREAD_LIBS])
+])
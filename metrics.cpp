@@ -0,0 +1,568 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.hpp"
+
+extern "C" {
+#include <pthread.h>
+#include <stdint.h>
+}
+
+#include <map>
+
+#include "internal.hpp"
+
+
+namespace {
+
+
+/// Number of counters kept per function: calls, exceptions and latencies.
+static const std::size_t ncounters = 2 + lutok::call_stats::latency_buckets;
+
+
+/// Index of the counter of calls.
+static const std::size_t calls_counter = 0;
+
+
+/// Index of the counter of exceptions.
+static const std::size_t exceptions_counter = 1;
+
+
+/// Index of the counter of the first latency bucket.
+static const std::size_t latency_counter = 2;
+
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+/// A counter updated by a single thread and read by any thread.
+typedef std::atomic< unsigned long > counter;
+
+
+/// Increments a counter from the thread that owns it.
+///
+/// \param c The counter to increment.
+static void
+increment(counter& c)
+{
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+
+/// Reads a counter from any thread.
+///
+/// \param c The counter to read.
+///
+/// \return The value of the counter.
+static unsigned long
+load(const counter& c)
+{
+    return c.load(std::memory_order_relaxed);
+}
+#else
+/// A counter updated by a single thread and read by any thread.
+typedef volatile unsigned long counter;
+
+
+/// Increments a counter from the thread that owns it.
+///
+/// \param c The counter to increment.
+static void
+increment(counter& c)
+{
+    c = c + 1;
+}
+
+
+/// Reads a counter from any thread.
+///
+/// \param c The counter to read.
+///
+/// \return The value of the counter.
+static unsigned long
+load(const counter& c)
+{
+    return c;
+}
+#endif
+
+
+/// Counters of a function in a thread record.
+///
+/// The counters are only modified by the thread that owns the record.  To
+/// keep it that way, resetting the metrics does not clear the counters but
+/// records their values as a baseline to subtract from them.
+struct function_counters {
+    /// The counters, indexed by the *_counter constants.
+    counter values[ncounters];
+
+    /// Values of the counters at the last reset.
+    ///
+    /// Protected by the mutex of the record that holds these counters.
+    unsigned long baseline[ncounters];
+
+    /// Constructor.
+    function_counters(void)
+    {
+        for (std::size_t i = 0; i < ncounters; i++) {
+            values[i] = 0;
+            baseline[i] = 0;
+        }
+    }
+
+    /// Gets the number of events counted since the last reset.
+    ///
+    /// \param index The index of the counter.
+    ///
+    /// \return The value of the counter minus its baseline.
+    unsigned long
+    get(const std::size_t index) const
+    {
+        return load(values[index]) - baseline[index];
+    }
+};
+
+
+/// Collection of counters indexed by function.
+typedef std::map< lutok::cxx_function, function_counters* > counters_map;
+
+
+/// Counters of the calls made by a thread.
+struct thread_record {
+    /// Lock protecting the structure of the functions map, but not the values
+    /// of the counters.  Only taken by the owner thread to insert new
+    /// functions.
+    pthread_mutex_t mutex;
+
+    /// Counters of the functions called by the thread.
+    counters_map functions;
+
+    /// Constructor.
+    thread_record(void)
+    {
+        ::pthread_mutex_init(&mutex, NULL);
+    }
+
+    /// Destructor.
+    ~thread_record(void)
+    {
+        for (counters_map::iterator iter = functions.begin();
+             iter != functions.end(); ++iter)
+            delete (*iter).second;
+        ::pthread_mutex_destroy(&mutex);
+    }
+
+    /// Gets the counters of a function, creating them if needed.
+    ///
+    /// Must only be called by the thread that owns the record.
+    ///
+    /// \param function The function to look up.
+    ///
+    /// \return The counters of the function.
+    function_counters*
+    find(lutok::cxx_function function)
+    {
+        const counters_map::const_iterator iter = functions.find(function);
+        if (iter != functions.end())
+            return (*iter).second;
+
+        function_counters* counters = new function_counters();
+        ::pthread_mutex_lock(&mutex);
+        functions[function] = counters;
+        ::pthread_mutex_unlock(&mutex);
+        return counters;
+    }
+};
+
+
+/// Global state of the metrics, protected by registry_mutex.
+struct registry {
+    /// Records of the live threads that have made measured calls.
+    std::vector< thread_record* > records;
+
+    /// Totals accumulated by the threads that have exited, since the last
+    /// reset.
+    std::map< lutok::cxx_function, std::vector< unsigned long > > retired;
+
+    /// Names given to the functions.
+    std::map< lutok::cxx_function, std::string > names;
+};
+
+
+/// Lock protecting the registry.
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/// Guard to initialize the registry and the key of the thread records once.
+static pthread_once_t registry_once = PTHREAD_ONCE_INIT;
+
+
+/// Key to the record of the current thread.
+static pthread_key_t record_key;
+
+
+/// The global registry.  Never released.
+static registry* global_registry = NULL;
+
+
+/// Scoped holder of the registry lock.
+class registry_locker {
+    /// Disallow copies.
+    registry_locker(const registry_locker&);
+
+    /// Disallow assignment.
+    registry_locker& operator=(const registry_locker&);
+
+public:
+    /// Locks the registry.
+    registry_locker(void)
+    {
+        ::pthread_mutex_lock(&registry_mutex);
+    }
+
+    /// Unlocks the registry.
+    ~registry_locker(void)
+    {
+        ::pthread_mutex_unlock(&registry_mutex);
+    }
+};
+
+
+/// Folds the record of an exiting thread into the retired totals.
+///
+/// \param data The record of the thread.
+extern "C" void
+retire_record(void* data)
+{
+    thread_record* record = static_cast< thread_record* >(data);
+
+    {
+        registry_locker locker;
+        std::vector< thread_record* >& records = global_registry->records;
+        for (std::vector< thread_record* >::iterator iter = records.begin();
+             iter != records.end(); ++iter) {
+            if (*iter == record) {
+                records.erase(iter);
+                break;
+            }
+        }
+
+        for (counters_map::const_iterator iter = record->functions.begin();
+             iter != record->functions.end(); ++iter) {
+            std::vector< unsigned long >& totals =
+                global_registry->retired[(*iter).first];
+            totals.resize(ncounters, 0);
+            for (std::size_t i = 0; i < ncounters; i++)
+                totals[i] += (*iter).second->get(i);
+        }
+    }
+
+    delete record;
+}
+
+
+/// Initializes the registry and the key of the thread records.
+extern "C" void
+init_registry(void)
+{
+    global_registry = new registry();
+    ::pthread_key_create(&record_key, retire_record);
+}
+
+
+/// Gets the record of the current thread, creating it if needed.
+///
+/// \return The record of the current thread.
+static thread_record*
+current_record(void)
+{
+    ::pthread_once(&registry_once, init_registry);
+
+    thread_record* record = static_cast< thread_record* >(
+        ::pthread_getspecific(record_key));
+    if (record == NULL) {
+        record = new thread_record();
+        ::pthread_setspecific(record_key, record);
+
+        registry_locker locker;
+        global_registry->records.push_back(record);
+    }
+    return record;
+}
+
+
+/// Accounts for a finished call.
+///
+/// \param counters The counters of the called function.
+/// \param start The time at which the call started, in nanoseconds.
+static void
+record_call(function_counters* counters, const uint64_t start)
+{
+    uint64_t elapsed = lutok::detail::now_nanoseconds() - start;
+    std::size_t bucket = 0;
+    while (elapsed > 1 && bucket < lutok::call_stats::latency_buckets - 1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+
+    increment(counters->values[calls_counter]);
+    increment(counters->values[latency_counter + bucket]);
+}
+
+
+/// Gets the statistics of a function out of a results map.
+///
+/// \param results The results being collected.
+/// \param function The function to look up.
+///
+/// \return The statistics of the function, added with all counters zeroed if
+/// they were not yet in the results.
+static lutok::call_stats&
+find_stats(std::map< lutok::cxx_function, lutok::call_stats >& results,
+           lutok::cxx_function function)
+{
+    std::map< lutok::cxx_function, lutok::call_stats >::iterator iter =
+        results.find(function);
+    if (iter == results.end()) {
+        lutok::call_stats stats;
+        stats.function = function;
+        stats.calls = 0;
+        stats.exceptions = 0;
+        for (std::size_t i = 0; i < lutok::call_stats::latency_buckets; i++)
+            stats.latency[i] = 0;
+        iter = results.insert(std::make_pair(function, stats)).first;
+    }
+    return (*iter).second;
+}
+
+
+/// Adds counter values to the statistics of a function.
+///
+/// \param stats The statistics to update.
+/// \param get_counter Functor to get the value of the counter at an index.
+template< typename Getter >
+static void
+add_counters(lutok::call_stats& stats, const Getter& get_counter)
+{
+    stats.calls += get_counter(calls_counter);
+    stats.exceptions += get_counter(exceptions_counter);
+    for (std::size_t i = 0; i < lutok::call_stats::latency_buckets; i++)
+        stats.latency[i] += get_counter(latency_counter + i);
+}
+
+
+/// Functor to read the counters of a thread record.
+struct live_getter {
+    /// The counters to read.
+    const function_counters* counters;
+
+    /// Gets the value of a counter.
+    ///
+    /// \param index The index of the counter.
+    ///
+    /// \return The counted events since the last reset.
+    unsigned long
+    operator()(const std::size_t index) const
+    {
+        return counters->get(index);
+    }
+};
+
+
+/// Functor to read the retired totals of a function.
+struct retired_getter {
+    /// The totals to read.
+    const std::vector< unsigned long >* totals;
+
+    /// Gets the value of a counter.
+    ///
+    /// \param index The index of the counter.
+    ///
+    /// \return The counted events.
+    unsigned long
+    operator()(const std::size_t index) const
+    {
+        return (*totals)[index];
+    }
+};
+
+
+}  // anonymous namespace
+
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+std::atomic< bool > lutok::detail::call_metrics_active(false);
+#else
+volatile bool lutok::detail::call_metrics_active = false;
+#endif
+
+
+/// Calls a C++ function and measures the call.
+///
+/// This is used by the trampolines of the C++ functions while the call metrics
+/// are enabled.
+///
+/// \param function The function to call.
+/// \param s The Lua state to pass to the function.
+///
+/// \return The value returned by the function.
+///
+/// \throw Any exception thrown by the function.
+int
+lutok::detail::measure_call(cxx_function function, state& s)
+{
+    function_counters* counters = current_record()->find(function);
+    const uint64_t start = lutok::detail::now_nanoseconds();
+    try {
+        const int nresults = function(s);
+        record_call(counters, start);
+        return nresults;
+    } catch (...) {
+        increment(counters->values[exceptions_counter]);
+        record_call(counters, start);
+        throw;
+    }
+}
+
+
+/// Stops measuring the calls to C++ functions.
+///
+/// The collected metrics are kept.
+void
+lutok::disable_call_metrics(void)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    detail::call_metrics_active.store(false, std::memory_order_relaxed);
+#else
+    detail::call_metrics_active = false;
+#endif
+}
+
+
+/// Starts measuring the calls to C++ functions.
+///
+/// This affects all the states in the process.
+void
+lutok::enable_call_metrics(void)
+{
+    ::pthread_once(&registry_once, init_registry);
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    detail::call_metrics_active.store(true, std::memory_order_relaxed);
+#else
+    detail::call_metrics_active = true;
+#endif
+}
+
+
+/// Collects the metrics of all threads.
+///
+/// The counters of each thread are read while only holding the lock of that
+/// thread, so measured calls do not stop while the metrics are collected.  As
+/// a result, the metrics are not an atomic snapshot across threads.
+///
+/// \return The statistics of every measured function, sorted by the address of
+/// the function.
+std::vector< lutok::call_stats >
+lutok::get_call_metrics(void)
+{
+    ::pthread_once(&registry_once, init_registry);
+    std::map< cxx_function, call_stats > results;
+
+    registry_locker locker;
+    for (std::vector< thread_record* >::const_iterator iter =
+             global_registry->records.begin();
+         iter != global_registry->records.end(); ++iter) {
+        ::pthread_mutex_lock(&(*iter)->mutex);
+        for (counters_map::const_iterator iter2 = (*iter)->functions.begin();
+             iter2 != (*iter)->functions.end(); ++iter2) {
+            live_getter getter;
+            getter.counters = (*iter2).second;
+            add_counters(find_stats(results, (*iter2).first), getter);
+        }
+        ::pthread_mutex_unlock(&(*iter)->mutex);
+    }
+
+    for (std::map< cxx_function, std::vector< unsigned long > >::const_iterator
+             iter = global_registry->retired.begin();
+         iter != global_registry->retired.end(); ++iter) {
+        retired_getter getter;
+        getter.totals = &(*iter).second;
+        add_counters(find_stats(results, (*iter).first), getter);
+    }
+
+    std::vector< call_stats > stats;
+    for (std::map< cxx_function, call_stats >::iterator iter = results.begin();
+         iter != results.end(); ++iter) {
+        const std::map< cxx_function, std::string >::const_iterator name =
+            global_registry->names.find((*iter).first);
+        if (name != global_registry->names.end())
+            (*iter).second.name = (*name).second;
+        stats.push_back((*iter).second);
+    }
+    return stats;
+}
+
+
+/// Gives a name to a function in the call metrics.
+///
+/// create_module() names its members automatically while the call metrics are
+/// enabled.
+///
+/// \param function The function to name.
+/// \param name The name of the function, replacing any previous one.
+void
+lutok::name_call_metrics(cxx_function function, const std::string& name)
+{
+    ::pthread_once(&registry_once, init_registry);
+    registry_locker locker;
+    global_registry->names[function] = name;
+}
+
+
+/// Discards the collected metrics.
+///
+/// The names given to the functions are kept.  Calls in progress while the
+/// metrics are reset may be accounted for either before or after the reset.
+void
+lutok::reset_call_metrics(void)
+{
+    ::pthread_once(&registry_once, init_registry);
+
+    registry_locker locker;
+    for (std::vector< thread_record* >::const_iterator iter =
+             global_registry->records.begin();
+         iter != global_registry->records.end(); ++iter) {
+        ::pthread_mutex_lock(&(*iter)->mutex);
+        for (counters_map::iterator iter2 = (*iter)->functions.begin();
+             iter2 != (*iter)->functions.end(); ++iter2) {
+            function_counters* counters = (*iter2).second;
+            for (std::size_t i = 0; i < ncounters; i++)
+                counters->baseline[i] = load(counters->values[i]);
+        }
+        ::pthread_mutex_unlock(&(*iter)->mutex);
+    }
+    global_registry->retired.clear();
+}
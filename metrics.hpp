@@ -0,0 +1,121 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file metrics.hpp
+/// Provides opt-in instrumentation of the C++ functions called from Lua.
+///
+/// When enabled, every call from Lua into a C++ function pushed with
+/// state::push_cxx_function() or state::push_cxx_closure() is counted, along
+/// with the exceptions it throws and its latency.  The counters live in
+/// per-thread records so that calls do not contend on shared data, and reading
+/// them only locks one thread record at a time.  While disabled, the only cost
+/// left in the call path is the check of a global flag.
+
+#if !defined(LUTOK_METRICS_HPP)
+#define LUTOK_METRICS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+#include <lutok/state.hpp>
+
+namespace lutok {
+
+
+/// Statistics about the calls to a C++ function from Lua.
+struct call_stats {
+    /// Number of buckets of the latency histogram.
+    static const std::size_t latency_buckets = 32;
+
+    /// The measured function.
+    cxx_function function;
+
+    /// The name given to the function, or empty if it has none.
+    std::string name;
+
+    /// Number of calls to the function.
+    unsigned long calls;
+
+    /// Number of calls to the function that threw an exception.
+    unsigned long exceptions;
+
+    /// Histogram of the latencies of the calls.
+    ///
+    /// Bucket i counts the calls that took less than 2^(i+1) nanoseconds and,
+    /// except for the first bucket, at least 2^i nanoseconds.  The last bucket
+    /// also counts all slower calls.
+    unsigned long latency[latency_buckets];
+};
+
+
+void disable_call_metrics(void);
+void enable_call_metrics(void);
+std::vector< call_stats > get_call_metrics(void);
+void name_call_metrics(cxx_function, const std::string&);
+void reset_call_metrics(void);
+
+
+namespace detail {
+
+
+/// Whether the calls to C++ functions are being measured.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+extern std::atomic< bool > call_metrics_active;
+#else
+extern volatile bool call_metrics_active;
+#endif
+
+
+int measure_call(cxx_function, state&);
+
+
+/// Checks if the calls to C++ functions are being measured.
+///
+/// \return True if the call metrics are enabled.
+inline bool
+call_metrics_enabled(void)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    return call_metrics_active.load(std::memory_order_relaxed);
+#else
+    return call_metrics_active;
+#endif
+}
+
+
+}  // namespace detail
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_METRICS_HPP)
@@ -0,0 +1,249 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "metrics.hpp"
+
+extern "C" {
+#include <pthread.h>
+}
+
+#include <map>
+#include <stdexcept>
+
+#include <atf-c++.hpp>
+
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// C++ function that returns nothing.
+///
+/// \return The number of return values pushed onto the stack.
+static int
+c_noop(lutok::state& /* state */)
+{
+    return 0;
+}
+
+
+/// C++ function that always fails.
+///
+/// \return Nothing; it always throws.
+static int
+c_fail(lutok::state& /* state */)
+{
+    throw std::runtime_error("Failed on purpose");
+}
+
+
+/// Gets the statistics of a function.
+///
+/// \param function The function to look for.
+///
+/// \return The statistics of the function, or all zeros if it has none.
+static lutok::call_stats
+find_stats(lutok::cxx_function function)
+{
+    const std::vector< lutok::call_stats > stats = lutok::get_call_metrics();
+    for (std::vector< lutok::call_stats >::const_iterator iter =
+             stats.begin(); iter != stats.end(); ++iter) {
+        if ((*iter).function == function)
+            return *iter;
+    }
+
+    lutok::call_stats empty;
+    empty.function = function;
+    empty.calls = 0;
+    empty.exceptions = 0;
+    for (std::size_t i = 0; i < lutok::call_stats::latency_buckets; i++)
+        empty.latency[i] = 0;
+    return empty;
+}
+
+
+/// Adds up the buckets of the latency histogram of a function.
+///
+/// \param stats The statistics of the function.
+///
+/// \return The number of calls in the histogram.
+static unsigned long
+histogram_calls(const lutok::call_stats& stats)
+{
+    unsigned long total = 0;
+    for (std::size_t i = 0; i < lutok::call_stats::latency_buckets; i++)
+        total += stats.latency[i];
+    return total;
+}
+
+
+/// Thread that calls c_noop from its own state a few times.
+///
+/// \param unused_arg Unused.
+///
+/// \return Nothing.
+static void*
+call_noop(void* /* unused_arg */)
+{
+    lutok::state state;
+    state.push_cxx_function(c_noop);
+    state.set_global("noop");
+    lutok::do_string(state, "for i = 1, 7 do noop() end", 0, 0, 0);
+    return NULL;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(disabled);
+ATF_TEST_CASE_BODY(disabled)
+{
+    lutok::state state;
+    state.push_cxx_function(c_noop);
+    state.set_global("noop");
+    lutok::do_string(state, "noop(); noop()", 0, 0, 0);
+    ATF_REQUIRE(lutok::get_call_metrics().empty());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(calls_and_exceptions);
+ATF_TEST_CASE_BODY(calls_and_exceptions)
+{
+    lutok::enable_call_metrics();
+
+    lutok::state state;
+    state.open_base();
+    state.push_cxx_function(c_noop);
+    state.set_global("noop");
+    state.push_cxx_function(c_fail);
+    state.set_global("fail");
+    lutok::do_string(state, "for i = 1, 10 do noop() end", 0, 0, 0);
+    lutok::do_string(state, "for i = 1, 3 do pcall(fail) end", 0, 0, 0);
+
+    const lutok::call_stats noop = find_stats(c_noop);
+    ATF_REQUIRE_EQ(10, noop.calls);
+    ATF_REQUIRE_EQ(0, noop.exceptions);
+    ATF_REQUIRE_EQ(10, histogram_calls(noop));
+    ATF_REQUIRE(noop.name.empty());
+
+    const lutok::call_stats fail = find_stats(c_fail);
+    ATF_REQUIRE_EQ(3, fail.calls);
+    ATF_REQUIRE_EQ(3, fail.exceptions);
+    ATF_REQUIRE_EQ(3, histogram_calls(fail));
+
+    lutok::disable_call_metrics();
+    lutok::do_string(state, "noop()", 0, 0, 0);
+    ATF_REQUIRE_EQ(10, find_stats(c_noop).calls);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(closures);
+ATF_TEST_CASE_BODY(closures)
+{
+    lutok::enable_call_metrics();
+
+    lutok::state state;
+    state.push_integer(5);
+    state.push_cxx_closure(c_noop, 1);
+    state.set_global("noop");
+    lutok::do_string(state, "noop(); noop()", 0, 0, 0);
+    ATF_REQUIRE_EQ(2, find_stats(c_noop).calls);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(create_module__names);
+ATF_TEST_CASE_BODY(create_module__names)
+{
+    lutok::enable_call_metrics();
+
+    lutok::state state;
+    std::map< std::string, lutok::cxx_function > members;
+    members["noop"] = c_noop;
+    lutok::create_module(state, "mymodule", members);
+    lutok::do_string(state, "mymodule.noop()", 0, 0, 0);
+
+    const lutok::call_stats noop = find_stats(c_noop);
+    ATF_REQUIRE_EQ(1, noop.calls);
+    ATF_REQUIRE_EQ("mymodule.noop", noop.name);
+
+    lutok::name_call_metrics(c_noop, "renamed");
+    ATF_REQUIRE_EQ("renamed", find_stats(c_noop).name);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reset);
+ATF_TEST_CASE_BODY(reset)
+{
+    lutok::enable_call_metrics();
+
+    lutok::state state;
+    state.push_cxx_function(c_noop);
+    state.set_global("noop");
+    lutok::do_string(state, "noop(); noop()", 0, 0, 0);
+    ATF_REQUIRE_EQ(2, find_stats(c_noop).calls);
+
+    lutok::reset_call_metrics();
+    const lutok::call_stats cleared = find_stats(c_noop);
+    ATF_REQUIRE_EQ(0, cleared.calls);
+    ATF_REQUIRE_EQ(0, histogram_calls(cleared));
+
+    lutok::do_string(state, "noop()", 0, 0, 0);
+    ATF_REQUIRE_EQ(1, find_stats(c_noop).calls);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(threads);
+ATF_TEST_CASE_BODY(threads)
+{
+    lutok::enable_call_metrics();
+
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+        ATF_REQUIRE(::pthread_create(&threads[i], NULL, call_noop, NULL) == 0);
+    for (int i = 0; i < 4; i++)
+        ATF_REQUIRE(::pthread_join(threads[i], NULL) == 0);
+
+    const lutok::call_stats noop = find_stats(c_noop);
+    ATF_REQUIRE_EQ(28, noop.calls);
+    ATF_REQUIRE_EQ(28, histogram_calls(noop));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, disabled);
+    ATF_ADD_TEST_CASE(tcs, calls_and_exceptions);
+    ATF_ADD_TEST_CASE(tcs, closures);
+    ATF_ADD_TEST_CASE(tcs, create_module__names);
+    ATF_ADD_TEST_CASE(tcs, reset);
+    ATF_ADD_TEST_CASE(tcs, threads);
+}
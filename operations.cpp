@@ -27,15 +27,125 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cassert>
+#include <sstream>
 
 #include <lua.hpp>
 
+#include "c_gate.hpp"
+#include "chunk_cache.hpp"
 #include "exceptions.hpp"
+#include "internal.hpp"
+#include "metrics.hpp"
 #include "operations.hpp"
 #include "stack_cleaner.hpp"
 #include "state.hpp"
 
 
+namespace {
+
+
+/// Maximum number of characters of a Lua string to include in error messages.
+static const std::string::size_type max_quoted_chunk = 64;
+
+
+/// Calls a chunk that has just been loaded.
+///
+/// \param s The Lua state.
+/// \param nargs The number of arguments on the stack to pass to the chunk.
+///     These are located below the chunk.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler, as seen before the chunk was loaded.
+///
+/// \throw api_error If the chunk fails.
+static void
+call_loaded_chunk(lutok::state& s, const int nargs, const int nresults,
+                  const int errfunc)
+{
+    if (nargs > 0)
+        s.insert(-nargs - 1);
+    s.pcall(nargs, nresults == -1 ? LUA_MULTRET : nresults,
+            errfunc == 0 ? 0 : errfunc - 1);
+}
+
+
+/// Computes the number of results left on the stack by a chunk.
+///
+/// \param s The Lua state.
+/// \param height The height of the stack before the chunk and its arguments
+///     were pushed.
+/// \param nresults The number of results that were expected; -1 for any.
+///
+/// \return The number of results left on the stack.
+static unsigned int
+count_results(lutok::state& s, const int height, const int nresults)
+{
+    const int actual_results = s.get_top() - height;
+    assert(nresults == -1 || actual_results == nresults);
+    assert(actual_results >= 0);
+    return static_cast< unsigned int >(actual_results);
+}
+
+
+/// Runs a chunk that has just been loaded, without throwing.
+///
+/// \param raw_state The Lua state.
+/// \param load_status The status returned by the function that loaded the
+///     chunk.  On success, stack(-1) contains the chunk; on failure, it
+///     contains the error object.
+/// \param nargs The number of arguments on the stack to pass to the chunk.
+///     These are located below the chunk or the error object.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler, as seen before the chunk was loaded.
+///
+/// \return The status of the chunk.  On failure, the arguments are removed and
+/// the error object is left on the top of the stack.
+static lutok::status
+try_call_loaded_chunk(lua_State* raw_state, const int load_status,
+                      const int nargs, const int nresults, const int errfunc)
+{
+    if (nargs > 0)
+        lua_insert(raw_state, -nargs - 1);
+    if (load_status != 0) {
+        lua_pop(raw_state, nargs);
+        return lutok::status(load_status);
+    }
+    return lutok::status(lua_pcall(
+        raw_state, nargs, nresults == -1 ? LUA_MULTRET : nresults,
+        errfunc == 0 ? 0 : errfunc - 1));
+}
+
+
+}  // anonymous namespace
+
+
+/// Runs bounded garbage collection while a state is idle.
+///
+/// This is meant to be called between requests, such as right after a state
+/// is returned to a state_pool, to move collection work out of the code paths
+/// that are sensitive to latency.  The collector runs in basic incremental
+/// steps until it completes a cycle or the time limit expires.  Steps are not
+/// interruptible, so the limit can be exceeded by the length of one step.
+///
+/// \param s The Lua state.
+/// \param time_limit Maximum time to spend collecting, in microseconds.  At
+///     least one step is always run.
+///
+/// \return True if a collection cycle was completed.
+bool
+lutok::collect_idle(state& s, const unsigned long time_limit)
+{
+    const double deadline = detail::now_nanoseconds() / 1000.0 +
+        time_limit;
+    do {
+        if (s.gc_step(0))
+            return true;
+    } while (detail::now_nanoseconds() / 1000.0 < deadline);
+    return false;
+}
+
+
 /// Creates a module: i.e. a table with a set of methods in it.
 ///
 /// \param s The Lua state.
@@ -46,12 +156,45 @@ lutok::create_module(state& s, const std::string& name,
                      const std::map< std::string, cxx_function >& members)
 {
     stack_cleaner cleaner(s);
-    s.new_table();
+    s.new_table(0, static_cast< int >(members.size()));
     for (std::map< std::string, cxx_function >::const_iterator
          iter = members.begin(); iter != members.end(); iter++) {
         s.push_string((*iter).first);
         s.push_cxx_function((*iter).second);
-        s.set_table(-3);
+        s.raw_set(-3);
+        if (detail::call_metrics_enabled())
+            name_call_metrics((*iter).second, name + "." + (*iter).first);
+    }
+    s.set_global(name);
+}
+
+
+/// Creates a module from a static table of functions.
+///
+/// This is cheaper than the variant that takes a map: the module table is
+/// presized for all the members and the functions refer to the entries of the
+/// table instead of holding copies of their addresses in separate userdata.
+///
+/// \param s The Lua state.
+/// \param name The name of the module to create.
+/// \param members The member functions to add to the module.  The array must
+///     outlive the state, which usually means that it must have static storage
+///     duration.
+/// \param nmembers The number of entries in members.
+void
+lutok::create_module(state& s, const std::string& name,
+                     const module_function* members,
+                     const std::size_t nmembers)
+{
+    stack_cleaner cleaner(s);
+    s.new_table(0, static_cast< int >(nmembers));
+    for (std::size_t i = 0; i < nmembers; i++) {
+        s.push_string(members[i].name);
+        s.push_static_cxx_function(&members[i].function);
+        s.raw_set(-3);
+        if (detail::call_metrics_enabled())
+            name_call_metrics(members[i].function,
+                              name + "." + members[i].name);
     }
     s.set_global(name);
 }
@@ -81,19 +224,49 @@ lutok::do_file(state& s, const std::string& file, const int nargs,
 
     try {
         s.load_file(file);
-        if (nargs > 0)
-            s.insert(-nargs - 1);
-        s.pcall(nargs, nresults == -1 ? LUA_MULTRET : nresults,
-                errfunc == 0 ? 0 : errfunc - 1);
+        call_loaded_chunk(s, nargs, nresults, errfunc);
     } catch (const lutok::api_error& e) {
         throw lutok::error("Failed to load Lua file '" + file + "': " +
                            e.what());
     }
 
-    const int actual_results = s.get_top() - height;
-    assert(nresults == -1 || actual_results == nresults);
-    assert(actual_results >= 0);
-    return static_cast< unsigned int >(actual_results);
+    return count_results(s, height, nresults);
+}
+
+
+/// Loads and processes a Lua file through a cache of compiled chunks.
+///
+/// This is equivalent to the do_file variant that does not take a cache, but
+/// the file is only compiled if the cache does not hold an up-to-date copy of
+/// it.
+///
+/// \param s The Lua state.
+/// \param cache The cache of compiled chunks.
+/// \param file The file to load.
+/// \param nargs The number of arguments on the stack to pass to the file.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler.
+///
+/// \return The number of results left on the stack.
+///
+/// \throw error If there is a problem processing the file.
+unsigned int
+lutok::do_file(state& s, chunk_cache& cache, const std::string& file,
+               const int nargs, const int nresults, const int errfunc)
+{
+    assert(nresults >= -1);
+    const int height = s.get_top() - nargs;
+
+    try {
+        cache.load_file(s, file);
+        call_loaded_chunk(s, nargs, nresults, errfunc);
+    } catch (const lutok::api_error& e) {
+        throw lutok::error("Failed to load Lua file '" + file + "': " +
+                           e.what());
+    }
+
+    return count_results(s, height, nresults);
 }
 
 
@@ -121,19 +294,48 @@ lutok::do_string(state& s, const std::string& str, const int nargs,
 
     try {
         s.load_string(str);
-        if (nargs > 0)
-            s.insert(-nargs - 1);
-        s.pcall(nargs, nresults == -1 ? LUA_MULTRET : nresults,
-                errfunc == 0 ? 0 : errfunc - 1);
+        call_loaded_chunk(s, nargs, nresults, errfunc);
     } catch (const lutok::api_error& e) {
-        throw lutok::error("Failed to process Lua string '" + str + "': " +
-                           e.what());
+        throw lutok::error("Failed to process Lua string '" +
+                           detail::quote_chunk(str) + "': " + e.what());
     }
 
-    const int actual_results = s.get_top() - height;
-    assert(nresults == -1 || actual_results == nresults);
-    assert(actual_results >= 0);
-    return static_cast< unsigned int >(actual_results);
+    return count_results(s, height, nresults);
+}
+
+
+/// Processes a Lua script through a cache of compiled chunks.
+///
+/// This is equivalent to the do_string variant that does not take a cache,
+/// but the string is only compiled if the cache does not hold a copy of it.
+///
+/// \param s The Lua state.
+/// \param cache The cache of compiled chunks.
+/// \param str The string to process.
+/// \param nargs The number of arguments on the stack to pass to the chunk.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler.
+///
+/// \return The number of results left on the stack.
+///
+/// \throw error If there is a problem processing the string.
+unsigned int
+lutok::do_string(state& s, chunk_cache& cache, const std::string& str,
+                 const int nargs, const int nresults, const int errfunc)
+{
+    assert(nresults >= -1);
+    const int height = s.get_top() - nargs;
+
+    try {
+        cache.load_string(s, str);
+        call_loaded_chunk(s, nargs, nresults, errfunc);
+    } catch (const lutok::api_error& e) {
+        throw lutok::error("Failed to process Lua string '" +
+                           detail::quote_chunk(str) + "': " + e.what());
+    }
+
+    return count_results(s, height, nresults);
 }
 
 
@@ -151,3 +353,81 @@ lutok::eval(state& s, const std::string& expression, const int nresults)
     assert(nresults > 0);
     do_string(s, "return " + expression, 0, nresults, 0);
 }
+
+
+/// Processes a Lua file without throwing.
+///
+/// This is equivalent to do_file but errors are reported through the returned
+/// status instead of exceptions, which avoids the cost of building messages
+/// and unwinding the stack when failures are expected.
+///
+/// \param s The Lua state.
+/// \param file The file to load.
+/// \param nargs The number of arguments on the stack to pass to the file.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler.
+///
+/// \return The status of the file.  On success, the results are left on the
+/// stack.  On failure, the arguments are removed and the error object is left
+/// on the top of the stack.
+lutok::status
+lutok::try_do_file(state& s, const std::string& file, const int nargs,
+                   const int nresults, const int errfunc)
+{
+    assert(nresults >= -1);
+    lua_State* raw_state = state_c_gate(s).c_state();
+    return try_call_loaded_chunk(raw_state,
+                                 luaL_loadfile(raw_state, file.c_str()),
+                                 nargs, nresults, errfunc);
+}
+
+
+/// Processes a Lua script without throwing.
+///
+/// This is equivalent to do_string but errors are reported through the
+/// returned status instead of exceptions, which avoids the cost of building
+/// messages and unwinding the stack when failures are expected.
+///
+/// \param s The Lua state.
+/// \param str The string to process.
+/// \param nargs The number of arguments on the stack to pass to the chunk.
+/// \param nresults The number of results to expect; -1 for any.
+/// \param errfunc If not 0, index of a function in the stack to act as an
+///     error handler.
+///
+/// \return The status of the chunk.  On success, the results are left on the
+/// stack.  On failure, the arguments are removed and the error object is left
+/// on the top of the stack.
+lutok::status
+lutok::try_do_string(state& s, const std::string& str, const int nargs,
+                     const int nresults, const int errfunc)
+{
+    assert(nresults >= -1);
+    lua_State* raw_state = state_c_gate(s).c_state();
+    return try_call_loaded_chunk(raw_state,
+                                 luaL_loadstring(raw_state, str.c_str()),
+                                 nargs, nresults, errfunc);
+}
+
+
+/// Abbreviates a Lua string to be included in an error message.
+///
+/// Scripts can be arbitrarily long, so error messages only include their
+/// beginning to avoid copying the whole source into every exception.
+///
+/// \param str The Lua string.
+///
+/// \return The string itself if it is short, or its first characters followed
+/// by its total length otherwise.
+std::string
+lutok::detail::quote_chunk(const std::string& str)
+{
+    if (str.length() <= max_quoted_chunk)
+        return str;
+
+    std::ostringstream quoted;
+    quoted << str.substr(0, max_quoted_chunk) << "... (" << str.length()
+           << " bytes)";
+    return quoted.str();
+}
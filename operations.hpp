@@ -32,6 +32,7 @@
 #if !defined(LUTOK_OPERATIONS_HPP)
 #define LUTOK_OPERATIONS_HPP
 
+#include <cstddef>
 #include <map>
 #include <string>
 #include <vector>
@@ -41,13 +42,70 @@
 namespace lutok {
 
 
+class chunk_cache;
+
+
+/// An entry of a static table of functions to register in a module.
+///
+/// This is an aggregate so that tables of entries can be defined as constant
+/// arrays with static storage duration, as in:
+///
+/// static const module_function members[] = {
+///     { "add", cxx_add },
+///     { "multiply", cxx_multiply },
+/// };
+/// create_module(state, "math2", members);
+struct module_function {
+    /// The name of the function within the module.
+    const char* name;
+
+    /// The function to register.
+    cxx_function function;
+};
+
+
+bool collect_idle(state&, const unsigned long);
 void create_module(state&, const std::string&,
                    const std::map< std::string, cxx_function >&);
+void create_module(state&, const std::string&, const module_function*,
+                   const std::size_t);
 unsigned int do_file(state&, const std::string&, const int, const int,
                      const int);
+unsigned int do_file(state&, chunk_cache&, const std::string&, const int,
+                     const int, const int);
 unsigned int do_string(state&, const std::string&, const int, const int,
                        const int);
+unsigned int do_string(state&, chunk_cache&, const std::string&, const int,
+                       const int, const int);
 void eval(state&, const std::string&, const int);
+status try_do_file(state&, const std::string&, const int, const int,
+                   const int);
+status try_do_string(state&, const std::string&, const int, const int,
+                     const int);
+
+
+namespace detail {
+
+
+std::string quote_chunk(const std::string&);
+
+
+}  // namespace detail
+
+
+/// Creates a module from an array of functions with static storage duration.
+///
+/// \param s The Lua state.
+/// \param name The name of the module to create.
+/// \param members The member functions to add to the module.  The array must
+///     outlive the state.
+template< std::size_t Length >
+void
+create_module(state& s, const std::string& name,
+              const module_function (&members)[Length])
+{
+    create_module(s, name, members, Length);
+}
 
 
 }  // namespace lutok
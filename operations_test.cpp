@@ -32,6 +32,7 @@
 
 #include <atf-c++.hpp>
 
+#include "chunk_cache.hpp"
 #include "exceptions.hpp"
 #include "state.ipp"
 #include "test_utils.hpp"
@@ -77,6 +78,39 @@ hook_multiply(lutok::state& state)
 }  // anonymous namespace
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(collect_idle__completes);
+ATF_TEST_CASE_BODY(collect_idle__completes)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    lutok::do_string(state, "garbage = {} for i = 1, 10000 do "
+                     "garbage[i] = {} end", 0, 0, 0);
+    const unsigned int before = state.gc_count();
+    lutok::do_string(state, "garbage = nil", 0, 0, 0);
+    // The first cycle may have started while the garbage was still reachable.
+    int completed = 0;
+    for (int i = 0; completed < 2 && i < 1000; i++) {
+        if (lutok::collect_idle(state, 100000))
+            completed++;
+    }
+    ATF_REQUIRE_EQ(2, completed);
+    ATF_REQUIRE(state.gc_count() < before);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(collect_idle__no_time);
+ATF_TEST_CASE_BODY(collect_idle__no_time)
+{
+    lutok::state state;
+    lutok::do_string(state, "garbage = {} for i = 1, 10000 do "
+                     "garbage[i] = {} end garbage = nil", 0, 0, 0);
+    int calls = 0;
+    while (!lutok::collect_idle(state, 0))
+        calls++;
+    ATF_REQUIRE(calls > 0);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(create_module__empty);
 ATF_TEST_CASE_BODY(create_module__empty)
 {
@@ -125,6 +159,39 @@ ATF_TEST_CASE_BODY(create_module__many)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(create_module__static);
+ATF_TEST_CASE_BODY(create_module__static)
+{
+    static const lutok::module_function members[] = {
+        { "add", hook_add },
+        { "multiply", hook_multiply },
+    };
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    lutok::create_module(state, "my_math", members);
+
+    lutok::do_string(state, "return my_math.add(10, 20)", 0, 1, 0);
+    ATF_REQUIRE_EQ(30, state.to_integer(-1));
+    lutok::do_string(state, "return my_math.multiply(10, 20)", 0, 1, 0);
+    ATF_REQUIRE_EQ(200, state.to_integer(-1));
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(create_module__static_empty);
+ATF_TEST_CASE_BODY(create_module__static_empty)
+{
+    lutok::state state;
+    lutok::create_module(state, "my_math", NULL, 0);
+
+    state.open_base();
+    lutok::do_string(state, "return next(my_math) == nil", 0, 1, 0);
+    ATF_REQUIRE(state.to_boolean(-1));
+    state.pop(1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(do_file__some_args);
 ATF_TEST_CASE_BODY(do_file__some_args)
 {
@@ -234,6 +301,42 @@ ATF_TEST_CASE_BODY(do_file__error_with_errfunc)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(do_file__cache);
+ATF_TEST_CASE_BODY(do_file__cache)
+{
+    std::ofstream output("test.lua");
+    output << "local a1 = ...\nreturn a1 * 2\n";
+    output.close();
+
+    lutok::chunk_cache cache;
+    lutok::state state;
+    for (int i = 1; i <= 3; i++) {
+        state.push_integer(i);
+        ATF_REQUIRE_EQ(1, lutok::do_file(state, cache, "test.lua", 1, 1, 0));
+        ATF_REQUIRE_EQ(1, state.get_top());
+        ATF_REQUIRE_EQ(i * 2, state.to_integer(-1));
+        state.pop(1);
+    }
+    ATF_REQUIRE_EQ(2, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(do_file__cache_error);
+ATF_TEST_CASE_BODY(do_file__cache_error)
+{
+    std::ofstream output("test.lua");
+    output << "a b c\n";
+    output.close();
+
+    lutok::chunk_cache cache;
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Failed to load Lua file 'test.lua'",
+                         lutok::do_file(state, cache, "test.lua", 0, 0, 0));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(do_string__some_args);
 ATF_TEST_CASE_BODY(do_string__some_args)
 {
@@ -296,6 +399,23 @@ ATF_TEST_CASE_BODY(do_string__error)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(do_string__error_long_chunk);
+ATF_TEST_CASE_BODY(do_string__error_long_chunk)
+{
+    const std::string chunk = "a b c " + std::string(1000, 'x');
+    lutok::state state;
+    try {
+        lutok::do_string(state, chunk, 0, 0, 0);
+        ATF_FAIL("error not raised");
+    } catch (const lutok::error& e) {
+        const std::string message = e.what();
+        ATF_REQUIRE_MATCH("Failed to process Lua string 'a b c x+\\.\\.\\. "
+                          "\\(1006 bytes\\)'", message);
+        ATF_REQUIRE(message.find(chunk) == std::string::npos);
+    }
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(do_string__error_with_errfunc);
 ATF_TEST_CASE_BODY(do_string__error_with_errfunc)
 {
@@ -311,6 +431,24 @@ ATF_TEST_CASE_BODY(do_string__error_with_errfunc)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(do_string__cache);
+ATF_TEST_CASE_BODY(do_string__cache)
+{
+    lutok::chunk_cache cache;
+    lutok::state state;
+    for (int i = 1; i <= 3; i++) {
+        state.push_integer(i);
+        ATF_REQUIRE_EQ(1, lutok::do_string(state, cache, "return ... + 1",
+                                           1, 1, 0));
+        ATF_REQUIRE_EQ(1, state.get_top());
+        ATF_REQUIRE_EQ(i + 1, state.to_integer(-1));
+        state.pop(1);
+    }
+    ATF_REQUIRE_EQ(2, cache.hits());
+    ATF_REQUIRE_EQ(1, cache.misses());
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(eval__one_result);
 ATF_TEST_CASE_BODY(eval__one_result)
 {
@@ -345,11 +483,91 @@ ATF_TEST_CASE_BODY(eval__error)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(try_do_file__ok);
+ATF_TEST_CASE_BODY(try_do_file__ok)
+{
+    std::ofstream output("test.lua");
+    output << "return ... + 1\n";
+    output.close();
+
+    lutok::state state;
+    state.push_integer(9);
+    const lutok::status status = lutok::try_do_file(state, "test.lua", 1, 1,
+                                                    0);
+    ATF_REQUIRE(status.ok());
+    ATF_REQUIRE_EQ(1, state.get_top());
+    ATF_REQUIRE_EQ(10, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_do_file__not_found);
+ATF_TEST_CASE_BODY(try_do_file__not_found)
+{
+    lutok::state state;
+    state.push_integer(9);
+    const lutok::status status = lutok::try_do_file(state, "missing.lua", 1,
+                                                    0, 0);
+    ATF_REQUIRE(!status.ok());
+    ATF_REQUIRE_EQ(1, state.get_top());
+    ATF_REQUIRE_MATCH("missing.lua", status.message(state));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_do_string__ok);
+ATF_TEST_CASE_BODY(try_do_string__ok)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    const lutok::status status = lutok::try_do_string(state, "return 1, 2",
+                                                      0, -1, 0);
+    ATF_REQUIRE(status.ok());
+    ATF_REQUIRE_EQ(2, state.get_top());
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_do_string__syntax_error);
+ATF_TEST_CASE_BODY(try_do_string__syntax_error)
+{
+    lutok::state state;
+    state.push_integer(1);
+    state.push_integer(2);
+    const lutok::status status = lutok::try_do_string(state, "a b c", 2, 0,
+                                                      0);
+    ATF_REQUIRE(!status.ok());
+    ATF_REQUIRE_EQ(LUA_ERRSYNTAX, status.code());
+    ATF_REQUIRE_EQ(1, state.get_top());
+    ATF_REQUIRE(!status.message(state).empty());
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_do_string__runtime_error);
+ATF_TEST_CASE_BODY(try_do_string__runtime_error)
+{
+    lutok::state state;
+    state.push_integer(5);
+    const lutok::status status = lutok::try_do_string(
+        state, "error('Bad value ' .. ...)", 1, 0, 0);
+    ATF_REQUIRE(!status.ok());
+    ATF_REQUIRE_EQ(LUA_ERRRUN, status.code());
+    ATF_REQUIRE_EQ(1, state.get_top());
+    ATF_REQUIRE_MATCH("Bad value 5", status.message(state));
+    state.pop(1);
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
+    ATF_ADD_TEST_CASE(tcs, collect_idle__completes);
+    ATF_ADD_TEST_CASE(tcs, collect_idle__no_time);
     ATF_ADD_TEST_CASE(tcs, create_module__empty);
     ATF_ADD_TEST_CASE(tcs, create_module__one);
     ATF_ADD_TEST_CASE(tcs, create_module__many);
+    ATF_ADD_TEST_CASE(tcs, create_module__static);
+    ATF_ADD_TEST_CASE(tcs, create_module__static_empty);
 
     ATF_ADD_TEST_CASE(tcs, do_file__some_args);
     ATF_ADD_TEST_CASE(tcs, do_file__any_results);
@@ -358,15 +576,25 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, do_file__not_found);
     ATF_ADD_TEST_CASE(tcs, do_file__error);
     ATF_ADD_TEST_CASE(tcs, do_file__error_with_errfunc);
+    ATF_ADD_TEST_CASE(tcs, do_file__cache);
+    ATF_ADD_TEST_CASE(tcs, do_file__cache_error);
 
     ATF_ADD_TEST_CASE(tcs, do_string__some_args);
     ATF_ADD_TEST_CASE(tcs, do_string__any_results);
     ATF_ADD_TEST_CASE(tcs, do_string__no_results);
     ATF_ADD_TEST_CASE(tcs, do_string__many_results);
     ATF_ADD_TEST_CASE(tcs, do_string__error);
+    ATF_ADD_TEST_CASE(tcs, do_string__error_long_chunk);
     ATF_ADD_TEST_CASE(tcs, do_string__error_with_errfunc);
+    ATF_ADD_TEST_CASE(tcs, do_string__cache);
 
     ATF_ADD_TEST_CASE(tcs, eval__one_result);
     ATF_ADD_TEST_CASE(tcs, eval__many_results);
     ATF_ADD_TEST_CASE(tcs, eval__error);
+
+    ATF_ADD_TEST_CASE(tcs, try_do_file__ok);
+    ATF_ADD_TEST_CASE(tcs, try_do_file__not_found);
+    ATF_ADD_TEST_CASE(tcs, try_do_string__ok);
+    ATF_ADD_TEST_CASE(tcs, try_do_string__syntax_error);
+    ATF_ADD_TEST_CASE(tcs, try_do_string__runtime_error);
 }
@@ -0,0 +1,234 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pairs.hpp"
+
+#include <cassert>
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "state.ipp"
+
+
+/// Constructs a view of an entry.
+///
+/// \param raw_state The Lua C API state.
+/// \param key_index Absolute stack index of the key of the entry.
+lutok::pairs_entry::pairs_entry(lua_State* raw_state, const int key_index) :
+    _raw_state(raw_state),
+    _key_index(key_index)
+{
+}
+
+
+/// Gets the stack index of the key of the entry.
+///
+/// \return An absolute stack index.
+int
+lutok::pairs_entry::key_index(void) const
+{
+    return _key_index;
+}
+
+
+/// Gets the key of the entry as a string without copying it.
+///
+/// Keys that are numbers are not converted, as doing so would break the
+/// iteration.
+///
+/// \return A reference to the key, valid while the entry is current.
+///
+/// \throw error If the key is not a string.
+lutok::string_ref
+lutok::pairs_entry::key_string(void) const
+{
+    if (lua_type(_raw_state, _key_index) != LUA_TSTRING)
+        throw lutok::error("Table key is not a string");
+    std::size_t length;
+    const char* data = lua_tolstring(_raw_state, _key_index, &length);
+    return string_ref(data, length);
+}
+
+
+/// Gets the stack index of the value of the entry.
+///
+/// \return An absolute stack index.
+int
+lutok::pairs_entry::value_index(void) const
+{
+    return _key_index + 1;
+}
+
+
+/// Gets the value of the entry as a string without copying it.
+///
+/// Values that are numbers are converted to strings in place.
+///
+/// \return A reference to the value, valid while the entry is current.
+///
+/// \throw error If the value is not a string or a number.
+lutok::string_ref
+lutok::pairs_entry::value_string(void) const
+{
+    std::size_t length;
+    const char* data = lua_tolstring(_raw_state, value_index(), &length);
+    if (data == NULL)
+        throw lutok::error("Table value is not a string");
+    return string_ref(data, length);
+}
+
+
+/// Constructs an iterator.
+///
+/// \param range The range being iterated over, or NULL for the end iterator.
+lutok::pairs_iterator::pairs_iterator(pairs_range* range) :
+    _range(range)
+{
+}
+
+
+/// Gets the current entry.
+///
+/// \return A view of the current entry.
+lutok::pairs_entry
+lutok::pairs_iterator::operator*(void) const
+{
+    assert(_range != NULL);
+    return pairs_entry(_range->_raw_state, _range->_top + 1);
+}
+
+
+/// Advances the iterator to the next entry.
+///
+/// \return A reference to this iterator.
+lutok::pairs_iterator&
+lutok::pairs_iterator::operator++(void)
+{
+    assert(_range != NULL);
+    if (!_range->advance())
+        _range = NULL;
+    return *this;
+}
+
+
+/// Checks if two iterators are equal.
+///
+/// \param other The iterator to compare to.
+///
+/// \return True if both iterators point to the same range, or if both are at
+/// the end of the iteration.
+bool
+lutok::pairs_iterator::operator==(const pairs_iterator& other) const
+{
+    return _range == other._range;
+}
+
+
+/// Checks if two iterators are different.
+///
+/// \param other The iterator to compare to.
+///
+/// \return The negation of operator==.
+bool
+lutok::pairs_iterator::operator!=(const pairs_iterator& other) const
+{
+    return !(*this == other);
+}
+
+
+/// Constructs a range over the entries of a table.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the table.
+///
+/// \throw error If the value at the given index is not a table.
+lutok::pairs_range::pairs_range(state& s, const int index) :
+    _raw_state(state_c_gate(s).c_state()),
+    _table_index(index),
+    _top(lua_gettop(_raw_state)),
+    _active(false)
+{
+    if (index < 0 && index > LUA_REGISTRYINDEX)
+        _table_index = _top + index + 1;
+    if (!lua_istable(_raw_state, _table_index))
+        throw lutok::error("Cannot iterate over a value that is not a table");
+}
+
+
+/// Destroys the range, releasing the values of an unfinished iteration.
+lutok::pairs_range::~pairs_range(void)
+{
+    if (_active)
+        lua_settop(_raw_state, _top);
+}
+
+
+/// Moves the iteration to the next entry of the table.
+///
+/// \return True if there is a new current entry; false if the iteration is
+/// complete.
+bool
+lutok::pairs_range::advance(void)
+{
+    assert(_active);
+    lua_settop(_raw_state, _top + 1);
+    if (lua_next(_raw_state, _table_index) == 0) {
+        _active = false;
+        return false;
+    }
+    return true;
+}
+
+
+/// Starts the iteration over the table.
+///
+/// \return An iterator positioned on the first entry of the table, or the end
+/// iterator if the table is empty.
+lutok::pairs_iterator
+lutok::pairs_range::begin(void)
+{
+    lua_settop(_raw_state, _top);
+    lua_pushnil(_raw_state);
+    _active = true;
+    if (!advance())
+        return end();
+    return pairs_iterator(this);
+}
+
+
+/// Gets the end iterator.
+///
+/// \return An iterator that compares equal to any iterator whose iteration is
+/// complete.
+lutok::pairs_iterator
+lutok::pairs_range::end(void)
+{
+    return pairs_iterator(NULL);
+}
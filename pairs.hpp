@@ -0,0 +1,136 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file pairs.hpp
+/// Provides iteration over the entries of Lua tables.
+
+#if !defined(LUTOK_PAIRS_HPP)
+#define LUTOK_PAIRS_HPP
+
+#include <lutok/state.hpp>
+
+namespace lutok {
+
+
+class pairs_iterator;
+class pairs_range;
+
+
+/// View of the current entry of a table iteration.
+///
+/// The key and the value of the entry live on the Lua stack while the
+/// iteration is positioned on the entry, so this object is only valid until
+/// the iterator that returned it is advanced.
+class pairs_entry {
+    /// The Lua C API state.
+    lua_State* _raw_state;
+
+    /// Absolute stack index of the key; the value follows it.
+    int _key_index;
+
+    friend class pairs_iterator;
+    pairs_entry(lua_State*, const int);
+
+public:
+    int key_index(void) const;
+    string_ref key_string(void) const;
+    int value_index(void) const;
+    string_ref value_string(void) const;
+};
+
+
+/// Single-pass iterator over the entries of a table.
+///
+/// All iterators of a range share the position of the range, which is held in
+/// the Lua stack.  Advancing one of them advances all of them.
+class pairs_iterator {
+    /// The range being iterated over, or NULL if the iteration is complete.
+    pairs_range* _range;
+
+    friend class pairs_range;
+    explicit pairs_iterator(pairs_range*);
+
+public:
+    pairs_entry operator*(void) const;
+    pairs_iterator& operator++(void);
+    bool operator==(const pairs_iterator&) const;
+    bool operator!=(const pairs_iterator&) const;
+};
+
+
+/// Range over the entries of a table, in the order provided by lua_next.
+///
+/// The iteration uses raw accesses, so the __pairs metamethod is not honored.
+/// Because the key of the current entry is never modified, walking the table
+/// cannot raise Lua errors and thus does not require any protected calls.
+///
+/// Objects of this class are returned by state::pairs() and are intended to be
+/// used in range-based loops:
+///
+/// for (lutok::pairs_entry entry : state.pairs(-1)) {
+///     const lutok::string_ref key = entry.key_string();
+///     ... do stuff with entry.value_index() ...
+/// }
+///
+/// The iteration keeps the key and the value of the current entry on top of
+/// the stack.  Anything pushed while processing an entry is discarded when
+/// advancing to the next one, and leaving the loop early, even because of an
+/// exception, restores the stack to its original depth once the range goes
+/// out of scope.  The table must not be modified during the iteration, except
+/// for assigning to existing fields.
+///
+/// Starting an iteration with begin() resets the stack to the depth it had
+/// when the range was created.
+class pairs_range {
+    /// The Lua C API state.
+    lua_State* _raw_state;
+
+    /// Absolute stack index of the table.
+    int _table_index;
+
+    /// Depth of the stack when the range was created.
+    int _top;
+
+    /// Whether an iteration is in progress and owns values on the stack.
+    bool _active;
+
+    friend class pairs_iterator;
+    bool advance(void);
+
+public:
+    pairs_range(state&, const int);
+    ~pairs_range(void);
+
+    pairs_iterator begin(void);
+    pairs_iterator end(void);
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_PAIRS_HPP)
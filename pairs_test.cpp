@@ -0,0 +1,190 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "pairs.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(iterate__all);
+ATF_TEST_CASE_BODY(iterate__all)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {first=1, second=2, third=3}", 0, 1, 0);
+    state.push_integer(5);
+
+    std::map< std::string, int > entries;
+    lutok::pairs_range range = state.pairs(-2);
+    for (lutok::pairs_iterator iter = range.begin(); iter != range.end();
+         ++iter) {
+        const lutok::pairs_entry entry = *iter;
+        entries[entry.key_string().str()] = state.to_integer(
+            entry.value_index());
+    }
+    ATF_REQUIRE_EQ(3, entries.size());
+    ATF_REQUIRE_EQ(1, entries["first"]);
+    ATF_REQUIRE_EQ(2, entries["second"]);
+    ATF_REQUIRE_EQ(3, entries["third"]);
+    ATF_REQUIRE_EQ(5, state.to_integer(-1));
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(iterate__empty);
+ATF_TEST_CASE_BODY(iterate__empty)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.new_table();
+    {
+        lutok::pairs_range range = state.pairs(-1);
+        ATF_REQUIRE(range.begin() == range.end());
+        ATF_REQUIRE_EQ(1, state.get_top());
+    }
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(iterate__early_exit);
+ATF_TEST_CASE_BODY(iterate__early_exit)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {1, 2, 3, 4}", 0, 1, 0);
+    {
+        lutok::pairs_range range = state.pairs(-1);
+        int count = 0;
+        for (lutok::pairs_iterator iter = range.begin(); iter != range.end();
+             ++iter) {
+            state.push_integer(100);
+            if (++count == 2)
+                break;
+        }
+        ATF_REQUIRE_EQ(2, count);
+    }
+    ATF_REQUIRE_EQ(1, state.get_top());
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(iterate__exception);
+ATF_TEST_CASE_BODY(iterate__exception)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {1, 2, 3, 4}", 0, 1, 0);
+    try {
+        lutok::pairs_range range = state.pairs(-1);
+        for (lutok::pairs_iterator iter = range.begin(); iter != range.end();
+             ++iter)
+            throw std::runtime_error("abort");
+        ATF_FAIL("Exception not raised");
+    } catch (const std::runtime_error& e) {
+        ATF_REQUIRE_EQ(std::string("abort"), e.what());
+    }
+    ATF_REQUIRE_EQ(1, state.get_top());
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(entry__values);
+ATF_TEST_CASE_BODY(entry__values)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {[10]=42}", 0, 1, 0);
+    lutok::pairs_range range = state.pairs(-1);
+    lutok::pairs_iterator iter = range.begin();
+    ATF_REQUIRE(iter != range.end());
+    const lutok::pairs_entry entry = *iter;
+    ATF_REQUIRE_EQ(10, state.to_integer(entry.key_index()));
+    ATF_REQUIRE_THROW_RE(lutok::error, "key is not a string",
+                         entry.key_string());
+    ATF_REQUIRE_EQ("42", entry.value_string().str());
+    ++iter;
+    ATF_REQUIRE(iter == range.end());
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(entry__bad_value);
+ATF_TEST_CASE_BODY(entry__bad_value)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {a={}}", 0, 1, 0);
+    {
+        lutok::pairs_range range = state.pairs(-1);
+        const lutok::pairs_entry entry = *range.begin();
+        ATF_REQUIRE_EQ("a", entry.key_string().str());
+        ATF_REQUIRE_THROW_RE(lutok::error, "value is not a string",
+                             entry.value_string());
+    }
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(not_a_table);
+ATF_TEST_CASE_BODY(not_a_table)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.push_integer(3);
+    ATF_REQUIRE_THROW_RE(lutok::error, "not a table", state.pairs(-1));
+    state.pop(1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, iterate__all);
+    ATF_ADD_TEST_CASE(tcs, iterate__empty);
+    ATF_ADD_TEST_CASE(tcs, iterate__early_exit);
+    ATF_ADD_TEST_CASE(tcs, iterate__exception);
+    ATF_ADD_TEST_CASE(tcs, entry__values);
+    ATF_ADD_TEST_CASE(tcs, entry__bad_value);
+    ATF_ADD_TEST_CASE(tcs, not_a_table);
+}
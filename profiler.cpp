@@ -0,0 +1,392 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "profiler.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Object whose address identifies the profiler of a state in its registry.
+static const char registry_key = 0;
+
+
+/// Initial number of slots of the table of interned sources.
+static const std::size_t initial_source_slots = 64;
+
+
+/// Gets the registry key of the profilers as a light userdata.
+///
+/// \return The key.
+static void*
+profiler_key(void)
+{
+    return const_cast< char* >(&registry_key);
+}
+
+
+/// Computes the hash of a string.
+///
+/// \param str The string to hash.
+///
+/// \return The FNV-1a hash of the string.
+static unsigned long
+hash_string(const char* str)
+{
+    unsigned long hash = 2166136261UL;
+    for (; *str != '\0'; ++str) {
+        hash ^= static_cast< unsigned char >(*str);
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+
+/// A frame of a sampled stack.
+struct frame {
+    /// Identifier of the interned source of the function.
+    int source;
+
+    /// Line on which the function is defined, or -1 if unknown.
+    int line;
+};
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::profiler.
+struct lutok::profiler::impl {
+    /// The Lua state to which the profiler is attached.
+    lua_State* lua_state;
+
+    /// Maximum number of samples held in the buffer.
+    std::size_t capacity;
+
+    /// Maximum number of frames recorded per sample.
+    unsigned int max_depth;
+
+    /// Frames of the samples; sample i occupies max_depth entries starting at
+    /// i * max_depth, the innermost frame first.
+    std::vector< frame > frames;
+
+    /// Number of frames recorded for each sample.
+    std::vector< unsigned int > depths;
+
+    /// Number of samples taken since the last clear.
+    unsigned long taken;
+
+    /// Interned sources, indexed by their identifier.
+    std::vector< std::string > sources;
+
+    /// Hash table of the interned sources; each slot holds the identifier of
+    /// a source plus one, or 0 if empty.
+    std::vector< int > source_slots;
+
+    /// Whether the profiler is sampling.
+    bool running;
+
+    /// Constructor.
+    ///
+    /// \param lua_state_ The Lua state.
+    /// \param capacity_ Maximum number of samples held in the buffer.
+    /// \param max_depth_ Maximum number of frames recorded per sample.
+    impl(lua_State* lua_state_, const std::size_t capacity_,
+         const unsigned int max_depth_) :
+        lua_state(lua_state_),
+        capacity(capacity_),
+        max_depth(max_depth_),
+        frames(capacity_ * max_depth_),
+        depths(capacity_),
+        taken(0),
+        source_slots(initial_source_slots, 0),
+        running(false)
+    {
+    }
+
+    /// Gets the profiler attached to a state.
+    ///
+    /// \param raw_state The Lua state or any of its threads.
+    ///
+    /// \return The profiler, or NULL if the state does not have any.
+    static impl*
+    find(lua_State* raw_state)
+    {
+        lua_pushlightuserdata(raw_state, profiler_key());
+        lua_rawget(raw_state, LUA_REGISTRYINDEX);
+        impl* profiler = static_cast< impl* >(lua_touserdata(raw_state, -1));
+        lua_pop(raw_state, 1);
+        return profiler;
+    }
+
+    /// Inserts an interned source into the hash table.
+    ///
+    /// \param id The identifier of the source, which must already be stored in
+    ///     the sources vector.
+    void
+    insert_slot(const int id)
+    {
+        const std::size_t mask = source_slots.size() - 1;
+        std::size_t slot = hash_string(sources[id].c_str()) & mask;
+        while (source_slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        source_slots[slot] = id + 1;
+    }
+
+    /// Gets the identifier of a source, interning it if not yet known.
+    ///
+    /// Memory is only allocated the first time a source is seen.
+    ///
+    /// \param source The source to look up.
+    ///
+    /// \return The identifier of the source.
+    int
+    intern(const char* source)
+    {
+        const std::size_t mask = source_slots.size() - 1;
+        std::size_t slot = hash_string(source) & mask;
+        while (source_slots[slot] != 0) {
+            const int id = source_slots[slot] - 1;
+            if (std::strcmp(sources[id].c_str(), source) == 0)
+                return id;
+            slot = (slot + 1) & mask;
+        }
+
+        const int id = static_cast< int >(sources.size());
+        sources.push_back(source);
+        if (sources.size() * 2 > source_slots.size()) {
+            source_slots.assign(source_slots.size() * 2, 0);
+            for (int i = 0; i < static_cast< int >(sources.size()); ++i)
+                insert_slot(i);
+        } else {
+            source_slots[slot] = id + 1;
+        }
+        return id;
+    }
+
+    /// Records the current stack of a thread as a new sample.
+    ///
+    /// \param raw_state The thread to sample.
+    void
+    sample(lua_State* raw_state)
+    {
+        const std::size_t index = taken % capacity;
+        frame* sample_frames = &frames[index * max_depth];
+
+        unsigned int depth = 0;
+        lua_Debug ar;
+        while (depth < max_depth && lua_getstack(raw_state, depth, &ar)) {
+            lua_getinfo(raw_state, "S", &ar);
+            sample_frames[depth].source = intern(ar.short_src);
+            sample_frames[depth].line = ar.linedefined;
+            ++depth;
+        }
+        depths[index] = depth;
+        ++taken;
+    }
+
+    /// Count hook to take samples.
+    ///
+    /// \param raw_state The Lua state running the hook.
+    /// \param unused_debug Information about the running function.
+    static void
+    hook(lua_State* raw_state, lua_Debug* /* unused_debug */)
+    {
+        impl* profiler = find(raw_state);
+        if (profiler != NULL && profiler->running)
+            profiler->sample(raw_state);
+    }
+
+    /// Formats the label of a frame.
+    ///
+    /// Semicolons in the source are replaced by colons because they separate
+    /// the frames of the folded stacks.
+    ///
+    /// \param f The frame to format.
+    ///
+    /// \return The label of the frame.
+    std::string
+    label(const frame& f) const
+    {
+        std::ostringstream str;
+        str << sources[f.source];
+        if (f.line >= 0)
+            str << ':' << f.line;
+
+        std::string text = str.str();
+        for (std::string::size_type pos = text.find(';');
+             pos != std::string::npos; pos = text.find(';', pos))
+            text[pos] = ':';
+        return text;
+    }
+};
+
+
+/// Attaches a stopped profiler to a state.
+///
+/// \param s The Lua state.
+/// \param capacity Maximum number of samples to hold.  Must be positive.
+/// \param max_depth Maximum number of frames to record per sample; deeper
+///     frames are ignored.  Must be positive.
+///
+/// \throw error If the state already has a profiler.
+lutok::profiler::profiler(state& s, const std::size_t capacity,
+                          const unsigned int max_depth) :
+    _pimpl(new impl(state_c_gate(s).c_state(), capacity, max_depth))
+{
+    assert(capacity > 0);
+    assert(max_depth > 0);
+
+    if (impl::find(_pimpl->lua_state) != NULL)
+        throw lutok::error("The state already has a profiler");
+
+    lua_pushlightuserdata(_pimpl->lua_state, profiler_key());
+    lua_pushlightuserdata(_pimpl->lua_state, _pimpl.get());
+    lua_rawset(_pimpl->lua_state, LUA_REGISTRYINDEX);
+}
+
+
+/// Stops the profiler and detaches it from the state.
+lutok::profiler::~profiler(void)
+{
+    stop();
+
+    lua_pushlightuserdata(_pimpl->lua_state, profiler_key());
+    lua_pushnil(_pimpl->lua_state);
+    lua_rawset(_pimpl->lua_state, LUA_REGISTRYINDEX);
+}
+
+
+/// Discards all the collected samples.
+void
+lutok::profiler::clear(void)
+{
+    _pimpl->taken = 0;
+}
+
+
+/// Gets the number of samples lost because the buffer was full.
+///
+/// \return The number of samples overwritten since the last clear.
+unsigned long
+lutok::profiler::overwritten(void) const
+{
+    if (_pimpl->taken <= _pimpl->capacity)
+        return 0;
+    return _pimpl->taken - _pimpl->capacity;
+}
+
+
+/// Gets the number of samples held in the buffer.
+///
+/// \return The number of samples, which never exceeds the capacity.
+std::size_t
+lutok::profiler::samples(void) const
+{
+    if (_pimpl->taken < _pimpl->capacity)
+        return static_cast< std::size_t >(_pimpl->taken);
+    return _pimpl->capacity;
+}
+
+
+/// Starts taking samples.
+///
+/// \param interval Number of instructions between samples.  Must be positive.
+///
+/// \throw error If the state has a debug hook installed by someone else.
+void
+lutok::profiler::start(const unsigned int interval)
+{
+    assert(interval > 0);
+
+    const lua_Hook current = lua_gethook(_pimpl->lua_state);
+    if (current != NULL && current != impl::hook)
+        throw lutok::error("The state already has a debug hook");
+
+    lua_sethook(_pimpl->lua_state, impl::hook, LUA_MASKCOUNT,
+                static_cast< int >(interval));
+    _pimpl->running = true;
+}
+
+
+/// Stops taking samples.
+///
+/// The collected samples are kept until the profiler is cleared.
+void
+lutok::profiler::stop(void)
+{
+    if (!_pimpl->running)
+        return;
+    if (lua_gethook(_pimpl->lua_state) == impl::hook)
+        lua_sethook(_pimpl->lua_state, NULL, 0, 0);
+    _pimpl->running = false;
+}
+
+
+/// Writes the collected samples in the folded-stack format.
+///
+/// \param output The stream into which to write the stacks, sorted
+///     alphabetically.
+void
+lutok::profiler::write_folded(std::ostream& output) const
+{
+    std::map< std::string, unsigned long > stacks;
+
+    const std::size_t count = samples();
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::size_t index =
+            (_pimpl->taken - count + i) % _pimpl->capacity;
+        const frame* sample_frames = &_pimpl->frames[index * _pimpl->max_depth];
+
+        std::string stack;
+        for (unsigned int depth = _pimpl->depths[index]; depth > 0; --depth) {
+            if (!stack.empty())
+                stack += ';';
+            stack += _pimpl->label(sample_frames[depth - 1]);
+        }
+        if (!stack.empty())
+            ++stacks[stack];
+    }
+
+    for (std::map< std::string, unsigned long >::const_iterator iter =
+             stacks.begin(); iter != stacks.end(); ++iter)
+        output << (*iter).first << ' ' << (*iter).second << '\n';
+}
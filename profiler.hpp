@@ -0,0 +1,102 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file profiler.hpp
+/// Provides a sampling profiler for Lua code.
+
+#if !defined(LUTOK_PROFILER_HPP)
+#define LUTOK_PROFILER_HPP
+
+#include <cstddef>
+#include <ostream>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class state;
+
+
+/// Sampling profiler for the Lua code run by a state.
+///
+/// While running, the profiler captures the Lua call stack every given number
+/// of instructions from a count hook.  Each frame is recorded as an interned
+/// source identifier and the line on which its function is defined, so that
+/// samples are stored in a ring buffer preallocated at construction time and
+/// taking a sample does not allocate memory.  Sources are only copied the
+/// first time they are seen.  When the buffer is full, new samples overwrite
+/// the oldest ones.
+///
+/// The collected samples can be exported in the folded-stack format consumed
+/// by flame graph tools: one line per distinct stack, with its frames listed
+/// from the outermost to the innermost separated by semicolons and followed by
+/// the number of samples that hit the stack.  Frames are labeled as
+/// "source:line", where line is the one on which the function is defined.
+///
+/// The profiler uses the debug hook of the state, so it cannot run while any
+/// other hook, such as the one of a budget, is installed.  Coroutines inherit
+/// the hook of the thread that creates them, so only coroutines created while
+/// the profiler runs are sampled.  The profiler must be destroyed before the
+/// state is closed.
+class profiler {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    /// Disallow copies.
+    profiler(const profiler&);
+
+    /// Disallow assignment.
+    profiler& operator=(const profiler&);
+
+public:
+    profiler(state&, const std::size_t, const unsigned int);
+    ~profiler(void);
+
+    void clear(void);
+    unsigned long overwritten(void) const;
+    std::size_t samples(void) const;
+    void start(const unsigned int);
+    void stop(void);
+    void write_folded(std::ostream&) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_PROFILER_HPP)
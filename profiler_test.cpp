@@ -0,0 +1,194 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "profiler.hpp"
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "budget.hpp"
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Lua code with two nested functions that burn instructions.
+static const char* const nested_code =
+    "local function inner()\n"
+    "    local x = 0\n"
+    "    for i = 1, 100000 do x = x + i end\n"
+    "    return x\n"
+    "end\n"
+    "local function outer()\n"
+    "    local x = inner()\n"
+    "    return x\n"
+    "end\n"
+    "for i = 1, 10 do outer() end\n";
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(stopped);
+ATF_TEST_CASE_BODY(stopped)
+{
+    lutok::state state;
+    lutok::profiler profiler(state, 100, 10);
+    ATF_REQUIRE(lua_gethook(raw(state)) == NULL);
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    ATF_REQUIRE_EQ(0, profiler.samples());
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+    ATF_REQUIRE_EQ("", output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(start_stop);
+ATF_TEST_CASE_BODY(start_stop)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::profiler profiler(state, 1000, 10);
+    profiler.start(1000);
+    ATF_REQUIRE(lua_gethook(raw(state)) != NULL);
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    profiler.stop();
+    ATF_REQUIRE(lua_gethook(raw(state)) == NULL);
+
+    const std::size_t samples = profiler.samples();
+    ATF_REQUIRE(samples > 0);
+    ATF_REQUIRE_EQ(0, profiler.overwritten());
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    ATF_REQUIRE_EQ(samples, profiler.samples());
+
+    profiler.clear();
+    ATF_REQUIRE_EQ(0, profiler.samples());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(overwritten);
+ATF_TEST_CASE_BODY(overwritten)
+{
+    lutok::state state;
+    lutok::profiler profiler(state, 5, 10);
+    profiler.start(100);
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    profiler.stop();
+    ATF_REQUIRE_EQ(5, profiler.samples());
+    ATF_REQUIRE(profiler.overwritten() > 0);
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+    std::istringstream input(output.str());
+    unsigned long total = 0;
+    std::string line;
+    while (std::getline(input, line))
+        total += std::atol(line.substr(line.rfind(' ') + 1).c_str());
+    ATF_REQUIRE_EQ(5, total);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(write_folded);
+ATF_TEST_CASE_BODY(write_folded)
+{
+    lutok::state state;
+    lutok::profiler profiler(state, 1000, 10);
+    profiler.start(1000);
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    profiler.stop();
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+    ATF_REQUIRE_MATCH(":0;.*:6;.*:1 [0-9]+", output.str());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(max_depth);
+ATF_TEST_CASE_BODY(max_depth)
+{
+    lutok::state state;
+    lutok::profiler profiler(state, 1000, 1);
+    profiler.start(1000);
+    lutok::do_string(state, nested_code, 0, 0, 0);
+    profiler.stop();
+
+    std::ostringstream output;
+    profiler.write_folded(output);
+    ATF_REQUIRE(!output.str().empty());
+    ATF_REQUIRE(output.str().find(';') == std::string::npos);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(one_per_state);
+ATF_TEST_CASE_BODY(one_per_state)
+{
+    lutok::state state;
+    {
+        lutok::profiler profiler(state, 10, 10);
+        ATF_REQUIRE_THROW_RE(lutok::error, "already has a profiler",
+                             lutok::profiler(state, 10, 10));
+    }
+    lutok::profiler profiler(state, 10, 10);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(other_hook);
+ATF_TEST_CASE_BODY(other_hook)
+{
+    lutok::state state;
+    lutok::budget budget(state);
+    budget.set_instruction_limit(1000000);
+
+    lutok::profiler profiler(state, 10, 10);
+    ATF_REQUIRE_THROW_RE(lutok::error, "already has a debug hook",
+                         profiler.start(100));
+    profiler.stop();
+    ATF_REQUIRE(lua_gethook(raw(state)) != NULL);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, stopped);
+    ATF_ADD_TEST_CASE(tcs, start_stop);
+    ATF_ADD_TEST_CASE(tcs, overwritten);
+    ATF_ADD_TEST_CASE(tcs, write_folded);
+    ATF_ADD_TEST_CASE(tcs, max_depth);
+    ATF_ADD_TEST_CASE(tcs, one_per_state);
+    ATF_ADD_TEST_CASE(tcs, other_hook);
+}
@@ -0,0 +1,267 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "ref.hpp"
+
+#include <cassert>
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Gets the main thread of a Lua state.
+///
+/// Registry references are shared by all the threads of a state, but the
+/// threads other than the main one can be garbage collected.  Holding onto the
+/// main thread guarantees that the reference can be released later.
+///
+/// \param raw_state The Lua state or one of its threads.
+///
+/// \return The main thread of the state if it can be determined; raw_state
+/// otherwise.
+static lua_State*
+main_thread(lua_State* raw_state)
+{
+#if LUA_VERSION_NUM >= 502
+    lua_rawgeti(raw_state, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+    lua_State* thread = lua_tothread(raw_state, -1);
+    lua_pop(raw_state, 1);
+    return thread;
+#else
+    return raw_state;
+#endif
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::ref_group.
+struct lutok::ref_group::impl {
+    /// The Lua state that holds the reference to the table.
+    lua_State* lua_state;
+
+    /// The reference to the table of values in the registry; LUA_NOREF once
+    /// the group has been released.
+    int table_reference;
+
+    /// Creates the table of values and pins it in the registry.
+    ///
+    /// \param lua_state_ The Lua state.
+    impl(lua_State* lua_state_) :
+        lua_state(main_thread(lua_state_)),
+        table_reference(LUA_NOREF)
+    {
+        lua_newtable(lua_state_);
+        table_reference = luaL_ref(lua_state_, LUA_REGISTRYINDEX);
+    }
+
+    /// Releases the table of values if not yet done.
+    ~impl(void)
+    {
+        release();
+    }
+
+    /// Drops the table of values and, with it, all the values it holds.
+    void
+    release(void)
+    {
+        if (table_reference != LUA_NOREF) {
+            luaL_unref(lua_state, LUA_REGISTRYINDEX, table_reference);
+            table_reference = LUA_NOREF;
+        }
+    }
+};
+
+
+/// Internal implementation for lutok::ref.
+struct lutok::ref::impl {
+    /// The Lua state that holds the reference.
+    lua_State* lua_state;
+
+    /// The group the reference belongs to; NULL for references held directly
+    /// by the registry.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< ref_group::impl > group;
+#else
+    std::tr1::shared_ptr< ref_group::impl > group;
+#endif
+
+    /// The reference to the value in the registry or in the group table.
+    int reference;
+
+    /// Pins the value on the top of the stack in the registry.
+    ///
+    /// \param lua_state_ The Lua state.  The value on the top of its stack is
+    ///     popped.
+    impl(lua_State* lua_state_) :
+        lua_state(main_thread(lua_state_)),
+        reference(luaL_ref(lua_state_, LUA_REGISTRYINDEX))
+    {
+    }
+
+    /// Pins the value on the top of the stack in the table of a group.
+    ///
+    /// \param lua_state_ The Lua state.  The value on the top of its stack is
+    ///     popped.
+    /// \param group_ The group that holds the value.  Must not be released.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    impl(lua_State* lua_state_,
+         const std::shared_ptr< ref_group::impl >& group_) :
+#else
+    impl(lua_State* lua_state_,
+         const std::tr1::shared_ptr< ref_group::impl >& group_) :
+#endif
+        lua_state(group_->lua_state),
+        group(group_),
+        reference(LUA_NOREF)
+    {
+        assert(group->table_reference != LUA_NOREF);
+        lua_rawgeti(lua_state_, LUA_REGISTRYINDEX, group->table_reference);
+        lua_insert(lua_state_, -2);
+        reference = luaL_ref(lua_state_, -2);
+        lua_pop(lua_state_, 1);
+    }
+
+    /// Releases the reference unless its group is gone already.
+    ~impl(void)
+    {
+        if (!group) {
+            luaL_unref(lua_state, LUA_REGISTRYINDEX, reference);
+        } else if (group->table_reference != LUA_NOREF) {
+            lua_rawgeti(lua_state, LUA_REGISTRYINDEX, group->table_reference);
+            luaL_unref(lua_state, -1, reference);
+            lua_pop(lua_state, 1);
+        }
+    }
+};
+
+
+/// Creates a new, empty group of references.
+///
+/// \param s The Lua state.
+///
+/// \warning Terminates execution if there is not enough memory.
+lutok::ref_group::ref_group(state& s) :
+    _pimpl(new impl(state_c_gate(s).c_state()))
+{
+}
+
+
+/// Destructor.
+///
+/// The values are released once the last member of the group goes away.
+lutok::ref_group::~ref_group(void)
+{
+}
+
+
+/// Releases all the values held by the group at once.
+///
+/// Any member of the group becomes unusable and can be destroyed at any time,
+/// even after the Lua state has been closed.  New members cannot be added to
+/// the group anymore.
+///
+/// This must be called before the Lua state is closed if any member or copy of
+/// the group is to outlive it.
+void
+lutok::ref_group::release(void)
+{
+    _pimpl->release();
+}
+
+
+/// Checks if the group has been released.
+///
+/// \return True if release() has been called on the group or any of its
+/// copies.
+bool
+lutok::ref_group::released(void) const
+{
+    return _pimpl->table_reference == LUA_NOREF;
+}
+
+
+/// Creates a reference to a value on the stack.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the value.  The value is not removed from
+///     the stack.
+///
+/// \warning Terminates execution if there is not enough memory.
+lutok::ref::ref(state& s, const int index)
+{
+    s.push_value(index);
+    _pimpl.reset(new impl(state_c_gate(s).c_state()));
+}
+
+
+/// Creates a reference to a value on the stack as part of a group.
+///
+/// \param s The Lua state.
+/// \param group The group to add the reference to.  Must not be released.
+/// \param index The stack index of the value.  The value is not removed from
+///     the stack.
+///
+/// \warning Terminates execution if there is not enough memory.
+lutok::ref::ref(state& s, ref_group& group, const int index)
+{
+    s.push_value(index);
+    _pimpl.reset(new impl(state_c_gate(s).c_state(), group._pimpl));
+}
+
+
+/// Destructor.
+lutok::ref::~ref(void)
+{
+}
+
+
+/// Pushes the referenced value onto the stack.
+///
+/// \param s The Lua state.  This must be the state in which the reference was
+///     created or one of its threads.
+void
+lutok::ref::push(state& s) const
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    if (!_pimpl->group) {
+        lua_rawgeti(raw_state, LUA_REGISTRYINDEX, _pimpl->reference);
+    } else {
+        assert(_pimpl->group->table_reference != LUA_NOREF);
+        lua_rawgeti(raw_state, LUA_REGISTRYINDEX,
+                    _pimpl->group->table_reference);
+        lua_rawgeti(raw_state, -1, _pimpl->reference);
+        lua_remove(raw_state, -2);
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file ref.hpp
+/// Provides handles to Lua values pinned in the registry.
+
+#if !defined(LUTOK_REF_HPP)
+#define LUTOK_REF_HPP
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class ref;
+class state;
+
+
+/// Collection of references that can be released all at once.
+///
+/// The values referenced by the members of a group are held by a single table
+/// in the registry.  Releasing the group drops that table, and with it all of
+/// the values, in one operation; the members become inert and their
+/// destruction does not touch the Lua state anymore.  This is the fast path to
+/// tear down a state that holds many references: release their group and then
+/// close the state, destroying the references whenever convenient.
+///
+/// Copies of a group object share the same table, which is released when
+/// release() is called or when the last copy of the group and of its members
+/// is destroyed, whichever happens first.
+class ref_group {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    friend class ref;
+
+public:
+    explicit ref_group(state&);
+    ~ref_group(void);
+
+    void release(void);
+    bool released(void) const;
+};
+
+
+/// Handle to a Lua value pinned in the registry.
+///
+/// A reference keeps a value alive and allows pushing it back onto the stack
+/// at the cost of a single table lookup, which is much cheaper than accessing
+/// the value by name through get_global.  This is useful to hold onto
+/// callbacks, tables and other objects across calls into Lua.
+///
+/// Copies of a reference share the same registry entry, which is released when
+/// the last copy is destroyed.  Unless the reference belongs to a group that
+/// has already been released, all copies must be destroyed before the Lua
+/// state they belong to is closed.
+class ref {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+public:
+    ref(state&, const int);
+    ref(state&, ref_group&, const int);
+    ~ref(void);
+
+#if __cplusplus >= 201103L
+    ref(const ref&) = default;
+    ref(ref&&) = default;
+    ref& operator=(const ref&) = default;
+    ref& operator=(ref&&) = default;
+#endif
+
+    void push(state&) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_REF_HPP)
@@ -0,0 +1,270 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "ref.hpp"
+
+#include <string>
+#if __cplusplus >= 201103L
+#include <utility>
+#endif
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Creates a weakly-referenced table to track the lifetime of values.
+///
+/// The table is left on the top of the stack.
+///
+/// \param state The Lua state.
+static void
+push_weak_table(lutok::state& state)
+{
+    lua_newtable(raw(state));
+    lua_pushvalue(raw(state), -1);
+    lua_setglobal(raw(state), "weak");
+    state.open_base();
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "setmetatable(weak, {__mode='v'})") == 0);
+}
+
+
+/// Checks whether a value tracked by the weak table is still alive.
+///
+/// \param state The Lua state.  The weak table must be on the top of the
+///     stack.
+/// \param name The name of the entry in the weak table.
+///
+/// \return True if the value has not been garbage collected.
+static bool
+is_alive(lutok::state& state, const char* name)
+{
+    lua_gc(raw(state), LUA_GCCOLLECT, 0);
+    lua_getfield(raw(state), -1, name);
+    const bool alive = !lua_isnil(raw(state), -1);
+    lua_pop(raw(state), 1);
+    return alive;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push);
+ATF_TEST_CASE_BODY(push)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lua_pushinteger(raw(state), 123);
+    const lutok::ref ref(state, -1);
+    lua_pushinteger(raw(state), 456);
+    lua_replace(raw(state), -2);
+
+    ref.push(state);
+    ATF_REQUIRE_EQ(123, lua_tointeger(raw(state), -1));
+    ATF_REQUIRE_EQ(456, lua_tointeger(raw(state), -2));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy);
+ATF_TEST_CASE_BODY(copy)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    push_weak_table(state);
+    {
+        lua_newtable(raw(state));
+        lua_pushvalue(raw(state), -1);
+        lua_setfield(raw(state), -3, "entry");
+        lutok::ref* ref1 = new lutok::ref(state, -1);
+        lua_pop(raw(state), 1);
+
+        const lutok::ref ref2 = *ref1;
+        delete ref1;
+        ATF_REQUIRE(is_alive(state, "entry"));
+
+        ref2.push(state);
+        ATF_REQUIRE(lua_istable(raw(state), -1));
+        lua_pop(raw(state), 1);
+    }
+    ATF_REQUIRE(!is_alive(state, "entry"));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(release);
+ATF_TEST_CASE_BODY(release)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    push_weak_table(state);
+    {
+        lua_newtable(raw(state));
+        lua_pushvalue(raw(state), -1);
+        lua_setfield(raw(state), -3, "entry");
+        const lutok::ref ref(state, -1);
+        lua_pop(raw(state), 1);
+        ATF_REQUIRE(is_alive(state, "entry"));
+    }
+    ATF_REQUIRE(!is_alive(state, "entry"));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(group__push);
+ATF_TEST_CASE_BODY(group__push)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::ref_group group(state);
+    ATF_REQUIRE(!group.released());
+
+    lua_pushstring(raw(state), "first");
+    const lutok::ref ref1(state, group, -1);
+    lua_pushstring(raw(state), "second");
+    const lutok::ref ref2(state, group, -1);
+    lua_pop(raw(state), 2);
+
+    ref2.push(state);
+    ref1.push(state);
+    ATF_REQUIRE_EQ(std::string("first"), lua_tostring(raw(state), -1));
+    ATF_REQUIRE_EQ(std::string("second"), lua_tostring(raw(state), -2));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(group__member_release);
+ATF_TEST_CASE_BODY(group__member_release)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::ref_group group(state);
+    push_weak_table(state);
+    {
+        lua_newtable(raw(state));
+        lua_pushvalue(raw(state), -1);
+        lua_setfield(raw(state), -3, "entry");
+        const lutok::ref ref(state, group, -1);
+        lua_pop(raw(state), 1);
+        ATF_REQUIRE(is_alive(state, "entry"));
+    }
+    ATF_REQUIRE(!is_alive(state, "entry"));
+    ATF_REQUIRE(!group.released());
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(group__release);
+ATF_TEST_CASE_BODY(group__release)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::ref_group group(state);
+    push_weak_table(state);
+    lua_newtable(raw(state));
+    lua_pushvalue(raw(state), -1);
+    lua_setfield(raw(state), -3, "entry1");
+    const lutok::ref ref1(state, group, -1);
+    lua_pop(raw(state), 1);
+    lua_newtable(raw(state));
+    lua_pushvalue(raw(state), -1);
+    lua_setfield(raw(state), -3, "entry2");
+    const lutok::ref ref2(state, group, -1);
+    lua_pop(raw(state), 1);
+
+    ATF_REQUIRE(is_alive(state, "entry1"));
+    ATF_REQUIRE(is_alive(state, "entry2"));
+    group.release();
+    ATF_REQUIRE(group.released());
+    ATF_REQUIRE(!is_alive(state, "entry1"));
+    ATF_REQUIRE(!is_alive(state, "entry2"));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(group__outlive_state);
+ATF_TEST_CASE_BODY(group__outlive_state)
+{
+    lutok::ref* ref;
+    {
+        lutok::state state;
+        lutok::ref_group group(state);
+        lua_pushinteger(raw(state), 5);
+        ref = new lutok::ref(state, group, -1);
+        lua_pop(raw(state), 1);
+        group.release();
+    }
+    delete ref;
+}
+
+
+#if __cplusplus >= 201103L
+ATF_TEST_CASE_WITHOUT_HEAD(move);
+ATF_TEST_CASE_BODY(move)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lua_pushinteger(raw(state), 77);
+    lutok::ref ref1(state, -1);
+    lua_pop(raw(state), 1);
+
+    const lutok::ref ref2(std::move(ref1));
+    ref2.push(state);
+    ATF_REQUIRE_EQ(77, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+#endif
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, push);
+    ATF_ADD_TEST_CASE(tcs, copy);
+    ATF_ADD_TEST_CASE(tcs, release);
+    ATF_ADD_TEST_CASE(tcs, group__push);
+    ATF_ADD_TEST_CASE(tcs, group__member_release);
+    ATF_ADD_TEST_CASE(tcs, group__release);
+    ATF_ADD_TEST_CASE(tcs, group__outlive_state);
+#if __cplusplus >= 201103L
+    ATF_ADD_TEST_CASE(tcs, move);
+#endif
+}
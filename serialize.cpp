@@ -0,0 +1,837 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "serialize.hpp"
+
+#include <stdint.h>
+
+#include <cstring>
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "stack_cleaner.hpp"
+#include "state.ipp"
+#include "table.hpp"
+
+
+namespace {
+
+
+/// Maximum nesting depth of the tables in a value.
+///
+/// This bounds the recursion of the serializer and the deserializer so that
+/// they do not exhaust the C stack.  Cycles and tables referenced more than
+/// once do not count towards the limit.
+static const int max_depth = 200;
+
+
+/// Tag of a serialized nil.
+static const char tag_nil = 0;
+
+/// Tag of a serialized false boolean.
+static const char tag_false = 1;
+
+/// Tag of a serialized true boolean.
+static const char tag_true = 2;
+
+/// Tag of a serialized integer, followed by its zigzag-encoded varint.
+static const char tag_integer = 3;
+
+/// Tag of a serialized floating-point number, followed by its 8 bytes in
+/// little-endian order.
+static const char tag_number = 4;
+
+/// Tag of a serialized string, followed by its length as a varint and its
+/// bytes.
+static const char tag_string = 5;
+
+/// Tag of a serialized table, followed by the length of its sequence as a
+/// varint, the values in the sequence, any other key/value pairs and tag_end.
+static const char tag_table = 6;
+
+/// Tag of a table serialized earlier in the same value, followed by its
+/// 1-based order of appearance as a varint.
+static const char tag_reference = 7;
+
+/// Tag marking the end of the key/value pairs of a table.
+static const char tag_end = 8;
+
+
+/// Ensures that the stack of a state can hold more values.
+///
+/// \param raw_state The Lua state.
+/// \param slots The number of values that are going to be pushed.
+///
+/// \throw lutok::error If the stack cannot grow.
+static void
+ensure_stack(lua_State* raw_state, const int slots)
+{
+    if (!lua_checkstack(raw_state, slots))
+        throw lutok::error("Cannot grow the Lua stack to hold the requested "
+                           "values");
+}
+
+
+/// Checks if a key belongs to the sequence of a table.
+///
+/// \param raw_state The Lua state.
+/// \param index The stack index of the key.
+/// \param length The length of the sequence of the table.
+///
+/// \return True if the key is an integer between 1 and length.
+static bool
+is_sequence_key(lua_State* raw_state, const int index,
+                const std::size_t length)
+{
+    if (lua_type(raw_state, index) != LUA_TNUMBER)
+        return false;
+#if LUA_VERSION_NUM >= 503
+    if (!lua_isinteger(raw_state, index))
+        return false;
+    const lua_Integer key = lua_tointeger(raw_state, index);
+    return key >= 1 && static_cast< std::size_t >(key) <= length;
+#else
+    const lua_Number key = lua_tonumber(raw_state, index);
+    return key >= 1 && key <= static_cast< lua_Number >(length) &&
+        key == static_cast< lua_Number >(static_cast< std::size_t >(key));
+#endif
+}
+
+
+/// Sink of the walker that encodes values into their binary form.
+class encoder {
+    /// The buffer to append the encoded values to.
+    std::string& _output;
+
+    /// Appends an unsigned integer using 7 bits per byte.
+    ///
+    /// \param value The integer to append.
+    void
+    put_varint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            _output.push_back(static_cast< char >((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        _output.push_back(static_cast< char >(value));
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param output_ The buffer to append the encoded values to.
+    explicit encoder(std::string& output_) :
+        _output(output_)
+    {
+    }
+
+    /// Encodes the start of a table.
+    ///
+    /// \param length The length of the sequence of the table.
+    void
+    begin_table(const std::size_t length, const unsigned long /* id */)
+    {
+        _output.push_back(tag_table);
+        put_varint(length);
+    }
+
+    /// Encodes the end of a table.
+    void
+    end_table(void)
+    {
+        _output.push_back(tag_end);
+    }
+
+    /// Encodes a boolean.
+    ///
+    /// \param value The boolean to encode.
+    void
+    push_boolean(const bool value)
+    {
+        _output.push_back(value ? tag_true : tag_false);
+    }
+
+    /// Encodes an integer.
+    ///
+    /// \param value The integer to encode.
+    void
+    push_integer(const int64_t value)
+    {
+        _output.push_back(tag_integer);
+        const uint64_t bits = static_cast< uint64_t >(value);
+        put_varint(value < 0 ? ~(bits << 1) : bits << 1);
+    }
+
+    /// Encodes nil.
+    void
+    push_nil(void)
+    {
+        _output.push_back(tag_nil);
+    }
+
+    /// Encodes a floating-point number.
+    ///
+    /// \param value The number to encode.
+    void
+    push_number(const double value)
+    {
+        _output.push_back(tag_number);
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            _output.push_back(static_cast< char >(bits & 0xff));
+            bits >>= 8;
+        }
+    }
+
+    /// Encodes a reference to a table that has already been encoded.
+    ///
+    /// \param id The order of appearance of the table.
+    void
+    push_reference(const unsigned long id)
+    {
+        _output.push_back(tag_reference);
+        put_varint(id);
+    }
+
+    /// Encodes a string.
+    ///
+    /// \param data The bytes of the string.
+    /// \param length The length of the string.
+    void
+    push_string(const char* data, const std::size_t length)
+    {
+        _output.push_back(tag_string);
+        put_varint(length);
+        _output.append(data, length);
+    }
+
+    /// Stores a value in the sequence of the current table; a no-op.
+    void
+    set_array(const std::size_t /* index */)
+    {
+    }
+
+    /// Stores a key/value pair in the current table; a no-op.
+    void
+    set_field(void)
+    {
+    }
+};
+
+
+/// Sink of the walker and the decoder that pushes values onto a stack.
+class builder {
+    /// The Lua state to push the values into.
+    lua_State* _lua_state;
+
+    /// Stack index of the table that maps the order of appearance of the
+    /// tables to the tables themselves.
+    int _tables_index;
+
+public:
+    /// Constructor.
+    ///
+    /// \param lua_state_ The Lua state to push the values into.  Must have
+    ///     room for two values.
+    explicit builder(lua_State* lua_state_) :
+        _lua_state(lua_state_)
+    {
+        lua_newtable(_lua_state);
+        _tables_index = lua_gettop(_lua_state);
+    }
+
+    /// Pushes a new table.
+    ///
+    /// \param length The length of the sequence of the table.
+    /// \param id The order of appearance of the table.
+    ///
+    /// \throw lutok::error If the stack cannot grow.
+    void
+    begin_table(const std::size_t length, const unsigned long id)
+    {
+        ensure_stack(_lua_state, 4);
+        lua_createtable(_lua_state, lutok::detail::table_size_hint(length), 0);
+        lua_pushvalue(_lua_state, -1);
+        lua_rawseti(_lua_state, _tables_index, static_cast< int >(id));
+    }
+
+    /// Completes a table; a no-op.
+    void
+    end_table(void)
+    {
+    }
+
+    /// Removes the internal bookkeeping from the stack.
+    ///
+    /// After this, the only value left by the builder is the pushed value.
+    void
+    finish(void)
+    {
+        lua_remove(_lua_state, _tables_index);
+    }
+
+    /// Checks if the value on the top of the stack can be a table key.
+    ///
+    /// \return False if the value is nil or NaN.
+    bool
+    is_valid_key(void)
+    {
+        if (lua_isnil(_lua_state, -1))
+            return false;
+        if (lua_type(_lua_state, -1) == LUA_TNUMBER) {
+            const lua_Number number = lua_tonumber(_lua_state, -1);
+            return number == number;
+        }
+        return true;
+    }
+
+    /// Pushes a boolean.
+    ///
+    /// \param value The boolean to push.
+    void
+    push_boolean(const bool value)
+    {
+        lua_pushboolean(_lua_state, value ? 1 : 0);
+    }
+
+    /// Pushes an integer.
+    ///
+    /// \param value The integer to push.
+    void
+    push_integer(const int64_t value)
+    {
+        lua_pushinteger(_lua_state, static_cast< lua_Integer >(value));
+    }
+
+    /// Pushes nil.
+    void
+    push_nil(void)
+    {
+        lua_pushnil(_lua_state);
+    }
+
+    /// Pushes a floating-point number.
+    ///
+    /// \param value The number to push.
+    void
+    push_number(const double value)
+    {
+        lua_pushnumber(_lua_state, value);
+    }
+
+    /// Pushes a table that has already been built.
+    ///
+    /// \param id The order of appearance of the table.
+    void
+    push_reference(const unsigned long id)
+    {
+        lua_rawgeti(_lua_state, _tables_index, static_cast< int >(id));
+    }
+
+    /// Pushes a string.
+    ///
+    /// \param data The bytes of the string.
+    /// \param length The length of the string.
+    void
+    push_string(const char* data, const std::size_t length)
+    {
+        lua_pushlstring(_lua_state, data, length);
+    }
+
+    /// Pops a value and stores it in the sequence of the table below it.
+    ///
+    /// \param index The position of the value in the sequence.
+    void
+    set_array(const std::size_t index)
+    {
+        lua_rawseti(_lua_state, -2, static_cast< int >(index));
+    }
+
+    /// Pops a key/value pair and stores it in the table below them.
+    void
+    set_field(void)
+    {
+        lua_rawset(_lua_state, -3);
+    }
+};
+
+
+/// Traverses a value on a stack and feeds its contents to a sink.
+///
+/// \tparam Sink Either encoder or builder.
+template< class Sink >
+class walker {
+    /// The Lua state that holds the value to traverse.
+    lua_State* _lua_state;
+
+    /// The sink to feed the contents of the value to.
+    Sink& _sink;
+
+    /// Stack index of the table that maps the visited tables to their order
+    /// of appearance.
+    int _seen_index;
+
+    /// Number of tables visited so far.
+    unsigned long _tables;
+
+    /// Traverses a table.
+    ///
+    /// \param index The absolute stack index of the table.
+    /// \param depth The nesting depth of the table.
+    ///
+    /// \throw lutok::error If the table cannot be serialized.
+    void
+    walk_table(const int index, const int depth)
+    {
+        if (depth >= max_depth)
+            throw lutok::error("Cannot serialize tables nested this deeply");
+        ensure_stack(_lua_state, 4);
+
+        lua_pushvalue(_lua_state, index);
+        lua_rawget(_lua_state, _seen_index);
+        if (!lua_isnil(_lua_state, -1)) {
+            const unsigned long id = static_cast< unsigned long >(
+                lua_tointeger(_lua_state, -1));
+            lua_pop(_lua_state, 1);
+            _sink.push_reference(id);
+            return;
+        }
+        lua_pop(_lua_state, 1);
+
+        const unsigned long id = ++_tables;
+        lua_pushvalue(_lua_state, index);
+        lua_pushinteger(_lua_state, static_cast< lua_Integer >(id));
+        lua_rawset(_lua_state, _seen_index);
+
+        const std::size_t length = lutok::detail::raw_length(_lua_state, index);
+        _sink.begin_table(length, id);
+        for (std::size_t i = 1; i <= length; i++) {
+            lua_rawgeti(_lua_state, index, static_cast< int >(i));
+            walk(lua_gettop(_lua_state), depth + 1);
+            lua_pop(_lua_state, 1);
+            _sink.set_array(i);
+        }
+
+        lua_pushnil(_lua_state);
+        while (lua_next(_lua_state, index) != 0) {
+            if (!is_sequence_key(_lua_state, -2, length)) {
+                const int top = lua_gettop(_lua_state);
+                walk(top - 1, depth + 1);
+                walk(top, depth + 1);
+                _sink.set_field();
+            }
+            lua_pop(_lua_state, 1);
+        }
+        _sink.end_table();
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param lua_state_ The Lua state that holds the values to traverse.
+    ///     Must have room for one value.
+    /// \param sink_ The sink to feed the contents of the values to.
+    walker(lua_State* lua_state_, Sink& sink_) :
+        _lua_state(lua_state_),
+        _sink(sink_),
+        _tables(0)
+    {
+        lua_newtable(_lua_state);
+        _seen_index = lua_gettop(_lua_state);
+    }
+
+    /// Traverses a value.
+    ///
+    /// \param index The absolute stack index of the value.
+    /// \param depth The nesting depth of the value.
+    ///
+    /// \throw lutok::error If the value, or any value within it, is of a type
+    ///     that cannot be serialized.
+    void
+    walk(const int index, const int depth)
+    {
+        switch (lua_type(_lua_state, index)) {
+        case LUA_TNIL:
+            _sink.push_nil();
+            break;
+
+        case LUA_TBOOLEAN:
+            _sink.push_boolean(lua_toboolean(_lua_state, index) != 0);
+            break;
+
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(_lua_state, index)) {
+                _sink.push_integer(static_cast< int64_t >(
+                    lua_tointeger(_lua_state, index)));
+                break;
+            }
+#endif
+            _sink.push_number(static_cast< double >(
+                lua_tonumber(_lua_state, index)));
+            break;
+
+        case LUA_TSTRING: {
+            std::size_t length;
+            const char* data = lua_tolstring(_lua_state, index, &length);
+            _sink.push_string(data, length);
+            break;
+        }
+
+        case LUA_TTABLE:
+            walk_table(index, depth);
+            break;
+
+        default:
+            throw lutok::error(std::string("Cannot serialize a ") +
+                               luaL_typename(_lua_state, index) + " value");
+        }
+    }
+};
+
+
+/// Parses the binary form of a value and feeds it to a builder.
+class decoder {
+    /// The next byte to parse.
+    const char* _position;
+
+    /// The end of the input.
+    const char* _end;
+
+    /// The builder to feed the parsed values to.
+    builder& _builder;
+
+    /// Number of tables parsed so far.
+    unsigned long _tables;
+
+    /// Raises the error for malformed input.
+    ///
+    /// \throw lutok::error Always.
+    static void
+    fail(void)
+    {
+        throw lutok::error("Invalid serialized value");
+    }
+
+    /// Gets the number of bytes left in the input.
+    ///
+    /// \return A byte count.
+    std::size_t
+    remaining(void) const
+    {
+        return static_cast< std::size_t >(_end - _position);
+    }
+
+    /// Consumes one byte of the input.
+    ///
+    /// \return The byte.
+    ///
+    /// \throw lutok::error If the input is exhausted.
+    unsigned char
+    get_byte(void)
+    {
+        if (_position == _end)
+            fail();
+        return static_cast< unsigned char >(*_position++);
+    }
+
+    /// Consumes an unsigned integer encoded with 7 bits per byte.
+    ///
+    /// \return The integer.
+    ///
+    /// \throw lutok::error If the integer is truncated or too large.
+    uint64_t
+    get_varint(void)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            const unsigned char byte = get_byte();
+            value |= static_cast< uint64_t >(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        fail();
+        return 0;
+    }
+
+    /// Parses a table after its tag.
+    ///
+    /// \param depth The nesting depth of the table.
+    ///
+    /// \throw lutok::error If the input is malformed.
+    void
+    decode_table(const int depth)
+    {
+        if (depth >= max_depth)
+            fail();
+        const uint64_t length = get_varint();
+        // Every value takes at least one byte; this prevents a corrupt length
+        // from triggering a huge allocation.
+        if (length > remaining())
+            fail();
+
+        const unsigned long id = ++_tables;
+        _builder.begin_table(static_cast< std::size_t >(length), id);
+        for (std::size_t i = 1; i <= length; i++) {
+            decode(depth + 1);
+            _builder.set_array(i);
+        }
+
+        for (;;) {
+            if (_position == _end)
+                fail();
+            if (*_position == tag_end) {
+                _position++;
+                break;
+            }
+            decode(depth + 1);
+            if (!_builder.is_valid_key())
+                fail();
+            decode(depth + 1);
+            _builder.set_field();
+        }
+        _builder.end_table();
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param data The binary form to parse.
+    /// \param length The length of data.
+    /// \param builder_ The builder to feed the parsed values to.
+    decoder(const char* data, const std::size_t length, builder& builder_) :
+        _position(data),
+        _end(data + length),
+        _builder(builder_),
+        _tables(0)
+    {
+    }
+
+    /// Checks if the whole input has been consumed.
+    ///
+    /// \return True if there are no bytes left.
+    bool
+    done(void) const
+    {
+        return _position == _end;
+    }
+
+    /// Parses one value.
+    ///
+    /// \param depth The nesting depth of the value.
+    ///
+    /// \throw lutok::error If the input is malformed.
+    void
+    decode(const int depth)
+    {
+        switch (static_cast< char >(get_byte())) {
+        case tag_nil:
+            _builder.push_nil();
+            break;
+
+        case tag_false:
+            _builder.push_boolean(false);
+            break;
+
+        case tag_true:
+            _builder.push_boolean(true);
+            break;
+
+        case tag_integer: {
+            const uint64_t bits = get_varint();
+            _builder.push_integer((bits & 1) != 0 ?
+                -static_cast< int64_t >(bits >> 1) - 1 :
+                static_cast< int64_t >(bits >> 1));
+            break;
+        }
+
+        case tag_number: {
+            if (remaining() < 8)
+                fail();
+            uint64_t bits = 0;
+            for (int i = 7; i >= 0; i--)
+                bits = (bits << 8) | static_cast< unsigned char >(
+                    _position[i]);
+            _position += 8;
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            _builder.push_number(value);
+            break;
+        }
+
+        case tag_string: {
+            const uint64_t length = get_varint();
+            if (length > remaining())
+                fail();
+            _builder.push_string(_position,
+                                 static_cast< std::size_t >(length));
+            _position += length;
+            break;
+        }
+
+        case tag_table:
+            decode_table(depth);
+            break;
+
+        case tag_reference: {
+            const uint64_t id = get_varint();
+            if (id == 0 || id > _tables)
+                fail();
+            _builder.push_reference(static_cast< unsigned long >(id));
+            break;
+        }
+
+        default:
+            fail();
+        }
+    }
+};
+
+
+}  // anonymous namespace
+
+
+/// Pushes a value given in the binary form returned by serialize().
+///
+/// \param s The Lua state.
+/// \param data The binary form of the value.
+/// \param length The length of data.
+///
+/// \throw error If the data is malformed.  The stack is left untouched.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::deserialize(state& s, const char* data, const std::size_t length)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    stack_cleaner cleaner(s);
+    ensure_stack(raw_state, 3);
+
+    builder sink(raw_state);
+    decoder input(data, length, sink);
+    input.decode(0);
+    if (!input.done())
+        throw lutok::error("Invalid serialized value");
+    sink.finish();
+    cleaner.forget();
+}
+
+
+/// Pushes a value given in the binary form returned by serialize().
+///
+/// \param s The Lua state.
+/// \param data The binary form of the value.
+///
+/// \throw error If the data is malformed.  The stack is left untouched.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::deserialize(state& s, const std::string& data)
+{
+    deserialize(s, data.data(), data.length());
+}
+
+
+/// Encodes a value in a compact binary form.
+///
+/// Supported values are nil, booleans, numbers, strings and tables of these.
+/// Integers and floating-point numbers keep their subtype in the versions of
+/// Lua that distinguish them.  Tables that appear more than once in the value,
+/// including those that form cycles, are encoded once and restored as a single
+/// table.  Metatables are not preserved and metamethods are not invoked.
+///
+/// The binary form does not depend on the architecture of the machine, but
+/// integers that do not fit the integer type of the Lua state that decodes
+/// them are truncated.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the value to encode.
+///
+/// \return The binary form of the value, to be passed to deserialize().
+///
+/// \throw error If the value holds functions, userdata or threads, or if its
+///     tables are too deeply nested.
+std::string
+lutok::serialize(state& s, const int index)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    const int value_index = detail::absolute_index(raw_state, index);
+    stack_cleaner cleaner(s);
+    ensure_stack(raw_state, 1);
+
+    std::string output;
+    encoder sink(output);
+    walker< encoder > source(raw_state, sink);
+    source.walk(value_index, 0);
+    return output;
+}
+
+
+/// Copies a value from one Lua state to another.
+///
+/// The value is rebuilt in the target state while traversing it in the source
+/// state, without going through its binary form.  The same rules as in
+/// serialize() apply to the values that can be copied.
+///
+/// \param from The Lua state that holds the value.
+/// \param index The stack index of the value in the source state.
+/// \param to The Lua state to push the copy onto.  If it is the same as the
+///     source, the value is copied through its binary form.
+///
+/// \throw error If the value cannot be serialized.  Neither stack is modified
+///     in this case.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::transfer(state& from, const int index, state& to)
+{
+    lua_State* raw_from = state_c_gate(from).c_state();
+    lua_State* raw_to = state_c_gate(to).c_state();
+    if (raw_from == raw_to) {
+        const std::string data = serialize(from, index);
+        deserialize(to, data);
+        return;
+    }
+
+    const int value_index = detail::absolute_index(raw_from, index);
+    stack_cleaner to_cleaner(to);
+    {
+        stack_cleaner from_cleaner(from);
+        ensure_stack(raw_from, 1);
+        ensure_stack(raw_to, 3);
+
+        builder sink(raw_to);
+        walker< builder > source(raw_from, sink);
+        source.walk(value_index, 0);
+        sink.finish();
+    }
+    to_cleaner.forget();
+}
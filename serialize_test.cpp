@@ -0,0 +1,288 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "serialize.hpp"
+
+#include <string>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Evaluates a Lua expression that must yield a boolean.
+///
+/// \param state The Lua state.
+/// \param expression The expression to evaluate.
+///
+/// \return The value of the expression.
+static bool
+check(lutok::state& state, const std::string& expression)
+{
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              ("return " + expression).c_str()) == 0);
+    const bool result = lua_toboolean(raw(state), -1) != 0;
+    lua_pop(raw(state), 1);
+    return result;
+}
+
+
+/// Serializes a value and deserializes it into a global variable.
+///
+/// \param state The Lua state.
+/// \param expression Expression that yields the value to copy.
+static void
+round_trip(lutok::state& state, const std::string& expression)
+{
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              ("return " + expression).c_str()) == 0);
+    const std::string data = lutok::serialize(state, -1);
+    lua_pop(raw(state), 1);
+    lutok::deserialize(state, data);
+    lua_setglobal(raw(state), "copy");
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip__scalars);
+ATF_TEST_CASE_BODY(round_trip__scalars)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    round_trip(state, "nil");
+    ATF_REQUIRE(check(state, "copy == nil"));
+    round_trip(state, "true");
+    ATF_REQUIRE(check(state, "copy == true"));
+    round_trip(state, "false");
+    ATF_REQUIRE(check(state, "copy == false"));
+    round_trip(state, "-1234567");
+    ATF_REQUIRE(check(state, "copy == -1234567"));
+    round_trip(state, "2.5");
+    ATF_REQUIRE(check(state, "copy == 2.5"));
+    round_trip(state, "1/0");
+    ATF_REQUIRE(check(state, "copy == 1/0"));
+    round_trip(state, "'a\\0b'");
+    ATF_REQUIRE(check(state, "copy == 'a\\0b'"));
+}
+
+
+#if LUA_VERSION_NUM >= 503
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip__integer_subtypes);
+ATF_TEST_CASE_BODY(round_trip__integer_subtypes)
+{
+    lutok::state state;
+    state.open_all();
+    stack_balance_checker checker(state);
+
+    round_trip(state, "math.maxinteger");
+    ATF_REQUIRE(check(state, "math.type(copy) == 'integer' and "
+                      "copy == math.maxinteger"));
+    round_trip(state, "math.mininteger");
+    ATF_REQUIRE(check(state, "copy == math.mininteger"));
+    round_trip(state, "3.0");
+    ATF_REQUIRE(check(state, "math.type(copy) == 'float' and copy == 3"));
+}
+#endif
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip__tables);
+ATF_TEST_CASE_BODY(round_trip__tables)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    round_trip(state, "{10, 20, 30, name = 'x', [true] = {1, {2}}, "
+               "[{}] = 'key'}");
+    ATF_REQUIRE(check(state, "#copy == 3 and copy[1] == 10 and "
+                      "copy[3] == 30"));
+    ATF_REQUIRE(check(state, "copy.name == 'x' and copy[true][2][1] == 2"));
+    ATF_REQUIRE(check(state, "(function() for k, v in pairs(copy) do "
+                      "if type(k) == 'table' then return v == 'key' end "
+                      "end end)()"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip__cycles);
+ATF_TEST_CASE_BODY(round_trip__cycles)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    round_trip(state, "(function() local t = {} t.self = t "
+               "t.list = {t, t} return t end)()");
+    ATF_REQUIRE(check(state, "copy.self == copy"));
+    ATF_REQUIRE(check(state, "copy.list[1] == copy and "
+                      "copy.list[2] == copy"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip__shared);
+ATF_TEST_CASE_BODY(round_trip__shared)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    round_trip(state, "(function() local s = {1} return {a = s, b = s} "
+               "end)()");
+    ATF_REQUIRE(check(state, "copy.a == copy.b and copy.a[1] == 1"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(serialize__unsupported);
+ATF_TEST_CASE_BODY(serialize__unsupported)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE(luaL_dostring(raw(state), "return {1, 2, {print}}") == 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Cannot serialize a function",
+                         lutok::serialize(state, -1));
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(serialize__too_deep);
+ATF_TEST_CASE_BODY(serialize__too_deep)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "local t = {} for i = 1, 1000 do t = {t} end "
+                              "return t") == 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "nested",
+                         lutok::serialize(state, -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(deserialize__invalid);
+ATF_TEST_CASE_BODY(deserialize__invalid)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "return {1, 2, 'three', {four = 4}}") == 0);
+    const std::string data = lutok::serialize(state, -1);
+    lua_pop(raw(state), 1);
+
+    for (std::string::size_type i = 0; i < data.length(); i++) {
+        ATF_REQUIRE_THROW_RE(lutok::error, "Invalid serialized value",
+                             lutok::deserialize(state, data.substr(0, i)));
+    }
+    ATF_REQUIRE_THROW_RE(lutok::error, "Invalid serialized value",
+                         lutok::deserialize(state, data + '\0'));
+    ATF_REQUIRE_THROW_RE(lutok::error, "Invalid serialized value",
+                         lutok::deserialize(state, std::string("\x63")));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(transfer__values);
+ATF_TEST_CASE_BODY(transfer__values)
+{
+    lutok::state state1;
+    lutok::state state2;
+    stack_balance_checker checker1(state1);
+    stack_balance_checker checker2(state2);
+
+    ATF_REQUIRE(luaL_dostring(raw(state1),
+                              "local t = {1, 'two', x = {y = 2.5}} "
+                              "t.x.back = t return t") == 0);
+    lutok::transfer(state1, -1, state2);
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state1)));
+    lua_pop(raw(state1), 1);
+
+    lua_setglobal(raw(state2), "copy");
+    ATF_REQUIRE(check(state2, "copy[1] == 1 and copy[2] == 'two'"));
+    ATF_REQUIRE(check(state2, "copy.x.y == 2.5 and copy.x.back == copy"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(transfer__same_state);
+ATF_TEST_CASE_BODY(transfer__same_state)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "original = {a = {1}} return original") == 0);
+    lutok::transfer(state, -1, state);
+    lua_setglobal(raw(state), "copy");
+    lua_pop(raw(state), 1);
+    ATF_REQUIRE(check(state, "copy ~= original and copy.a ~= original.a"));
+    ATF_REQUIRE(check(state, "copy.a[1] == 1"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(transfer__unsupported);
+ATF_TEST_CASE_BODY(transfer__unsupported)
+{
+    lutok::state state1;
+    lutok::state state2;
+    state1.open_all();
+    stack_balance_checker checker1(state1);
+    stack_balance_checker checker2(state2);
+
+    ATF_REQUIRE(luaL_dostring(raw(state1),
+                              "return {a = 1, "
+                              "b = coroutine.create(print)}") == 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Cannot serialize a thread",
+                         lutok::transfer(state1, -1, state2));
+    lua_pop(raw(state1), 1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, round_trip__scalars);
+#if LUA_VERSION_NUM >= 503
+    ATF_ADD_TEST_CASE(tcs, round_trip__integer_subtypes);
+#endif
+    ATF_ADD_TEST_CASE(tcs, round_trip__tables);
+    ATF_ADD_TEST_CASE(tcs, round_trip__cycles);
+    ATF_ADD_TEST_CASE(tcs, round_trip__shared);
+    ATF_ADD_TEST_CASE(tcs, serialize__unsupported);
+    ATF_ADD_TEST_CASE(tcs, serialize__too_deep);
+    ATF_ADD_TEST_CASE(tcs, deserialize__invalid);
+    ATF_ADD_TEST_CASE(tcs, transfer__values);
+    ATF_ADD_TEST_CASE(tcs, transfer__same_state);
+    ATF_ADD_TEST_CASE(tcs, transfer__unsupported);
+}
@@ -0,0 +1,1159 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "shared_data.hpp"
+
+extern "C" {
+#include <pthread.h>
+}
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "internal.hpp"
+#include "serialize.hpp"
+#include "stack_cleaner.hpp"
+#include "state.ipp"
+#include "table.hpp"
+
+
+namespace {
+
+
+/// Maximum nesting depth of the tables in a snapshot.
+static const int max_depth = 200;
+
+
+/// Kind of a nil value in a snapshot.
+static const unsigned char kind_nil = 0;
+
+/// Kind of a boolean value in a snapshot.
+static const unsigned char kind_boolean = 1;
+
+/// Kind of an integer value in a snapshot.
+static const unsigned char kind_integer = 2;
+
+/// Kind of a floating-point value in a snapshot.
+static const unsigned char kind_number = 3;
+
+/// Kind of a string value in a snapshot.
+static const unsigned char kind_string = 4;
+
+/// Kind of a table value in a snapshot.
+static const unsigned char kind_table = 5;
+
+
+/// Object whose address identifies the metatable of the proxies.
+static const char metatable_key = 0;
+
+
+/// Object whose address identifies the cache of proxies of a state.
+static const char cache_key = 0;
+
+
+/// A value stored in a snapshot.
+struct snapshot_value {
+    /// One of the kind_* constants.
+    unsigned char kind;
+
+    /// The contents of the value, as given by kind.
+    union {
+        /// The value of a boolean.
+        bool boolean;
+
+        /// The value of an integer.
+        int64_t integer;
+
+        /// The value of a floating-point number.
+        double number;
+
+        /// Index of a string or a table in the snapshot.
+        std::size_t index;
+    } u;
+};
+
+
+/// A key/value pair of a table in a snapshot.
+struct snapshot_field {
+    /// The key; never nil nor NaN.
+    snapshot_value key;
+
+    /// The value.
+    snapshot_value value;
+};
+
+
+/// A table in a snapshot.
+struct snapshot_table {
+    /// Values of the sequence of the table, which may contain nils.
+    std::vector< snapshot_value > array;
+
+    /// The remaining key/value pairs, sorted by key.
+    std::vector< snapshot_field > fields;
+};
+
+
+/// Lookup key to search the fields of a table.
+///
+/// Unlike snapshot_value, this can hold strings that are not part of the
+/// snapshot, such as those provided by Lua.
+struct key_probe {
+    /// One of the kind_* constants.
+    unsigned char kind;
+
+    /// The value of a boolean or an integer.
+    int64_t integer;
+
+    /// The value of a floating-point number.
+    double number;
+
+    /// The bytes of a string.
+    const char* data;
+
+    /// The length of a string, or the index of a table.
+    std::size_t length;
+};
+
+
+/// Prepares a probe that matches a value of a snapshot.
+///
+/// \param strings The strings of the snapshot.
+/// \param value The value to match.
+///
+/// \return The probe.
+static key_probe
+make_probe(const std::vector< std::string >& strings,
+           const snapshot_value& value)
+{
+    key_probe probe;
+    probe.kind = value.kind;
+    probe.integer = 0;
+    probe.number = 0;
+    probe.data = NULL;
+    probe.length = 0;
+    switch (value.kind) {
+    case kind_boolean: probe.integer = value.u.boolean ? 1 : 0; break;
+    case kind_integer: probe.integer = value.u.integer; break;
+    case kind_number: probe.number = value.u.number; break;
+    case kind_string:
+        probe.data = strings[value.u.index].data();
+        probe.length = strings[value.u.index].length();
+        break;
+    case kind_table: probe.length = value.u.index; break;
+    }
+    return probe;
+}
+
+
+/// Compares a key of a snapshot against a probe.
+///
+/// Keys are ordered by kind first and by value second; the order among values
+/// of different kinds is arbitrary but consistent.
+///
+/// \param strings The strings of the snapshot.
+/// \param key The key of the snapshot.
+/// \param probe The probe to compare against.
+///
+/// \return A negative number, zero or a positive number if the key is less
+/// than, equal to or greater than the probe.
+static int
+compare_key(const std::vector< std::string >& strings,
+            const snapshot_value& key, const key_probe& probe)
+{
+    if (key.kind != probe.kind)
+        return key.kind < probe.kind ? -1 : 1;
+
+    switch (key.kind) {
+    case kind_boolean: {
+        const int64_t value = key.u.boolean ? 1 : 0;
+        return value == probe.integer ? 0 : (value < probe.integer ? -1 : 1);
+    }
+
+    case kind_integer:
+        return key.u.integer == probe.integer ? 0 :
+            (key.u.integer < probe.integer ? -1 : 1);
+
+    case kind_number:
+        return key.u.number == probe.number ? 0 :
+            (key.u.number < probe.number ? -1 : 1);
+
+    case kind_string: {
+        const std::string& value = strings[key.u.index];
+        const std::size_t common = std::min(value.length(), probe.length);
+        const int result = std::memcmp(value.data(), probe.data, common);
+        if (result != 0)
+            return result;
+        return value.length() == probe.length ? 0 :
+            (value.length() < probe.length ? -1 : 1);
+    }
+
+    case kind_table:
+        return key.u.index == probe.length ? 0 :
+            (key.u.index < probe.length ? -1 : 1);
+    }
+    return 0;
+}
+
+
+/// Sort predicate for the fields of a table.
+class field_less {
+    /// The strings of the snapshot.
+    const std::vector< std::string >& _strings;
+
+public:
+    /// Constructor.
+    ///
+    /// \param strings_ The strings of the snapshot.
+    explicit field_less(const std::vector< std::string >& strings_) :
+        _strings(strings_)
+    {
+    }
+
+    /// Compares two fields by key.
+    ///
+    /// \param a The first field.
+    /// \param b The second field.
+    ///
+    /// \return True if the key of a is less than the key of b.
+    bool
+    operator()(const snapshot_field& a, const snapshot_field& b) const
+    {
+        return compare_key(_strings, a.key, make_probe(_strings, b.key)) < 0;
+    }
+};
+
+
+/// Searches for a key in the fields of a table.
+///
+/// \param strings The strings of the snapshot.
+/// \param fields The fields of the table, sorted by key.
+/// \param probe The key to look for.
+///
+/// \return The position of the matching field, or fields.size() if none.
+static std::size_t
+find_field(const std::vector< std::string >& strings,
+           const std::vector< snapshot_field >& fields,
+           const key_probe& probe)
+{
+    std::size_t low = 0;
+    std::size_t high = fields.size();
+    while (low < high) {
+        const std::size_t middle = low + (high - low) / 2;
+        const int result = compare_key(strings, fields[middle].key, probe);
+        if (result == 0)
+            return middle;
+        else if (result < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return fields.size();
+}
+
+
+/// Checks if a number on the stack is a position within a sequence.
+///
+/// \param raw_state The Lua state.
+/// \param index The stack index of the number.
+/// \param length The length of the sequence.
+/// \param [out] position The 1-based position, if the number is one.
+///
+/// \return True if the number is an integer between 1 and length.
+static bool
+sequence_position(lua_State* raw_state, const int index,
+                  const std::size_t length, std::size_t* position)
+{
+    if (lua_type(raw_state, index) != LUA_TNUMBER)
+        return false;
+    const lua_Number number = lua_tonumber(raw_state, index);
+    if (!(number >= 1 && number <= static_cast< lua_Number >(length)))
+        return false;
+    const std::size_t candidate = static_cast< std::size_t >(number);
+    if (static_cast< lua_Number >(candidate) != number)
+        return false;
+    *position = candidate;
+    return true;
+}
+
+
+/// Copies a Lua table and its contents into the structures of a snapshot.
+class snapshot_builder {
+    /// The Lua state that holds the table.
+    lua_State* _lua_state;
+
+    /// The strings of the snapshot under construction.
+    std::vector< std::string >& _strings;
+
+    /// The tables of the snapshot under construction.
+    std::vector< snapshot_table >& _tables;
+
+    /// Positions of the strings added so far, to store each string once.
+    std::map< std::string, std::size_t > _interned;
+
+    /// Stack index of the table that maps the visited tables to their index
+    /// in the snapshot.
+    int _seen_index;
+
+    /// Adds a string to the snapshot.
+    ///
+    /// \param index The stack index of the string.
+    ///
+    /// \return The index of the string in the snapshot.
+    std::size_t
+    intern(const int index)
+    {
+        std::size_t length;
+        const char* data = lua_tolstring(_lua_state, index, &length);
+        const std::string value(data, length);
+        const std::map< std::string, std::size_t >::const_iterator iter =
+            _interned.find(value);
+        if (iter != _interned.end())
+            return (*iter).second;
+        _strings.push_back(value);
+        _interned.insert(std::make_pair(value, _strings.size() - 1));
+        return _strings.size() - 1;
+    }
+
+    /// Adds a table to the snapshot.
+    ///
+    /// \param index The absolute stack index of the table.
+    /// \param depth The nesting depth of the table.
+    ///
+    /// \return The index of the table in the snapshot.
+    ///
+    /// \throw lutok::error If the table cannot be copied.
+    std::size_t
+    add_table(const int index, const int depth)
+    {
+        if (depth >= max_depth)
+            throw lutok::error("Cannot share tables nested this deeply");
+        if (!lua_checkstack(_lua_state, 4))
+            throw lutok::error("Cannot grow the Lua stack to hold the "
+                               "requested values");
+
+        lua_pushvalue(_lua_state, index);
+        lua_rawget(_lua_state, _seen_index);
+        if (!lua_isnil(_lua_state, -1)) {
+            const std::size_t id = static_cast< std::size_t >(
+                lua_tonumber(_lua_state, -1));
+            lua_pop(_lua_state, 1);
+            return id;
+        }
+        lua_pop(_lua_state, 1);
+
+        const std::size_t id = _tables.size();
+        _tables.push_back(snapshot_table());
+        lua_pushvalue(_lua_state, index);
+        lua_pushnumber(_lua_state, static_cast< lua_Number >(id));
+        lua_rawset(_lua_state, _seen_index);
+
+        const std::size_t length = lutok::detail::raw_length(_lua_state, index);
+        std::vector< snapshot_value > array;
+        array.reserve(length);
+        for (std::size_t i = 1; i <= length; i++) {
+            lua_rawgeti(_lua_state, index, static_cast< int >(i));
+            array.push_back(add_value(lua_gettop(_lua_state), depth + 1));
+            lua_pop(_lua_state, 1);
+        }
+
+        std::vector< snapshot_field > fields;
+        lua_pushnil(_lua_state);
+        while (lua_next(_lua_state, index) != 0) {
+            std::size_t position;
+            if (!sequence_position(_lua_state, -2, length, &position)) {
+                const int top = lua_gettop(_lua_state);
+                snapshot_field field;
+                field.key = add_value(top - 1, depth + 1);
+                field.value = add_value(top, depth + 1);
+                fields.push_back(field);
+            }
+            lua_pop(_lua_state, 1);
+        }
+        std::sort(fields.begin(), fields.end(), field_less(_strings));
+
+        _tables[id].array.swap(array);
+        _tables[id].fields.swap(fields);
+        return id;
+    }
+
+public:
+    /// Constructor.
+    ///
+    /// \param lua_state_ The Lua state that holds the table.  Must have room
+    ///     for one value.
+    /// \param strings_ The strings of the snapshot under construction.
+    /// \param tables_ The tables of the snapshot under construction.
+    snapshot_builder(lua_State* lua_state_,
+                     std::vector< std::string >& strings_,
+                     std::vector< snapshot_table >& tables_) :
+        _lua_state(lua_state_),
+        _strings(strings_),
+        _tables(tables_)
+    {
+        lua_newtable(_lua_state);
+        _seen_index = lua_gettop(_lua_state);
+    }
+
+    /// Adds a value to the snapshot.
+    ///
+    /// \param index The absolute stack index of the value.
+    /// \param depth The nesting depth of the value.
+    ///
+    /// \return The copy of the value.
+    ///
+    /// \throw lutok::error If the value, or any value within it, is of a type
+    ///     that cannot be shared.
+    snapshot_value
+    add_value(const int index, const int depth)
+    {
+        snapshot_value value;
+        value.u.index = 0;
+        switch (lua_type(_lua_state, index)) {
+        case LUA_TNIL:
+            value.kind = kind_nil;
+            break;
+
+        case LUA_TBOOLEAN:
+            value.kind = kind_boolean;
+            value.u.boolean = lua_toboolean(_lua_state, index) != 0;
+            break;
+
+        case LUA_TNUMBER:
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(_lua_state, index)) {
+                value.kind = kind_integer;
+                value.u.integer = static_cast< int64_t >(
+                    lua_tointeger(_lua_state, index));
+                break;
+            }
+#endif
+            value.kind = kind_number;
+            value.u.number = static_cast< double >(
+                lua_tonumber(_lua_state, index));
+            break;
+
+        case LUA_TSTRING:
+            value.kind = kind_string;
+            value.u.index = intern(index);
+            break;
+
+        case LUA_TTABLE:
+            value.kind = kind_table;
+            value.u.index = add_table(index, depth);
+            break;
+
+        default:
+            throw lutok::error(std::string("Cannot share a ") +
+                               luaL_typename(_lua_state, index) + " value");
+        }
+        return value;
+    }
+};
+
+
+using lutok::detail::mutex_locker;
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::shared_snapshot.
+struct lutok::shared_snapshot::impl {
+    /// The strings of the snapshot, each stored once.
+    std::vector< std::string > strings;
+
+    /// The tables of the snapshot.  The first one is the root.
+    std::vector< snapshot_table > tables;
+};
+
+
+/// Creates a snapshot from its internal implementation.
+///
+/// \param pimpl The internal implementation, which is shared.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+lutok::shared_snapshot::shared_snapshot(const std::shared_ptr< impl >& pimpl) :
+#else
+lutok::shared_snapshot::shared_snapshot(
+    const std::tr1::shared_ptr< impl >& pimpl) :
+#endif
+    _pimpl(pimpl)
+{
+}
+
+
+/// Destructor.
+lutok::shared_snapshot::~shared_snapshot(void)
+{
+}
+
+
+/// Builds a snapshot from the binary form of a table.
+///
+/// This allows loading the data from a memory-mapped file written with the
+/// output of serialize(), without going through Lua source code.
+///
+/// \param data The binary form of the table, as returned by serialize().
+/// \param length The length of data.
+///
+/// \return The new snapshot.
+///
+/// \throw error If the data is malformed or does not represent a table.
+lutok::shared_snapshot
+lutok::shared_snapshot::from_serialized(const char* data,
+                                        const std::size_t length)
+{
+    state scratch;
+    deserialize(scratch, data, length);
+    const shared_snapshot snapshot = from_value(scratch, -1);
+    scratch.pop(1);
+    return snapshot;
+}
+
+
+/// Builds a snapshot by copying a table from a state.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the table to copy.  Metatables and
+///     metamethods are ignored.
+///
+/// \return The new snapshot.
+///
+/// \throw error If the value is not a table, if it contains values that cannot
+///     be shared, or if its tables are too deeply nested.
+lutok::shared_snapshot
+lutok::shared_snapshot::from_value(state& s, const int index)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    if (lua_type(raw_state, index) != LUA_TTABLE)
+        throw lutok::error("Shared data must be a table");
+    const int table_index = detail::absolute_index(raw_state, index);
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > data(new impl());
+#else
+    std::tr1::shared_ptr< impl > data(new impl());
+#endif
+    stack_cleaner cleaner(s);
+    if (!lua_checkstack(raw_state, 1))
+        throw lutok::error("Cannot grow the Lua stack to hold the requested "
+                           "values");
+    snapshot_builder builder(raw_state, data->strings, data->tables);
+    builder.add_value(table_index, 0);
+    return shared_snapshot(data);
+}
+
+
+/// Gets the number of tables in the snapshot.
+///
+/// \return The number of distinct tables, including the root one.
+std::size_t
+lutok::shared_snapshot::tables(void) const
+{
+    return _pimpl->tables.size();
+}
+
+
+/// Internal implementation for lutok::shared_data.
+struct lutok::shared_data::impl {
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    /// Pointer to a snapshot.
+    typedef std::shared_ptr< shared_snapshot::impl > snapshot_ptr;
+
+    /// Pointer to the internal implementation of the shared data.
+    typedef std::shared_ptr< impl > source_ptr;
+#else
+    /// Pointer to a snapshot.
+    typedef std::tr1::shared_ptr< shared_snapshot::impl > snapshot_ptr;
+
+    /// Pointer to the internal implementation of the shared data.
+    typedef std::tr1::shared_ptr< impl > source_ptr;
+#endif
+
+    /// Contents of the userdata that stand for the tables of a snapshot.
+    struct proxy {
+        /// The snapshot that holds the table.
+        snapshot_ptr snapshot;
+
+        /// Index of the table in the snapshot.
+        std::size_t table;
+
+        /// The shared data to follow on replacements, or NULL if the proxy is
+        /// pinned to its snapshot.  Only set for the root tables.
+        source_ptr source;
+
+        /// The version of the shared data that snapshot corresponds to.
+        unsigned long version;
+
+        /// Constructor.
+        ///
+        /// \param snapshot_ The snapshot that holds the table.
+        /// \param table_ Index of the table in the snapshot.
+        /// \param source_ The shared data to follow, or NULL.
+        /// \param version_ The version of the shared data.
+        proxy(const snapshot_ptr& snapshot_, const std::size_t table_,
+              const source_ptr& source_, const unsigned long version_) :
+            snapshot(snapshot_),
+            table(table_),
+            source(source_),
+            version(version_)
+        {
+        }
+    };
+
+    /// Lock protecting the current snapshot.
+    pthread_mutex_t mutex;
+
+    /// The current snapshot.
+    ///
+    /// Protected by mutex.
+    snapshot_ptr current;
+
+    /// Number of times the snapshot has been replaced.
+    ///
+    /// Only modified while holding mutex.  Where atomic operations are
+    /// available, this is read without holding the lock so that accesses
+    /// through the root proxies do not need to take it unless the snapshot
+    /// has changed.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::atomic< unsigned long > version;
+#else
+    unsigned long version;
+#endif
+
+    /// Constructor.
+    ///
+    /// \param initial The first snapshot.
+    explicit impl(const snapshot_ptr& initial) :
+        current(initial),
+        version(0)
+    {
+        ::pthread_mutex_init(&mutex, NULL);
+    }
+
+    /// Destructor.
+    ~impl(void)
+    {
+        ::pthread_mutex_destroy(&mutex);
+    }
+
+    /// Gets the registry key of the metatable of the proxies.
+    ///
+    /// \return The key as a light userdata.
+    static void*
+    metatable_registry_key(void)
+    {
+        return const_cast< char* >(&metatable_key);
+    }
+
+    /// Gets the registry key of the cache of proxies.
+    ///
+    /// \return The key as a light userdata.
+    static void*
+    cache_registry_key(void)
+    {
+        return const_cast< char* >(&cache_key);
+    }
+
+    /// Gets the snapshot a proxy reads from, following replacements.
+    ///
+    /// \param target The proxy.
+    ///
+    /// \return The snapshot.  The reference points into the proxy and is
+    /// invalidated by the next call for the same proxy, which may also drop
+    /// the last reference to the snapshot; callers that resolve any other
+    /// proxy while using the snapshot must hold a copy of the pointer.
+    static const snapshot_ptr&
+    resolve(proxy& target)
+    {
+        if (!target.source)
+            return target.snapshot;
+
+        impl& source = *target.source;
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        if (source.version.load() != target.version) {
+            mutex_locker locker(source.mutex);
+            target.snapshot = source.current;
+            target.version = source.version.load();
+        }
+#else
+        mutex_locker locker(source.mutex);
+        if (source.version != target.version) {
+            target.snapshot = source.current;
+            target.version = source.version;
+        }
+#endif
+        return target.snapshot;
+    }
+
+    /// Gets a proxy from the stack.
+    ///
+    /// \param raw_state The Lua state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The proxy, or NULL if the value is not a proxy.
+    static proxy*
+    to_proxy(lua_State* raw_state, const int index)
+    {
+        void* data = lua_touserdata(raw_state, index);
+        if (data == NULL || !lua_getmetatable(raw_state, index))
+            return NULL;
+        lua_pushlightuserdata(raw_state, metatable_registry_key());
+        lua_rawget(raw_state, LUA_REGISTRYINDEX);
+        const bool matches = lua_rawequal(raw_state, -1, -2);
+        lua_pop(raw_state, 2);
+        return matches ? static_cast< proxy* >(data) : NULL;
+    }
+
+    /// Prepares a probe to look up a Lua value in a snapshot.
+    ///
+    /// \param raw_state The Lua state.
+    /// \param index The stack index of the value.
+    /// \param snapshot The snapshot to look up.
+    /// \param [out] probe The probe.
+    ///
+    /// \return False if the value cannot possibly be a key of the snapshot.
+    static bool
+    make_lua_probe(lua_State* raw_state, const int index,
+                   const shared_snapshot::impl* snapshot, key_probe* probe)
+    {
+        probe->integer = 0;
+        probe->number = 0;
+        probe->data = NULL;
+        probe->length = 0;
+        switch (lua_type(raw_state, index)) {
+        case LUA_TBOOLEAN:
+            probe->kind = kind_boolean;
+            probe->integer = lua_toboolean(raw_state, index) ? 1 : 0;
+            return true;
+
+        case LUA_TNUMBER: {
+#if LUA_VERSION_NUM >= 503
+            if (lua_isinteger(raw_state, index)) {
+                probe->kind = kind_integer;
+                probe->integer = static_cast< int64_t >(
+                    lua_tointeger(raw_state, index));
+                return true;
+            }
+            // Lua stores floats with integral values as integer keys.
+            const double number = lua_tonumber(raw_state, index);
+            if (number >= -9223372036854775808.0 &&
+                number < 9223372036854775808.0 &&
+                number == static_cast< double >(
+                    static_cast< int64_t >(number))) {
+                probe->kind = kind_integer;
+                probe->integer = static_cast< int64_t >(number);
+                return true;
+            }
+#else
+            const double number = lua_tonumber(raw_state, index);
+#endif
+            probe->kind = kind_number;
+            probe->number = number;
+            return true;
+        }
+
+        case LUA_TSTRING:
+            probe->kind = kind_string;
+            probe->data = lua_tolstring(raw_state, index, &probe->length);
+            return true;
+
+        case LUA_TUSERDATA: {
+            proxy* key = to_proxy(raw_state, index);
+            if (key == NULL || resolve(*key).get() != snapshot)
+                return false;
+            probe->kind = kind_table;
+            probe->length = key->table;
+            return true;
+        }
+
+        default:
+            return false;
+        }
+    }
+
+    /// Pushes the metatable of the proxies, creating it on first use.
+    ///
+    /// \param raw_state The Lua state.
+    static void
+    push_metatable(lua_State* raw_state)
+    {
+        lua_pushlightuserdata(raw_state, metatable_registry_key());
+        lua_rawget(raw_state, LUA_REGISTRYINDEX);
+        if (!lua_isnil(raw_state, -1))
+            return;
+        lua_pop(raw_state, 1);
+
+        lua_newtable(raw_state);
+        lua_pushstring(raw_state, "shared_data");
+        lua_setfield(raw_state, -2, "__name");
+        lua_pushstring(raw_state, "shared_data");
+        lua_setfield(raw_state, -2, "__metatable");
+        lua_pushcfunction(raw_state, proxy_gc);
+        lua_setfield(raw_state, -2, "__gc");
+        lua_pushcfunction(raw_state, proxy_index);
+        lua_setfield(raw_state, -2, "__index");
+        lua_pushcfunction(raw_state, proxy_len);
+        lua_setfield(raw_state, -2, "__len");
+        lua_pushcfunction(raw_state, proxy_newindex);
+        lua_setfield(raw_state, -2, "__newindex");
+        lua_pushcfunction(raw_state, proxy_pairs);
+        lua_setfield(raw_state, -2, "__pairs");
+
+        lua_pushlightuserdata(raw_state, metatable_registry_key());
+        lua_pushvalue(raw_state, -2);
+        lua_rawset(raw_state, LUA_REGISTRYINDEX);
+    }
+
+    /// Pushes a proxy pinned to a table of a snapshot.
+    ///
+    /// Proxies are cached in a table with weak values so that all the
+    /// accesses to the same table return the same object while it is alive.
+    ///
+    /// \param raw_state The Lua state.
+    /// \param snapshot The snapshot that holds the table.
+    /// \param table Index of the table in the snapshot.
+    static void
+    push_proxy(lua_State* raw_state, const snapshot_ptr& snapshot,
+               const std::size_t table)
+    {
+        lua_pushlightuserdata(raw_state, cache_registry_key());
+        lua_rawget(raw_state, LUA_REGISTRYINDEX);
+        if (lua_isnil(raw_state, -1)) {
+            lua_pop(raw_state, 1);
+            lua_newtable(raw_state);
+            lua_newtable(raw_state);
+            lua_pushstring(raw_state, "v");
+            lua_setfield(raw_state, -2, "__mode");
+            lua_setmetatable(raw_state, -2);
+            lua_pushlightuserdata(raw_state, cache_registry_key());
+            lua_pushvalue(raw_state, -2);
+            lua_rawset(raw_state, LUA_REGISTRYINDEX);
+        }
+
+        void* key = const_cast< snapshot_table* >(&snapshot->tables[table]);
+        lua_pushlightuserdata(raw_state, key);
+        lua_rawget(raw_state, -2);
+        if (lua_isnil(raw_state, -1)) {
+            lua_pop(raw_state, 1);
+            new (lua_newuserdata(raw_state, sizeof(proxy))) proxy(
+                snapshot, table, source_ptr(), 0);
+            push_metatable(raw_state);
+            lua_setmetatable(raw_state, -2);
+            lua_pushlightuserdata(raw_state, key);
+            lua_pushvalue(raw_state, -2);
+            lua_rawset(raw_state, -4);
+        }
+        lua_remove(raw_state, -2);
+    }
+
+    /// Pushes a value of a snapshot onto the stack.
+    ///
+    /// \param raw_state The Lua state.
+    /// \param snapshot The snapshot that holds the value.
+    /// \param value The value to push.
+    static void
+    push_value(lua_State* raw_state, const snapshot_ptr& snapshot,
+               const snapshot_value& value)
+    {
+        switch (value.kind) {
+        case kind_nil:
+            lua_pushnil(raw_state);
+            break;
+
+        case kind_boolean:
+            lua_pushboolean(raw_state, value.u.boolean ? 1 : 0);
+            break;
+
+        case kind_integer:
+            lua_pushinteger(raw_state,
+                            static_cast< lua_Integer >(value.u.integer));
+            break;
+
+        case kind_number:
+            lua_pushnumber(raw_state, static_cast< lua_Number >(
+                value.u.number));
+            break;
+
+        case kind_string: {
+            const std::string& str = snapshot->strings[value.u.index];
+            lua_pushlstring(raw_state, str.data(), str.length());
+            break;
+        }
+
+        case kind_table:
+            push_proxy(raw_state, snapshot, value.u.index);
+            break;
+        }
+    }
+
+    /// Destroys a proxy; the __gc metamethod.
+    ///
+    /// \param raw_state The Lua state.  stack(1) is the proxy.
+    ///
+    /// \return 0.
+    static int
+    proxy_gc(lua_State* raw_state)
+    {
+        static_cast< proxy* >(lua_touserdata(raw_state, 1))->~proxy();
+        return 0;
+    }
+
+    /// Looks up a key in a proxy; the __index metamethod.
+    ///
+    /// \param raw_state The Lua state.  stack(1) is the proxy and stack(2)
+    ///     is the key.
+    ///
+    /// \return 1, with the value of the key or nil on the stack.
+    static int
+    proxy_index(lua_State* raw_state)
+    {
+        proxy* target = static_cast< proxy* >(lua_touserdata(raw_state, 1));
+        const snapshot_ptr snapshot = resolve(*target);
+        const snapshot_table& table = snapshot->tables[target->table];
+
+        std::size_t position;
+        if (sequence_position(raw_state, 2, table.array.size(), &position)) {
+            push_value(raw_state, snapshot, table.array[position - 1]);
+            return 1;
+        }
+
+        key_probe probe;
+        if (make_lua_probe(raw_state, 2, snapshot.get(), &probe)) {
+            const std::size_t found = find_field(snapshot->strings,
+                                                 table.fields, probe);
+            if (found < table.fields.size()) {
+                push_value(raw_state, snapshot, table.fields[found].value);
+                return 1;
+            }
+        }
+        lua_pushnil(raw_state);
+        return 1;
+    }
+
+    /// Gets the length of the sequence of a proxy; the __len metamethod.
+    ///
+    /// \param raw_state The Lua state.  stack(1) is the proxy.
+    ///
+    /// \return 1, with the length on the stack.
+    static int
+    proxy_len(lua_State* raw_state)
+    {
+        proxy* target = static_cast< proxy* >(lua_touserdata(raw_state, 1));
+        const snapshot_ptr snapshot = resolve(*target);
+        lua_pushinteger(raw_state, static_cast< lua_Integer >(
+            snapshot->tables[target->table].array.size()));
+        return 1;
+    }
+
+    /// Rejects modifications to a proxy; the __newindex metamethod.
+    ///
+    /// \param raw_state The Lua state.
+    ///
+    /// \return Never returns.
+    static int
+    proxy_newindex(lua_State* raw_state)
+    {
+        return luaL_error(raw_state, "Cannot modify shared data");
+    }
+
+    /// Pushes the entry of a proxy that follows a key.
+    ///
+    /// \param raw_state The Lua state.  stack(2) is the previous key, or nil
+    ///     to get the first entry.
+    /// \param target The proxy.
+    ///
+    /// \return 2, with the next key and its value on the stack, 1, with nil
+    /// on the stack, once there are no more entries, or 0, with nothing on
+    /// the stack, if the previous key is not in the proxy.
+    static int
+    push_next(lua_State* raw_state, proxy* target)
+    {
+        const snapshot_ptr snapshot = resolve(*target);
+        const snapshot_table& table = snapshot->tables[target->table];
+        const std::size_t length = table.array.size();
+
+        std::size_t position = 0;
+        if (lua_isnil(raw_state, 2)) {
+            position = 0;
+        } else if (sequence_position(raw_state, 2, length, &position)) {
+            // The next entry comes right after the current one.
+        } else {
+            key_probe probe;
+            std::size_t found = table.fields.size();
+            if (make_lua_probe(raw_state, 2, snapshot.get(), &probe))
+                found = find_field(snapshot->strings, table.fields, probe);
+            if (found == table.fields.size())
+                return 0;
+            position = length + found + 1;
+        }
+
+        while (position < length && table.array[position].kind == kind_nil)
+            position++;
+        if (position < length) {
+            lua_pushinteger(raw_state,
+                            static_cast< lua_Integer >(position + 1));
+            push_value(raw_state, snapshot, table.array[position]);
+            return 2;
+        } else if (position - length < table.fields.size()) {
+            const snapshot_field& field = table.fields[position - length];
+            push_value(raw_state, snapshot, field.key);
+            push_value(raw_state, snapshot, field.value);
+            return 2;
+        } else {
+            lua_pushnil(raw_state);
+            return 1;
+        }
+    }
+
+    /// Gets the entry of a proxy that follows a key, as next() does.
+    ///
+    /// The entries of the sequence come first, in order, followed by the
+    /// other fields in the order of their keys.
+    ///
+    /// \param raw_state The Lua state.  stack(1) is the proxy and stack(2) is
+    ///     the previous key, or nil to get the first entry.
+    ///
+    /// \return 2, with the next key and its value on the stack, or 1, with
+    /// nil on the stack, once there are no more entries.
+    static int
+    proxy_next(lua_State* raw_state)
+    {
+        proxy* target = to_proxy(raw_state, 1);
+        if (target == NULL)
+            return luaL_argerror(raw_state, 1, "shared data expected");
+        // Raised here, once the snapshot held by push_next is released, as
+        // the error may skip the destructors of the frames it goes through.
+        const int nresults = push_next(raw_state, target);
+        if (nresults == 0)
+            return luaL_error(raw_state, "invalid key to 'next'");
+        return nresults;
+    }
+
+    /// Starts an iteration over a proxy; the __pairs metamethod.
+    ///
+    /// The iteration is pinned to the current snapshot so that replacing the
+    /// snapshot midway does not disturb it.
+    ///
+    /// \param raw_state The Lua state.  stack(1) is the proxy.
+    ///
+    /// \return 3, with the iterator function, the pinned proxy and nil on the
+    /// stack.
+    static int
+    proxy_pairs(lua_State* raw_state)
+    {
+        proxy* target = static_cast< proxy* >(lua_touserdata(raw_state, 1));
+        lua_pushcfunction(raw_state, proxy_next);
+        push_proxy(raw_state, resolve(*target), target->table);
+        lua_pushnil(raw_state);
+        return 3;
+    }
+};
+
+
+/// Creates shared data backed by a snapshot.
+///
+/// \param initial The snapshot to expose.
+lutok::shared_data::shared_data(const shared_snapshot& initial) :
+    _pimpl(new impl(initial._pimpl))
+{
+}
+
+
+/// Destructor.
+///
+/// The proxies pushed into states remain valid after this.
+lutok::shared_data::~shared_data(void)
+{
+}
+
+
+/// Pushes a proxy to the root table of the data onto the stack.
+///
+/// The proxy always reads from the most recent snapshot given to replace().
+///
+/// \param s The Lua state.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::shared_data::push(state& s) const
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    impl::snapshot_ptr current;
+    unsigned long version;
+    {
+        mutex_locker locker(_pimpl->mutex);
+        current = _pimpl->current;
+        version = _pimpl->version;
+    }
+
+    new (lua_newuserdata(raw_state, sizeof(impl::proxy))) impl::proxy(
+        current, 0, _pimpl, version);
+    impl::push_metatable(raw_state);
+    lua_setmetatable(raw_state, -2);
+}
+
+
+/// Replaces the snapshot backing the data.
+///
+/// This can be called from any thread while the data is being read by any
+/// number of states.  The previous snapshot is released once the nested
+/// proxies that refer to it are collected.
+///
+/// \param next The new snapshot.
+void
+lutok::shared_data::replace(const shared_snapshot& next)
+{
+    mutex_locker locker(_pimpl->mutex);
+    _pimpl->current = next._pimpl;
+    _pimpl->version++;
+}
+
+
+/// Gets the current snapshot.
+///
+/// \return The snapshot that the root proxies read from.
+lutok::shared_snapshot
+lutok::shared_data::snapshot(void) const
+{
+    mutex_locker locker(_pimpl->mutex);
+    return shared_snapshot(_pimpl->current);
+}
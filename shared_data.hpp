@@ -0,0 +1,128 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file shared_data.hpp
+/// Provides read-only data shared by many Lua states.
+
+#if !defined(LUTOK_SHARED_DATA_HPP)
+#define LUTOK_SHARED_DATA_HPP
+
+#include <cstddef>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class shared_data;
+class state;
+
+
+/// Immutable copy of a Lua table held outside of any state.
+///
+/// A snapshot stores the contents of a table, and of the tables nested in it,
+/// in compact C++ structures: sequences as arrays and the remaining fields as
+/// arrays sorted by key for binary searching.  Snapshots are expensive to
+/// build but, once built, can be read concurrently from any number of threads
+/// and exposed to any number of states through shared_data.
+///
+/// Supported values are the same as those of serialize(): nil, booleans,
+/// numbers, strings and tables, including cycles.  Copies of a snapshot share
+/// the same data.
+class shared_snapshot {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+
+    shared_snapshot(const std::shared_ptr< impl >&);
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+
+    shared_snapshot(const std::tr1::shared_ptr< impl >&);
+#endif
+
+    friend class shared_data;
+
+public:
+    ~shared_snapshot(void);
+
+    static shared_snapshot from_serialized(const char*, const std::size_t);
+    static shared_snapshot from_value(state&, const int);
+
+    std::size_t tables(void) const;
+};
+
+
+/// Read-only table, backed by a snapshot, that can be pushed into many states.
+///
+/// Instead of copying the snapshot into every state, push() creates a userdata
+/// proxy whose __index, __len and __pairs metamethods read the snapshot
+/// directly.  Nested tables are exposed as proxies too, which are created on
+/// first access and cached per state so that repeated accesses return the same
+/// object.  Strings are copied into the state when read.  Attempts to modify
+/// the data raise an error.
+///
+/// The snapshot can be replaced at any time and from any thread with
+/// replace(), which hot-reloads the data in all the states without touching
+/// them: the root proxies switch to the new snapshot on their next access,
+/// while the nested proxies obtained before keep reading from the snapshot
+/// they belong to until they are collected.
+///
+/// Copies of an object refer to the same data.
+///
+/// \warning The __pairs metamethod is not honored by Lua 5.1, so pairs() does
+/// not work on the proxies in that version.
+class shared_data {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+public:
+    explicit shared_data(const shared_snapshot&);
+    ~shared_data(void);
+
+    void push(state&) const;
+    void replace(const shared_snapshot&);
+    shared_snapshot snapshot(void) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_SHARED_DATA_HPP)
@@ -0,0 +1,326 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "shared_data.hpp"
+
+#include <string>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "serialize.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Evaluates a Lua expression that must yield a boolean.
+///
+/// \param state The Lua state.
+/// \param expression The expression to evaluate.
+///
+/// \return The value of the expression.
+static bool
+check(lutok::state& state, const std::string& expression)
+{
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              ("return " + expression).c_str()) == 0);
+    const bool result = lua_toboolean(raw(state), -1) != 0;
+    lua_pop(raw(state), 1);
+    return result;
+}
+
+
+/// Builds a snapshot out of a Lua expression.
+///
+/// \param expression Expression that yields the table to copy.
+///
+/// \return The new snapshot.
+static lutok::shared_snapshot
+make_snapshot(const std::string& expression)
+{
+    lutok::state state;
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              ("return " + expression).c_str()) == 0);
+    const lutok::shared_snapshot snapshot =
+        lutok::shared_snapshot::from_value(state, -1);
+    lua_pop(raw(state), 1);
+    return snapshot;
+}
+
+
+/// Exposes shared data as a global variable.
+///
+/// \param state The Lua state.
+/// \param data The data to expose.
+/// \param name The name of the global variable.
+static void
+set_global(lutok::state& state, const lutok::shared_data& data,
+           const char* name)
+{
+    data.push(state);
+    lua_setglobal(raw(state), name);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(index__scalars);
+ATF_TEST_CASE_BODY(index__scalars)
+{
+    const lutok::shared_data data(make_snapshot(
+        "{10, 'two', x = 2.5, [true] = 'yes', [1.5] = 'half', ['a\\0b'] = 3}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(check(state, "d[1] == 10 and d[2] == 'two' and d[3] == nil"));
+    ATF_REQUIRE(check(state, "d.x == 2.5 and d[true] == 'yes'"));
+    ATF_REQUIRE(check(state, "d[1.5] == 'half' and d['a\\0b'] == 3"));
+    ATF_REQUIRE(check(state, "d.missing == nil and d[false] == nil"));
+    ATF_REQUIRE(check(state, "d[2.0] == 'two'"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(index__nested);
+ATF_TEST_CASE_BODY(index__nested)
+{
+    const lutok::shared_data data(make_snapshot(
+        "{config = {name = 'foo', ports = {80, 443}}}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(check(state, "d.config.name == 'foo'"));
+    ATF_REQUIRE(check(state, "d.config.ports[2] == 443"));
+    ATF_REQUIRE(check(state, "d.config == d.config"));
+    ATF_REQUIRE(check(state, "d.config.ports ~= d.config"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(index__cycles);
+ATF_TEST_CASE_BODY(index__cycles)
+{
+    lutok::state builder;
+    ATF_REQUIRE(luaL_dostring(raw(builder),
+                              "local t = {a = {}} t.a.up = t t.self = t "
+                              "t[t.a] = 'by table' return t") == 0);
+    const lutok::shared_snapshot snapshot =
+        lutok::shared_snapshot::from_value(builder, -1);
+    lua_pop(raw(builder), 1);
+    ATF_REQUIRE_EQ(2, snapshot.tables());
+    const lutok::shared_data data(snapshot);
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(check(state, "d.a.up.a == d.a and d.self.self.a == d.a"));
+    ATF_REQUIRE(check(state, "d[d.a] == 'by table'"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(len);
+ATF_TEST_CASE_BODY(len)
+{
+    const lutok::shared_data data(make_snapshot("{1, 2, 3, t = {'a'}}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(check(state, "#d == 3 and #d.t == 1"));
+}
+
+
+#if LUA_VERSION_NUM >= 502
+ATF_TEST_CASE_WITHOUT_HEAD(pairs);
+ATF_TEST_CASE_BODY(pairs)
+{
+    const lutok::shared_data data(make_snapshot(
+        "{'a', 'b', x = 1, y = {2}, [true] = 3}"));
+
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(luaL_dostring(raw(state),
+        "count = 0 sequence = '' "
+        "for k, v in pairs(d) do "
+        "    count = count + 1 "
+        "    if type(k) == 'number' then sequence = sequence .. v end "
+        "    assert(d[k] == v) "
+        "end") == 0);
+    ATF_REQUIRE(check(state, "count == 5 and sequence == 'ab'"));
+}
+#endif
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(modify__fails);
+ATF_TEST_CASE_BODY(modify__fails)
+{
+    const lutok::shared_data data(make_snapshot("{a = 1, t = {}}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(luaL_dostring(raw(state), "d.a = 2") != 0);
+    ATF_REQUIRE_MATCH("Cannot modify shared data",
+                      lua_tostring(raw(state), -1));
+    lua_pop(raw(state), 1);
+    ATF_REQUIRE(luaL_dostring(raw(state), "d.t.x = 1") != 0);
+    lua_pop(raw(state), 1);
+    ATF_REQUIRE(check(state, "d.a == 1 and d.t.x == nil"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(replace);
+ATF_TEST_CASE_BODY(replace)
+{
+    lutok::shared_data data(make_snapshot("{version = 1, t = {v = 1}}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    ATF_REQUIRE(luaL_dostring(raw(state), "old = d.t") == 0);
+    ATF_REQUIRE(check(state, "d.version == 1"));
+
+    data.replace(make_snapshot("{version = 2, t = {v = 2}}"));
+    ATF_REQUIRE(check(state, "d.version == 2 and d.t.v == 2"));
+    ATF_REQUIRE(check(state, "old.v == 1 and old ~= d.t"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(replace__proxy_key);
+ATF_TEST_CASE_BODY(replace__proxy_key)
+{
+    lutok::shared_data data(make_snapshot("{x = 1, t = {}}"));
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    set_global(state, data, "d");
+    set_global(state, data, "e");
+    ATF_REQUIRE(check(state, "d[d] == nil and d[e] == nil and d[d.t] == nil"));
+
+    data.replace(make_snapshot("{x = 2, t = {}}"));
+    ATF_REQUIRE(check(state, "d[d] == nil and d.x == 2"));
+    data.replace(make_snapshot("{x = 3, t = {}}"));
+    ATF_REQUIRE(check(state, "d[e] == nil and e[d] == nil and e.x == 3"));
+    data.replace(make_snapshot("{x = 4, t = {}}"));
+    ATF_REQUIRE(check(state, "#d == 0 and d[d.t] == nil"));
+    ATF_REQUIRE(check(state, "d.x == 4 and e.x == 4"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(many_states);
+ATF_TEST_CASE_BODY(many_states)
+{
+    lutok::shared_data data(make_snapshot("{x = 'first'}"));
+    const lutok::shared_data copy = data;
+
+    lutok::state state1;
+    lutok::state state2;
+    set_global(state1, data, "d");
+    set_global(state2, copy, "d");
+    ATF_REQUIRE(check(state1, "d.x == 'first'"));
+    ATF_REQUIRE(check(state2, "d.x == 'first'"));
+
+    data.replace(make_snapshot("{x = 'second'}"));
+    ATF_REQUIRE(check(state1, "d.x == 'second'"));
+    ATF_REQUIRE(check(state2, "d.x == 'second'"));
+    ATF_REQUIRE_EQ(1, copy.snapshot().tables());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_serialized);
+ATF_TEST_CASE_BODY(from_serialized)
+{
+    lutok::state builder;
+    ATF_REQUIRE(luaL_dostring(raw(builder),
+                              "return {list = {1, 2}, name = 'foo'}") == 0);
+    const std::string bytes = lutok::serialize(builder, -1);
+    lua_pop(raw(builder), 1);
+
+    const lutok::shared_data data(lutok::shared_snapshot::from_serialized(
+        bytes.data(), bytes.length()));
+    lutok::state state;
+    set_global(state, data, "d");
+    ATF_REQUIRE(check(state, "d.name == 'foo' and d.list[2] == 2"));
+
+    ATF_REQUIRE_THROW_RE(lutok::error, "Invalid serialized value",
+                         lutok::shared_snapshot::from_serialized(
+                             bytes.data(), bytes.length() - 1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(from_value__errors);
+ATF_TEST_CASE_BODY(from_value__errors)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lua_pushinteger(raw(state), 5);
+    ATF_REQUIRE_THROW_RE(lutok::error, "must be a table",
+                         lutok::shared_snapshot::from_value(state, -1));
+    lua_pop(raw(state), 1);
+
+    ATF_REQUIRE(luaL_dostring(raw(state), "return {a = {}}") == 0);
+    lua_newuserdata(raw(state), 1);
+    lua_setfield(raw(state), -2, "b");
+    ATF_REQUIRE_THROW_RE(lutok::error, "Cannot share a userdata",
+                         lutok::shared_snapshot::from_value(state, -1));
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    lua_pop(raw(state), 1);
+
+    ATF_REQUIRE(luaL_dostring(raw(state),
+                              "local t = {} for i = 1, 300 do t = {t} end "
+                              "return t") == 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "nested this deeply",
+                         lutok::shared_snapshot::from_value(state, -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, index__scalars);
+    ATF_ADD_TEST_CASE(tcs, index__nested);
+    ATF_ADD_TEST_CASE(tcs, index__cycles);
+    ATF_ADD_TEST_CASE(tcs, len);
+#if LUA_VERSION_NUM >= 502
+    ATF_ADD_TEST_CASE(tcs, pairs);
+#endif
+    ATF_ADD_TEST_CASE(tcs, modify__fails);
+    ATF_ADD_TEST_CASE(tcs, replace);
+    ATF_ADD_TEST_CASE(tcs, replace__proxy_key);
+    ATF_ADD_TEST_CASE(tcs, many_states);
+    ATF_ADD_TEST_CASE(tcs, from_serialized);
+    ATF_ADD_TEST_CASE(tcs, from_value__errors);
+}
@@ -27,14 +27,23 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 /// \file stack_cleaner.hpp
-/// Provides the stack_cleaner class.
+/// Provides the stack_cleaner and stack_reserve classes.
+///
+/// Both classes are implemented inline and do not allocate memory, so that
+/// they can be used in the hottest bindings at no extra cost.
+///
+/// Defining LUTOK_CHECK_STACK_BALANCE before including this file enables extra
+/// run-time checks of the usage of the stack in the destructors of these
+/// classes.  The checks are implemented with assert(), so they only have an
+/// effect when NDEBUG is not defined either.
 
 #if !defined(LUTOK_STACK_CLEANER_HPP)
 #define LUTOK_STACK_CLEANER_HPP
 
-#include <memory>
+#include <cassert>
 
-#include <lutok/state.hpp>
+#include <lutok/exceptions.hpp>
+#include <lutok/state.ipp>
 
 namespace lutok {
 
@@ -69,10 +78,11 @@ namespace lutok {
 /// accessed later.  Otherwise, the instance will be destroyed right away and
 /// will not have the desired effect.
 class stack_cleaner {
-    struct impl;
+    /// The Lua state whose stack is restored.
+    lua_State* _lua_state;
 
-    /// Pointer to the shared internal implementation.
-    std::auto_ptr< impl > _pimpl;
+    /// The depth of the Lua stack to be restored.
+    int _original_depth;
 
     /// Disallow copies.
     stack_cleaner(const stack_cleaner&);
@@ -88,6 +98,111 @@ public:
 };
 
 
+/// A RAII model for a reservation of space on the Lua stack.
+///
+/// At creation time, the object ensures that the stack can hold the given
+/// number of extra values by calling lua_checkstack once, so that a sequence of
+/// pushes of known length does not need to grow the stack repeatedly.  Lua
+/// guarantees only a few free slots to the C code, so the reservation is also
+/// required to push many values safely.
+///
+/// When LUTOK_CHECK_STACK_BALANCE is defined, the destructor verifies that the
+/// depth of the stack stayed between its depth at creation time and the
+/// reserved space.  The layout of the class does not depend on this setting,
+/// so code built with and without it can be mixed.
+class stack_reserve {
+    /// The Lua state whose stack is checked.
+    lua_State* _lua_state;
+
+    /// The depth of the Lua stack at creation time.
+    int _original_depth;
+
+    /// The number of reserved slots.
+    int _slots;
+
+    /// Disallow copies.
+    stack_reserve(const stack_reserve&);
+
+    /// Disallow assignment.
+    stack_reserve& operator=(const stack_reserve&);
+
+public:
+    stack_reserve(state&, const int);
+    ~stack_reserve(void);
+};
+
+
+/// Creates a new stack cleaner.
+///
+/// This gathers the current height of the stack so that extra elements can be
+/// popped during destruction.
+///
+/// \param state_ The Lua state.
+inline
+stack_cleaner::stack_cleaner(state& state_) :
+    _lua_state(state_._pimpl->lua_state),
+    _original_depth(lua_gettop(state_._pimpl->lua_state))
+{
+}
+
+
+/// Pops any values from the stack not known at construction time.
+///
+/// \pre The current height of the stack must be equal or greater to the height
+/// of the stack when this object was instantiated.
+inline
+stack_cleaner::~stack_cleaner(void)
+{
+    assert(lua_gettop(_lua_state) >= _original_depth);
+    lua_settop(_lua_state, _original_depth);
+}
+
+
+/// Forgets about any elements currently in the stack.
+///
+/// This allows a function to return values on the stack because all the
+/// elements that are currently in the stack will not be touched during
+/// destruction when the function is called.
+inline void
+stack_cleaner::forget(void)
+{
+    _original_depth = lua_gettop(_lua_state);
+}
+
+
+/// Reserves space on the stack.
+///
+/// \param state_ The Lua state.
+/// \param slots The number of values that the caller is going to push.
+///
+/// \throw error If the stack cannot grow to hold the values.
+inline
+stack_reserve::stack_reserve(state& state_, const int slots) :
+    _lua_state(state_._pimpl->lua_state),
+    _original_depth(lua_gettop(_lua_state)),
+    _slots(slots)
+{
+    assert(slots >= 0);
+    if (!lua_checkstack(_lua_state, slots))
+        throw error("Cannot grow the Lua stack to hold the requested values");
+}
+
+
+/// Checks the usage of the reserved space, if enabled.
+///
+/// \pre If LUTOK_CHECK_STACK_BALANCE is defined, the current height of the
+/// stack must not be lower than its height when this object was instantiated
+/// nor higher than that plus the reserved slots.
+inline
+stack_reserve::~stack_reserve(void)
+{
+#if defined(LUTOK_CHECK_STACK_BALANCE)
+    assert(lua_gettop(_lua_state) >= _original_depth);
+    assert(lua_gettop(_lua_state) <= _original_depth + _slots);
+#endif
+}
+
+
 }  // namespace lutok
 
 #endif  // !defined(LUTOK_STACK_CLEANER_HPP)
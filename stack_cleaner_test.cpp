@@ -26,10 +26,15 @@
 // (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+// Exercise the optional checks of the stack guards.
+#define LUTOK_CHECK_STACK_BALANCE
+
 #include "stack_cleaner.hpp"
 
 #include <atf-c++.hpp>
 
+#include "exceptions.hpp"
+
 
 ATF_TEST_CASE_WITHOUT_HEAD(empty);
 ATF_TEST_CASE_BODY(empty)
@@ -99,10 +104,55 @@ ATF_TEST_CASE_BODY(forget)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(reserve__many);
+ATF_TEST_CASE_BODY(reserve__many)
+{
+    lutok::state state;
+    {
+        lutok::stack_cleaner cleaner(state);
+        // Lua 5.1 caps the C stack at LUAI_MAXCSTACK (8000) values.
+        lutok::stack_reserve reserve(state, 5000);
+        for (int i = 0; i < 5000; i++)
+            state.push_integer(i);
+        ATF_REQUIRE_EQ(5000, state.get_top());
+        ATF_REQUIRE_EQ(4999, state.to_integer(-1));
+    }
+    ATF_REQUIRE_EQ(0, state.get_top());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reserve__nested);
+ATF_TEST_CASE_BODY(reserve__nested)
+{
+    lutok::state state;
+    lutok::stack_reserve reserve1(state, 2);
+    state.push_integer(1);
+    {
+        lutok::stack_reserve reserve2(state, 1);
+        state.push_integer(2);
+    }
+    ATF_REQUIRE_EQ(2, state.get_top());
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(reserve__too_many);
+ATF_TEST_CASE_BODY(reserve__too_many)
+{
+    lutok::state state;
+    ATF_REQUIRE_THROW_RE(lutok::error, "Cannot grow the Lua stack",
+                         lutok::stack_reserve(state, 100000000));
+    ATF_REQUIRE_EQ(0, state.get_top());
+}
+
+
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, empty);
     ATF_ADD_TEST_CASE(tcs, some);
     ATF_ADD_TEST_CASE(tcs, nested);
     ATF_ADD_TEST_CASE(tcs, forget);
+    ATF_ADD_TEST_CASE(tcs, reserve__many);
+    ATF_ADD_TEST_CASE(tcs, reserve__nested);
+    ATF_ADD_TEST_CASE(tcs, reserve__too_many);
 }
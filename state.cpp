@@ -27,14 +27,25 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 extern "C" {
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
 #include <unistd.h>
 }
 
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <istream>
+#include <new>
 
+#include "allocator.hpp"
 #include "c_gate.hpp"
 #include "exceptions.hpp"
+#include "metrics.hpp"
+#include "pairs.hpp"
 #include "state.ipp"
 
 
@@ -125,10 +136,61 @@ protected_settable(lua_State* state)
 }
 
 
+#if !defined(_LIBCPP_VERSION) && __cplusplus < 201103L
+/// Deleter for shared pointers that do not own the pointed-to object.
+template< class Type >
+struct no_delete {
+    /// Does nothing.
+    void
+    operator()(Type* /* object */) const
+    {
+    }
+};
+
+
+#endif
+/// Routes the memory requests of a Lua state to an allocator object.
+///
+/// \param user_data The lutok::allocator serving the state.
+/// \param ptr The block to resize or release, or NULL to allocate a new one.
+/// \param old_size The size of ptr.  If ptr is NULL, Lua 5.2 and later pass a
+///     type code here instead, so it must be ignored.
+/// \param new_size The new size of the block, or 0 to release it.
+///
+/// \return The new block, or NULL if new_size is 0 or on failure.
+static void*
+reallocate_from_allocator(void* user_data, void* ptr, size_t old_size,
+                          size_t new_size)
+{
+    lutok::allocator* allocator = static_cast< lutok::allocator* >(user_data);
+    return allocator->reallocate(ptr, ptr == NULL ? 0 : old_size, new_size);
+}
+
+
+/// Reports an unprotected error before Lua aborts the program.
+///
+/// This mimics the panic function installed by luaL_newstate, which
+/// lua_newstate does not set up.
+///
+/// \param raw_state The Lua C API state.
+///
+/// \return Nothing meaningful; Lua aborts execution after this returns.
+static int
+report_panic(lua_State* raw_state)
+{
+    const char* message = lua_tostring(raw_state, -1);
+    std::fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n",
+                 message == NULL ? "error object is not a string" : message);
+    return 0;
+}
+
+
 /// Calls a C++ Lua function from a C calling environment.
 ///
 /// Any errors reported by the C++ function are caught and reported to the
-/// caller as Lua errors.
+/// caller as Lua errors.  Functions that request to yield through
+/// state::yield() are suspended once the C++ objects involved in the call are
+/// gone, as Lua 5.2 and later implement lua_yield with a longjmp.
 ///
 /// \param function The C++ function to call.
 /// \param raw_state The raw Lua state.
@@ -140,16 +202,23 @@ call_cxx_function_from_c(lutok::cxx_function function,
                          lua_State* raw_state) throw()
 {
     char error_buf[1024];
+    int yield_nresults = -1;
 
     try {
-        lutok::state state = lutok::state_c_gate::connect(raw_state);
-        return function(state);
+        lutok::state_ref state(raw_state);
+        const int nresults = lutok::detail::call_metrics_enabled() ?
+            lutok::detail::measure_call(function, state) : function(state);
+        if (nresults >= 0)
+            return nresults;
+        yield_nresults = -nresults - 1;
     } catch (const std::exception& e) {
         std::strncpy(error_buf, e.what(), sizeof(error_buf));
     } catch (...) {
         std::strncpy(error_buf, "Unhandled exception in Lua C++ hook",
                      sizeof(error_buf));
     }
+    if (yield_nresults >= 0)
+        return lua_yield(raw_state, yield_nresults);
     error_buf[sizeof(error_buf) - 1] = '\0';
     // We raise the Lua error from outside the try/catch context and we use
     // a stack-based buffer to hold the message to ensure that we do not leak
@@ -167,28 +236,61 @@ call_cxx_function_from_c(lutok::cxx_function function,
 /// C++ function we have to call.  All we do here is safely delegate the
 /// execution to the wrapped C++ closure.
 ///
+/// The extra upvalue comes right after the upvalues provided by the user, so
+/// its position depends on how many of these there are.  Instead of querying
+/// the debug API to find this out on every call, there is one instantiation of
+/// this trampoline for every possible number of user upvalues, given by
+/// NValues, and push_cxx_closure() picks the right one.
+///
 /// \param raw_state The Lua C API state.
 ///
 /// \return The number of return values of the called closure.
+template< int NValues >
 static int
 cxx_closure_trampoline(lua_State* raw_state)
 {
-    lutok::state state = lutok::state_c_gate::connect(raw_state);
-
-    int nupvalues;
-    {
-        lua_Debug debug;
-        lua_getstack(raw_state, 0, &debug);
-        lua_getinfo(raw_state, "u", &debug);
-        nupvalues = debug.nups;
-    }
-
-    lutok::cxx_function* function = state.to_userdata< lutok::cxx_function >(
-        state.upvalue_index(nupvalues));
+    lutok::cxx_function* function = static_cast< lutok::cxx_function* >(
+        lua_touserdata(raw_state, lua_upvalueindex(NValues + 1)));
     return call_cxx_function_from_c(*function, raw_state);
 }
 
 
+/// Maximum number of user upvalues that a C++ closure can have.
+///
+/// Lua limits C closures to 255 upvalues and we need one of them to hold the
+/// address of the C++ function.
+static const int max_cxx_closure_upvalues = 254;
+
+
+#define TRAMPOLINES_1(n) cxx_closure_trampoline< (n) >
+#define TRAMPOLINES_2(n) TRAMPOLINES_1(n), TRAMPOLINES_1((n) + 1)
+#define TRAMPOLINES_4(n) TRAMPOLINES_2(n), TRAMPOLINES_2((n) + 2)
+#define TRAMPOLINES_8(n) TRAMPOLINES_4(n), TRAMPOLINES_4((n) + 4)
+#define TRAMPOLINES_16(n) TRAMPOLINES_8(n), TRAMPOLINES_8((n) + 8)
+#define TRAMPOLINES_32(n) TRAMPOLINES_16(n), TRAMPOLINES_16((n) + 16)
+#define TRAMPOLINES_64(n) TRAMPOLINES_32(n), TRAMPOLINES_32((n) + 32)
+#define TRAMPOLINES_128(n) TRAMPOLINES_64(n), TRAMPOLINES_64((n) + 64)
+
+
+/// Trampolines for C++ closures, indexed by their number of user upvalues.
+static const lua_CFunction cxx_closure_trampolines[
+    max_cxx_closure_upvalues + 1] = {
+    TRAMPOLINES_128(0), TRAMPOLINES_64(128), TRAMPOLINES_32(192),
+    TRAMPOLINES_16(224), TRAMPOLINES_8(240), TRAMPOLINES_4(248),
+    TRAMPOLINES_2(252), TRAMPOLINES_1(254),
+};
+
+
+#undef TRAMPOLINES_128
+#undef TRAMPOLINES_64
+#undef TRAMPOLINES_32
+#undef TRAMPOLINES_16
+#undef TRAMPOLINES_8
+#undef TRAMPOLINES_4
+#undef TRAMPOLINES_2
+#undef TRAMPOLINES_1
+
+
 /// Lua glue to call a C++ function.
 ///
 /// This Lua binding is actually a closure that we have constructed from the
@@ -202,39 +304,272 @@ cxx_closure_trampoline(lua_State* raw_state)
 static int
 cxx_function_trampoline(lua_State* raw_state)
 {
-    lutok::state state = lutok::state_c_gate::connect(raw_state);
-    lutok::cxx_function* function = state.to_userdata< lutok::cxx_function >(
-        state.upvalue_index(1));
+    lutok::cxx_function* function = static_cast< lutok::cxx_function* >(
+        lua_touserdata(raw_state, lua_upvalueindex(1)));
     return call_cxx_function_from_c(*function, raw_state);
 }
 
 
-}  // anonymous namespace
+/// Lua glue to call a C++ function held in static storage.
+///
+/// This is the same as cxx_function_trampoline but for the closures
+/// constructed by the state.push_static_cxx_function() method, whose single
+/// upvalue is a light userdata pointing to the address of the C++ function.
+///
+/// \param raw_state The Lua C API state.
+///
+/// \return The number of return values of the called function.
+static int
+static_cxx_function_trampoline(lua_State* raw_state)
+{
+    const lutok::cxx_function* function =
+        static_cast< const lutok::cxx_function* >(
+            lua_touserdata(raw_state, lua_upvalueindex(1)));
+    return call_cxx_function_from_c(*function, raw_state);
+}
 
 
-const int lutok::registry_index = LUA_REGISTRYINDEX;
+/// lua_Writer that appends a dumped chunk to a string.
+///
+/// \param unused_state The Lua state.
+/// \param data The piece of the chunk to append.
+/// \param size The length of data.
+/// \param ud Pointer to the std::string to append the data to.
+///
+/// \return 0 on success; 1 if the data could not be appended.
+static int
+append_to_string(lua_State* /* unused_state */, const void* data,
+                 size_t size, void* ud)
+{
+    std::string* output = static_cast< std::string* >(ud);
+    try {
+        output->append(static_cast< const char* >(data), size);
+        return 0;
+    } catch (...) {
+        return 1;
+    }
+}
 
 
-/// Internal implementation for lutok::state.
-struct lutok::state::impl {
-    /// The Lua internal state.
-    lua_State* lua_state;
+/// Size of the blocks in which read_from_stream() feeds a stream to Lua.
+static const std::size_t stream_block_size = 8192;
 
-    /// Whether we own the state or not (to decide if we close it).
-    bool owned;
 
-    /// Constructor.
+/// State of read_from_stream() across calls.
+struct stream_reader {
+    /// The stream to read the chunk from.
+    std::istream* input;
+
+    /// Whether reading from the stream raised an exception.
+    bool failed;
+
+    /// Buffer holding the last block read from the stream.
+    char block[stream_block_size];
+};
+
+
+/// lua_Reader that feeds a chunk from a stream in fixed-size blocks.
+///
+/// \param unused_state The Lua state.
+/// \param ud Pointer to the stream_reader.
+/// \param [out] size The length of the returned block.
+///
+/// \return The next block of the chunk, or NULL at the end of the stream or
+/// on errors.
+static const char*
+read_from_stream(lua_State* /* unused_state */, void* ud, size_t* size)
+{
+    stream_reader* reader = static_cast< stream_reader* >(ud);
+    try {
+        reader->input->read(reader->block, sizeof(reader->block));
+        *size = static_cast< size_t >(reader->input->gcount());
+    } catch (...) {
+        reader->failed = true;
+        *size = 0;
+    }
+    return *size == 0 ? NULL : reader->block;
+}
+
+
+/// Read-only memory mapping of a whole file.
+///
+/// The mapping is released when the object goes out of scope.
+class mapped_file {
+    /// Base address of the mapping; NULL if the file is empty or could not
+    /// be mapped.
+    void* _data;
+
+    /// Length of the mapping.
+    std::size_t _length;
+
+    /// Disallow copies.
+    mapped_file(const mapped_file&);
+
+    /// Disallow assignment.
+    mapped_file& operator=(const mapped_file&);
+
+public:
+    /// Maps a file into memory.
+    ///
+    /// \param fd Descriptor of the file to map.  Can be closed right after
+    ///     the mapping is created.
+    /// \param length The length of the file.
+    mapped_file(const int fd, const std::size_t length) :
+        _data(NULL), _length(length)
+    {
+        if (_length > 0) {
+            void* data = ::mmap(NULL, _length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED)
+                _data = data;
+        }
+    }
+
+    /// Releases the mapping.
+    ~mapped_file(void)
+    {
+        if (_data != NULL)
+            ::munmap(_data, _length);
+    }
+
+    /// Gets the contents of the file.
     ///
-    /// \param lua_ The Lua internal state.
-    /// \param owned_ Whether we own the state or not.
-    impl(lua_State* lua_, bool owned_) :
-        lua_state(lua_),
-        owned(owned_)
+    /// \return A pointer to the mapped contents, or NULL if the file is empty
+    /// or could not be mapped.
+    const char*
+    data(void) const
     {
+        return static_cast< const char* >(_data);
+    }
+
+    /// Gets the length of the file.
+    ///
+    /// \return The length in bytes.
+    std::size_t
+    length(void) const
+    {
+        return _length;
     }
 };
 
 
+#if LUA_VERSION_NUM < 503
+/// Checks if a number has an integral value representable in 64 bits.
+///
+/// \param value The number to check.
+///
+/// \return True if value can be converted to int64_t without loss; false for
+/// fractional values, values out of range, infinities and NaN.
+static bool
+is_integral_int64(const lua_Number value)
+{
+    // 2^63 is exactly representable as a float, unlike INT64_MAX.
+    const lua_Number limit = 9223372036854775808.0;
+    if (!(value >= -limit && value < limit))
+        return false;
+    return std::floor(value) == value;
+}
+
+
+#endif
+}  // anonymous namespace
+
+
+const int lutok::registry_index = LUA_REGISTRYINDEX;
+
+
+/// Constructs a new reference to a string.
+///
+/// \param data_ Pointer to the first character of the string.  The memory
+///     pointed to by this must remain valid during the lifetime of this object.
+/// \param length_ Length of the string, in bytes.
+lutok::string_ref::string_ref(const char* data_, const std::size_t length_) :
+    _data(data_),
+    _length(length_)
+{
+}
+
+
+/// Gets the pointer to the referenced string.
+///
+/// \return A pointer to the first character of the string.
+const char*
+lutok::string_ref::data(void) const
+{
+    return _data;
+}
+
+
+/// Gets the length of the referenced string.
+///
+/// \return The length of the string in bytes, not including any terminator.
+std::size_t
+lutok::string_ref::length(void) const
+{
+    return _length;
+}
+
+
+/// Copies the referenced string into a new string object.
+///
+/// \return A newly-allocated string with the same contents, including any
+/// embedded NUL characters.
+std::string
+lutok::string_ref::str(void) const
+{
+    return std::string(_data, _length);
+}
+
+
+/// Constructs a new status.
+///
+/// \param code_ The Lua status code of the operation.
+lutok::status::status(const int code_) :
+    _code(code_)
+{
+}
+
+
+/// Gets the Lua status code of the operation.
+///
+/// \return LUA_OK (0) on success, or one of the LUA_ERR* codes on failure.
+int
+lutok::status::code(void) const
+{
+    return _code;
+}
+
+
+/// Gets the error message of a failed operation.
+///
+/// \pre The operation failed and its error object is still on the top of the
+///     stack.
+///
+/// \param s The Lua state in which the operation failed.
+///
+/// \return The error message, or a description of the error object if it is
+/// not a string.  The error object is left on the stack.
+std::string
+lutok::status::message(state& s) const
+{
+    assert(!ok());
+    lua_State* raw_state = state_c_gate(s).c_state();
+    if (lua_isstring(raw_state, -1))
+        return lua_tostring(raw_state, -1);
+    return std::string("(error object is a ") +
+        luaL_typename(raw_state, -1) + " value)";
+}
+
+
+/// Checks if the operation succeeded.
+///
+/// \return True if the operation succeeded.
+bool
+lutok::status::ok(void) const
+{
+    return _code == 0;
+}
+
+
 /// Initializes the Lua state.
 ///
 /// You must share the same state object alongside the lifetime of your Lua
@@ -248,6 +583,23 @@ lutok::state::state(void)
 }
 
 
+/// Initializes the Lua state with a custom memory allocator.
+///
+/// \param allocator_ The allocator that will serve all memory requests of the
+///     Lua session.  It must remain alive until the session is terminated, so
+///     it typically has to be declared before the state object.
+///
+/// \throw error If the allocator cannot provide the memory for the new state.
+lutok::state::state(allocator& allocator_)
+{
+    lua_State* lua = lua_newstate(reallocate_from_allocator, &allocator_);
+    if (lua == NULL)
+        throw lutok::error("lua open failed");
+    lua_atpanic(lua, report_panic);
+    _pimpl.reset(new impl(lua, true));
+}
+
+
 /// Initializes the Lua state from an existing raw state.
 ///
 /// Instances constructed using this method do NOT own the raw state.  This
@@ -260,6 +612,49 @@ lutok::state::state(void* raw_state_) :
 }
 
 
+/// Initializes the Lua state from an existing raw state and external storage.
+///
+/// Instances constructed using this method do NOT own the raw state nor the
+/// storage holding their internal implementation, and they do not allocate
+/// any memory.  The caller must ensure that the storage outlives the state
+/// and all of its copies.
+///
+/// \param raw_state_ The raw Lua state to wrap.
+/// \param storage Memory in which to construct the internal implementation.
+///     Must be suitably aligned and large enough to hold an impl object.
+lutok::state::state(void* raw_state_, void* storage)
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    : _pimpl(std::shared_ptr< impl >(),
+             new (storage) impl(reinterpret_cast< lua_State* >(raw_state_),
+                                false, true))
+{
+}
+#else
+{
+    // TR1 lacks the aliasing constructor of shared_ptr, so we must live with
+    // the allocation of a control block.  At least we avoid the impl one.
+    _pimpl.reset(new (storage) impl(reinterpret_cast< lua_State* >(raw_state_),
+                                    false, true),
+                 no_delete< impl >());
+}
+#endif
+
+
+/// Copy constructor.
+///
+/// The copy refers to the same Lua session as the original.  If the original
+/// wraps a raw state through a state_ref, the copy allocates its own internal
+/// implementation so that it remains valid after the state_ref is gone.
+///
+/// \param other The state to copy.
+lutok::state::state(const state& other) :
+    _pimpl(other._pimpl)
+{
+    if (_pimpl->borrowed)
+        _pimpl.reset(new impl(_pimpl->lua_state, false));
+}
+
+
 /// Destructor for the Lua state.
 ///
 /// Closes the session unless it has already been closed by calling the
@@ -272,6 +667,24 @@ lutok::state::~state(void)
 }
 
 
+/// Assignment operator.
+///
+/// \param other The state to copy.
+///
+/// \return A reference to this object.
+///
+/// \see state(const state&) for details on copies of states wrapped by a
+/// state_ref.
+lutok::state&
+lutok::state::operator=(const state& other)
+{
+    _pimpl = other._pimpl;
+    if (_pimpl->borrowed)
+        _pimpl.reset(new impl(_pimpl->lua_state, false));
+    return *this;
+}
+
+
 /// Terminates this Lua session.
 ///
 /// It is recommended to call this instead of relying on the destructor to do
@@ -290,6 +703,147 @@ lutok::state::close(void)
 }
 
 
+/// Wrapper around lua_dump.
+///
+/// The function is dumped with its debug information so that errors raised
+/// by the reloaded function carry the original source names and line numbers.
+///
+/// \pre stack(-1) is the Lua function to dump.
+///
+/// \return The binary representation of the function, which can later be
+/// passed to load_buffer() in any state of the same Lua version.
+///
+/// \throw api_error If the function cannot be dumped, e.g. because it is a C
+///     function.
+std::string
+lutok::state::dump(void)
+{
+    std::string bytecode;
+#if LUA_VERSION_NUM >= 503
+    const int error = lua_dump(_pimpl->lua_state, append_to_string,
+                               &bytecode, 0);
+#else
+    const int error = lua_dump(_pimpl->lua_state, append_to_string,
+                               &bytecode);
+#endif
+    if (error != 0)
+        throw lutok::api_error("lua_dump", "Cannot dump function");
+    return bytecode;
+}
+
+
+/// Runs a full garbage-collection cycle.
+///
+/// \warning Terminates execution if a finalizer raises an error.
+void
+lutok::state::gc_collect(void)
+{
+    lua_gc(_pimpl->lua_state, LUA_GCCOLLECT, 0);
+}
+
+
+/// Gets the amount of memory in use by the state.
+///
+/// \return The size of the heap in kilobytes.
+unsigned int
+lutok::state::gc_count(void)
+{
+    return static_cast< unsigned int >(lua_gc(_pimpl->lua_state, LUA_GCCOUNT,
+                                              0));
+}
+
+
+/// Restarts the garbage collector after gc_stop().
+void
+lutok::state::gc_restart(void)
+{
+    lua_gc(_pimpl->lua_state, LUA_GCRESTART, 0);
+}
+
+
+/// Switches the garbage collector to generational mode.
+///
+/// \throw error If the Lua version does not provide a generational collector.
+void
+lutok::state::gc_set_generational(void)
+{
+#if LUA_VERSION_NUM >= 504
+    lua_gc(_pimpl->lua_state, LUA_GCGEN, 0, 0);
+#elif defined(LUA_GCGEN)
+    lua_gc(_pimpl->lua_state, LUA_GCGEN, 0);
+#else
+    throw lutok::error("Generational garbage collection is not supported by "
+                       "this version of Lua");
+#endif
+}
+
+
+/// Switches the garbage collector to incremental mode.
+///
+/// This is the default mode and the only one in some versions of Lua, where
+/// this is a no-op.
+void
+lutok::state::gc_set_incremental(void)
+{
+#if LUA_VERSION_NUM >= 504
+    lua_gc(_pimpl->lua_state, LUA_GCINC, 0, 0, 0);
+#elif defined(LUA_GCINC)
+    lua_gc(_pimpl->lua_state, LUA_GCINC, 0);
+#endif
+}
+
+
+/// Sets the pause of the incremental garbage collector.
+///
+/// \param pause How much the heap has to grow, in percent, before a new cycle
+///     starts.  For example, 200 waits for the heap to double.
+///
+/// \return The previous pause.
+int
+lutok::state::gc_set_pause(const int pause)
+{
+    return lua_gc(_pimpl->lua_state, LUA_GCSETPAUSE, pause);
+}
+
+
+/// Sets the step multiplier of the incremental garbage collector.
+///
+/// \param multiplier The speed of the collector relative to memory
+///     allocation, in percent.
+///
+/// \return The previous step multiplier.
+int
+lutok::state::gc_set_step_multiplier(const int multiplier)
+{
+    return lua_gc(_pimpl->lua_state, LUA_GCSETSTEPMUL, multiplier);
+}
+
+
+/// Performs an incremental step of garbage collection.
+///
+/// \param kilobytes The size of the step, as the amount of allocation it
+///     stands for.  0 runs a single basic step.
+///
+/// \return True if the step finished a collection cycle.
+///
+/// \warning Terminates execution if a finalizer raises an error.
+bool
+lutok::state::gc_step(const int kilobytes)
+{
+    return lua_gc(_pimpl->lua_state, LUA_GCSTEP, kilobytes) != 0;
+}
+
+
+/// Stops the garbage collector until gc_restart() is called.
+///
+/// Explicit calls to gc_collect() and gc_step() still run the collector.
+void
+lutok::state::gc_stop(void)
+{
+    lua_gc(_pimpl->lua_state, LUA_GCSTOP, 0);
+}
+
+
 /// Wrapper around lua_getglobal.
 ///
 /// \param name The second parameter to lua_getglobal.
@@ -308,6 +862,19 @@ lutok::state::get_global(const std::string& name)
 }
 
 
+/// Wrapper around lua_getglobal without protection against errors.
+///
+/// \param name The second parameter to lua_getglobal.
+///
+/// \warning Errors are not reported as exceptions; see the class documentation
+/// for details.
+void
+lutok::state::get_global_unchecked(const std::string& name)
+{
+    lua_getglobal(_pimpl->lua_state, name.c_str());
+}
+
+
 /// Pushes a reference to the global table onto the stack.
 ///
 /// This is a wrapper around the incompatible differences between Lua 5.1 and
@@ -377,6 +944,21 @@ lutok::state::get_table(const int index)
 }
 
 
+/// Wrapper around lua_gettable without protection against errors.
+///
+/// \param index The second parameter to lua_gettable.
+///
+/// \warning Errors are not reported as exceptions; see the class documentation
+/// for details.
+void
+lutok::state::get_table_unchecked(const int index)
+{
+    assert(lua_gettop(_pimpl->lua_state) >= 2);
+    assert(lua_istable(_pimpl->lua_state, index));
+    lua_gettable(_pimpl->lua_state, index);
+}
+
+
 /// Wrapper around lua_gettop.
 ///
 /// \return The return value of lua_gettop.
@@ -421,6 +1003,29 @@ lutok::state::is_function(const int index)
 }
 
 
+/// Checks if a value on the stack is an integer.
+///
+/// Lua 5.3 and later have a native integer subtype, so this is a wrapper
+/// around lua_isinteger and numbers that happen to have an integral float
+/// value are not integers.  Earlier versions represent all numbers as floats,
+/// so this instead checks if the value is a number with an integral value.
+///
+/// \param index The stack index of the value to check.
+///
+/// \return True if the value is an integer.
+bool
+lutok::state::is_integer(const int index)
+{
+#if LUA_VERSION_NUM >= 503
+    return lua_isinteger(_pimpl->lua_state, index);
+#else
+    if (lua_type(_pimpl->lua_state, index) != LUA_TNUMBER)
+        return false;
+    return is_integral_int64(lua_tonumber(_pimpl->lua_state, index));
+#endif
+}
+
+
 /// Wrapper around lua_isnil.
 ///
 /// \param index The second parameter to lua_isnil.
@@ -481,6 +1086,26 @@ lutok::state::is_userdata(const int index)
 }
 
 
+/// Wrapper around luaL_loadbuffer.
+///
+/// \param data The second parameter to luaL_loadbuffer.  This can hold either
+///     source code or a binary chunk as returned by dump().
+/// \param length The third parameter to luaL_loadbuffer.
+/// \param chunkname The fourth parameter to luaL_loadbuffer.
+///
+/// \throw api_error If luaL_loadbuffer returns an error.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::state::load_buffer(const char* data, const std::size_t length,
+                          const std::string& chunkname)
+{
+    if (luaL_loadbuffer(_pimpl->lua_state, data, length,
+                        chunkname.c_str()) != 0)
+        throw lutok::api_error::from_stack(*this, "luaL_loadbuffer");
+}
+
+
 /// Wrapper around luaL_loadfile.
 ///
 /// \param file The second parameter to luaL_loadfile.
@@ -499,6 +1124,94 @@ lutok::state::load_file(const std::string& file)
 }
 
 
+/// Loads a file by mapping it into memory.
+///
+/// This behaves like load_file() but feeds the file to Lua straight from the
+/// page cache instead of reading it through stdio, which is cheaper for large
+/// scripts and precompiled chunks.  As with luaL_loadfile, a leading line
+/// starting with '#' is skipped and the chunk is named after the file.  If the
+/// file cannot be mapped, such as when it is not a regular file, this falls
+/// back to load_file().
+///
+/// \param file The file to load.
+///
+/// \throw api_error If the file cannot be compiled.
+/// \throw file_not_found_error If the file cannot be accessed.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::state::load_mapped_file(const std::string& file)
+{
+    const int fd = ::open(file.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw lutok::file_not_found_error(file);
+    struct ::stat sb;
+    if (::fstat(fd, &sb) == -1 || !S_ISREG(sb.st_mode)) {
+        ::close(fd);
+        load_file(file);
+        return;
+    }
+    const mapped_file mapping(fd, static_cast< std::size_t >(sb.st_size));
+    ::close(fd);
+    if (mapping.data() == NULL && mapping.length() > 0) {
+        load_file(file);
+        return;
+    }
+
+    const char* data = mapping.data();
+    std::size_t length = mapping.length();
+    if (length > 0 && data[0] == '#') {
+        // Keep the newline so that line numbers in errors remain correct.
+        const void* newline = std::memchr(data, '\n', length);
+        const std::size_t skip = newline == NULL ? length :
+            static_cast< std::size_t >(static_cast< const char* >(newline) -
+                                       data);
+        data += skip;
+        length -= skip;
+    }
+    if (luaL_loadbuffer(_pimpl->lua_state, length == 0 ? "" : data, length,
+                        ("@" + file).c_str()) != 0)
+        throw lutok::api_error::from_stack(*this, "luaL_loadbuffer");
+}
+
+
+/// Loads a chunk from a stream with lua_load.
+///
+/// The stream is consumed in fixed-size blocks so that the chunk never needs
+/// to be held in memory as a whole.  It can contain either source code or a
+/// binary chunk as returned by dump().
+///
+/// \param input The stream to read the chunk from.  It is read until its end.
+/// \param chunkname The name of the chunk for error messages and debug
+///     information.
+///
+/// \throw api_error If lua_load returns an error.
+/// \throw error If reading from the stream fails.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::state::load_stream(std::istream& input, const std::string& chunkname)
+{
+    stream_reader reader;
+    reader.input = &input;
+    reader.failed = false;
+#if LUA_VERSION_NUM >= 502
+    const int status = lua_load(_pimpl->lua_state, read_from_stream, &reader,
+                                chunkname.c_str(), NULL);
+#else
+    const int status = lua_load(_pimpl->lua_state, read_from_stream, &reader,
+                                chunkname.c_str());
+#endif
+    if (reader.failed || input.bad()) {
+        lua_pop(_pimpl->lua_state, 1);
+        throw lutok::error("Failed to read chunk " + chunkname +
+                           " from stream");
+    }
+    if (status != 0)
+        throw lutok::api_error::from_stack(*this, "lua_load");
+}
+
+
 /// Wrapper around luaL_loadstring.
 ///
 /// \param str The second parameter to luaL_loadstring.
@@ -524,6 +1237,19 @@ lutok::state::new_table(void)
 }
 
 
+/// Wrapper around lua_createtable.
+///
+/// \param narr The number of array elements to preallocate.
+/// \param nrec The number of non-array elements to preallocate.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::state::new_table(const int narr, const int nrec)
+{
+    lua_createtable(_pimpl->lua_state, narr, nrec);
+}
+
+
 /// Wrapper around lua_newuserdata.
 ///
 /// This is internal.  The public type-safe interface of this method should be
@@ -568,6 +1294,23 @@ lutok::state::next(const int index)
 }
 
 
+/// Wrapper around lua_next without protection against errors.
+///
+/// \param index The second parameter to lua_next.
+///
+/// \return True if there are more elements to process; false otherwise.
+///
+/// \warning Errors are not reported as exceptions; see the class documentation
+/// for details.
+bool
+lutok::state::next_unchecked(const int index)
+{
+    assert(lua_istable(_pimpl->lua_state, index));
+    assert(lua_gettop(_pimpl->lua_state) >= 1);
+    return lua_next(_pimpl->lua_state, index) != 0;
+}
+
+
 /// Wrapper around luaL_openlibs.
 ///
 /// \throw api_error If luaL_openlibs fails.
@@ -632,6 +1375,23 @@ lutok::state::open_table(void)
 }
 
 
+/// Creates a range to iterate over the entries of a table.
+///
+/// This is much cheaper than repeated calls to next(), as the iteration does
+/// not need any protected calls; see pairs_range for details.
+///
+/// \param index The stack index of the table.
+///
+/// \return A range over the entries of the table.
+///
+/// \throw error If the value at the given index is not a table.
+lutok::pairs_range
+lutok::state::pairs(const int index)
+{
+    return pairs_range(*this, index);
+}
+
+
 /// Wrapper around lua_pcall.
 ///
 /// \param nargs The second parameter to lua_pcall.
@@ -675,14 +1435,17 @@ lutok::state::push_boolean(const bool value)
 /// extra magic to allow passing C++ functions instead of plain C functions.
 ///
 /// \param function The C++ function to be pushed as a closure.
-/// \param nvalues The number of upvalues that the function receives.
+/// \param nvalues The number of upvalues that the function receives.  Cannot
+///     be larger than 254.
 void
 lutok::state::push_cxx_closure(cxx_function function, const int nvalues)
 {
+    assert(nvalues >= 0 && nvalues <= max_cxx_closure_upvalues);
     cxx_function *data = static_cast< cxx_function* >(
         lua_newuserdata(_pimpl->lua_state, sizeof(cxx_function)));
     *data = function;
-    lua_pushcclosure(_pimpl->lua_state, cxx_closure_trampoline, nvalues + 1);
+    lua_pushcclosure(_pimpl->lua_state, cxx_closure_trampolines[nvalues],
+                     nvalues + 1);
 }
 
 
@@ -712,6 +1475,28 @@ lutok::state::push_integer(const int value)
 }
 
 
+/// Pushes a 64-bit integer onto the stack.
+///
+/// Lua 5.3 and later store the value as a native integer, which is 64 bits
+/// wide in the default configuration.  Earlier versions push values that do
+/// not fit a lua_Integer as floats, which is lossy for magnitudes above 2^53.
+///
+/// \param value The value to push.
+void
+lutok::state::push_integer64(const int64_t value)
+{
+#if LUA_VERSION_NUM >= 503
+    lua_pushinteger(_pimpl->lua_state, static_cast< lua_Integer >(value));
+#else
+    const lua_Integer narrowed = static_cast< lua_Integer >(value);
+    if (static_cast< int64_t >(narrowed) == value)
+        lua_pushinteger(_pimpl->lua_state, narrowed);
+    else
+        lua_pushnumber(_pimpl->lua_state, static_cast< lua_Number >(value));
+#endif
+}
+
+
 /// Wrapper around lua_pushnil.
 void
 lutok::state::push_nil(void)
@@ -720,15 +1505,69 @@ lutok::state::push_nil(void)
 }
 
 
+/// Wrapper around lua_pushnumber.
+///
+/// \param value The second parameter to lua_pushnumber.
+void
+lutok::state::push_number(const double value)
+{
+    lua_pushnumber(_pimpl->lua_state, value);
+}
+
+
+/// Pushes a C++ function held in static storage onto the stack.
+///
+/// Unlike push_cxx_function(), this does not allocate a userdata to hold the
+/// address of the function: the Lua function refers to the given pointer
+/// through a light userdata instead.
+///
+/// \param function Pointer to the C++ function to push.  The pointed-to
+///     variable must outlive all the uses of the Lua function, which usually
+///     means that it must have static storage duration.
+void
+lutok::state::push_static_cxx_function(const cxx_function* function)
+{
+    lua_pushlightuserdata(_pimpl->lua_state,
+                          const_cast< cxx_function* >(function));
+    lua_pushcclosure(_pimpl->lua_state, static_cxx_function_trampoline, 1);
+}
+
+
 /// Wrapper around lua_pushstring.
 ///
 /// \param str The second parameter to lua_pushstring.
 ///
 /// \warning Terminates execution if there is not enough memory.
 void
+lutok::state::push_string(const char* str)
+{
+    lua_pushstring(_pimpl->lua_state, str);
+}
+
+
+/// Wrapper around lua_pushlstring.
+///
+/// \param str The second parameter to lua_pushlstring.  May contain embedded
+///     NUL characters and does not need to be NUL-terminated.
+/// \param length The third parameter to lua_pushlstring.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
+lutok::state::push_string(const char* str, const std::size_t length)
+{
+    lua_pushlstring(_pimpl->lua_state, str, length);
+}
+
+
+/// Wrapper around lua_pushlstring for string objects.
+///
+/// \param str The string to push.  Any embedded NUL characters are preserved.
+///
+/// \warning Terminates execution if there is not enough memory.
+void
 lutok::state::push_string(const std::string& str)
 {
-    lua_pushstring(_pimpl->lua_state, str.c_str());
+    lua_pushlstring(_pimpl->lua_state, str.data(), str.length());
 }
 
 
@@ -785,6 +1624,19 @@ lutok::state::set_global(const std::string& name)
 }
 
 
+/// Wrapper around lua_setglobal without protection against errors.
+///
+/// \param name The second parameter to lua_setglobal.
+///
+/// \warning Errors are not reported as exceptions; see the class documentation
+/// for details.
+void
+lutok::state::set_global_unchecked(const std::string& name)
+{
+    lua_setglobal(_pimpl->lua_state, name.c_str());
+}
+
+
 /// Wrapper around lua_setmetatable.
 ///
 /// \param index The second parameter to lua_setmetatable.
@@ -816,6 +1668,21 @@ lutok::state::set_table(const int index)
 }
 
 
+/// Wrapper around lua_settable without protection against errors.
+///
+/// \param index The second parameter to lua_settable.
+///
+/// \warning Errors are not reported as exceptions; see the class documentation
+/// for details.
+void
+lutok::state::set_table_unchecked(const int index)
+{
+    assert(lua_gettop(_pimpl->lua_state) >= 3);
+    assert(lua_istable(_pimpl->lua_state, index));
+    lua_settable(_pimpl->lua_state, index);
+}
+
+
 /// Wrapper around lua_toboolean.
 ///
 /// \param index The second parameter to lua_toboolean.
@@ -842,6 +1709,47 @@ lutok::state::to_integer(const int index)
 }
 
 
+/// Gets a value on the stack as a 64-bit integer.
+///
+/// Lua 5.3 and later return native integers unchanged and convert floats with
+/// an integral value.  Earlier versions truncate the float representation of
+/// the number, which does not overflow even if lua_Integer is narrower than 64
+/// bits; infinities, NaN and values out of the range of int64_t cannot be
+/// converted.
+///
+/// \param index The stack index of the value.
+///
+/// \return The value as an integer, or 0 if it cannot be converted.
+int64_t
+lutok::state::to_integer64(const int index)
+{
+    assert(is_number(index));
+#if LUA_VERSION_NUM >= 503
+    return static_cast< int64_t >(lua_tointeger(_pimpl->lua_state, index));
+#else
+    const lua_Number value = lua_tonumber(_pimpl->lua_state, index);
+    const lua_Number truncated = value < 0 ? std::ceil(value) :
+        std::floor(value);
+    if (!is_integral_int64(truncated))
+        return 0;
+    return static_cast< int64_t >(truncated);
+#endif
+}
+
+
+/// Wrapper around lua_tonumber.
+///
+/// \param index The second parameter to lua_tonumber.
+///
+/// \return The return value of lua_tonumber.
+double
+lutok::state::to_number(const int index)
+{
+    assert(is_number(index));
+    return lua_tonumber(_pimpl->lua_state, index);
+}
+
+
 /// Wrapper around lua_touserdata.
 ///
 /// This is internal.  The public type-safe interface of this method should be
@@ -871,11 +1779,44 @@ std::string
 lutok::state::to_string(const int index)
 {
     assert(is_string(index));
-    const char *raw_string = lua_tostring(_pimpl->lua_state, index);
+    std::size_t length;
+    const char *raw_string = lua_tolstring(_pimpl->lua_state, index, &length);
     // Note that the creation of a string object below (explicit for clarity)
     // implies that the raw string is duplicated and, henceforth, the string is
     // safe even if the corresponding element is popped from the Lua stack.
-    return std::string(raw_string);
+    return std::string(raw_string, length);
+}
+
+
+/// Wrapper around lua_tolstring that does not copy the string.
+///
+/// \param index The second parameter to lua_tolstring.
+///
+/// \return A reference to the string held by Lua.  The reference is only valid
+/// while the value remains on the stack.  Note that, if the value is a number,
+/// Lua converts it to a string in place.
+lutok::string_ref
+lutok::state::to_string_ref(const int index)
+{
+    assert(is_string(index));
+    std::size_t length;
+    const char *raw_string = lua_tolstring(_pimpl->lua_state, index, &length);
+    return string_ref(raw_string, length);
+}
+
+
+/// Wrapper around lua_pcall that does not throw.
+///
+/// \param nargs The second parameter to lua_pcall.
+/// \param nresults The third parameter to lua_pcall.
+/// \param errfunc The fourth parameter to lua_pcall.
+///
+/// \return The status of the call.  On failure, the error object is left on
+/// the top of the stack.
+lutok::status
+lutok::state::try_pcall(const int nargs, const int nresults, const int errfunc)
+{
+    return status(lua_pcall(_pimpl->lua_state, nargs, nresults, errfunc));
 }
 
 
@@ -891,6 +1832,26 @@ lutok::state::upvalue_index(const int index)
 }
 
 
+/// Requests the suspension of the running coroutine.
+///
+/// This must be used as the return expression of a cxx_function, as in
+/// "return state.yield(1);".  The value returned by this method tells the C++
+/// trampolines to yield instead of returning once the C++ function has
+/// completed.  The values passed to the coroutine when it is resumed become the
+/// results of the C++ function.
+///
+/// \param nresults The number of values on the top of the stack to pass to
+///     the resumer.
+///
+/// \return A value to be returned by the calling cxx_function.
+int
+lutok::state::yield(const int nresults)
+{
+    assert(nresults >= 0);
+    return -nresults - 1;
+}
+
+
 /// Gets the internal lua_State object.
 ///
 /// \return The raw Lua state.  This is returned as a void pointer to prevent
@@ -902,3 +1863,37 @@ lutok::state::raw_state(void)
 {
     return _pimpl->lua_state;
 }
+
+
+/// Wraps a raw Lua state without allocating memory.
+///
+/// \param raw_state The raw Lua state to wrap.  The state is not owned by this
+///     object and thus it is not closed on destruction.
+lutok::state_ref::state_ref(lua_State* raw_state) :
+    _state(static_cast< void* >(raw_state), &_storage)
+{
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    static_assert(sizeof(state::impl) <= sizeof(storage),
+                  "state_ref storage too small for state::impl");
+#else
+    assert(sizeof(state::impl) <= sizeof(storage));
+#endif
+}
+
+
+/// Destructor.
+///
+/// Destroying this object has no implications on the life cycle of the Lua
+/// state.
+lutok::state_ref::~state_ref(void)
+{
+}
+
+
+/// Gets the wrapped state.
+///
+/// \return A reference to the wrapped state, valid while this object is alive.
+lutok::state_ref::operator state&(void)
+{
+    return _state;
+}
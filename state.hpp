@@ -32,6 +32,10 @@
 #if !defined(LUTOK_STATE_HPP)
 #define LUTOK_STATE_HPP
 
+#include <stdint.h>
+
+#include <cstddef>
+#include <iosfwd>
 #include <string>
 
 #if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
@@ -40,11 +44,18 @@
 #include <tr1/memory>
 #endif
 
+struct lua_State;
+
 namespace lutok {
 
 
+class allocator;
 class debug;
+class pairs_range;
+class stack_cleaner;
+class stack_reserve;
 class state;
+class state_ref;
 
 
 /// The type of a C++ function that can be bound into Lua.
@@ -52,6 +63,10 @@ class state;
 /// Functions of this type are free to raise exceptions.  These will not
 /// propagate into the Lua C API.  However, any such exceptions will be reported
 /// as a Lua error and their type will be lost.
+///
+/// Functions of this type return the number of results they pushed onto the
+/// stack or, to suspend the coroutine running them, the value returned by
+/// state::yield().
 typedef int (*cxx_function)(state&);
 
 
@@ -59,6 +74,53 @@ typedef int (*cxx_function)(state&);
 extern const int registry_index;
 
 
+/// A non-owning reference to a string held by Lua.
+///
+/// Objects of this class are returned by state::to_string_ref() to provide
+/// access to the contents of a string without copying it.  The referenced
+/// string is owned by Lua, which means that the object is only valid while the
+/// corresponding value remains on the Lua stack.
+///
+/// Strings referenced by this class may contain embedded NUL characters and
+/// are not guaranteed to be NUL-terminated from the point of view of the user,
+/// so always use length() to know their size.
+class string_ref {
+    /// Pointer to the first character of the string.
+    const char* _data;
+
+    /// Length of the string, in bytes.
+    std::size_t _length;
+
+public:
+    string_ref(const char*, const std::size_t);
+
+    const char* data(void) const;
+    std::size_t length(void) const;
+    std::string str(void) const;
+};
+
+
+/// The outcome of an operation that reports errors without throwing.
+///
+/// Objects of this class are returned by the try_* variants of the operations
+/// that usually raise exceptions, which are cheaper when failures are common.
+/// A failed operation leaves its error object on the top of the stack, as the
+/// Lua C API does, and its message is only converted into a C++ string if
+/// message() is called.  The caller is responsible for popping the error
+/// object.
+class status {
+    /// The Lua status code; LUA_OK (0) on success.
+    int _code;
+
+public:
+    explicit status(const int);
+
+    int code(void) const;
+    std::string message(state&) const;
+    bool ok(void) const;
+};
+
+
 /// A RAII model for the Lua state.
 ///
 /// This class holds the state of the Lua interpreter during its existence and
@@ -73,6 +135,21 @@ extern const int registry_index;
 /// situations, they are pretty complex because they need to do extra work to
 /// capture the errors reported by the Lua C API.  We prefer having fine-grained
 /// error control rather than efficiency, so this is OK.
+///
+/// For those situations where the extra work is too costly, the methods
+/// suffixed by _unchecked provide the same functionality as their protected
+/// counterparts but call the Lua C API directly.  The caller is responsible
+/// for ensuring that these operations cannot fail, e.g. by only using them on
+/// plain tables without metatables.  Any error raised within these methods is
+/// not converted to an exception: instead, Lua unwinds the C stack to the
+/// closest enclosing protected call or, in the absence of one, aborts the
+/// program.
+///
+/// The get(), is(), push() and push_all() templates provide typed access to
+/// the stack.  They are defined in state.ipp, dispatch on the type of their
+/// values at compile time through the stack_traits class template, and inline
+/// down to the Lua C API.  Support for additional types can be added by
+/// specializing stack_traits.
 class state {
     struct impl;
 
@@ -86,57 +163,109 @@ class state {
     void* new_userdata_voidp(const size_t);
     void* to_userdata_voidp(const int);
 
+    friend class stack_cleaner;
+    friend class stack_reserve;
     friend class state_c_gate;
+    friend class state_ref;
     explicit state(void*);
+    state(void*, void*);
     void* raw_state(void);
 
 public:
     state(void);
+    explicit state(allocator&);
+    state(const state&);
     ~state(void);
 
+    state& operator=(const state&);
+
     void close(void);
+    std::string dump(void);
+    void gc_collect(void);
+    unsigned int gc_count(void);
+    void gc_restart(void);
+    void gc_set_generational(void);
+    void gc_set_incremental(void);
+    int gc_set_pause(const int);
+    int gc_set_step_multiplier(const int);
+    bool gc_step(const int);
+    void gc_stop(void);
+    template< typename Type > Type get(const int);
     void get_global(const std::string&);
+    void get_global_unchecked(const std::string&);
     void get_global_table(void);
     bool get_metafield(const int, const std::string&);
     bool get_metatable(const int);
     void get_table(const int);
+    void get_table_unchecked(const int);
     int get_top(void);
     void insert(const int);
+    template< typename Type > bool is(const int);
     bool is_boolean(const int);
     bool is_function(const int);
+    bool is_integer(const int);
     bool is_nil(const int);
     bool is_number(const int);
     bool is_string(const int);
     bool is_table(const int);
     bool is_userdata(const int);
+    void load_buffer(const char*, const std::size_t, const std::string&);
     void load_file(const std::string&);
+    void load_mapped_file(const std::string&);
+    void load_stream(std::istream&, const std::string&);
     void load_string(const std::string&);
     void new_table(void);
+    void new_table(const int, const int);
     template< typename Type > Type* new_userdata(void);
     bool next(const int);
+    bool next_unchecked(const int);
     void open_all(void);
     void open_base(void);
     void open_string(void);
     void open_table(void);
+    pairs_range pairs(const int);
     void pcall(const int, const int, const int);
     void pop(const int);
+    template< typename Type > void push(const Type&);
+    template< typename Type1, typename Type2 >
+    void push_all(const Type1&, const Type2&);
+    template< typename Type1, typename Type2, typename Type3 >
+    void push_all(const Type1&, const Type2&, const Type3&);
+    template< typename Type1, typename Type2, typename Type3, typename Type4 >
+    void push_all(const Type1&, const Type2&, const Type3&, const Type4&);
+    template< typename Type1, typename Type2, typename Type3, typename Type4,
+              typename Type5 >
+    void push_all(const Type1&, const Type2&, const Type3&, const Type4&,
+                  const Type5&);
     void push_boolean(const bool);
     void push_cxx_closure(cxx_function, const int);
     void push_cxx_function(cxx_function);
     void push_integer(const int);
+    void push_integer64(const int64_t);
     void push_nil(void);
+    void push_number(const double);
+    void push_static_cxx_function(const cxx_function*);
+    void push_string(const char*);
+    void push_string(const char*, const std::size_t);
     void push_string(const std::string&);
     void push_value(const int);
     void raw_get(const int);
     void raw_set(const int);
     void set_global(const std::string&);
+    void set_global_unchecked(const std::string&);
     void set_metatable(const int);
     void set_table(const int);
+    void set_table_unchecked(const int);
     bool to_boolean(const int);
     long to_integer(const int);
+    int64_t to_integer64(const int);
+    double to_number(const int);
     template< typename Type > Type* to_userdata(const int);
     std::string to_string(const int);
+    string_ref to_string_ref(const int);
+    status try_pcall(const int, const int, const int);
     int upvalue_index(const int);
+    int yield(const int);
 };
 
 
@@ -29,11 +29,481 @@
 #if !defined(LUTOK_STATE_IPP)
 #define LUTOK_STATE_IPP
 
+#include <cassert>
+#include <cstddef>
+#include <string>
+
+#include <lua.hpp>
 #include <lutok/state.hpp>
 
 namespace lutok {
 
 
+/// Internal implementation for lutok::state.
+///
+/// This is defined here rather than in state.cpp so that the inline templates
+/// below and the inline stack guards can reach the raw Lua state.  Reading it
+/// through the shared implementation, instead of caching it in every state
+/// object, ensures that all copies of a state notice when it is closed.
+struct state::impl {
+    /// The Lua internal state.
+    lua_State* lua_state;
+
+    /// Whether we own the state or not (to decide if we close it).
+    bool owned;
+
+    /// Whether this object lives in storage provided by a state_ref.
+    ///
+    /// Such storage disappears when the state_ref goes out of scope, so
+    /// copies of states using it cannot share it.
+    bool borrowed;
+
+    /// Constructor.
+    ///
+    /// \param lua_ The Lua internal state.
+    /// \param owned_ Whether we own the state or not.
+    /// \param borrowed_ Whether the object lives in external storage.
+    impl(lua_State* lua_, bool owned_, bool borrowed_ = false) :
+        lua_state(lua_),
+        owned(owned_),
+        borrowed(borrowed_)
+    {
+    }
+};
+
+
+namespace detail {
+
+
+/// Type with the alignment that Lua guarantees for the userdata it allocates.
+union userdata_alignment {
+    /// Floating point member.
+    double number;
+    /// Pointer member.
+    void* pointer;
+    /// Integral member.
+    long integer;
+};
+
+
+}  // namespace detail
+
+
+/// Conversions between C++ values and values on the Lua stack.
+///
+/// This class template provides the implementation of the typed accessors of
+/// the state class: state::get(), state::is() and state::push().  There is no
+/// generic definition: every supported type has its own specialization, which
+/// means that using the accessors with an unsupported type is a compile-time
+/// error.
+///
+/// Specializations must provide the following static methods, although they
+/// can omit those that make no sense for their type:
+///
+/// - static bool is(lua_State*, const int): checks if the value at the given
+///   index can be converted to the type.
+/// - static Type get(lua_State*, const int): converts the value at the given
+///   index to the type.  The value is guaranteed to pass the is() check.
+/// - static void push(lua_State*, const Type&): pushes a value of the type onto
+///   the stack.
+/// - static const char* name(lua_State*): gets the name of the Lua type that
+///   is() accepts, for use in error messages.  The string must remain valid
+///   while the state is alive.
+///
+/// Users can specialize this template for their own types.
+template< typename Type >
+struct stack_traits;
+
+
+/// Conversions for booleans.
+template<>
+struct stack_traits< bool > {
+    /// Checks if a value is a boolean.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a boolean.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isboolean(raw_state, index);
+    }
+
+    /// Gets a boolean from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static bool
+    get(lua_State* raw_state, const int index)
+    {
+        return lua_toboolean(raw_state, index) != 0;
+    }
+
+    /// Pushes a boolean onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const bool& value)
+    {
+        lua_pushboolean(raw_state, value);
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "boolean";
+    }
+};
+
+
+/// Conversions for integers.
+template<>
+struct stack_traits< int > {
+    /// Checks if a value is a number.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a number or a string convertible to one.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isnumber(raw_state, index);
+    }
+
+    /// Gets a number from the stack as an integer.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static int
+    get(lua_State* raw_state, const int index)
+    {
+        return static_cast< int >(lua_tointeger(raw_state, index));
+    }
+
+    /// Pushes an integer onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const int& value)
+    {
+        lua_pushinteger(raw_state, value);
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "number";
+    }
+};
+
+
+/// Conversions for long integers.
+template<>
+struct stack_traits< long > {
+    /// Checks if a value is a number.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a number or a string convertible to one.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isnumber(raw_state, index);
+    }
+
+    /// Gets a number from the stack as a long integer.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static long
+    get(lua_State* raw_state, const int index)
+    {
+        return static_cast< long >(lua_tointeger(raw_state, index));
+    }
+
+    /// Pushes a long integer onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const long& value)
+    {
+        lua_pushinteger(raw_state, static_cast< lua_Integer >(value));
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "number";
+    }
+};
+
+
+/// Conversions for floating point numbers.
+template<>
+struct stack_traits< double > {
+    /// Checks if a value is a number.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a number or a string convertible to one.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isnumber(raw_state, index);
+    }
+
+    /// Gets a number from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static double
+    get(lua_State* raw_state, const int index)
+    {
+        return static_cast< double >(lua_tonumber(raw_state, index));
+    }
+
+    /// Pushes a floating point number onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const double& value)
+    {
+        lua_pushnumber(raw_state, static_cast< lua_Number >(value));
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "number";
+    }
+};
+
+
+/// Conversions for strings.
+template<>
+struct stack_traits< std::string > {
+    /// Checks if a value is a string.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a string or a number.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isstring(raw_state, index);
+    }
+
+    /// Gets a copy of a string from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value, which may contain embedded NUL characters.
+    static std::string
+    get(lua_State* raw_state, const int index)
+    {
+        std::size_t length;
+        const char* data = lua_tolstring(raw_state, index, &length);
+        return std::string(data, length);
+    }
+
+    /// Pushes a string onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const std::string& value)
+    {
+        lua_pushlstring(raw_state, value.data(), value.length());
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "string";
+    }
+};
+
+
+/// Conversions for non-owning references to strings.
+template<>
+struct stack_traits< string_ref > {
+    /// Checks if a value is a string.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a string or a number.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isstring(raw_state, index);
+    }
+
+    /// Gets a reference to a string on the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.  Numbers are converted to
+    ///     strings in place.
+    ///
+    /// \return A reference that remains valid while the value is on the stack.
+    static string_ref
+    get(lua_State* raw_state, const int index)
+    {
+        std::size_t length;
+        const char* data = lua_tolstring(raw_state, index, &length);
+        return string_ref(data, length);
+    }
+
+    /// Pushes a copy of a string onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const string_ref& value)
+    {
+        lua_pushlstring(raw_state, value.data(), value.length());
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "string";
+    }
+};
+
+
+/// Conversions for C strings.
+template<>
+struct stack_traits< const char* > {
+    /// Checks if a value is a string.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a string or a number.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_isstring(raw_state, index);
+    }
+
+    /// Gets a pointer to a string on the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return A pointer that remains valid while the value is on the stack.
+    static const char*
+    get(lua_State* raw_state, const int index)
+    {
+        return lua_tostring(raw_state, index);
+    }
+
+    /// Pushes a copy of a NUL-terminated string onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const char* const& value)
+    {
+        lua_pushstring(raw_state, value);
+    }
+
+    /// Gets the name of the type of the values accepted by is().
+    ///
+    /// \return The name of the type, for error messages.
+    static const char*
+    name(lua_State* /* raw_state */)
+    {
+        return "string";
+    }
+};
+
+
+/// Conversions for string literals.
+///
+/// This only allows pushing literals; use the std::string or const char*
+/// conversions to get values from the stack.
+template< std::size_t Length >
+struct stack_traits< char[Length] > {
+    /// Pushes a copy of a string literal onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const char (&value)[Length])
+    {
+        lua_pushstring(raw_state, value);
+    }
+};
+
+
+/// Gets a value from the stack.
+///
+/// \param index The stack index of the value.
+///
+/// \pre The value at the given index must be convertible to the type, as
+///     reported by is().
+///
+/// \return The converted value.
+template< typename Type >
+Type
+state::get(const int index)
+{
+    assert(stack_traits< Type >::is(_pimpl->lua_state, index));
+    return stack_traits< Type >::get(_pimpl->lua_state, index);
+}
+
+
+/// Checks if a value of the stack is convertible to a given type.
+///
+/// \param index The stack index of the value.
+///
+/// \return True if get() can be called for the value.
+template< typename Type >
+bool
+state::is(const int index)
+{
+    return stack_traits< Type >::is(_pimpl->lua_state, index);
+}
+
+
 /// Wrapper around lua_newuserdata.
 ///
 /// This allocates an object as big as the size of the provided Type.
@@ -49,6 +519,94 @@ state::new_userdata(void)
 }
 
 
+/// Pushes a value onto the stack.
+///
+/// \param value The value to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type >
+void
+state::push(const Type& value)
+{
+    stack_traits< Type >::push(_pimpl->lua_state, value);
+}
+
+
+/// Pushes two values onto the stack.
+///
+/// \param value1 The first value to push.
+/// \param value2 The second value to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type1, typename Type2 >
+void
+state::push_all(const Type1& value1, const Type2& value2)
+{
+    push(value1);
+    push(value2);
+}
+
+
+/// Pushes three values onto the stack.
+///
+/// \param value1 The first value to push.
+/// \param value2 The second value to push.
+/// \param value3 The third value to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type1, typename Type2, typename Type3 >
+void
+state::push_all(const Type1& value1, const Type2& value2, const Type3& value3)
+{
+    push(value1);
+    push(value2);
+    push(value3);
+}
+
+
+/// Pushes four values onto the stack.
+///
+/// \param value1 The first value to push.
+/// \param value2 The second value to push.
+/// \param value3 The third value to push.
+/// \param value4 The fourth value to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type1, typename Type2, typename Type3, typename Type4 >
+void
+state::push_all(const Type1& value1, const Type2& value2, const Type3& value3,
+                const Type4& value4)
+{
+    push(value1);
+    push(value2);
+    push(value3);
+    push(value4);
+}
+
+
+/// Pushes five values onto the stack.
+///
+/// \param value1 The first value to push.
+/// \param value2 The second value to push.
+/// \param value3 The third value to push.
+/// \param value4 The fourth value to push.
+/// \param value5 The fifth value to push.
+///
+/// \warning Terminates execution if there is not enough memory.
+template< typename Type1, typename Type2, typename Type3, typename Type4,
+          typename Type5 >
+void
+state::push_all(const Type1& value1, const Type2& value2, const Type3& value3,
+                const Type4& value4, const Type5& value5)
+{
+    push(value1);
+    push(value2);
+    push(value3);
+    push(value4);
+    push(value5);
+}
+
+
 /// Wrapper around lua_touserdata.
 ///
 /// \param index The second parameter to lua_touserdata.
@@ -0,0 +1,583 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "state_pool.hpp"
+
+extern "C" {
+#include <pthread.h>
+#include <unistd.h>
+}
+
+#include <cassert>
+#include <vector>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <atomic>
+#endif
+
+#include "internal.hpp"
+#include "operations.hpp"
+#include "state.hpp"
+#include "state_template.hpp"
+
+
+namespace {
+
+
+using lutok::detail::mutex_locker;
+
+
+/// Collection of idle states protected by its own lock.
+struct shard {
+    /// Lock protecting all the fields of this structure.
+    pthread_mutex_t mutex;
+
+    /// Idle states.  The capacity of the vector is reserved upfront so that
+    /// returning a state never allocates memory.
+    std::vector< lutok::state* > states;
+
+    /// Number of states handed out without waiting.
+    std::size_t hits;
+
+    /// Number of states replaced after failing the verification on return.
+    std::size_t discards;
+
+    /// Constructor.
+    ///
+    /// \param capacity Maximum number of states that the shard can hold.
+    explicit shard(const std::size_t capacity) :
+        hits(0),
+        discards(0)
+    {
+        ::pthread_mutex_init(&mutex, NULL);
+        states.reserve(capacity);
+    }
+
+    /// Destructor.
+    ~shard(void)
+    {
+        ::pthread_mutex_destroy(&mutex);
+    }
+};
+
+
+/// Computes a hash that identifies the current thread.
+///
+/// \return A number that is stable across calls from the same thread.
+static std::size_t
+current_thread_hash(void)
+{
+    const pthread_t self = ::pthread_self();
+    const unsigned char* bytes = reinterpret_cast< const unsigned char* >(
+        &self);
+
+    std::size_t hash = 0;
+    for (std::size_t i = 0; i < sizeof(self); i++)
+        hash = hash * 31 + bytes[i];
+    return hash ^ (hash >> 16);
+}
+
+
+/// Computes the number of shards for a pool.
+///
+/// \param size The number of states in the pool.
+///
+/// \return The number of online processors, bounded by the number of states.
+static std::size_t
+compute_shards(const std::size_t size)
+{
+    const long cpus = ::sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    else if (static_cast< std::size_t >(cpus) > size)
+        return size;
+    else
+        return static_cast< std::size_t >(cpus);
+}
+
+
+/// Creates and initializes a new state.
+///
+/// \param recipe The template to instantiate in the state.
+/// \param setup The function to initialize the state with after instantiating
+///     the template, or NULL.
+///
+/// \return A dynamically-allocated state.
+///
+/// \throw Any exception thrown by the template or the setup function.
+static lutok::state*
+create_state(const lutok::state_template& recipe,
+             lutok::state_pool::setup_function setup)
+{
+    lutok::state* state = new lutok::state();
+    try {
+        recipe.instantiate(*state);
+        if (setup != NULL)
+            setup(*state);
+    } catch (...) {
+        state->pop(state->get_top());
+        delete state;
+        throw;
+    }
+    assert(state->get_top() == 0);
+    return state;
+}
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::state_pool.
+struct lutok::state_pool::impl {
+    /// The template used to initialize new states.
+    state_template recipe;
+
+    /// The function used to initialize new states after instantiating the
+    /// template.
+    setup_function setup;
+
+    /// Whether to verify the states returned to the pool.
+    bool verify;
+
+    /// Total number of states owned by the pool.
+    std::size_t size;
+
+    /// Shards holding the idle states.
+    std::vector< shard* > shards;
+
+    /// Lock for the threads waiting for a state to become available.
+    pthread_mutex_t wait_mutex;
+
+    /// Condition signaled when a state is returned while threads are waiting.
+    pthread_cond_t available;
+
+    /// Number of requests that did not find an idle state immediately.
+    ///
+    /// Protected by wait_mutex.
+    std::size_t waits;
+
+    /// Number of threads currently waiting for a state.
+    ///
+    /// Only modified while holding wait_mutex.  Where atomic operations are
+    /// available, this is read without holding the lock so that returning a
+    /// state does not need to take the global lock when nobody is waiting.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::atomic< std::size_t > waiters;
+#else
+    std::size_t waiters;
+#endif
+
+    /// Constructor.
+    ///
+    /// \param size_ The number of states in the pool.
+    /// \param recipe_ The template used to initialize new states.
+    /// \param setup_ The function used to initialize new states.
+    /// \param verify_ Whether to verify the states returned to the pool.
+    impl(const std::size_t size_, const state_template& recipe_,
+         setup_function setup_, const bool verify_) :
+        recipe(recipe_),
+        setup(setup_),
+        verify(verify_),
+        size(size_),
+        waits(0),
+        waiters(0)
+    {
+        ::pthread_mutex_init(&wait_mutex, NULL);
+        ::pthread_cond_init(&available, NULL);
+    }
+
+    /// Creates the shards and fills them with new states.
+    ///
+    /// \throw Any exception thrown while initializing the states.
+    void
+    populate(void)
+    {
+        const std::size_t nshards = compute_shards(size);
+        for (std::size_t i = 0; i < nshards; i++)
+            shards.push_back(new shard(size));
+
+        for (std::size_t i = 0; i < size; i++)
+            shards[i % nshards]->states.push_back(create_state(recipe, setup));
+    }
+
+    /// Destructor.
+    ///
+    /// Closes all the states in the pool.  All of them must have been returned
+    /// to the pool by now.
+    ~impl(void)
+    {
+        for (std::vector< shard* >::iterator iter = shards.begin();
+             iter != shards.end(); ++iter) {
+            for (std::vector< state* >::iterator iter2 =
+                 (*iter)->states.begin(); iter2 != (*iter)->states.end();
+                 ++iter2)
+                delete *iter2;
+            delete *iter;
+        }
+        ::pthread_cond_destroy(&available);
+        ::pthread_mutex_destroy(&wait_mutex);
+    }
+
+    /// Takes an idle state out of the shards, if any.
+    ///
+    /// \param home The index of the shard to look into first.
+    /// \param block Whether to wait for the locks of the shards.  If false,
+    ///     busy shards other than the home one are skipped.
+    ///
+    /// \return The idle state, or NULL if none was found.
+    state*
+    take(const std::size_t home, const bool block)
+    {
+        for (std::size_t i = 0; i < shards.size(); i++) {
+            shard* candidate = shards[(home + i) % shards.size()];
+            if (i == 0 || block)
+                ::pthread_mutex_lock(&candidate->mutex);
+            else if (::pthread_mutex_trylock(&candidate->mutex) != 0)
+                continue;
+
+            state* found = NULL;
+            if (!candidate->states.empty()) {
+                found = candidate->states.back();
+                candidate->states.pop_back();
+                if (!block)
+                    candidate->hits++;
+            }
+            ::pthread_mutex_unlock(&candidate->mutex);
+
+            if (found != NULL)
+                return found;
+        }
+        return NULL;
+    }
+
+    /// Puts a state back into a shard and wakes up a waiting thread, if any.
+    ///
+    /// \param target The shard to return the state to.
+    /// \param returned The state to return.
+    /// \param at_front Whether to put the state where it is picked up last.
+    ///     This never allocates memory, as the capacity of the shards is
+    ///     reserved upfront.
+    void
+    put(shard* target, state* returned, const bool at_front)
+    {
+        {
+            mutex_locker locker(target->mutex);
+            if (at_front)
+                target->states.insert(target->states.begin(), returned);
+            else
+                target->states.push_back(returned);
+        }
+
+        if (has_waiters()) {
+            mutex_locker locker(wait_mutex);
+            ::pthread_cond_signal(&available);
+        }
+    }
+
+    /// Checks if there are threads waiting for a state.
+    ///
+    /// \return True if there are waiting threads.
+    bool
+    has_waiters(void)
+    {
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+        return waiters.load() > 0;
+#else
+        mutex_locker locker(wait_mutex);
+        return waiters > 0;
+#endif
+    }
+};
+
+
+/// Constructs a new pool and initializes all of its states.
+///
+/// \param size The number of states in the pool.  Must be positive.
+/// \param setup The function used to initialize the states, or NULL to leave
+///     them as created by the state constructor.
+/// \param verify Whether to check that states are returned with an empty
+///     stack, and replace those that are not.
+///
+/// \throw Any exception thrown by the setup function.
+lutok::state_pool::state_pool(const std::size_t size, setup_function setup,
+                              const bool verify) :
+    _pimpl(new impl(size, state_template(), setup, verify))
+{
+    assert(size > 0);
+    _pimpl->populate();
+}
+
+
+/// Constructs a new pool and initializes all of its states from a template.
+///
+/// \param size The number of states in the pool.  Must be positive.
+/// \param recipe The template to instantiate in every state.
+/// \param verify Whether to check that states are returned with an empty
+///     stack, and replace those that are not.
+///
+/// \throw error If the template cannot be instantiated.
+lutok::state_pool::state_pool(const std::size_t size,
+                              const state_template& recipe,
+                              const bool verify) :
+    _pimpl(new impl(size, recipe, NULL, verify))
+{
+    assert(size > 0);
+    _pimpl->populate();
+}
+
+
+/// Destructor.
+///
+/// All the leases must have been returned before the pool is destroyed.
+lutok::state_pool::~state_pool(void)
+{
+    assert(idle() == size());
+}
+
+
+/// Checks out a state from the pool, waiting for one if necessary.
+///
+/// \return An idle state.
+lutok::state*
+lutok::state_pool::acquire(void)
+{
+    const std::size_t home = current_thread_hash() % _pimpl->shards.size();
+
+    state* found = _pimpl->take(home, false);
+    if (found != NULL)
+        return found;
+
+    mutex_locker locker(_pimpl->wait_mutex);
+    _pimpl->waits++;
+    _pimpl->waiters++;
+    while ((found = _pimpl->take(home, true)) == NULL)
+        ::pthread_cond_wait(&_pimpl->available, &_pimpl->wait_mutex);
+    _pimpl->waiters--;
+    return found;
+}
+
+
+/// Returns a state to the pool.
+///
+/// If verification is enabled and the state has a non-empty stack, the state
+/// is replaced by a new one.  Should creating the replacement fail, the stack
+/// of the state is cleared and the state is reused.
+///
+/// \param returned The state to return, as previously given by acquire().
+void
+lutok::state_pool::release(state* returned)
+{
+    bool discarded = false;
+    if (_pimpl->verify && returned->get_top() != 0) {
+        returned->pop(returned->get_top());
+        try {
+            state* replacement = create_state(_pimpl->recipe,
+                                              _pimpl->setup);
+            delete returned;
+            returned = replacement;
+            discarded = true;
+        } catch (...) {
+            // Keep the returned state; its stack is clean now.
+        }
+    }
+
+    shard* home = _pimpl->shards[current_thread_hash() %
+                                 _pimpl->shards.size()];
+    if (discarded) {
+        mutex_locker locker(home->mutex);
+        home->discards++;
+    }
+    _pimpl->put(home, returned, false);
+}
+
+
+/// Runs bounded garbage collection on the idle states of the pool.
+///
+/// This is meant to be called from a thread that has nothing else to do, such
+/// as a worker between requests or a dedicated maintenance thread, so that
+/// collection work happens outside of the leases.  Idle states are taken out
+/// of the pool one at a time and stepped with collect_idle(); threads asking
+/// for a state meanwhile get any of the others.  States are put back where
+/// they are picked up last, so repeated calls rotate over the whole pool.
+///
+/// \param time_limit Maximum time to spend collecting across all states, in
+///     microseconds.  The limit can be exceeded by the length of one step.
+///
+/// \return The number of states that completed a collection cycle.
+std::size_t
+lutok::state_pool::collect_idle(const unsigned long time_limit)
+{
+    const double deadline = detail::now_nanoseconds() / 1000.0 +
+        time_limit;
+    std::size_t completed = 0;
+    for (std::size_t i = 0; i < _pimpl->shards.size(); i++) {
+        shard* current = _pimpl->shards[i];
+        std::size_t pending;
+        {
+            mutex_locker locker(current->mutex);
+            pending = current->states.size();
+        }
+
+        for (; pending > 0; pending--) {
+            const double now = detail::now_nanoseconds() / 1000.0;
+            if (now >= deadline)
+                return completed;
+
+            state* found;
+            {
+                mutex_locker locker(current->mutex);
+                if (current->states.empty())
+                    break;
+                found = current->states.back();
+                current->states.pop_back();
+            }
+            if (lutok::collect_idle(*found, static_cast< unsigned long >(
+                    deadline - now)))
+                completed++;
+            _pimpl->put(current, found, true);
+        }
+    }
+    return completed;
+}
+
+
+/// Gets the number of states replaced after failing verification on return.
+///
+/// \return A counter.
+std::size_t
+lutok::state_pool::discards(void) const
+{
+    std::size_t total = 0;
+    for (std::vector< shard* >::const_iterator iter = _pimpl->shards.begin();
+         iter != _pimpl->shards.end(); ++iter) {
+        mutex_locker locker((*iter)->mutex);
+        total += (*iter)->discards;
+    }
+    return total;
+}
+
+
+/// Gets the number of requests that found an idle state immediately.
+///
+/// \return A counter.
+std::size_t
+lutok::state_pool::hits(void) const
+{
+    std::size_t total = 0;
+    for (std::vector< shard* >::const_iterator iter = _pimpl->shards.begin();
+         iter != _pimpl->shards.end(); ++iter) {
+        mutex_locker locker((*iter)->mutex);
+        total += (*iter)->hits;
+    }
+    return total;
+}
+
+
+/// Gets the number of states currently in the pool.
+///
+/// \return The number of states not lent out.
+std::size_t
+lutok::state_pool::idle(void) const
+{
+    std::size_t total = 0;
+    for (std::vector< shard* >::const_iterator iter = _pimpl->shards.begin();
+         iter != _pimpl->shards.end(); ++iter) {
+        mutex_locker locker((*iter)->mutex);
+        total += (*iter)->states.size();
+    }
+    return total;
+}
+
+
+/// Gets the number of states owned by the pool.
+///
+/// \return The size of the pool, including the states that are lent out.
+std::size_t
+lutok::state_pool::size(void) const
+{
+    return _pimpl->size;
+}
+
+
+/// Gets the number of requests that did not find an idle state immediately.
+///
+/// \return A counter.
+std::size_t
+lutok::state_pool::waits(void) const
+{
+    mutex_locker locker(_pimpl->wait_mutex);
+    return _pimpl->waits;
+}
+
+
+/// Checks out a state from a pool.
+///
+/// \param pool The pool to borrow the state from.  If all of its states are
+///     in use, this blocks until one is returned.
+lutok::state_lease::state_lease(state_pool& pool) :
+    _pool(pool),
+    _state(pool.acquire())
+{
+}
+
+
+/// Returns the state to its pool.
+lutok::state_lease::~state_lease(void)
+{
+    _pool.release(_state);
+}
+
+
+/// Gets the borrowed state.
+///
+/// \return A reference to the state, valid during the lifetime of the lease.
+lutok::state&
+lutok::state_lease::get(void)
+{
+    return *_state;
+}
+
+
+/// Gets the borrowed state.
+///
+/// \return A reference to the state, valid during the lifetime of the lease.
+lutok::state&
+lutok::state_lease::operator*(void)
+{
+    return *_state;
+}
+
+
+/// Accesses the borrowed state.
+///
+/// \return A pointer to the state, valid during the lifetime of the lease.
+lutok::state*
+lutok::state_lease::operator->(void)
+{
+    return _state;
+}
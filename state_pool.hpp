@@ -0,0 +1,138 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file state_pool.hpp
+/// Provides a pool of pre-initialized Lua states for multi-threaded programs.
+
+#if !defined(LUTOK_STATE_POOL_HPP)
+#define LUTOK_STATE_POOL_HPP
+
+#include <cstddef>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class state;
+class state_lease;
+class state_template;
+
+
+/// Pool of pre-initialized Lua states.
+///
+/// A state can only be used by one thread at a time and is expensive to set
+/// up, so multi-threaded programs should not create a state per task.
+/// Instead, a pool creates a fixed number of states upfront, initializes each
+/// of them with a user-provided function or state_template, and lends them to
+/// threads through state_lease objects.
+///
+/// Idle states are spread across several shards, each protected by its own
+/// lock, and threads look first into a shard of their own.  This way,
+/// threads running on different processors rarely contend with each other.
+/// When all states are in use, threads requesting one block until another
+/// thread returns a state to the pool.
+///
+/// Optionally, the pool can verify that states are returned with an empty
+/// stack.  States that fail this check are considered to be in an unknown
+/// condition, so they are closed and replaced by freshly initialized ones.
+class state_pool {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    friend class state_lease;
+    state* acquire(void);
+    void release(state*);
+
+    /// Disallow copies.
+    state_pool(const state_pool&);
+
+    /// Disallow assignment.
+    state_pool& operator=(const state_pool&);
+
+public:
+    /// Function to initialize the states of a pool.
+    ///
+    /// The function receives a newly-created state and must leave its stack
+    /// empty.  The function may throw exceptions to indicate an error.
+    typedef void (*setup_function)(state&);
+
+    state_pool(const std::size_t, setup_function, const bool);
+    state_pool(const std::size_t, const state_template&, const bool);
+    ~state_pool(void);
+
+    std::size_t collect_idle(const unsigned long);
+    std::size_t discards(void) const;
+    std::size_t hits(void) const;
+    std::size_t idle(void) const;
+    std::size_t size(void) const;
+    std::size_t waits(void) const;
+};
+
+
+/// RAII holder for a state borrowed from a state_pool.
+///
+/// Creating an object of this class checks a state out of the pool, blocking
+/// if none is available, and destroying the object returns the state to the
+/// pool.  The lease must not live longer than the pool.
+class state_lease {
+    /// The pool the state belongs to.
+    state_pool& _pool;
+
+    /// The borrowed state.
+    state* _state;
+
+    /// Disallow copies.
+    state_lease(const state_lease&);
+
+    /// Disallow assignment.
+    state_lease& operator=(const state_lease&);
+
+public:
+    explicit state_lease(state_pool&);
+    ~state_lease(void);
+
+    state& get(void);
+    state& operator*(void);
+    state* operator->(void);
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_STATE_POOL_HPP)
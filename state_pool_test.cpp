@@ -0,0 +1,332 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "state_pool.hpp"
+
+extern "C" {
+#include <pthread.h>
+#include <unistd.h>
+}
+
+#include <stdexcept>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "operations.hpp"
+#include "state.ipp"
+#include "state_template.hpp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Number of times that setup_counter has been called.
+static int setup_calls = 0;
+
+
+/// Initializes a state by defining a global counter in it.
+///
+/// \param state The state to initialize.
+static void
+setup_counter(lutok::state& state)
+{
+    setup_calls++;
+    lutok::do_string(state, "counter = 0", 0, 0, 0);
+}
+
+
+/// Initialization function that always fails.
+static void
+setup_fail(lutok::state& /* state */)
+{
+    throw std::runtime_error("Cannot set up");
+}
+
+
+/// Increments the counter of a state and returns its new value.
+///
+/// \param state The state to operate on.
+///
+/// \return The new value of the counter.
+static long
+increment(lutok::state& state)
+{
+    lutok::do_string(state, "counter = counter + 1; return counter", 0, 1, 0);
+    const long value = state.to_integer(-1);
+    state.pop(1);
+    return value;
+}
+
+
+/// Thread body that borrows states from a pool many times.
+///
+/// \param arg Pointer to the pool.
+///
+/// \return NULL.
+static void*
+borrow_many(void* arg)
+{
+    lutok::state_pool* pool = static_cast< lutok::state_pool* >(arg);
+    for (int i = 0; i < 1000; i++) {
+        lutok::state_lease lease(*pool);
+        increment(*lease);
+    }
+    return NULL;
+}
+
+
+/// Thread body that borrows a state from a pool once.
+///
+/// \param arg Pointer to the pool.
+///
+/// \return NULL.
+static void*
+borrow_once(void* arg)
+{
+    lutok::state_pool* pool = static_cast< lutok::state_pool* >(arg);
+    lutok::state_lease lease(*pool);
+    increment(*lease);
+    return NULL;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup);
+ATF_TEST_CASE_BODY(setup)
+{
+    setup_calls = 0;
+    lutok::state_pool pool(3, setup_counter, false);
+    ATF_REQUIRE_EQ(3, setup_calls);
+    ATF_REQUIRE_EQ(3, pool.size());
+    ATF_REQUIRE_EQ(3, pool.idle());
+
+    lutok::state_lease lease(pool);
+    ATF_REQUIRE_EQ(1, increment(lease.get()));
+    ATF_REQUIRE_EQ(0, lease->get_top());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup__null);
+ATF_TEST_CASE_BODY(setup__null)
+{
+    lutok::state_pool pool(1, NULL, true);
+    lutok::state_lease lease(pool);
+    ATF_REQUIRE_EQ(0, lease->get_top());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup__fail);
+ATF_TEST_CASE_BODY(setup__fail)
+{
+    ATF_REQUIRE_THROW_RE(std::runtime_error, "Cannot set up",
+                         lutok::state_pool(2, setup_fail, false));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(setup__template);
+ATF_TEST_CASE_BODY(setup__template)
+{
+    lutok::state_template recipe;
+    recipe.add_string("counter = 10");
+
+    lutok::state_pool pool(2, recipe, true);
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(11, increment(*lease));
+        lease->push_integer(5);
+    }
+    ATF_REQUIRE_EQ(1, pool.discards());
+    lutok::state_lease lease1(pool);
+    lutok::state_lease lease2(pool);
+    ATF_REQUIRE_EQ(11, increment(*lease1));
+    ATF_REQUIRE_EQ(11, increment(*lease2));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lease__reuse);
+ATF_TEST_CASE_BODY(lease__reuse)
+{
+    lutok::state_pool pool(1, setup_counter, true);
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(0, pool.idle());
+        ATF_REQUIRE_EQ(1, increment(*lease));
+    }
+    ATF_REQUIRE_EQ(1, pool.idle());
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(2, increment(*lease));
+    }
+    ATF_REQUIRE_EQ(2, pool.hits());
+    ATF_REQUIRE_EQ(0, pool.waits());
+    ATF_REQUIRE_EQ(0, pool.discards());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(lease__many);
+ATF_TEST_CASE_BODY(lease__many)
+{
+    lutok::state_pool pool(2, setup_counter, true);
+    lutok::state_lease lease1(pool);
+    lutok::state_lease lease2(pool);
+    ATF_REQUIRE(&lease1.get() != &lease2.get());
+    ATF_REQUIRE_EQ(0, pool.idle());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(collect_idle);
+ATF_TEST_CASE_BODY(collect_idle)
+{
+    lutok::state_pool pool(3, setup_counter, true);
+    {
+        lutok::state_lease lease(pool);
+        lutok::do_string(*lease, "garbage = {} for i = 1, 10000 do "
+                         "garbage[i] = {} end garbage = nil", 0, 0, 0);
+    }
+    std::size_t completed = 0;
+    for (int i = 0; completed == 0 && i < 1000; i++)
+        completed = pool.collect_idle(1000000);
+    ATF_REQUIRE(completed > 0);
+    ATF_REQUIRE_EQ(3, pool.idle());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(collect_idle__busy);
+ATF_TEST_CASE_BODY(collect_idle__busy)
+{
+    lutok::state_pool pool(1, setup_counter, true);
+    lutok::state_lease lease(pool);
+    ATF_REQUIRE_EQ(0, pool.collect_idle(1000));
+    ATF_REQUIRE_EQ(1, increment(*lease));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(verify__discard);
+ATF_TEST_CASE_BODY(verify__discard)
+{
+    setup_calls = 0;
+    lutok::state_pool pool(1, setup_counter, true);
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(1, increment(*lease));
+        lease->push_integer(5);
+    }
+    ATF_REQUIRE_EQ(2, setup_calls);
+    ATF_REQUIRE_EQ(1, pool.discards());
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(0, lease->get_top());
+        ATF_REQUIRE_EQ(1, increment(*lease));
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(verify__disabled);
+ATF_TEST_CASE_BODY(verify__disabled)
+{
+    lutok::state_pool pool(1, setup_counter, false);
+    {
+        lutok::state_lease lease(pool);
+        lease->push_integer(5);
+    }
+    ATF_REQUIRE_EQ(0, pool.discards());
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE_EQ(1, lease->get_top());
+        lease->pop(1);
+    }
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(wait);
+ATF_TEST_CASE_BODY(wait)
+{
+    lutok::state_pool pool(1, setup_counter, true);
+
+    pthread_t thread;
+    {
+        lutok::state_lease lease(pool);
+        ATF_REQUIRE(::pthread_create(&thread, NULL, borrow_once, &pool) == 0);
+        while (pool.waits() == 0)
+            ::usleep(1000);
+        ATF_REQUIRE_EQ(1, increment(*lease));
+    }
+    ATF_REQUIRE(::pthread_join(thread, NULL) == 0);
+
+    ATF_REQUIRE_EQ(1, pool.hits());
+    ATF_REQUIRE_EQ(1, pool.waits());
+    lutok::state_lease lease(pool);
+    ATF_REQUIRE_EQ(3, increment(*lease));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(threads);
+ATF_TEST_CASE_BODY(threads)
+{
+    lutok::state_pool pool(3, setup_counter, true);
+
+    pthread_t threads[8];
+    for (int i = 0; i < 8; i++)
+        ATF_REQUIRE(::pthread_create(&threads[i], NULL, borrow_many,
+                                     &pool) == 0);
+    for (int i = 0; i < 8; i++)
+        ATF_REQUIRE(::pthread_join(threads[i], NULL) == 0);
+
+    ATF_REQUIRE_EQ(3, pool.idle());
+    ATF_REQUIRE_EQ(8000, pool.hits() + pool.waits());
+
+    long total = 0;
+    lutok::state_lease lease1(pool);
+    lutok::state_lease lease2(pool);
+    lutok::state_lease lease3(pool);
+    total += increment(*lease1) - 1;
+    total += increment(*lease2) - 1;
+    total += increment(*lease3) - 1;
+    ATF_REQUIRE_EQ(8000, total);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, setup);
+    ATF_ADD_TEST_CASE(tcs, setup__null);
+    ATF_ADD_TEST_CASE(tcs, setup__fail);
+    ATF_ADD_TEST_CASE(tcs, setup__template);
+    ATF_ADD_TEST_CASE(tcs, lease__reuse);
+    ATF_ADD_TEST_CASE(tcs, lease__many);
+    ATF_ADD_TEST_CASE(tcs, collect_idle);
+    ATF_ADD_TEST_CASE(tcs, collect_idle__busy);
+    ATF_ADD_TEST_CASE(tcs, verify__discard);
+    ATF_ADD_TEST_CASE(tcs, verify__disabled);
+    ATF_ADD_TEST_CASE(tcs, wait);
+    ATF_ADD_TEST_CASE(tcs, threads);
+}
@@ -0,0 +1,217 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "state_template.hpp"
+
+#include <cassert>
+#include <vector>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+
+
+namespace {
+
+
+/// Types of the initialization steps recorded by a template.
+enum step_type {
+    /// Opens all the standard libraries.
+    open_all_step,
+    /// Registers a module with C++ functions.
+    module_step,
+    /// Runs a precompiled chunk of Lua code.
+    chunk_step
+};
+
+
+/// A single initialization step.
+struct step {
+    /// The type of the step.
+    step_type type;
+
+    /// For modules, the name of the module.  For chunks, the prefix of the
+    /// error message to raise if the chunk fails.
+    std::string name;
+
+    /// For modules, the functions to register.
+    std::map< std::string, lutok::cxx_function > members;
+
+    /// For chunks, the binary form of the compiled chunk.
+    std::string bytecode;
+
+    /// Constructor.
+    ///
+    /// \param type_ The type of the step.
+    /// \param name_ The name of the step.
+    step(const step_type type_, const std::string& name_) :
+        type(type_),
+        name(name_)
+    {
+    }
+};
+
+
+}  // anonymous namespace
+
+
+/// Internal implementation for lutok::state_template.
+struct lutok::state_template::impl {
+    /// The recorded steps, in the order in which they have to be replayed.
+    std::vector< step > steps;
+
+    /// Records the chunk on the top of the stack of a state.
+    ///
+    /// \param compiler The state that holds the compiled chunk.  The chunk is
+    ///     popped from its stack, even if this fails.
+    /// \param error_prefix Prefix of the error message to raise if the chunk
+    ///     fails to run.
+    ///
+    /// \throw api_error If the chunk cannot be dumped.
+    void
+    add_chunk(state& compiler, const std::string& error_prefix)
+    {
+        step new_step(chunk_step, error_prefix);
+        try {
+            new_step.bytecode = compiler.dump();
+        } catch (...) {
+            compiler.pop(1);
+            throw;
+        }
+        compiler.pop(1);
+        steps.push_back(new_step);
+    }
+};
+
+
+/// Constructs an empty template.
+lutok::state_template::state_template(void) :
+    _pimpl(new impl())
+{
+}
+
+
+/// Destructor.
+lutok::state_template::~state_template(void)
+{
+}
+
+
+/// Records the execution of a Lua file.
+///
+/// The file is compiled immediately, so later modifications to it do not
+/// affect the template.
+///
+/// \param file The file to run.
+///
+/// \throw file_not_found_error If the file cannot be accessed.
+/// \throw api_error If the file cannot be compiled.
+void
+lutok::state_template::add_file(const std::string& file)
+{
+    state compiler;
+    compiler.load_file(file);
+    _pimpl->add_chunk(compiler, "Failed to load Lua file '" + file + "'");
+}
+
+
+/// Records the registration of a module.
+///
+/// \param name The name of the module to create.
+/// \param members The list of member functions to add to the module.
+///
+/// \see create_module
+void
+lutok::state_template::add_module(
+    const std::string& name,
+    const std::map< std::string, cxx_function >& members)
+{
+    step new_step(module_step, name);
+    new_step.members = members;
+    _pimpl->steps.push_back(new_step);
+}
+
+
+/// Records the opening of all the standard libraries.
+///
+/// \see state::open_all
+void
+lutok::state_template::add_open_all(void)
+{
+    _pimpl->steps.push_back(step(open_all_step, ""));
+}
+
+
+/// Records the execution of a Lua script.
+///
+/// The script is compiled immediately.
+///
+/// \param str The script to run.
+///
+/// \throw api_error If the script cannot be compiled.
+void
+lutok::state_template::add_string(const std::string& str)
+{
+    state compiler;
+    compiler.load_string(str);
+    _pimpl->add_chunk(compiler, "Failed to process Lua string '" +
+                      detail::quote_chunk(str) + "'");
+}
+
+
+/// Initializes a state by replaying the steps recorded in the template.
+///
+/// \param s The state to initialize.  This is usually a newly-created state.
+///
+/// \throw error If any of the steps fails.
+void
+lutok::state_template::instantiate(state& s) const
+{
+    for (std::vector< step >::const_iterator iter = _pimpl->steps.begin();
+         iter != _pimpl->steps.end(); ++iter) {
+        switch ((*iter).type) {
+        case open_all_step:
+            s.open_all();
+            break;
+
+        case module_step:
+            create_module(s, (*iter).name, (*iter).members);
+            break;
+
+        case chunk_step:
+            try {
+                s.load_buffer((*iter).bytecode.data(),
+                              (*iter).bytecode.length(), "=state_template");
+                s.pcall(0, 0, 0);
+            } catch (const lutok::api_error& e) {
+                throw lutok::error((*iter).name + ": " + e.what());
+            }
+            break;
+        }
+    }
+}
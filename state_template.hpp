@@ -0,0 +1,89 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file state_template.hpp
+/// Provides reusable recipes to initialize Lua states quickly.
+
+#if !defined(LUTOK_STATE_TEMPLATE_HPP)
+#define LUTOK_STATE_TEMPLATE_HPP
+
+#include <map>
+#include <string>
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+#include <lutok/state.hpp>
+
+namespace lutok {
+
+
+/// Recipe to bring new states to a fully initialized condition.
+///
+/// Lua states cannot be copied, so the only way to have many states with the
+/// same contents is to run the same initialization code on each of them.  A
+/// template records that initialization once, step by step, and then replays
+/// it on any number of states.  The key difference with running the setup
+/// code by hand is that the Lua code is compiled only once, when it is added
+/// to the template: new states just load the precompiled chunks, so creating
+/// them does not involve the Lua compiler.
+///
+/// Copies of a template share the same recipe.  Templates must not be
+/// modified while other threads instantiate them, but instantiating the same
+/// template from multiple threads at once is safe as long as each thread uses
+/// a different state.
+class state_template {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+public:
+    state_template(void);
+    ~state_template(void);
+
+    void add_file(const std::string&);
+    void add_module(const std::string&,
+                    const std::map< std::string, cxx_function >&);
+    void add_open_all(void);
+    void add_string(const std::string&);
+
+    void instantiate(state&) const;
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_STATE_TEMPLATE_HPP)
@@ -0,0 +1,239 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "state_template.hpp"
+
+#include <fstream>
+
+#include <atf-c++.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Multiplication function for injection into Lua.
+///
+/// \pre stack(-2) The first factor.
+/// \pre stack(-1) The second factor.
+/// \post stack(-1) The product of the two input parameters.
+///
+/// \param state The Lua state.
+///
+/// \return The number of result values, i.e. 1.
+static int
+multiply(lutok::state& state)
+{
+    state.push_integer(state.to_integer(-1) * state.to_integer(-2));
+    return 1;
+}
+
+
+/// Evaluates an integer expression.
+///
+/// \param state The Lua state.
+/// \param expression The expression to evaluate.
+///
+/// \return The value of the expression.
+static long
+eval_integer(lutok::state& state, const std::string& expression)
+{
+    lutok::eval(state, expression, 1);
+    const long value = state.to_integer(-1);
+    state.pop(1);
+    return value;
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(empty);
+ATF_TEST_CASE_BODY(empty)
+{
+    lutok::state_template recipe;
+    lutok::state state;
+    stack_balance_checker checker(state);
+    recipe.instantiate(state);
+    lutok::eval(state, "string", 1);
+    ATF_REQUIRE(state.is_nil(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_open_all);
+ATF_TEST_CASE_BODY(add_open_all)
+{
+    lutok::state_template recipe;
+    recipe.add_open_all();
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    recipe.instantiate(state);
+    ATF_REQUIRE_EQ(3, eval_integer(state, "string.len('abc')"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_module);
+ATF_TEST_CASE_BODY(add_module)
+{
+    std::map< std::string, lutok::cxx_function > members;
+    members["multiply"] = multiply;
+
+    lutok::state_template recipe;
+    recipe.add_module("my_math", members);
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    recipe.instantiate(state);
+    ATF_REQUIRE_EQ(42, eval_integer(state, "my_math.multiply(6, 7)"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_string);
+ATF_TEST_CASE_BODY(add_string)
+{
+    std::map< std::string, lutok::cxx_function > members;
+    members["multiply"] = multiply;
+
+    lutok::state_template recipe;
+    recipe.add_module("my_math", members);
+    recipe.add_string("function square(x) return my_math.multiply(x, x) end");
+    recipe.add_string("nine = square(3)");
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    recipe.instantiate(state);
+    ATF_REQUIRE_EQ(9, eval_integer(state, "nine"));
+    ATF_REQUIRE_EQ(16, eval_integer(state, "square(4)"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_string__compile_error);
+ATF_TEST_CASE_BODY(add_string__compile_error)
+{
+    lutok::state_template recipe;
+    REQUIRE_API_ERROR("luaL_loadstring", recipe.add_string("a b c"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_file);
+ATF_TEST_CASE_BODY(add_file)
+{
+    std::ofstream output("prelude.lua");
+    output << "answer = 42\n";
+    output.close();
+
+    lutok::state_template recipe;
+    recipe.add_file("prelude.lua");
+
+    output.open("prelude.lua");
+    output << "answer = 0\n";
+    output.close();
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    recipe.instantiate(state);
+    ATF_REQUIRE_EQ(42, eval_integer(state, "answer"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(add_file__not_found);
+ATF_TEST_CASE_BODY(add_file__not_found)
+{
+    lutok::state_template recipe;
+    ATF_REQUIRE_THROW_RE(lutok::file_not_found_error, "missing.lua",
+                         recipe.add_file("missing.lua"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instantiate__runtime_error);
+ATF_TEST_CASE_BODY(instantiate__runtime_error)
+{
+    std::ofstream output("prelude.lua");
+    output << "\nerror('oops')\n";
+    output.close();
+
+    lutok::state_template recipe;
+    recipe.add_file("prelude.lua");
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_THROW_RE(lutok::error,
+                         "Failed to load Lua file 'prelude.lua': "
+                         ".*prelude.lua:2: oops",
+                         recipe.instantiate(state));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(instantiate__many);
+ATF_TEST_CASE_BODY(instantiate__many)
+{
+    lutok::state_template recipe;
+    recipe.add_string("counter = 0");
+
+    lutok::state state1;
+    lutok::state state2;
+    recipe.instantiate(state1);
+    recipe.instantiate(state2);
+    lutok::do_string(state1, "counter = counter + 5", 0, 0, 0);
+    ATF_REQUIRE_EQ(5, eval_integer(state1, "counter"));
+    ATF_REQUIRE_EQ(0, eval_integer(state2, "counter"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(copy);
+ATF_TEST_CASE_BODY(copy)
+{
+    lutok::state_template recipe;
+    lutok::state_template copy = recipe;
+    copy.add_string("value = 7");
+
+    lutok::state state;
+    recipe.instantiate(state);
+    ATF_REQUIRE_EQ(7, eval_integer(state, "value"));
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, empty);
+    ATF_ADD_TEST_CASE(tcs, add_open_all);
+    ATF_ADD_TEST_CASE(tcs, add_module);
+    ATF_ADD_TEST_CASE(tcs, add_string);
+    ATF_ADD_TEST_CASE(tcs, add_string__compile_error);
+    ATF_ADD_TEST_CASE(tcs, add_file);
+    ATF_ADD_TEST_CASE(tcs, add_file__not_found);
+    ATF_ADD_TEST_CASE(tcs, instantiate__runtime_error);
+    ATF_ADD_TEST_CASE(tcs, instantiate__many);
+    ATF_ADD_TEST_CASE(tcs, copy);
+}
@@ -28,9 +28,11 @@
 
 #include "state.ipp"
 
+#include <cmath>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
 #include <atf-c++.hpp>
@@ -135,6 +137,26 @@ cxx_multiply_closure(lutok::state& state)
 }
 
 
+/// A custom C++ function that adds all of its integral upvalues.
+///
+/// \pre stack(-1) contains the number of upvalues to add.
+/// \post stack(-1) contains the sum of the upvalues.
+///
+/// \param state The Lua state.
+///
+/// \return The number of result values, i.e. 1.
+static int
+cxx_sum_closure(lutok::state& state)
+{
+    const int count = lua_tointeger(raw(state), -1);
+    int sum = 0;
+    for (int i = 1; i <= count; i++)
+        sum += lua_tointeger(raw(state), lua_upvalueindex(i));
+    lua_pushinteger(raw(state), sum);
+    return 1;
+}
+
+
 /// A custom C++ integral division function for Lua.
 ///
 /// \pre stack(-2) contains the dividend.
@@ -183,9 +205,74 @@ raise_long_error(lutok::state& state)
 }
 
 
+/// User-defined type to validate the extensibility of stack_traits.
+struct point {
+    /// The horizontal coordinate.
+    int x;
+
+    /// The vertical coordinate.
+    int y;
+};
+
+
 }  // anonymous namespace
 
 
+namespace lutok {
+
+
+/// Conversions for points, represented as tables with x and y fields.
+template<>
+struct stack_traits< point > {
+    /// Checks if a value is a table.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return True if the value is a table.
+    static bool
+    is(lua_State* raw_state, const int index)
+    {
+        return lua_istable(raw_state, index);
+    }
+
+    /// Gets a point from the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param index The stack index of the value.
+    ///
+    /// \return The value.
+    static point
+    get(lua_State* raw_state, const int index)
+    {
+        point value;
+        lua_getfield(raw_state, index, "x");
+        value.x = static_cast< int >(lua_tointeger(raw_state, -1));
+        lua_getfield(raw_state, index < 0 ? index - 1 : index, "y");
+        value.y = static_cast< int >(lua_tointeger(raw_state, -1));
+        lua_pop(raw_state, 2);
+        return value;
+    }
+
+    /// Pushes a point onto the stack.
+    ///
+    /// \param raw_state The Lua C API state.
+    /// \param value The value to push.
+    static void
+    push(lua_State* raw_state, const point& value)
+    {
+        lua_newtable(raw_state);
+        lua_pushinteger(raw_state, value.x);
+        lua_setfield(raw_state, -2, "x");
+        lua_pushinteger(raw_state, value.y);
+        lua_setfield(raw_state, -2, "y");
+    }
+};
+
+
+}  // namespace lutok
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(close);
 ATF_TEST_CASE_BODY(close)
 {
@@ -196,6 +283,138 @@ ATF_TEST_CASE_BODY(close)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(dump__ok);
+ATF_TEST_CASE_BODY(dump__ok)
+{
+    lutok::state state1;
+    luaL_loadstring(raw(state1), "return 2 * 21");
+    const std::string bytecode = state1.dump();
+    ATF_REQUIRE(!bytecode.empty());
+    ATF_REQUIRE(lua_isfunction(raw(state1), -1));
+    lua_pop(raw(state1), 1);
+
+    lutok::state state2;
+    state2.load_buffer(bytecode.data(), bytecode.length(), "test");
+    ATF_REQUIRE(lua_pcall(raw(state2), 0, 1, 0) == 0);
+    ATF_REQUIRE_EQ(42, lua_tointeger(raw(state2), -1));
+    lua_pop(raw(state2), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(dump__fail);
+ATF_TEST_CASE_BODY(dump__fail)
+{
+    lutok::state state;
+    lua_pushcfunction(raw(state), c_get_upvalues);
+    REQUIRE_API_ERROR("lua_dump", state.dump());
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_collect);
+ATF_TEST_CASE_BODY(gc_collect)
+{
+    lutok::state state;
+    luaL_dostring(raw(state), "garbage = {} for i = 1, 10000 do "
+                  "garbage[i] = {} end");
+    const unsigned int before = state.gc_count();
+    luaL_dostring(raw(state), "garbage = nil");
+    state.gc_collect();
+    ATF_REQUIRE(state.gc_count() < before);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_set_generational);
+ATF_TEST_CASE_BODY(gc_set_generational)
+{
+    lutok::state state;
+#if LUA_VERSION_NUM >= 504 || defined(LUA_GCGEN)
+    state.gc_set_generational();
+    state.gc_set_incremental();
+#else
+    ATF_REQUIRE_THROW_RE(lutok::error, "not supported",
+                         state.gc_set_generational());
+    state.gc_set_incremental();
+#endif
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_set_pause);
+ATF_TEST_CASE_BODY(gc_set_pause)
+{
+    lutok::state state;
+    state.gc_set_pause(150);
+    ATF_REQUIRE_EQ(150, state.gc_set_pause(300));
+    ATF_REQUIRE_EQ(300, state.gc_set_pause(200));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_set_step_multiplier);
+ATF_TEST_CASE_BODY(gc_set_step_multiplier)
+{
+    lutok::state state;
+    state.gc_set_step_multiplier(400);
+    ATF_REQUIRE_EQ(400, state.gc_set_step_multiplier(100));
+    ATF_REQUIRE_EQ(100, state.gc_set_step_multiplier(200));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_step);
+ATF_TEST_CASE_BODY(gc_step)
+{
+    lutok::state state;
+    luaL_dostring(raw(state), "garbage = {} for i = 1, 10000 do "
+                  "garbage[i] = {} end garbage = nil");
+    bool finished = false;
+    for (int i = 0; !finished && i < 1000000; i++)
+        finished = state.gc_step(0);
+    ATF_REQUIRE(finished);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(gc_stop__restart);
+ATF_TEST_CASE_BODY(gc_stop__restart)
+{
+    lutok::state state;
+    state.gc_collect();
+    state.gc_stop();
+    const unsigned int before = state.gc_count();
+    luaL_dostring(raw(state), "for i = 1, 10000 do local t = {} end");
+    ATF_REQUIRE(state.gc_count() > before);
+    state.gc_restart();
+    state.gc_collect();
+    ATF_REQUIRE(state.gc_count() <= before);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get__numbers);
+ATF_TEST_CASE_BODY(get__numbers)
+{
+    lutok::state state;
+    lua_pushinteger(raw(state), 15);
+    lua_pushnumber(raw(state), 2.5);
+    lua_pushboolean(raw(state), 1);
+    ATF_REQUIRE_EQ(15, state.get< int >(-3));
+    ATF_REQUIRE_EQ(15L, state.get< long >(-3));
+    ATF_REQUIRE_EQ(2.5, state.get< double >(-2));
+    ATF_REQUIRE(state.get< bool >(-1));
+    lua_pop(raw(state), 3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(get__strings);
+ATF_TEST_CASE_BODY(get__strings)
+{
+    lutok::state state;
+    lua_pushlstring(raw(state), "foo\0bar", 7);
+    ATF_REQUIRE_EQ(std::string("foo\0bar", 7),
+                   state.get< std::string >(-1));
+    ATF_REQUIRE_EQ(7, state.get< lutok::string_ref >(-1).length());
+    ATF_REQUIRE(std::strcmp("foo", state.get< const char* >(-1)) == 0);
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(get_global__ok);
 ATF_TEST_CASE_BODY(get_global__ok)
 {
@@ -217,6 +436,18 @@ ATF_TEST_CASE_BODY(get_global__undefined)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(get_global_unchecked);
+ATF_TEST_CASE_BODY(get_global_unchecked)
+{
+    lutok::state state;
+    ATF_REQUIRE(luaL_dostring(raw(state), "test_variable = 3") == 0);
+    state.get_global_unchecked("test_variable");
+    ATF_REQUIRE(lua_isnumber(raw(state), -1));
+    ATF_REQUIRE_EQ(3, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(get_global_table);
 ATF_TEST_CASE_BODY(get_global_table)
 {
@@ -329,6 +560,23 @@ ATF_TEST_CASE_BODY(get_table__unknown_index)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(get_table_unchecked);
+ATF_TEST_CASE_BODY(get_table_unchecked)
+{
+    lutok::state state;
+    ATF_REQUIRE(luaL_dostring(raw(state), "t = { a = 1, bar = 234 }") == 0);
+    lua_getglobal(raw(state), "t");
+    lua_pushstring(raw(state), "bar");
+    state.get_table_unchecked(-2);
+    ATF_REQUIRE(lua_isnumber(raw(state), -1));
+    ATF_REQUIRE_EQ(234, lua_tointeger(raw(state), -1));
+    lua_pushstring(raw(state), "baz");
+    state.get_table_unchecked(-3);
+    ATF_REQUIRE(lua_isnil(raw(state), -1));
+    lua_pop(raw(state), 3);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(get_top);
 ATF_TEST_CASE_BODY(get_top)
 {
@@ -359,6 +607,28 @@ ATF_TEST_CASE_BODY(insert)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(is);
+ATF_TEST_CASE_BODY(is)
+{
+    lutok::state state;
+    lua_pushboolean(raw(state), 0);
+    lua_pushinteger(raw(state), 3);
+    lua_pushstring(raw(state), "text");
+    ATF_REQUIRE(state.is< bool >(-3));
+    ATF_REQUIRE(!state.is< int >(-3));
+    ATF_REQUIRE(!state.is< std::string >(-3));
+    ATF_REQUIRE(state.is< int >(-2));
+    ATF_REQUIRE(state.is< double >(-2));
+    ATF_REQUIRE(state.is< std::string >(-2));
+    ATF_REQUIRE(!state.is< bool >(-2));
+    ATF_REQUIRE(!state.is< long >(-1));
+    ATF_REQUIRE(state.is< std::string >(-1));
+    ATF_REQUIRE(state.is< const char* >(-1));
+    ATF_REQUIRE(state.is< lutok::string_ref >(-1));
+    lua_pop(raw(state), 3);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(is_boolean__empty);
 ATF_TEST_CASE_BODY(is_boolean__empty)
 {
@@ -403,6 +673,46 @@ ATF_TEST_CASE_BODY(is_function__ok)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(is_integer__empty);
+ATF_TEST_CASE_BODY(is_integer__empty)
+{
+    lutok::state state;
+    ATF_REQUIRE(!state.is_integer(-1));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(is_integer__ok);
+ATF_TEST_CASE_BODY(is_integer__ok)
+{
+    lutok::state state;
+    lua_pushstring(raw(state), "5");
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pushnumber(raw(state), 2.5);
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pushinteger(raw(state), 5);
+    ATF_REQUIRE(state.is_integer(-1));
+    ATF_REQUIRE(!state.is_integer(-2));
+    ATF_REQUIRE(!state.is_integer(-3));
+    lua_pop(raw(state), 3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(is_integer__out_of_range);
+ATF_TEST_CASE_BODY(is_integer__out_of_range)
+{
+    lutok::state state;
+    lua_pushnumber(raw(state), HUGE_VAL);
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pushnumber(raw(state), -HUGE_VAL);
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pushnumber(raw(state), 1e19);
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pushnumber(raw(state), 0.0 / 0.0);
+    ATF_REQUIRE(!state.is_integer(-1));
+    lua_pop(raw(state), 4);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(is_nil__empty);
 ATF_TEST_CASE_BODY(is_nil__empty)
 {
@@ -515,6 +825,28 @@ ATF_TEST_CASE_BODY(is_userdata__ok)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(load_buffer__ok);
+ATF_TEST_CASE_BODY(load_buffer__ok)
+{
+    const char code[] = "return 2 + 3 -- Trailing garbage.";
+    lutok::state state;
+    state.load_buffer(code, 12, "test");
+    ATF_REQUIRE(lua_pcall(raw(state), 0, 1, 0) == 0);
+    ATF_REQUIRE_EQ(5, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_buffer__fail);
+ATF_TEST_CASE_BODY(load_buffer__fail)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "the-chunk",
+                         state.load_buffer("a b c", 5, "=the-chunk"));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(load_file__ok);
 ATF_TEST_CASE_BODY(load_file__ok)
 {
@@ -552,6 +884,104 @@ ATF_TEST_CASE_BODY(load_file__file_not_found_error)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(load_mapped_file__ok);
+ATF_TEST_CASE_BODY(load_mapped_file__ok)
+{
+    std::ofstream output("test.lua");
+    output << "#! /usr/bin/env lua\nin_the_file = \"oh yes\"\n";
+    output.close();
+
+    lutok::state state;
+    state.load_mapped_file("test.lua");
+    ATF_REQUIRE(lua_pcall(raw(state), 0, 0, 0) == 0);
+    lua_getglobal(raw(state), "in_the_file");
+    ATF_REQUIRE(std::strcmp("oh yes", lua_tostring(raw(state), -1)) == 0);
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_mapped_file__empty);
+ATF_TEST_CASE_BODY(load_mapped_file__empty)
+{
+    std::ofstream output("test.lua");
+    output.close();
+
+    lutok::state state;
+    state.load_mapped_file("test.lua");
+    ATF_REQUIRE(lua_pcall(raw(state), 0, 1, 0) == 0);
+    ATF_REQUIRE(lua_isnil(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_mapped_file__api_error);
+ATF_TEST_CASE_BODY(load_mapped_file__api_error)
+{
+    std::ofstream output("test.lua");
+    output << "# A comment\n\nI have a bad syntax!  Wohoo!\n";
+    output.close();
+
+    lutok::state state;
+    stack_balance_checker checker(state);
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "test.lua:3",
+                         state.load_mapped_file("test.lua"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_mapped_file__file_not_found_error);
+ATF_TEST_CASE_BODY(load_mapped_file__file_not_found_error)
+{
+    lutok::state state;
+    ATF_REQUIRE_THROW_RE(lutok::file_not_found_error, "missing.lua",
+                         state.load_mapped_file("missing.lua"));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_stream__ok);
+ATF_TEST_CASE_BODY(load_stream__ok)
+{
+    std::ostringstream code;
+    code << "local t = 0\n";
+    for (int i = 0; i < 2000; ++i)
+        code << "t = t + " << i << "\n";
+    code << "return t\n";
+    std::istringstream input(code.str());
+
+    lutok::state state;
+    state.load_stream(input, "test");
+    ATF_REQUIRE(lua_pcall(raw(state), 0, 1, 0) == 0);
+    ATF_REQUIRE_EQ(1999000, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_stream__binary);
+ATF_TEST_CASE_BODY(load_stream__binary)
+{
+    lutok::state state1;
+    luaL_loadstring(raw(state1), "return 2 * 21");
+    std::istringstream input(state1.dump());
+    lua_pop(raw(state1), 1);
+
+    lutok::state state2;
+    state2.load_stream(input, "test");
+    ATF_REQUIRE(lua_pcall(raw(state2), 0, 1, 0) == 0);
+    ATF_REQUIRE_EQ(42, lua_tointeger(raw(state2), -1));
+    lua_pop(raw(state2), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(load_stream__fail);
+ATF_TEST_CASE_BODY(load_stream__fail)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+    std::istringstream input("a b c");
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "the-chunk",
+                         state.load_stream(input, "=the-chunk"));
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(load_string__ok);
 ATF_TEST_CASE_BODY(load_string__ok)
 {
@@ -582,6 +1012,17 @@ ATF_TEST_CASE_BODY(new_table)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(new_table__presized);
+ATF_TEST_CASE_BODY(new_table__presized)
+{
+    lutok::state state;
+    state.new_table(10, 5);
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    ATF_REQUIRE(lua_istable(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(new_userdata);
 ATF_TEST_CASE_BODY(new_userdata)
 {
@@ -638,6 +1079,29 @@ ATF_TEST_CASE_BODY(next__many)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(next_unchecked);
+ATF_TEST_CASE_BODY(next_unchecked)
+{
+    lutok::state state;
+    luaL_dostring(raw(state), "t = {}; t[1] = 100");
+
+    lua_getglobal(raw(state), "t");
+    lua_pushnil(raw(state));
+
+    ATF_REQUIRE(state.next_unchecked(-2));
+    ATF_REQUIRE_EQ(3, lua_gettop(raw(state)));
+    ATF_REQUIRE(lua_isnumber(raw(state), -2));
+    ATF_REQUIRE_EQ(1, lua_tointeger(raw(state), -2));
+    ATF_REQUIRE(lua_isnumber(raw(state), -1));
+    ATF_REQUIRE_EQ(100, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+
+    ATF_REQUIRE(!state.next_unchecked(-2));
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(open_base);
 ATF_TEST_CASE_BODY(open_base)
 {
@@ -737,6 +1201,81 @@ ATF_TEST_CASE_BODY(pop__many)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(push__scalars);
+ATF_TEST_CASE_BODY(push__scalars)
+{
+    lutok::state state;
+    state.push(true);
+    state.push(8);
+    state.push(9L);
+    state.push(0.5);
+    ATF_REQUIRE_EQ(4, lua_gettop(raw(state)));
+    ATF_REQUIRE(lua_toboolean(raw(state), -4));
+    ATF_REQUIRE_EQ(8, lua_tointeger(raw(state), -3));
+    ATF_REQUIRE_EQ(9, lua_tointeger(raw(state), -2));
+    ATF_REQUIRE_EQ(0.5, lua_tonumber(raw(state), -1));
+    lua_pop(raw(state), 4);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push__strings);
+ATF_TEST_CASE_BODY(push__strings)
+{
+    lutok::state state;
+    const char* c_string = "second";
+    state.push("first");
+    state.push(c_string);
+    state.push(std::string("thi\0rd", 6));
+    state.push(lutok::string_ref("fourth", 4));
+    ATF_REQUIRE_EQ(std::string("first"), lua_tostring(raw(state), -4));
+    ATF_REQUIRE_EQ(std::string("second"), lua_tostring(raw(state), -3));
+    size_t length;
+    lua_tolstring(raw(state), -2, &length);
+    ATF_REQUIRE_EQ(6, length);
+    ATF_REQUIRE_EQ(std::string("four"), lua_tostring(raw(state), -1));
+    lua_pop(raw(state), 4);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push__user_type);
+ATF_TEST_CASE_BODY(push__user_type)
+{
+    lutok::state state;
+    point original;
+    original.x = 3;
+    original.y = -4;
+    state.push(original);
+    ATF_REQUIRE(state.is< point >(-1));
+    lua_getfield(raw(state), -1, "y");
+    ATF_REQUIRE_EQ(-4, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+
+    const point copy = state.get< point >(-1);
+    ATF_REQUIRE_EQ(3, copy.x);
+    ATF_REQUIRE_EQ(-4, copy.y);
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_all);
+ATF_TEST_CASE_BODY(push_all)
+{
+    lutok::state state;
+    state.push_all(1, "two", 3.0, false, std::string("five"));
+    ATF_REQUIRE_EQ(5, lua_gettop(raw(state)));
+    ATF_REQUIRE_EQ(1, lua_tointeger(raw(state), 1));
+    ATF_REQUIRE_EQ(std::string("two"), lua_tostring(raw(state), 2));
+    ATF_REQUIRE_EQ(3.0, lua_tonumber(raw(state), 3));
+    ATF_REQUIRE(lua_isboolean(raw(state), 4));
+    ATF_REQUIRE_EQ(std::string("five"), lua_tostring(raw(state), 5));
+    lua_pop(raw(state), 5);
+
+    state.push_all(1, 2);
+    ATF_REQUIRE_EQ(2, lua_gettop(raw(state)));
+    lua_pop(raw(state), 2);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(push_boolean);
 ATF_TEST_CASE_BODY(push_boolean)
 {
@@ -767,6 +1306,24 @@ ATF_TEST_CASE_BODY(push_cxx_closure)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(push_cxx_closure__many_upvalues);
+ATF_TEST_CASE_BODY(push_cxx_closure__many_upvalues)
+{
+    lutok::state state;
+    for (int nvalues = 0; nvalues <= 254; nvalues += 127) {
+        ATF_REQUIRE(lua_checkstack(raw(state), nvalues + 2));
+        for (int i = 1; i <= nvalues; i++)
+            lua_pushinteger(raw(state), i);
+        state.push_cxx_closure(cxx_sum_closure, nvalues);
+        lua_pushinteger(raw(state), nvalues);
+        ATF_REQUIRE(lua_pcall(raw(state), 1, 1, 0) == 0);
+        ATF_REQUIRE_EQ(nvalues * (nvalues + 1) / 2,
+                       lua_tointeger(raw(state), -1));
+        lua_pop(raw(state), 1);
+    }
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(push_cxx_function__ok);
 ATF_TEST_CASE_BODY(push_cxx_function__ok)
 {
@@ -839,6 +1396,37 @@ ATF_TEST_CASE_BODY(push_integer)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(push_integer64);
+ATF_TEST_CASE_BODY(push_integer64)
+{
+    lutok::state state;
+    const int64_t large = (static_cast< int64_t >(1) << 40) + 3;
+    state.push_integer64(large);
+    state.push_integer64(-large);
+    ATF_REQUIRE_EQ(2, lua_gettop(raw(state)));
+    ATF_REQUIRE(state.is_integer(-1));
+    ATF_REQUIRE_EQ(-large, state.to_integer64(-1));
+    ATF_REQUIRE_EQ(large, state.to_integer64(-2));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_integer64__full_width);
+ATF_TEST_CASE_BODY(push_integer64__full_width)
+{
+#if LUA_VERSION_NUM >= 503
+    lutok::state state;
+    const int64_t large = (static_cast< int64_t >(1) << 62) + 1;
+    state.push_integer64(large);
+    ATF_REQUIRE(state.is_integer(-1));
+    ATF_REQUIRE_EQ(large, state.to_integer64(-1));
+    lua_pop(raw(state), 1);
+#else
+    ATF_SKIP("Lua versions before 5.3 do not have 64-bit integers");
+#endif
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(push_nil);
 ATF_TEST_CASE_BODY(push_nil)
 {
@@ -854,6 +1442,40 @@ ATF_TEST_CASE_BODY(push_nil)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(push_number);
+ATF_TEST_CASE_BODY(push_number)
+{
+    lutok::state state;
+    state.push_number(2.5);
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    ATF_REQUIRE_EQ(2.5, lua_tonumber(raw(state), -1));
+    state.push_number(-1e100);
+    ATF_REQUIRE_EQ(2, lua_gettop(raw(state)));
+    ATF_REQUIRE_EQ(-1e100, lua_tonumber(raw(state), -1));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_static_cxx_function);
+ATF_TEST_CASE_BODY(push_static_cxx_function)
+{
+    static const lutok::cxx_function function = cxx_divide;
+
+    lutok::state state;
+    state.push_static_cxx_function(&function);
+    lua_setglobal(raw(state), "cxx_divide");
+
+    ATF_REQUIRE(luaL_dostring(raw(state), "return cxx_divide(17, 3)") == 0);
+    ATF_REQUIRE_EQ(5, lua_tointeger(raw(state), -2));
+    ATF_REQUIRE_EQ(2, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 2);
+
+    ATF_REQUIRE(luaL_dostring(raw(state), "return cxx_divide(1, 0)") != 0);
+    ATF_REQUIRE_MATCH("Divisor is 0", lua_tostring(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(push_string);
 ATF_TEST_CASE_BODY(push_string)
 {
@@ -874,6 +1496,36 @@ ATF_TEST_CASE_BODY(push_string)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(push_string__c_string);
+ATF_TEST_CASE_BODY(push_string__c_string)
+{
+    lutok::state state;
+    state.push_string("literal");
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    ATF_REQUIRE_EQ(std::string("literal"), lua_tostring(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_string__embedded_nul);
+ATF_TEST_CASE_BODY(push_string__embedded_nul)
+{
+    lutok::state state;
+    const std::string str("ab\0cd", 5);
+    state.push_string(str);
+    state.push_string(str.data(), 4);
+
+    size_t length;
+    const char* raw_string = lua_tolstring(raw(state), -2, &length);
+    ATF_REQUIRE_EQ(5, length);
+    ATF_REQUIRE_EQ(str, std::string(raw_string, length));
+    raw_string = lua_tolstring(raw(state), -1, &length);
+    ATF_REQUIRE_EQ(4, length);
+    ATF_REQUIRE_EQ(std::string("ab\0c", 4), std::string(raw_string, length));
+    lua_pop(raw(state), 2);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(push_value);
 ATF_TEST_CASE_BODY(push_value)
 {
@@ -960,6 +1612,20 @@ ATF_TEST_CASE_BODY(set_global)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(set_global_unchecked);
+ATF_TEST_CASE_BODY(set_global_unchecked)
+{
+    lutok::state state;
+    lua_pushinteger(raw(state), 3);
+    state.set_global_unchecked("test_variable");
+    ATF_REQUIRE_EQ(0, lua_gettop(raw(state)));
+    ATF_REQUIRE(luaL_dostring(raw(state), "return test_variable + 1") == 0);
+    ATF_REQUIRE(lua_isnumber(raw(state), -1));
+    ATF_REQUIRE_EQ(4, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(set_metatable);
 ATF_TEST_CASE_BODY(set_metatable)
 {
@@ -1024,6 +1690,28 @@ ATF_TEST_CASE_BODY(set_table__nil)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(set_table_unchecked);
+ATF_TEST_CASE_BODY(set_table_unchecked)
+{
+    lutok::state state;
+    ATF_REQUIRE(luaL_dostring(raw(state), "t = { a = 1, bar = 234 }") == 0);
+    lua_getglobal(raw(state), "t");
+
+    lua_pushstring(raw(state), "bar");
+    lua_pushstring(raw(state), "baz");
+    state.set_table_unchecked(-3);
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+
+    lua_pushstring(raw(state), "bar");
+    lua_gettable(raw(state), -2);
+    ATF_REQUIRE(lua_isstring(raw(state), -1));
+    ATF_REQUIRE_EQ(std::string("baz"), lua_tostring(raw(state), -1));
+    lua_pop(raw(state), 1);
+
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(to_boolean);
 ATF_TEST_CASE_BODY(to_boolean)
 {
@@ -1047,6 +1735,43 @@ ATF_TEST_CASE_BODY(to_integer)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(to_integer64);
+ATF_TEST_CASE_BODY(to_integer64)
+{
+    lutok::state state;
+    lua_pushinteger(raw(state), 12);
+    lua_pushnumber(raw(state), 1e15);
+    ATF_REQUIRE_EQ(12, state.to_integer64(-2));
+    ATF_REQUIRE_EQ(static_cast< int64_t >(1e15),
+                   state.to_integer64(-1));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_integer64__out_of_range);
+ATF_TEST_CASE_BODY(to_integer64__out_of_range)
+{
+    lutok::state state;
+    lua_pushnumber(raw(state), HUGE_VAL);
+    lua_pushnumber(raw(state), -1e30);
+    ATF_REQUIRE_EQ(0, state.to_integer64(-2));
+    ATF_REQUIRE_EQ(0, state.to_integer64(-1));
+    lua_pop(raw(state), 2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_number);
+ATF_TEST_CASE_BODY(to_number)
+{
+    lutok::state state;
+    lua_pushnumber(raw(state), 3.25);
+    lua_pushinteger(raw(state), 7);
+    ATF_REQUIRE_EQ(3.25, state.to_number(-2));
+    ATF_REQUIRE_EQ(7.0, state.to_number(-1));
+    lua_pop(raw(state), 2);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(to_string);
 ATF_TEST_CASE_BODY(to_string)
 {
@@ -1059,6 +1784,35 @@ ATF_TEST_CASE_BODY(to_string)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(to_string__embedded_nul);
+ATF_TEST_CASE_BODY(to_string__embedded_nul)
+{
+    lutok::state state;
+    lua_pushlstring(raw(state), "foo\0bar", 7);
+    ATF_REQUIRE_EQ(std::string("foo\0bar", 7), state.to_string(-1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_string_ref);
+ATF_TEST_CASE_BODY(to_string_ref)
+{
+    lutok::state state;
+    lua_pushlstring(raw(state), "foo\0bar", 7);
+    lua_pushinteger(raw(state), 12);
+
+    const lutok::string_ref ref1 = state.to_string_ref(-2);
+    ATF_REQUIRE(ref1.data() == lua_tostring(raw(state), -2));
+    ATF_REQUIRE_EQ(7, ref1.length());
+    ATF_REQUIRE_EQ(std::string("foo\0bar", 7), ref1.str());
+
+    const lutok::string_ref ref2 = state.to_string_ref(-1);
+    ATF_REQUIRE_EQ(2, ref2.length());
+    ATF_REQUIRE_EQ("12", ref2.str());
+    lua_pop(raw(state), 2);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(to_userdata);
 ATF_TEST_CASE_BODY(to_userdata)
 {
@@ -1076,6 +1830,47 @@ ATF_TEST_CASE_BODY(to_userdata)
 }
 
 
+ATF_TEST_CASE_WITHOUT_HEAD(try_pcall__ok);
+ATF_TEST_CASE_BODY(try_pcall__ok)
+{
+    lutok::state state;
+    luaL_loadstring(raw(state), "return ... * 2");
+    lua_pushinteger(raw(state), 21);
+    const lutok::status status = state.try_pcall(1, 1, 0);
+    ATF_REQUIRE(status.ok());
+    ATF_REQUIRE_EQ(0, status.code());
+    ATF_REQUIRE_EQ(42, lua_tointeger(raw(state), -1));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_pcall__fail);
+ATF_TEST_CASE_BODY(try_pcall__fail)
+{
+    lutok::state state;
+    luaL_loadstring(raw(state), "error('Oops')");
+    const lutok::status status = state.try_pcall(0, 0, 0);
+    ATF_REQUIRE(!status.ok());
+    ATF_REQUIRE_EQ(LUA_ERRRUN, status.code());
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    ATF_REQUIRE_MATCH("Oops", status.message(state));
+    ATF_REQUIRE_EQ(1, lua_gettop(raw(state)));
+    lua_pop(raw(state), 1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(try_pcall__fail_not_string);
+ATF_TEST_CASE_BODY(try_pcall__fail_not_string)
+{
+    lutok::state state;
+    luaL_loadstring(raw(state), "error({})");
+    const lutok::status status = state.try_pcall(0, 0, 0);
+    ATF_REQUIRE(!status.ok());
+    ATF_REQUIRE_EQ("(error object is a table value)", status.message(state));
+    lua_pop(raw(state), 1);
+}
+
+
 ATF_TEST_CASE_WITHOUT_HEAD(upvalue_index);
 ATF_TEST_CASE_BODY(upvalue_index)
 {
@@ -1096,8 +1891,19 @@ ATF_TEST_CASE_BODY(upvalue_index)
 ATF_INIT_TEST_CASES(tcs)
 {
     ATF_ADD_TEST_CASE(tcs, close);
+    ATF_ADD_TEST_CASE(tcs, dump__ok);
+    ATF_ADD_TEST_CASE(tcs, dump__fail);
+    ATF_ADD_TEST_CASE(tcs, gc_collect);
+    ATF_ADD_TEST_CASE(tcs, gc_set_generational);
+    ATF_ADD_TEST_CASE(tcs, gc_set_pause);
+    ATF_ADD_TEST_CASE(tcs, gc_set_step_multiplier);
+    ATF_ADD_TEST_CASE(tcs, gc_step);
+    ATF_ADD_TEST_CASE(tcs, gc_stop__restart);
+    ATF_ADD_TEST_CASE(tcs, get__numbers);
+    ATF_ADD_TEST_CASE(tcs, get__strings);
     ATF_ADD_TEST_CASE(tcs, get_global__ok);
     ATF_ADD_TEST_CASE(tcs, get_global__undefined);
+    ATF_ADD_TEST_CASE(tcs, get_global_unchecked);
     ATF_ADD_TEST_CASE(tcs, get_global_table);
     ATF_ADD_TEST_CASE(tcs, get_metafield__ok);
     ATF_ADD_TEST_CASE(tcs, get_metafield__undefined);
@@ -1106,12 +1912,17 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, get_table__ok);
     ATF_ADD_TEST_CASE(tcs, get_table__nil);
     ATF_ADD_TEST_CASE(tcs, get_table__unknown_index);
+    ATF_ADD_TEST_CASE(tcs, get_table_unchecked);
     ATF_ADD_TEST_CASE(tcs, get_top);
     ATF_ADD_TEST_CASE(tcs, insert);
+    ATF_ADD_TEST_CASE(tcs, is);
     ATF_ADD_TEST_CASE(tcs, is_boolean__empty);
     ATF_ADD_TEST_CASE(tcs, is_boolean__ok);
     ATF_ADD_TEST_CASE(tcs, is_function__empty);
     ATF_ADD_TEST_CASE(tcs, is_function__ok);
+    ATF_ADD_TEST_CASE(tcs, is_integer__empty);
+    ATF_ADD_TEST_CASE(tcs, is_integer__ok);
+    ATF_ADD_TEST_CASE(tcs, is_integer__out_of_range);
     ATF_ADD_TEST_CASE(tcs, is_nil__empty);
     ATF_ADD_TEST_CASE(tcs, is_nil__ok);
     ATF_ADD_TEST_CASE(tcs, is_number__empty);
@@ -1122,15 +1933,26 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, is_table__ok);
     ATF_ADD_TEST_CASE(tcs, is_userdata__empty);
     ATF_ADD_TEST_CASE(tcs, is_userdata__ok);
+    ATF_ADD_TEST_CASE(tcs, load_buffer__ok);
+    ATF_ADD_TEST_CASE(tcs, load_buffer__fail);
     ATF_ADD_TEST_CASE(tcs, load_file__ok);
     ATF_ADD_TEST_CASE(tcs, load_file__api_error);
     ATF_ADD_TEST_CASE(tcs, load_file__file_not_found_error);
+    ATF_ADD_TEST_CASE(tcs, load_mapped_file__ok);
+    ATF_ADD_TEST_CASE(tcs, load_mapped_file__empty);
+    ATF_ADD_TEST_CASE(tcs, load_mapped_file__api_error);
+    ATF_ADD_TEST_CASE(tcs, load_mapped_file__file_not_found_error);
+    ATF_ADD_TEST_CASE(tcs, load_stream__ok);
+    ATF_ADD_TEST_CASE(tcs, load_stream__binary);
+    ATF_ADD_TEST_CASE(tcs, load_stream__fail);
     ATF_ADD_TEST_CASE(tcs, load_string__ok);
     ATF_ADD_TEST_CASE(tcs, load_string__fail);
     ATF_ADD_TEST_CASE(tcs, new_table);
+    ATF_ADD_TEST_CASE(tcs, new_table__presized);
     ATF_ADD_TEST_CASE(tcs, new_userdata);
     ATF_ADD_TEST_CASE(tcs, next__empty);
     ATF_ADD_TEST_CASE(tcs, next__many);
+    ATF_ADD_TEST_CASE(tcs, next_unchecked);
     ATF_ADD_TEST_CASE(tcs, open_all);
     ATF_ADD_TEST_CASE(tcs, open_base);
     ATF_ADD_TEST_CASE(tcs, open_string);
@@ -1139,26 +1961,47 @@ ATF_INIT_TEST_CASES(tcs)
     ATF_ADD_TEST_CASE(tcs, pcall__fail);
     ATF_ADD_TEST_CASE(tcs, pop__one);
     ATF_ADD_TEST_CASE(tcs, pop__many);
+    ATF_ADD_TEST_CASE(tcs, push__scalars);
+    ATF_ADD_TEST_CASE(tcs, push__strings);
+    ATF_ADD_TEST_CASE(tcs, push__user_type);
+    ATF_ADD_TEST_CASE(tcs, push_all);
     ATF_ADD_TEST_CASE(tcs, push_boolean);
     ATF_ADD_TEST_CASE(tcs, push_cxx_closure);
+    ATF_ADD_TEST_CASE(tcs, push_cxx_closure__many_upvalues);
     ATF_ADD_TEST_CASE(tcs, push_cxx_function__ok);
     ATF_ADD_TEST_CASE(tcs, push_cxx_function__fail_exception);
     ATF_ADD_TEST_CASE(tcs, push_cxx_function__fail_anything);
     ATF_ADD_TEST_CASE(tcs, push_cxx_function__fail_overflow);
     ATF_ADD_TEST_CASE(tcs, push_integer);
+    ATF_ADD_TEST_CASE(tcs, push_integer64);
+    ATF_ADD_TEST_CASE(tcs, push_integer64__full_width);
     ATF_ADD_TEST_CASE(tcs, push_nil);
+    ATF_ADD_TEST_CASE(tcs, push_number);
+    ATF_ADD_TEST_CASE(tcs, push_static_cxx_function);
     ATF_ADD_TEST_CASE(tcs, push_string);
+    ATF_ADD_TEST_CASE(tcs, push_string__c_string);
+    ATF_ADD_TEST_CASE(tcs, push_string__embedded_nul);
     ATF_ADD_TEST_CASE(tcs, push_value);
     ATF_ADD_TEST_CASE(tcs, raw_get);
     ATF_ADD_TEST_CASE(tcs, raw_set);
     ATF_ADD_TEST_CASE(tcs, registry_index);
     ATF_ADD_TEST_CASE(tcs, set_global);
+    ATF_ADD_TEST_CASE(tcs, set_global_unchecked);
     ATF_ADD_TEST_CASE(tcs, set_metatable);
     ATF_ADD_TEST_CASE(tcs, set_table__ok);
     ATF_ADD_TEST_CASE(tcs, set_table__nil);
+    ATF_ADD_TEST_CASE(tcs, set_table_unchecked);
     ATF_ADD_TEST_CASE(tcs, to_boolean);
     ATF_ADD_TEST_CASE(tcs, to_integer);
+    ATF_ADD_TEST_CASE(tcs, to_integer64);
+    ATF_ADD_TEST_CASE(tcs, to_integer64__out_of_range);
+    ATF_ADD_TEST_CASE(tcs, to_number);
     ATF_ADD_TEST_CASE(tcs, to_string);
+    ATF_ADD_TEST_CASE(tcs, to_string__embedded_nul);
+    ATF_ADD_TEST_CASE(tcs, to_string_ref);
     ATF_ADD_TEST_CASE(tcs, to_userdata);
+    ATF_ADD_TEST_CASE(tcs, try_pcall__ok);
+    ATF_ADD_TEST_CASE(tcs, try_pcall__fail);
+    ATF_ADD_TEST_CASE(tcs, try_pcall__fail_not_string);
     ATF_ADD_TEST_CASE(tcs, upvalue_index);
 }
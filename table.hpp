@@ -0,0 +1,448 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file table.hpp
+/// Provides bulk conversions between C++ containers and Lua tables.
+///
+/// The functions in this module move whole containers in a single operation
+/// instead of one state call per element.  Tables are presized and accessed
+/// with raw operations, so metamethods are never invoked, and building a table
+/// requires a single protected call regardless of its size.
+///
+/// The elements are converted through stack_traits, so all of them must be of
+/// a supported type.
+
+#if !defined(LUTOK_TABLE_HPP)
+#define LUTOK_TABLE_HPP
+
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <lua.hpp>
+#include <lutok/c_gate.hpp>
+#include <lutok/exceptions.hpp>
+#include <lutok/stack_cleaner.hpp>
+#include <lutok/state.ipp>
+
+namespace lutok {
+namespace detail {
+
+
+/// Range of elements to be stored in a new table.
+template< typename Iterator >
+struct table_source {
+    /// Iterator to the first element.
+    Iterator begin;
+
+    /// Iterator past the last element.
+    Iterator end;
+
+    /// Number of elements in the range, used to presize the table.
+    std::size_t size;
+};
+
+
+/// Converts a count of elements to a table size hint.
+///
+/// \param size The number of elements.
+///
+/// \return The hint to pass to lua_createtable.
+inline int
+table_size_hint(const std::size_t size)
+{
+    return size > static_cast< std::size_t >(INT_MAX) ?
+        INT_MAX : static_cast< int >(size);
+}
+
+
+/// Sets the value on the top of the stack as an element of a table.
+///
+/// \param raw_state The Lua C API state.  stack(-2) is the table and stack(-1)
+///     is the value, which is popped.
+/// \param key The position of the element.
+inline void
+raw_set_element(lua_State* raw_state, const std::size_t key)
+{
+#if LUA_VERSION_NUM >= 503
+    lua_rawseti(raw_state, -2, static_cast< lua_Integer >(key));
+#else
+    if (key <= static_cast< std::size_t >(INT_MAX)) {
+        lua_rawseti(raw_state, -2, static_cast< int >(key));
+    } else {
+        lua_pushinteger(raw_state, static_cast< lua_Integer >(key));
+        lua_insert(raw_state, -2);
+        lua_rawset(raw_state, -3);
+    }
+#endif
+}
+
+
+/// Pushes an element of a table onto the stack.
+///
+/// \param raw_state The Lua C API state.
+/// \param table The absolute stack index of the table.
+/// \param key The position of the element.
+inline void
+raw_get_element(lua_State* raw_state, const int table, const std::size_t key)
+{
+#if LUA_VERSION_NUM >= 503
+    lua_rawgeti(raw_state, table, static_cast< lua_Integer >(key));
+#else
+    if (key <= static_cast< std::size_t >(INT_MAX)) {
+        lua_rawgeti(raw_state, table, static_cast< int >(key));
+    } else {
+        lua_pushinteger(raw_state, static_cast< lua_Integer >(key));
+        lua_rawget(raw_state, table);
+    }
+#endif
+}
+
+
+/// Fills a new array-like table with a range of elements.
+///
+/// \param raw_state The Lua C API state.
+/// \param source The elements to store in the table.
+///
+/// \post stack(-1) is the new table.
+template< typename Iterator >
+void
+fill_array(lua_State* raw_state, const table_source< Iterator >& source)
+{
+    typedef typename std::iterator_traits< Iterator >::value_type value_type;
+
+    lua_createtable(raw_state, table_size_hint(source.size), 0);
+    std::size_t key = 1;
+    for (Iterator iter = source.begin; iter != source.end; ++iter, ++key) {
+        stack_traits< value_type >::push(raw_state, *iter);
+        raw_set_element(raw_state, key);
+    }
+}
+
+
+/// Fills a new hash table with a range of key/value pairs.
+///
+/// \param raw_state The Lua C API state.
+/// \param source The pairs to store in the table.
+///
+/// \post stack(-1) is the new table.
+template< typename Key, typename Value, typename Iterator >
+void
+fill_map(lua_State* raw_state, const table_source< Iterator >& source)
+{
+    lua_createtable(raw_state, 0, table_size_hint(source.size));
+    for (Iterator iter = source.begin; iter != source.end; ++iter) {
+        stack_traits< Key >::push(raw_state, (*iter).first);
+        stack_traits< Value >::push(raw_state, (*iter).second);
+        lua_rawset(raw_state, -3);
+    }
+}
+
+
+/// Lua glue to build a table with one of the fill_* functions.
+///
+/// The conversions of the elements run user-provided stack_traits, which may
+/// throw.  C++ exceptions must not unwind through the Lua C frames, so they
+/// are converted to Lua errors here, the same way the C++ function trampolines
+/// do.
+///
+/// \param raw_state The Lua C API state.  stack(1) is a light userdata pointing
+///     to a table_source.
+///
+/// \return The number of return values, i.e. 1: the new table.
+template< typename Iterator,
+          void (*Fill)(lua_State*, const table_source< Iterator >&) >
+int
+protected_push(lua_State* raw_state)
+{
+    const table_source< Iterator >* source =
+        static_cast< const table_source< Iterator >* >(
+            lua_touserdata(raw_state, 1));
+
+    char error_buf[1024];
+    try {
+        Fill(raw_state, *source);
+        return 1;
+    } catch (const std::exception& e) {
+        std::strncpy(error_buf, e.what(), sizeof(error_buf));
+    } catch (...) {
+        std::strncpy(error_buf, "Unhandled exception while building a table",
+                     sizeof(error_buf));
+    }
+    error_buf[sizeof(error_buf) - 1] = '\0';
+    // Raised outside of the try/catch context, with the message in a
+    // stack-based buffer, so that the longjmp of Lua does not leak any C++
+    // objects.
+    return luaL_error(raw_state, "%s", error_buf);
+}
+
+
+/// Runs one of the protected_push instances in protected mode.
+///
+/// \param s The Lua state.
+/// \param function The function to run.
+/// \param source The source of the elements for the function.
+///
+/// \post stack(-1) is the new table.
+///
+/// \throw api_error If Lua fails to build the table or if converting any of
+///     the elements throws.
+inline void
+run_protected_push(state& s, lua_CFunction function, void* source)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    lua_pushcfunction(raw_state, function);
+    lua_pushlightuserdata(raw_state, source);
+    if (lua_pcall(raw_state, 1, 1, 0) != 0)
+        throw api_error::from_stack(s, "lua_createtable");
+}
+
+
+/// Converts a relative stack index to an absolute one.
+///
+/// \param raw_state The Lua C API state.
+/// \param index The stack index to convert.
+///
+/// \return The absolute index, which remains valid as the stack grows.
+inline int
+absolute_index(lua_State* raw_state, const int index)
+{
+    return index < 0 && index > LUA_REGISTRYINDEX ?
+        lua_gettop(raw_state) + index + 1 : index;
+}
+
+
+/// Gets the length of the array part of a table, without invoking metamethods.
+///
+/// \param raw_state The Lua C API state.
+/// \param index The stack index of the table.
+///
+/// \return The length of the table.
+inline std::size_t
+raw_length(lua_State* raw_state, const int index)
+{
+#if LUA_VERSION_NUM >= 502
+    return lua_rawlen(raw_state, index);
+#else
+    return lua_objlen(raw_state, index);
+#endif
+}
+
+
+/// Raises an error for a table element of an unexpected type.
+///
+/// \param raw_state The Lua C API state.
+/// \param index The stack index of the offending value.
+/// \param what Description of the offending element.
+///
+/// \throw error Always.
+inline void
+throw_bad_element(lua_State* raw_state, const int index,
+                  const std::string& what)
+{
+    std::ostringstream message;
+    message << what << " has unexpected type "
+            << lua_typename(raw_state, lua_type(raw_state, index));
+    throw error(message.str());
+}
+
+
+}  // namespace detail
+
+
+/// Pushes a new array-like table with a copy of a range of values.
+///
+/// The whole table is built within a single protected call.
+///
+/// \param s The Lua state.
+/// \param values Pointer to the first value of the range.
+/// \param size Number of values in the range.
+///
+/// \post stack(-1) is a table whose keys 1 to size contain the values.
+///
+/// \throw api_error If Lua fails to build the table or if converting any of
+///     the elements throws.
+template< typename Type >
+void
+push_array(state& s, const Type* values, const std::size_t size)
+{
+    detail::table_source< const Type* > source;
+    source.begin = values;
+    source.end = values + size;
+    source.size = size;
+    detail::run_protected_push(
+        s, detail::protected_push< const Type*,
+                                   detail::fill_array< const Type* > >,
+        &source);
+}
+
+
+/// Pushes a new hash table with a copy of the contents of a map.
+///
+/// The whole table is built within a single protected call.
+///
+/// \param s The Lua state.
+/// \param values The map to copy into the table.
+///
+/// \post stack(-1) is a table with the same keys and values as the map.
+///
+/// \throw api_error If Lua fails to build the table or if converting any of
+///     the elements throws.
+template< typename Key, typename Value >
+void
+push_map(state& s, const std::map< Key, Value >& values)
+{
+    typedef typename std::map< Key, Value >::const_iterator iterator;
+    detail::table_source< iterator > source;
+    source.begin = values.begin();
+    source.end = values.end();
+    source.size = values.size();
+    detail::run_protected_push(
+        s, detail::protected_push< iterator,
+                                   detail::fill_map< Key, Value, iterator > >,
+        &source);
+}
+
+
+/// Pushes a new array-like table with a copy of the contents of a vector.
+///
+/// The whole table is built within a single protected call.
+///
+/// \param s The Lua state.
+/// \param values The vector to copy into the table.
+///
+/// \post stack(-1) is a table whose keys 1 to values.size() contain the
+/// elements of the vector.
+///
+/// \throw api_error If Lua fails to build the table or if converting any of
+///     the elements throws.
+template< typename Type >
+void
+push_vector(state& s, const std::vector< Type >& values)
+{
+    typedef typename std::vector< Type >::const_iterator iterator;
+    detail::table_source< iterator > source;
+    source.begin = values.begin();
+    source.end = values.end();
+    source.size = values.size();
+    detail::run_protected_push(
+        s, detail::protected_push< iterator, detail::fill_array< iterator > >,
+        &source);
+}
+
+
+/// Copies all the entries of a table into a map.
+///
+/// The table is traversed with raw operations, which cannot raise Lua errors,
+/// so this does not need any protected calls.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the table.
+///
+/// \return A map with the keys and values of the table.
+///
+/// \throw error If the value at the given index is not a table or if any of
+///     its keys or values cannot be converted to the requested types.
+template< typename Key, typename Value >
+std::map< Key, Value >
+to_map(state& s, const int index)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    const int table = detail::absolute_index(raw_state, index);
+    if (!lua_istable(raw_state, table))
+        detail::throw_bad_element(raw_state, table, "Table");
+
+    stack_cleaner cleaner(s);
+    std::map< Key, Value > values;
+    lua_pushnil(raw_state);
+    while (lua_next(raw_state, table) != 0) {
+        // Convert a copy of the key because converting it in place, such as
+        // from a number to a string, would confuse lua_next.
+        lua_pushvalue(raw_state, -2);
+        if (!stack_traits< Key >::is(raw_state, -1))
+            detail::throw_bad_element(raw_state, -1, "Key");
+        if (!stack_traits< Value >::is(raw_state, -2))
+            detail::throw_bad_element(raw_state, -2, "Value");
+        values.insert(std::make_pair(
+            stack_traits< Key >::get(raw_state, -1),
+            stack_traits< Value >::get(raw_state, -2)));
+        lua_pop(raw_state, 2);
+    }
+    return values;
+}
+
+
+/// Copies the array part of a table into a vector.
+///
+/// The table is traversed with raw operations, which cannot raise Lua errors,
+/// so this does not need any protected calls.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the table.
+///
+/// \return A vector with the values of the keys 1 to the length of the table.
+///
+/// \throw error If the value at the given index is not a table or if any of
+///     its elements cannot be converted to the requested type.
+template< typename Type >
+std::vector< Type >
+to_vector(state& s, const int index)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    const int table = detail::absolute_index(raw_state, index);
+    if (!lua_istable(raw_state, table))
+        detail::throw_bad_element(raw_state, table, "Table");
+
+    stack_cleaner cleaner(s);
+    const std::size_t length = detail::raw_length(raw_state, table);
+    std::vector< Type > values;
+    values.reserve(length);
+    for (std::size_t i = 1; i <= length; i++) {
+        detail::raw_get_element(raw_state, table, i);
+        if (!stack_traits< Type >::is(raw_state, -1)) {
+            std::ostringstream what;
+            what << "Element " << i;
+            detail::throw_bad_element(raw_state, -1, what.str());
+        }
+        values.push_back(stack_traits< Type >::get(raw_state, -1));
+        lua_pop(raw_state, 1);
+    }
+    return values;
+}
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_TABLE_HPP)
@@ -0,0 +1,304 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "table.hpp"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// User-defined type whose conversion to Lua always fails.
+struct unpushable {
+};
+
+
+}  // anonymous namespace
+
+
+namespace lutok {
+
+
+/// Conversions for unpushable, which raise a C++ exception on push.
+template<>
+struct stack_traits< unpushable > {
+    /// Checks if a value is an unpushable.
+    ///
+    /// \return False, as no Lua value represents an unpushable.
+    static bool
+    is(lua_State* /* raw_state */, const int /* index */)
+    {
+        return false;
+    }
+
+    /// Gets an unpushable from the stack.
+    ///
+    /// \return A default value.
+    static unpushable
+    get(lua_State* /* raw_state */, const int /* index */)
+    {
+        return unpushable();
+    }
+
+    /// Fails to push an unpushable onto the stack.
+    ///
+    /// \throw std::runtime_error Always.
+    static void
+    push(lua_State* /* raw_state */, const unpushable& /* value */)
+    {
+        throw std::runtime_error("Cannot push an unpushable");
+    }
+};
+
+
+}  // namespace lutok
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_array);
+ATF_TEST_CASE_BODY(push_array)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const int values[] = { 5, 8, 13 };
+    lutok::push_array(state, values, 3);
+    state.set_global("t");
+    lutok::do_string(state, "return #t, t[1], t[2], t[3]", 0, 4, 0);
+    ATF_REQUIRE_EQ(3, state.to_integer(-4));
+    ATF_REQUIRE_EQ(5, state.to_integer(-3));
+    ATF_REQUIRE_EQ(8, state.to_integer(-2));
+    ATF_REQUIRE_EQ(13, state.to_integer(-1));
+    state.pop(4);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_vector__strings);
+ATF_TEST_CASE_BODY(push_vector__strings)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    std::vector< std::string > values;
+    values.push_back("first");
+    values.push_back(std::string("with\0nul", 8));
+    lutok::push_vector(state, values);
+    lua_rawgeti(raw(state), -1, 1);
+    ATF_REQUIRE_EQ("first", state.to_string(-1));
+    lua_rawgeti(raw(state), -2, 2);
+    ATF_REQUIRE(std::string("with\0nul", 8) == state.to_string(-1));
+    state.pop(3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_vector__empty);
+ATF_TEST_CASE_BODY(push_vector__empty)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::push_vector(state, std::vector< bool >());
+    ATF_REQUIRE(state.is_table(-1));
+    state.push_nil();
+    ATF_REQUIRE(!state.next(-2));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_map);
+ATF_TEST_CASE_BODY(push_map)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    std::map< std::string, double > values;
+    values["pi"] = 3.5;
+    values["e"] = 2.5;
+    lutok::push_map(state, values);
+    state.set_global("t");
+    lutok::do_string(state, "return t.pi, t.e, t[1]", 0, 3, 0);
+    ATF_REQUIRE_EQ(3.5, state.get< double >(-3));
+    ATF_REQUIRE_EQ(2.5, state.get< double >(-2));
+    ATF_REQUIRE(state.is_nil(-1));
+    state.pop(3);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(push_vector__throws);
+ATF_TEST_CASE_BODY(push_vector__throws)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    const std::vector< unpushable > values(3);
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "Cannot push an unpushable",
+                         lutok::push_vector(state, values));
+
+    std::map< std::string, unpushable > map_values;
+    map_values["key"] = unpushable();
+    ATF_REQUIRE_THROW_RE(lutok::api_error, "Cannot push an unpushable",
+                         lutok::push_map(state, map_values));
+
+    state.push_integer(7);
+    ATF_REQUIRE_EQ(7, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_vector__ok);
+ATF_TEST_CASE_BODY(to_vector__ok)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {10, 20, 30, foo='ignored'}", 0, 1, 0);
+    state.push_integer(123);
+    const std::vector< int > values = lutok::to_vector< int >(state, -2);
+    ATF_REQUIRE_EQ(3, values.size());
+    ATF_REQUIRE_EQ(10, values[0]);
+    ATF_REQUIRE_EQ(20, values[1]);
+    ATF_REQUIRE_EQ(30, values[2]);
+    state.pop(2);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_vector__raw);
+ATF_TEST_CASE_BODY(to_vector__raw)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return setmetatable({'a'}, "
+                     "{__index=function() error('called') end})", 0, 1, 0);
+    const std::vector< std::string > values =
+        lutok::to_vector< std::string >(state, -1);
+    ATF_REQUIRE_EQ(1, values.size());
+    ATF_REQUIRE_EQ("a", values[0]);
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_vector__bad_element);
+ATF_TEST_CASE_BODY(to_vector__bad_element)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {1, 2, {}, 4}", 0, 1, 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Element 3 has unexpected type table",
+                         lutok::to_vector< int >(state, -1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_vector__not_a_table);
+ATF_TEST_CASE_BODY(to_vector__not_a_table)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.push_integer(5);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Table has unexpected type number",
+                         lutok::to_vector< int >(state, -1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_map__ok);
+ATF_TEST_CASE_BODY(to_map__ok)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {a=1, b=2, [3]=4}", 0, 1, 0);
+    const std::map< std::string, int > values =
+        lutok::to_map< std::string, int >(state, -1);
+    ATF_REQUIRE_EQ(3, values.size());
+    ATF_REQUIRE_EQ(1, values.find("a")->second);
+    ATF_REQUIRE_EQ(2, values.find("b")->second);
+    ATF_REQUIRE_EQ(4, values.find("3")->second);
+    ATF_REQUIRE(state.is_table(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(to_map__bad_value);
+ATF_TEST_CASE_BODY(to_map__bad_value)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return {a=1, b=true}", 0, 1, 0);
+    ATF_REQUIRE_THROW_RE(lutok::error, "Value has unexpected type boolean",
+                         (lutok::to_map< std::string, int >(state, -1)));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(round_trip);
+ATF_TEST_CASE_BODY(round_trip)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    std::vector< double > original;
+    for (int i = 0; i < 1000; i++)
+        original.push_back(i / 4.0);
+    lutok::push_vector(state, original);
+    ATF_REQUIRE(original == lutok::to_vector< double >(state, -1));
+    state.pop(1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, push_array);
+    ATF_ADD_TEST_CASE(tcs, push_vector__strings);
+    ATF_ADD_TEST_CASE(tcs, push_vector__empty);
+    ATF_ADD_TEST_CASE(tcs, push_map);
+    ATF_ADD_TEST_CASE(tcs, push_vector__throws);
+    ATF_ADD_TEST_CASE(tcs, to_vector__ok);
+    ATF_ADD_TEST_CASE(tcs, to_vector__raw);
+    ATF_ADD_TEST_CASE(tcs, to_vector__bad_element);
+    ATF_ADD_TEST_CASE(tcs, to_vector__not_a_table);
+    ATF_ADD_TEST_CASE(tcs, to_map__ok);
+    ATF_ADD_TEST_CASE(tcs, to_map__bad_value);
+    ATF_ADD_TEST_CASE(tcs, round_trip);
+}
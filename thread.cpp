@@ -0,0 +1,205 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "thread.hpp"
+
+#include <lua.hpp>
+
+#include "c_gate.hpp"
+#include "exceptions.hpp"
+#include "ref.hpp"
+#include "state.ipp"
+
+
+/// Internal implementation for lutok::thread.
+struct lutok::thread::impl {
+    /// The coroutine.
+    lua_State* thread_state;
+
+    /// The reference to the coroutine in the registry.
+    ref reference;
+
+    /// Wrapper over the stack of the coroutine.
+    state wrapper;
+
+    /// Whether the coroutine has returned or failed.
+    bool finished;
+
+    /// Number of values yielded or returned by the last call to resume().
+    int results;
+
+    /// Pins the coroutine on the top of the stack in the registry.
+    ///
+    /// \param s The Lua state.  The coroutine on the top of its stack is
+    ///     popped.
+    impl(state& s) :
+        thread_state(lua_tothread(state_c_gate(s).c_state(), -1)),
+        reference(s, -1),
+        wrapper(state_c_gate::connect(thread_state)),
+        finished(false),
+        results(0)
+    {
+        s.pop(1);
+    }
+};
+
+
+/// Creates a handle from its internal implementation.
+///
+/// \param pimpl The internal implementation, whose ownership is transferred.
+lutok::thread::thread(impl* pimpl) :
+    _pimpl(pimpl)
+{
+}
+
+
+/// Creates a new coroutine to run a function.
+///
+/// \param s The Lua state.
+/// \param index The stack index of the function to run.  The function is not
+///     removed from the stack.
+///
+/// \throw error If the value at the given index is not a function.
+///
+/// \warning Terminates execution if there is not enough memory.
+lutok::thread::thread(state& s, const int index)
+{
+    if (!s.is_function(index))
+        throw lutok::error("Cannot run a value that is not a function in a "
+                           "thread");
+    lua_State* raw_state = state_c_gate(s).c_state();
+    lua_State* thread_state = lua_newthread(raw_state);
+    lua_pushvalue(raw_state, index < 0 ? index - 1 : index);
+    lua_xmove(raw_state, thread_state, 1);
+    _pimpl.reset(new impl(s));
+}
+
+
+/// Destructor.
+lutok::thread::~thread(void)
+{
+}
+
+
+/// Gets a handle to the coroutine that is currently running.
+///
+/// This is the integration point for event loops: a C++ function called from
+/// a coroutine uses this to capture the coroutine, hands the handle to the
+/// code that will complete its asynchronous work, and then returns the value
+/// of state::yield().  The handle can later be used to resume the coroutine.
+///
+/// \param s The Lua state as received by the C++ function.
+///
+/// \return A handle to the coroutine.
+///
+/// \throw error If the code is not running in a coroutine.
+lutok::thread
+lutok::thread::running(state& s)
+{
+    lua_State* raw_state = state_c_gate(s).c_state();
+    if (lua_pushthread(raw_state) == 1) {
+        lua_pop(raw_state, 1);
+        throw lutok::error("The main thread is not a coroutine");
+    }
+    return thread(new impl(s));
+}
+
+
+/// Checks if the coroutine has completed.
+///
+/// \return True if the function of the coroutine has returned or raised an
+/// error, in which case the coroutine cannot be resumed again.
+bool
+lutok::thread::finished(void) const
+{
+    return _pimpl->finished;
+}
+
+
+/// Gets the number of values yielded or returned by the coroutine.
+///
+/// \return The number of values that the last call to resume() left on the
+/// top of the stack of the coroutine.
+int
+lutok::thread::results(void) const
+{
+    return _pimpl->results;
+}
+
+
+/// Starts or continues the execution of the coroutine.
+///
+/// \param nargs The number of arguments on the top of the stack of the
+///     coroutine.  These are passed to the function of the coroutine on the
+///     first call, or become the results of the yield that suspended it
+///     otherwise.
+///
+/// \return True if the coroutine yielded, or false if it returned.  In both
+/// cases, the top results() values of the stack of the coroutine are the
+/// values that it yielded or returned.
+///
+/// \throw api_error If the coroutine raised an error, which leaves it
+///     finished.
+bool
+lutok::thread::resume(const int nargs)
+{
+    if (_pimpl->finished)
+        throw lutok::error("Cannot resume a finished thread");
+
+    _pimpl->results = 0;
+#if LUA_VERSION_NUM >= 504
+    int nresults;
+    const int status = lua_resume(_pimpl->thread_state, NULL, nargs,
+                                  &nresults);
+#elif LUA_VERSION_NUM >= 502
+    const int status = lua_resume(_pimpl->thread_state, NULL, nargs);
+#else
+    const int status = lua_resume(_pimpl->thread_state, nargs);
+#endif
+    if (status != LUA_YIELD)
+        _pimpl->finished = true;
+    if (status != LUA_YIELD && status != 0)
+        throw lutok::api_error::from_stack(_pimpl->wrapper, "lua_resume");
+#if LUA_VERSION_NUM >= 504
+    _pimpl->results = nresults;
+#else
+    // Before Lua 5.4, the stack only holds the results at this point.
+    _pimpl->results = lua_gettop(_pimpl->thread_state);
+#endif
+    return status == LUA_YIELD;
+}
+
+
+/// Gets the stack of the coroutine.
+///
+/// \return A state object that operates on the stack of the coroutine.
+lutok::state&
+lutok::thread::thread_state(void)
+{
+    return _pimpl->wrapper;
+}
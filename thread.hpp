@@ -0,0 +1,94 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file thread.hpp
+/// Provides the thread class to run Lua code as coroutines.
+
+#if !defined(LUTOK_THREAD_HPP)
+#define LUTOK_THREAD_HPP
+
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+#include <memory>
+#else
+#include <tr1/memory>
+#endif
+
+namespace lutok {
+
+
+class state;
+
+
+/// Handle to a Lua thread, also known as a coroutine.
+///
+/// A thread runs a function that can suspend itself and be resumed later,
+/// either from Lua code through coroutine.yield or from C++ functions through
+/// state::yield().  This allows a single OS thread to multiplex many scripts
+/// that wait for asynchronous operations: the C++ function that starts the
+/// operation captures the coroutine that called it with running(), yields,
+/// and the event loop resumes the coroutine once the operation completes,
+/// passing the outcome of the operation as the arguments to resume().
+///
+/// Each thread has its own stack, which is accessible through thread_state().
+/// The arguments to resume() are pushed onto this stack, and the values
+/// yielded or returned by the coroutine are left on its top.  results() tells
+/// how many there are: the stack may hold other values below them, such as the
+/// arguments of a C++ function that yielded.  Pop the results before resuming
+/// the coroutine again.
+///
+/// The coroutine is pinned in the registry of the state so that it is not
+/// collected while any copy of this object exists.  All copies must be
+/// destroyed before the Lua state they belong to is closed.
+class thread {
+    struct impl;
+
+    /// Pointer to the shared internal implementation.
+#if defined(_LIBCPP_VERSION) || __cplusplus >= 201103L
+    std::shared_ptr< impl > _pimpl;
+#else
+    std::tr1::shared_ptr< impl > _pimpl;
+#endif
+
+    explicit thread(impl*);
+
+public:
+    thread(state&, const int);
+    ~thread(void);
+
+    static thread running(state&);
+
+    bool finished(void) const;
+    int results(void) const;
+    bool resume(const int);
+    state& thread_state(void);
+};
+
+
+}  // namespace lutok
+
+#endif  // !defined(LUTOK_THREAD_HPP)
@@ -0,0 +1,247 @@
+// Copyright 2026 Google Inc.
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// * Neither the name of Google Inc. nor the names of its contributors
+//   may be used to endorse or promote products derived from this software
+//   without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+// A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+// OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+// LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+// THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "thread.hpp"
+
+#include <vector>
+
+#include <atf-c++.hpp>
+#include <lua.hpp>
+
+#include "exceptions.hpp"
+#include "operations.hpp"
+#include "state.ipp"
+#include "test_utils.hpp"
+
+
+namespace {
+
+
+/// Coroutines waiting for a value, as an event loop would keep them.
+static std::vector< lutok::thread > pending;
+
+
+/// C++ function that yields its argument multiplied by 10.
+///
+/// \param state The Lua state.
+///
+/// \return The value of state.yield().
+static int
+cxx_yield(lutok::state& state)
+{
+    state.push_integer(state.to_integer(-1) * 10);
+    return state.yield(1);
+}
+
+
+/// C++ function that suspends the caller until a value is available.
+///
+/// \param state The Lua state.
+///
+/// \return The value of state.yield().
+static int
+cxx_wait(lutok::state& state)
+{
+    pending.push_back(lutok::thread::running(state));
+    return state.yield(0);
+}
+
+
+}  // anonymous namespace
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(resume__return);
+ATF_TEST_CASE_BODY(resume__return)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return function(a, b) return a + b, a * b end",
+                     0, 1, 0);
+    lutok::thread thread(state, -1);
+    state.pop(1);
+
+    lutok::state& stack = thread.thread_state();
+    stack.push_integer(3);
+    stack.push_integer(4);
+    ATF_REQUIRE(!thread.resume(2));
+    ATF_REQUIRE(thread.finished());
+    ATF_REQUIRE_EQ(2, thread.results());
+    ATF_REQUIRE_EQ(7, stack.to_integer(-2));
+    ATF_REQUIRE_EQ(12, stack.to_integer(-1));
+    stack.pop(2);
+
+    ATF_REQUIRE_THROW_RE(lutok::error, "finished", thread.resume(0));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(resume__lua_yield);
+ATF_TEST_CASE_BODY(resume__lua_yield)
+{
+    lutok::state state;
+    state.open_all();
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return function(a) "
+                     "local b = coroutine.yield(a + 1); return b * 2 end",
+                     0, 1, 0);
+    lutok::thread thread(state, -1);
+    state.pop(1);
+
+    lutok::state& stack = thread.thread_state();
+    stack.push_integer(1);
+    ATF_REQUIRE(thread.resume(1));
+    ATF_REQUIRE(!thread.finished());
+    ATF_REQUIRE_EQ(1, thread.results());
+    ATF_REQUIRE_EQ(2, stack.to_integer(-1));
+    stack.pop(1);
+
+    stack.push_integer(21);
+    ATF_REQUIRE(!thread.resume(1));
+    ATF_REQUIRE_EQ(1, thread.results());
+    ATF_REQUIRE_EQ(42, stack.to_integer(-1));
+    stack.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(resume__cxx_yield);
+ATF_TEST_CASE_BODY(resume__cxx_yield)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.push_cxx_function(cxx_yield);
+    state.set_global("cxx_yield");
+    lutok::do_string(state, "return function() "
+                     "local a = cxx_yield(4); return a + 1 end", 0, 1, 0);
+    lutok::thread thread(state, -1);
+    state.pop(1);
+
+    lutok::state& stack = thread.thread_state();
+    ATF_REQUIRE(thread.resume(0));
+    ATF_REQUIRE_EQ(1, thread.results());
+    ATF_REQUIRE_EQ(40, stack.to_integer(-1));
+    stack.pop(thread.results());
+
+    stack.push_integer(99);
+    ATF_REQUIRE(!thread.resume(1));
+    ATF_REQUIRE_EQ(1, thread.results());
+    ATF_REQUIRE_EQ(100, stack.to_integer(-1));
+    stack.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(resume__error);
+ATF_TEST_CASE_BODY(resume__error)
+{
+    lutok::state state;
+    state.open_base();
+    stack_balance_checker checker(state);
+
+    lutok::do_string(state, "return function() error('oops') end", 0, 1, 0);
+    lutok::thread thread(state, -1);
+    state.pop(1);
+
+    REQUIRE_API_ERROR("lua_resume", thread.resume(0));
+    ATF_REQUIRE(thread.finished());
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(event_loop);
+ATF_TEST_CASE_BODY(event_loop)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.push_cxx_function(cxx_wait);
+    state.set_global("wait");
+    lutok::do_string(state, "total = 0; return function(id) "
+                     "local value = wait(); total = total + id * value end",
+                     0, 1, 0);
+
+    std::vector< lutok::thread > threads;
+    for (int i = 1; i <= 100; i++) {
+        lutok::thread thread(state, -1);
+        thread.thread_state().push_integer(i);
+        ATF_REQUIRE(thread.resume(1));
+        threads.push_back(thread);
+    }
+    state.pop(1);
+    ATF_REQUIRE_EQ(100, pending.size());
+
+    std::vector< lutok::thread > ready;
+    ready.swap(pending);
+    for (std::vector< lutok::thread >::iterator iter = ready.begin();
+         iter != ready.end(); ++iter) {
+        iter->thread_state().push_integer(2);
+        ATF_REQUIRE(!iter->resume(1));
+    }
+    for (std::vector< lutok::thread >::const_iterator iter = threads.begin();
+         iter != threads.end(); ++iter)
+        ATF_REQUIRE(iter->finished());
+
+    state.get_global("total");
+    ATF_REQUIRE_EQ(100 * 101, state.to_integer(-1));
+    state.pop(1);
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(running__main_thread);
+ATF_TEST_CASE_BODY(running__main_thread)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    ATF_REQUIRE_THROW_RE(lutok::error, "not a coroutine",
+                         lutok::thread::running(state));
+}
+
+
+ATF_TEST_CASE_WITHOUT_HEAD(ctor__not_a_function);
+ATF_TEST_CASE_BODY(ctor__not_a_function)
+{
+    lutok::state state;
+    stack_balance_checker checker(state);
+
+    state.push_integer(5);
+    ATF_REQUIRE_THROW_RE(lutok::error, "not a function",
+                         lutok::thread(state, -1));
+    state.pop(1);
+}
+
+
+ATF_INIT_TEST_CASES(tcs)
+{
+    ATF_ADD_TEST_CASE(tcs, resume__return);
+    ATF_ADD_TEST_CASE(tcs, resume__lua_yield);
+    ATF_ADD_TEST_CASE(tcs, resume__cxx_yield);
+    ATF_ADD_TEST_CASE(tcs, resume__error);
+    ATF_ADD_TEST_CASE(tcs, event_loop);
+    ATF_ADD_TEST_CASE(tcs, running__main_thread);
+    ATF_ADD_TEST_CASE(tcs, ctor__not_a_function);
+}